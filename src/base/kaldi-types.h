@@ -40,6 +40,7 @@ typedef float   BaseFloat;
 #include <stdint.h>
 
 namespace kaldi {
+typedef int8_t          int8;
 typedef uint16_t        uint16;
 typedef uint32_t        uint32;
 typedef uint64_t        uint64;
@@ -29,6 +29,21 @@
 #include "base/timer.h"
 #include "lat/kaldi-lattice.h" // for {Compact}LatticeArc
 
+namespace kaldi {
+// Decodes one utterance and gets the best path; returns true if there was
+// any output.  This is templated so we can use either type of
+// FasterDecoderTpl.
+template<class Decoder>
+bool DecodeBestPath(Decoder *decoder, DecodableInterface *decodable,
+                    bool allow_partial, fst::VectorFst<LatticeArc> *decoded,
+                    bool *reached_final) {
+  decoder->Decode(decodable);
+  *reached_final = decoder->ReachedFinal();
+  return ((allow_partial || *reached_final) &&
+          decoder->GetBestPath(decoded));
+}
+}
+
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
@@ -46,6 +61,7 @@ int main(int argc, char *argv[]) {
     bool binary = true;
     BaseFloat acoustic_scale = 0.1;
     bool allow_partial = true;
+    bool flat_hash = false;
     std::string word_syms_filename;
     FasterDecoderOptions decoder_opts;
     decoder_opts.Register(&po, true);  // true == include obscure settings.
@@ -53,6 +69,9 @@ int main(int argc, char *argv[]) {
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("allow-partial", &allow_partial, "Produce output even when final state was not reached");
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
+    po.Register("flat-hash", &flat_hash, "If true, use FlatHashList instead of "
+                "HashList to index the decoder's tokens (faster with large "
+                "beams; output is the same).");
 
     po.Read(argc, argv);
 
@@ -94,6 +113,7 @@ int main(int argc, char *argv[]) {
     kaldi::int64 frame_count = 0;
     int num_success = 0, num_fail = 0;
     FasterDecoder decoder(*decode_fst, decoder_opts);
+    FasterDecoderTpl<FlatHashList> flat_decoder(*decode_fst, decoder_opts);
 
     Timer timer;
 
@@ -108,14 +128,17 @@ int main(int argc, char *argv[]) {
       }
 
       DecodableMatrixScaledMapped decodable(trans_model, loglikes, acoustic_scale);
-      decoder.Decode(&decodable);
-
       VectorFst<LatticeArc> decoded;  // linear FST.
-
-      if ( (allow_partial || decoder.ReachedFinal())
-           && decoder.GetBestPath(&decoded) ) {
+      bool reached_final;
+      bool ans = (flat_hash ?
+                  DecodeBestPath(&flat_decoder, &decodable, allow_partial,
+                                 &decoded, &reached_final) :
+                  DecodeBestPath(&decoder, &decodable, allow_partial,
+                                 &decoded, &reached_final));
+
+      if (ans) {
         num_success++;
-        if (!decoder.ReachedFinal())
+        if (!reached_final)
           KALDI_WARN << "Decoder did not reach end-state, outputting partial traceback.";
 
         std::vector<int32> alignment;
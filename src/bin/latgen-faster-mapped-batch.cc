@@ -0,0 +1,201 @@
+// bin/latgen-faster-mapped-batch.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/decoder-wrappers.h"
+#include "decoder/decodable-matrix.h"
+#include "decoder/lattice-faster-batch-decoder.h"
+#include "base/timer.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    using fst::SymbolTable;
+    using fst::VectorFst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Generate lattices, reading log-likelihoods as matrices, decoding several\n"
+        "utterances at once in lockstep so that they share the traversal of the\n"
+        "decoding graph (see LatticeFasterBatchDecoder).  As soon as an utterance\n"
+        "finishes, the next one is started in its place, so lattices are written\n"
+        "in the order in which they finish, not the input order.  The real-time\n"
+        "factor printed at the end may be compared with that of\n"
+        "latgen-faster-mapped-parallel to measure throughput.\n"
+        " (model is needed only for the integer mappings in its transition-model)\n"
+        "Usage: latgen-faster-mapped-batch [options] trans-model-in fst-in "
+        "loglikes-rspecifier lattice-wspecifier [ words-wspecifier "
+        "[alignments-wspecifier] ]\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false;
+    BaseFloat acoustic_scale = 0.1;
+    int32 batch_size = 32;
+    LatticeFasterDecoderConfig config;
+
+    std::string word_syms_filename;
+    config.Register(&po);
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
+    po.Register("batch-size", &batch_size, "Number of utterances decoded at "
+                "the same time.");
+    po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
+    po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 4 || po.NumArgs() > 6) {
+      po.PrintUsage();
+      exit(1);
+    }
+    if (batch_size <= 0)
+      KALDI_ERR << "Invalid --batch-size " << batch_size;
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_in_str = po.GetArg(2),
+        feature_rspecifier = po.GetArg(3),
+        lattice_wspecifier = po.GetArg(4),
+        words_wspecifier = po.GetOptArg(5),
+        alignment_wspecifier = po.GetOptArg(6);
+
+    if (ClassifyRspecifier(fst_in_str, NULL, NULL) != kNoRspecifier)
+      KALDI_ERR << "latgen-faster-mapped-batch requires a single decoding "
+                << "graph (all utterances must share it); use "
+                << "latgen-faster-mapped for per-utterance graphs.";
+
+    TransitionModel trans_model;
+    ReadKaldiObject(model_in_filename, &trans_model);
+
+    bool determinize = config.determinize_lattice;
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+           : lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    Int32VectorWriter words_writer(words_wspecifier);
+
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_filename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                   << word_syms_filename;
+
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+    int num_success = 0, num_fail = 0;
+
+    SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
+    fst::Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
+
+    {
+      LatticeFasterBatchDecoder decoder(*decode_fst, config, batch_size);
+      // loglikes[s] holds the log-likelihoods of the utterance being decoded
+      // on stream s, and decodables[s], which refers to it, is NULL if stream
+      // s is idle.
+      std::vector<Matrix<BaseFloat> > loglikes(batch_size);
+      std::vector<DecodableInterface*> decodables(batch_size, NULL);
+      std::vector<std::string> utts(batch_size);
+
+      try {
+        while (true) {
+          // Start new utterances on any idle streams.
+          for (int32 s = 0; s < batch_size && !loglike_reader.Done(); s++) {
+            if (decodables[s] != NULL) continue;
+            for (; !loglike_reader.Done(); loglike_reader.Next()) {
+              std::string utt = loglike_reader.Key();
+              loglikes[s] = loglike_reader.Value();
+              loglike_reader.FreeCurrent();
+              if (loglikes[s].NumRows() == 0) {
+                KALDI_WARN << "Zero-length utterance: " << utt;
+                num_fail++;
+                continue;
+              }
+              utts[s] = utt;
+              decodables[s] = new DecodableMatrixScaledMapped(
+                  trans_model, loglikes[s], acoustic_scale);
+              decoder.InitDecoding(s);
+              loglike_reader.Next();
+              break;
+            }
+          }
+
+          bool any_active = false;
+          for (int32 s = 0; s < batch_size; s++)
+            if (decodables[s] != NULL) any_active = true;
+          if (!any_active) break;
+
+          // Decode one frame at a time, so that finished streams can be
+          // refilled promptly.
+          decoder.AdvanceDecoding(decodables, 1);
+
+          for (int32 s = 0; s < batch_size; s++) {
+            if (decodables[s] == NULL) continue;
+            LatticeFasterDecoder &stream_decoder = decoder.GetDecoder(s);
+            int32 num_frames = decodables[s]->NumFramesReady();
+            if (stream_decoder.NumFramesDecoded() < num_frames) continue;
+            stream_decoder.FinalizeDecoding();
+            double like;
+            if (OutputDecodedUtteranceLatticeFaster(
+                    stream_decoder, trans_model, word_syms, utts[s],
+                    acoustic_scale, determinize, allow_partial,
+                    &alignment_writer, &words_writer, &compact_lattice_writer,
+                    &lattice_writer, &like)) {
+              tot_like += like;
+              frame_count += num_frames;
+              num_success++;
+            } else num_fail++;
+            delete decodables[s];
+            decodables[s] = NULL;
+          }
+        }
+      } catch (...) {
+        // Free the decodables of the utterances that were being decoded.
+        DeletePointers(&decodables);
+        throw;
+      }
+    }
+    delete decode_fst; // delete this only after decoder goes out of scope.
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Decoded with batch size " << batch_size;
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor assuming 100 frames/sec is "
+              << (elapsed*100.0/frame_count);
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+    KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
+              << frame_count<<" frames.";
+
+    if (word_syms) delete word_syms;
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,192 @@
+// bin/latgen-faster-mapped-lookahead.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "lm/const-arpa-lm.h"
+#include "decoder/decoder-wrappers.h"
+#include "decoder/decodable-matrix.h"
+#include "base/timer.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    using fst::SymbolTable;
+    using fst::VectorFst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Generate lattices, reading log-likelihoods as matrices, with a\n"
+        "decoding graph that is composed on the fly from HCL and the grammar\n"
+        "(so HCLG never has to be built).  The HCL graph must have the\n"
+        "disambiguation symbols removed from its output side, and the grammar\n"
+        "must not contain them either, e.g.:\n"
+        "  fstrmsymbols --remove-from-output=true disambig_words.int HCL.fst\n"
+        "(or the grammar may be a ConstArpaLm, see --use-const-arpa).  The\n"
+        "HCL graph may be in MappedFst format (see fstmakemapped).\n"
+        " (model is needed only for the integer mappings in its transition-model)\n"
+        "Usage: latgen-faster-mapped-lookahead [options] trans-model-in HCL-fst-in "
+        "(G-fst-in|const-arpa-in) loglikes-rspecifier lattice-wspecifier "
+        "[ words-wspecifier [alignments-wspecifier] ]\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false;
+    bool use_const_arpa = false;
+    BaseFloat acoustic_scale = 0.1;
+    int32 lm_cache_size = 100000;
+    LatticeFasterDecoderConfig config;
+    fst::LookaheadComposeOptions compose_opts;
+
+    std::string word_syms_filename;
+    config.Register(&po);
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
+
+    po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
+    po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("use-const-arpa", &use_const_arpa, "If true, read the grammar "
+                "as a ConstArpaLm (see arpa-to-const-arpa) rather than as an FST.");
+    po.Register("lookahead", &compose_opts.lookahead, "If true, push an "
+                "estimate of the LM cost of each word back to the start of the "
+                "word, for better pruning (does not change the total costs).");
+    po.Register("cache-size", &compose_opts.cache_size, "Maximum number of "
+                "arcs of the composed graph to cache.");
+    po.Register("lm-cache-size", &lm_cache_size, "Number of LM arcs to cache.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 5 || po.NumArgs() > 7) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        hcl_in_str = po.GetArg(2),
+        lm_in_str = po.GetArg(3),
+        feature_rspecifier = po.GetArg(4),
+        lattice_wspecifier = po.GetArg(5),
+        words_wspecifier = po.GetOptArg(6),
+        alignment_wspecifier = po.GetOptArg(7);
+
+    TransitionModel trans_model;
+    ReadKaldiObject(model_in_filename, &trans_model);
+
+    bool determinize = config.determinize_lattice;
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+           : lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    Int32VectorWriter words_writer(words_wspecifier);
+
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_filename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                   << word_syms_filename;
+
+    fst::Fst<StdArc> *hcl_fst = fst::ReadFstKaldiGeneric(hcl_in_str);
+
+    // The grammar, as a DeterministicOnDemandFst.
+    ConstArpaLm const_arpa;
+    VectorFst<StdArc> *lm_fst = NULL;
+    fst::DeterministicOnDemandFst<StdArc> *lm_dfst = NULL;
+    if (use_const_arpa) {
+      ReadKaldiObject(lm_in_str, &const_arpa);
+      lm_dfst = new ConstArpaLmDeterministicFst(const_arpa);
+    } else {
+      lm_fst = fst::ReadFstKaldi(lm_in_str);
+      if (lm_fst->Properties(fst::kILabelSorted, true) == 0)
+        fst::ArcSort(lm_fst, fst::ILabelCompare<StdArc>());
+      lm_dfst = new fst::BackoffDeterministicOnDemandFst<StdArc>(*lm_fst);
+    }
+    fst::CacheDeterministicOnDemandFst<StdArc> cached_lm_dfst(lm_dfst,
+                                                             lm_cache_size);
+
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+    int num_success = 0, num_fail = 0;
+
+    Timer compose_timer;
+    fst::LookaheadComposeFst<StdArc> decode_fst(*hcl_fst, &cached_lm_dfst,
+                                                compose_opts);
+    KALDI_LOG << "Initialized on-the-fly composition in "
+              << compose_timer.Elapsed() << " seconds.";
+
+    {
+      LatticeFasterDecoder decoder(decode_fst, config);
+      SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
+      for (; !loglike_reader.Done(); loglike_reader.Next()) {
+        std::string utt = loglike_reader.Key();
+        Matrix<BaseFloat> loglikes (loglike_reader.Value());
+        loglike_reader.FreeCurrent();
+        if (loglikes.NumRows() == 0) {
+          KALDI_WARN << "Zero-length utterance: " << utt;
+          num_fail++;
+          continue;
+        }
+
+        DecodableMatrixScaledMapped decodable(trans_model, loglikes, acoustic_scale);
+
+        double like;
+        if (DecodeUtteranceLatticeFaster(
+                decoder, decodable, trans_model, word_syms, utt,
+                acoustic_scale, determinize, allow_partial, &alignment_writer,
+                &words_writer, &compact_lattice_writer, &lattice_writer,
+                &like)) {
+          tot_like += like;
+          frame_count += loglikes.NumRows();
+          num_success++;
+        } else num_fail++;
+      }
+    }
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor assuming 100 frames/sec is "
+              << (elapsed*100.0/frame_count);
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+    KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
+              << frame_count<<" frames.";
+    // The number of states is a measure of how much of HCLG we had to build;
+    // the cached arcs account for most of the memory used by the graph.
+    KALDI_LOG << "Composed graph has " << decode_fst.NumStatesCreated()
+              << " states, of which " << decode_fst.NumCachedArcs()
+              << " arcs are currently cached.";
+
+    delete lm_dfst;
+    delete lm_fst;
+    delete hcl_fst;
+    if (word_syms) delete word_syms;
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -46,6 +46,7 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     Timer timer;
     bool allow_partial = false;
+    bool flat_hash = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
     
@@ -55,6 +56,9 @@ int main(int argc, char *argv[]) {
 
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("flat-hash", &flat_hash, "If true, use FlatHashList instead of "
+                "HashList to index the decoder's tokens (faster with large "
+                "beams; output is the same).");
     
     po.Read(argc, argv);
 
@@ -98,10 +102,11 @@ int main(int argc, char *argv[]) {
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
-      VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+      fst::Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
 
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
+        LatticeFasterDecoderTpl<FlatHashList> flat_decoder(*decode_fst, config);
     
         for (; !loglike_reader.Done(); loglike_reader.Next()) {
           std::string utt = loglike_reader.Key();
@@ -116,11 +121,18 @@ int main(int argc, char *argv[]) {
           DecodableMatrixScaledMapped decodable(trans_model, loglikes, acoustic_scale);
 
           double like;
-          if (DecodeUtteranceLatticeFaster(
+          bool ans = (flat_hash ?
+              DecodeUtteranceLatticeFaster(
+                  flat_decoder, decodable, trans_model, word_syms, utt,
+                  acoustic_scale, determinize, allow_partial, &alignment_writer,
+                  &words_writer, &compact_lattice_writer, &lattice_writer,
+                  &like) :
+              DecodeUtteranceLatticeFaster(
                   decoder, decodable, trans_model, word_syms, utt,
                   acoustic_scale, determinize, allow_partial, &alignment_writer,
                   &words_writer, &compact_lattice_writer, &lattice_writer,
-                  &like)) {
+                  &like));
+          if (ans) {
             tot_like += like;
             frame_count += loglikes.NumRows();
             num_success++;
@@ -145,13 +157,24 @@ int main(int argc, char *argv[]) {
           num_fail++;
           continue;
         }
-        LatticeFasterDecoder decoder(fst_reader.Value(), config);
         DecodableMatrixScaledMapped decodable(trans_model, loglikes, acoustic_scale);
         double like;
-        if (DecodeUtteranceLatticeFaster(
-                decoder, decodable, trans_model, word_syms, utt, acoustic_scale,
-                determinize, allow_partial, &alignment_writer, &words_writer,
-                &compact_lattice_writer, &lattice_writer, &like)) {
+        bool ans;
+        if (flat_hash) {
+          LatticeFasterDecoderTpl<FlatHashList> decoder(fst_reader.Value(),
+                                                        config);
+          ans = DecodeUtteranceLatticeFaster(
+              decoder, decodable, trans_model, word_syms, utt, acoustic_scale,
+              determinize, allow_partial, &alignment_writer, &words_writer,
+              &compact_lattice_writer, &lattice_writer, &like);
+        } else {
+          LatticeFasterDecoder decoder(fst_reader.Value(), config);
+          ans = DecodeUtteranceLatticeFaster(
+              decoder, decodable, trans_model, word_syms, utt, acoustic_scale,
+              determinize, allow_partial, &alignment_writer, &words_writer,
+              &compact_lattice_writer, &lattice_writer, &like);
+        }
+        if (ans) {
           tot_like += like;
           frame_count += loglikes.NumRows();
           num_success++;
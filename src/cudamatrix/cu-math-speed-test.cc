@@ -0,0 +1,100 @@
+// cudamatrix/cu-math-speed-test.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "util/common-utils.h"
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
+#include "cudamatrix/cu-math.h"
+#include "cudamatrix/cu-math-test-utils.h"
+
+using namespace kaldi;
+
+
+namespace kaldi {
+
+// Compares the speed of ComputeLstmNonlinearity() and
+// BackpropLstmNonlinearity() with that of separate matrix operations, for
+// one time step of a typical multi-stream LSTM.
+template<typename Real>
+static void CuMathLstmNonlinearitySpeedTest() {
+  int32 num_streams = 40, cell_dim = 800, num_steps = 200;
+  CuMatrix<Real> prev_cell(num_streams, cell_dim),
+      act(num_streams, 7 * cell_dim), diff(num_streams, 7 * cell_dim);
+  CuVector<Real> p_i(cell_dim), p_f(cell_dim), p_o(cell_dim);
+  prev_cell.SetRandn();
+  act.SetRandn();
+  diff.SetRandn();
+  p_i.SetRandn();
+  p_f.SetRandn();
+  p_o.SetRandn();
+  for (int32 fused = 0; fused <= 1; fused++) {
+    Timer timer;
+    for (int32 t = 0; t < num_steps; t++) {
+      if (fused) {
+        cu::ComputeLstmNonlinearity(prev_cell, p_i, p_f, p_o, Real(50.0),
+                                    &act);
+        cu::BackpropLstmNonlinearity(prev_cell, act, act, diff,
+                                     p_i, p_f, p_o, &diff);
+      } else {
+        LstmNonlinearityReference(prev_cell, p_i, p_f, p_o, Real(50.0), &act);
+        BackpropLstmNonlinearityReference(prev_cell, act, act, diff,
+                                          p_i, p_f, p_o, &diff);
+      }
+    }
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "For LSTM nonlinearity with cell-dim " << cell_dim << ", "
+              << (fused ? "fused" : "separate") << " forward and backward "
+              << "computation processes " << (num_steps * num_streams / elapsed)
+              << " frames per second.";
+  }
+}
+
+template<typename Real> void CudaMathSpeedTest() {
+  CuMathLstmNonlinearitySpeedTest<Real>();
+}
+
+
+} // namespace kaldi
+
+
+int main() {
+    //Select the GPU
+#if HAVE_CUDA == 1
+    CuDevice::Instantiate().SelectGpuId("yes"); //-2 .. automatic selection
+#endif
+
+    kaldi::CudaMathSpeedTest<float>();
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().DoublePrecisionSupported()) {
+    kaldi::CudaMathSpeedTest<double>();
+  } else {
+    KALDI_WARN << "Double precision not supported";
+  }
+#else
+  kaldi::CudaMathSpeedTest<double>();
+#endif
+  std::cout << "Tests succeeded.\n";
+}
@@ -0,0 +1,91 @@
+// cudamatrix/cu-math-test-utils.h
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_CUDAMATRIX_CU_MATH_TEST_UTILS_H_
+#define KALDI_CUDAMATRIX_CU_MATH_TEST_UTILS_H_
+
+// This header contains functions shared by cu-math-test.cc and
+// cu-math-speed-test.cc; it is not part of the library.
+
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
+
+namespace kaldi {
+
+// Does what ComputeLstmNonlinearity() and BackpropLstmNonlinearity() do, with
+// separate matrix operations.
+template<typename Real>
+inline void LstmNonlinearityReference(const CuMatrixBase<Real> &prev_cell,
+                                     const CuVectorBase<Real> &p_i,
+                                     const CuVectorBase<Real> &p_f,
+                                     const CuVectorBase<Real> &p_o,
+                                     Real cell_clip,
+                                     CuMatrixBase<Real> *act) {
+  int32 n = prev_cell.NumCols();
+  CuSubMatrix<Real> g(act->ColRange(0, n)), i(act->ColRange(n, n)),
+      f(act->ColRange(2 * n, n)), o(act->ColRange(3 * n, n)),
+      c(act->ColRange(4 * n, n)), h(act->ColRange(5 * n, n)),
+      m(act->ColRange(6 * n, n));
+  i.AddMatDiagVec(1.0, prev_cell, kNoTrans, p_i, 1.0);
+  f.AddMatDiagVec(1.0, prev_cell, kNoTrans, p_f, 1.0);
+  i.Sigmoid(i);
+  f.Sigmoid(f);
+  g.Tanh(g);
+  c.AddMatMatElements(1.0, g, i, 0.0);
+  c.AddMatMatElements(1.0, prev_cell, f, 1.0);
+  c.ApplyFloor(-cell_clip);
+  c.ApplyCeiling(cell_clip);
+  h.Tanh(c);
+  o.AddMatDiagVec(1.0, c, kNoTrans, p_o, 1.0);
+  o.Sigmoid(o);
+  m.AddMatMatElements(1.0, h, o, 0.0);
+}
+
+template<typename Real>
+inline void BackpropLstmNonlinearityReference(
+    const CuMatrixBase<Real> &prev_cell, const CuMatrixBase<Real> &act,
+    const CuMatrixBase<Real> &next_act, const CuMatrixBase<Real> &next_diff,
+    const CuVectorBase<Real> &p_i, const CuVectorBase<Real> &p_f,
+    const CuVectorBase<Real> &p_o, CuMatrixBase<Real> *diff) {
+  int32 n = prev_cell.NumCols();
+  CuSubMatrix<Real> d_g(diff->ColRange(0, n)), d_i(diff->ColRange(n, n)),
+      d_f(diff->ColRange(2 * n, n)), d_o(diff->ColRange(3 * n, n)),
+      d_c(diff->ColRange(4 * n, n)), d_h(diff->ColRange(5 * n, n)),
+      d_m(diff->ColRange(6 * n, n));
+  d_h.AddMatMatElements(1.0, d_m, act.ColRange(3 * n, n), 0.0);
+  d_h.DiffTanh(act.ColRange(5 * n, n), d_h);
+  d_o.AddMatMatElements(1.0, d_m, act.ColRange(5 * n, n), 0.0);
+  d_o.DiffSigmoid(act.ColRange(3 * n, n), d_o);
+  d_c.CopyFromMat(d_h);
+  d_c.AddMatMatElements(1.0, next_diff.ColRange(4 * n, n),
+                        next_act.ColRange(2 * n, n), 1.0);
+  d_c.AddMatDiagVec(1.0, next_diff.ColRange(n, n), kNoTrans, p_i, 1.0);
+  d_c.AddMatDiagVec(1.0, next_diff.ColRange(2 * n, n), kNoTrans, p_f, 1.0);
+  d_c.AddMatDiagVec(1.0, d_o, kNoTrans, p_o, 1.0);
+  d_f.AddMatMatElements(1.0, d_c, prev_cell, 0.0);
+  d_f.DiffSigmoid(act.ColRange(2 * n, n), d_f);
+  d_i.AddMatMatElements(1.0, d_c, act.ColRange(0, n), 0.0);
+  d_i.DiffSigmoid(act.ColRange(n, n), d_i);
+  d_g.AddMatMatElements(1.0, d_c, act.ColRange(n, n), 0.0);
+  d_g.DiffTanh(act.ColRange(0, n), d_g);
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_CUDAMATRIX_CU_MATH_TEST_UTILS_H_
@@ -26,6 +26,7 @@
 #include "util/common-utils.h"
 #include "cudamatrix/cu-matrix-lib.h"
 #include "cudamatrix/cu-math.h"
+#include "cudamatrix/cu-math-test-utils.h"
 #include "cudamatrix/cu-array.h"
 
 #if defined(_MSC_VER)
@@ -139,6 +140,56 @@ static void UnitTestCuMathSplice() {
   }
 }
 
+template<typename Real>
+static void UnitTestCuMathLstmNonlinearity() {
+  int32 num_rows = 1 + Rand() % 50, cell_dim = 1 + Rand() % 100;
+  Real cell_clip = (Rand() % 2 == 0 ? 50.0 : 0.5);
+  CuMatrix<Real> prev_cell(num_rows, cell_dim), act(num_rows, 7 * cell_dim),
+      next_act(num_rows, 7 * cell_dim), next_diff(num_rows, 7 * cell_dim),
+      diff(num_rows, 7 * cell_dim);
+  CuVector<Real> p_i(cell_dim), p_f(cell_dim), p_o(cell_dim);
+  prev_cell.SetRandn();
+  prev_cell.Scale(2.0);
+  act.SetRandn();
+  next_act.SetRandn();
+  next_diff.SetRandn();
+  diff.SetRandn();
+  p_i.SetRandn();
+  p_f.SetRandn();
+  p_o.SetRandn();
+
+  CuMatrix<Real> act_ref(act);
+  cu::ComputeLstmNonlinearity(prev_cell, p_i, p_f, p_o, cell_clip, &act);
+  LstmNonlinearityReference(prev_cell, p_i, p_f, p_o, cell_clip, &act_ref);
+  AssertEqual(act, act_ref);
+
+  CuMatrix<Real> diff_ref(diff);
+  cu::BackpropLstmNonlinearity(prev_cell, act, next_act, next_diff,
+                               p_i, p_f, p_o, &diff);
+  BackpropLstmNonlinearityReference(prev_cell, act_ref, next_act, next_diff,
+                                    p_i, p_f, p_o, &diff_ref);
+  AssertEqual(diff, diff_ref);
+}
+
+// For small inputs the output of the cells is also small, and it should have
+// the full relative precision.
+template<typename Real>
+static void UnitTestCuMathLstmNonlinearitySmall() {
+  int32 num_rows = 1 + Rand() % 10, cell_dim = 1 + Rand() % 20;
+  CuMatrix<Real> prev_cell(num_rows, cell_dim), act(num_rows, 7 * cell_dim);
+  CuVector<Real> p_i(cell_dim), p_f(cell_dim), p_o(cell_dim);
+  act.SetRandn();
+  act.Scale(1.0e-14);
+  Matrix<Real> g(act.ColRange(0, cell_dim));
+  cu::ComputeLstmNonlinearity(prev_cell, p_i, p_f, p_o, Real(50.0), &act);
+  // With zero peepholes and previous cell, the cell is tanh(g) * sigmoid(i),
+  // where i is near zero, so about g / 2.
+  Matrix<Real> c(act.ColRange(4 * cell_dim, cell_dim));
+  for (int32 r = 0; r < num_rows; r++)
+    for (int32 j = 0; j < cell_dim; j++)
+      KALDI_ASSERT(ApproxEqual(c(r, j), Real(0.5) * g(r, j), Real(1.0e-04)));
+}
+
 template<typename Real> void CudaMathUnitTest() {
   #if HAVE_CUDA == 1  
     if (CuDevice::Instantiate().DoublePrecisionSupported())
@@ -146,6 +197,10 @@ template<typename Real> void CudaMathUnitTest() {
   UnitTestCuMathRandomize<Real>();
   UnitTestCuMathSplice<Real>();
   UnitTestCuMathCopy<Real>();
+  for (int32 i = 0; i < 5; i++) {
+    UnitTestCuMathLstmNonlinearity<Real>();
+    UnitTestCuMathLstmNonlinearitySmall<Real>();
+  }
 }
 
 
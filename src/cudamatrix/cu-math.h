@@ -73,6 +73,41 @@ void Copy(const CuMatrixBase<Real> &src,
           const CuArray<int32> &copy_from_indices,
           CuMatrixBase<Real> *tgt);
 
+/// Does the elementwise part of one time step of the forward computation of
+/// an LSTM with peephole connections (as in nnet1::LstmProjectedStreams).
+/// Each row of "activations" is one stream, and consists of 7 blocks of
+/// cell_dim columns, for [g i f o c h m] (see nnet-lstm-projected-streams.h);
+/// on input, the blocks g, i, f, o contain the input to the gates without the
+/// peephole terms, and on output all seven blocks are set.  "prev_cell" is
+/// the cell state c of the previous time step (zero at the start of a
+/// sequence).  The cell state is clipped to [-cell_clip, cell_clip].  On the
+/// CPU this is done in a single pass over the data; on the GPU it uses the
+/// usual matrix operations.
+template<typename Real>
+void ComputeLstmNonlinearity(const CuMatrixBase<Real> &prev_cell,
+                             const CuVectorBase<Real> &peephole_i_c,
+                             const CuVectorBase<Real> &peephole_f_c,
+                             const CuVectorBase<Real> &peephole_o_c,
+                             Real cell_clip,
+                             CuMatrixBase<Real> *activations);
+
+/// This is the backward pass of ComputeLstmNonlinearity().  "activations" is
+/// as output by it for this time step, and "next_activations" and "next_diff"
+/// are the activations and derivatives (in the same layout) for the next time
+/// step, of which only f, and c, i, f respectively, are used; the rows of
+/// next_diff should be zero for streams where the next time step starts a new
+/// sequence.  On input, block m of "diff" contains the derivative w.r.t. m;
+/// on output, blocks g, i, f, o, c and h are set to the derivatives w.r.t. the
+/// gate inputs (for g, i, f, o) and the values c and h.
+template<typename Real>
+void BackpropLstmNonlinearity(const CuMatrixBase<Real> &prev_cell,
+                              const CuMatrixBase<Real> &activations,
+                              const CuMatrixBase<Real> &next_activations,
+                              const CuMatrixBase<Real> &next_diff,
+                              const CuVectorBase<Real> &peephole_i_c,
+                              const CuVectorBase<Real> &peephole_f_c,
+                              const CuVectorBase<Real> &peephole_o_c,
+                              CuMatrixBase<Real> *diff);
 
 } // namespace cu
 } // namespace kaldi
@@ -85,6 +85,22 @@ class CuMatrixBase {
   friend void cu::Randomize<Real>(const CuMatrixBase<Real> &src,
                                   const CuArray<int32> &copy_from_idx,
                                   CuMatrixBase<Real> *tgt);
+  friend void cu::ComputeLstmNonlinearity<Real>(
+      const CuMatrixBase<Real> &prev_cell,
+      const CuVectorBase<Real> &peephole_i_c,
+      const CuVectorBase<Real> &peephole_f_c,
+      const CuVectorBase<Real> &peephole_o_c,
+      Real cell_clip,
+      CuMatrixBase<Real> *activations);
+  friend void cu::BackpropLstmNonlinearity<Real>(
+      const CuMatrixBase<Real> &prev_cell,
+      const CuMatrixBase<Real> &activations,
+      const CuMatrixBase<Real> &next_activations,
+      const CuMatrixBase<Real> &next_diff,
+      const CuVectorBase<Real> &peephole_i_c,
+      const CuVectorBase<Real> &peephole_f_c,
+      const CuVectorBase<Real> &peephole_o_c,
+      CuMatrixBase<Real> *diff);
 
   /// Copies column r from column indices[r] of src.
   /// As a special case, if indexes[i] == -1, sets column i to zero
@@ -343,7 +359,7 @@ class CuMatrixBase {
   // The same as adding M but scaling each column M_j by v(j).
   void AddMatDiagVec(const Real alpha,
                      const CuMatrixBase<Real> &M, MatrixTransposeType transM,
-                     CuVectorBase<Real> &v,
+                     const CuVectorBase<Real> &v,
                      Real beta = 1.0);  
 
   /// *this = beta * *this + alpha * A .* B (.* element by element multiplication)
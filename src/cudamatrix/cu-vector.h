@@ -60,6 +60,22 @@ class CuVectorBase {
   friend void cu::Splice<Real>(const CuMatrixBase<Real> &src,
                                const CuArray<int32> &frame_offsets,
                                CuMatrixBase<Real> *tgt);
+  friend void cu::ComputeLstmNonlinearity<Real>(
+      const CuMatrixBase<Real> &prev_cell,
+      const CuVectorBase<Real> &peephole_i_c,
+      const CuVectorBase<Real> &peephole_f_c,
+      const CuVectorBase<Real> &peephole_o_c,
+      Real cell_clip,
+      CuMatrixBase<Real> *activations);
+  friend void cu::BackpropLstmNonlinearity<Real>(
+      const CuMatrixBase<Real> &prev_cell,
+      const CuMatrixBase<Real> &activations,
+      const CuMatrixBase<Real> &next_activations,
+      const CuMatrixBase<Real> &next_diff,
+      const CuVectorBase<Real> &peephole_i_c,
+      const CuVectorBase<Real> &peephole_f_c,
+      const CuVectorBase<Real> &peephole_o_c,
+      CuMatrixBase<Real> *diff);
   friend class CuRand<Real>;
   
   /// Dimensions
@@ -69,6 +69,17 @@ class DecodableMatrixScaledMapped: public DecodableInterface {
     return scale_ * (*likes_)(frame, trans_model_.TransitionIdToPdf(tid));
   }
 
+  // Batch version of LogLikelihood(); avoids one virtual call per index.
+  virtual void LogLikelihoods(int32 frame,
+                              const std::vector<int32> &tids,
+                              std::vector<BaseFloat> *loglikes) {
+    const BaseFloat *row = likes_->RowData(frame);
+    size_t size = tids.size();
+    loglikes->resize(size);
+    for (size_t i = 0; i < size; i++)
+      (*loglikes)[i] = scale_ * row[trans_model_.TransitionIdToPdf(tids[i])];
+  }
+
   // Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
 
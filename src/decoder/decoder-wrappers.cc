@@ -194,8 +194,9 @@ DecodeUtteranceLatticeFasterClass::~DecodeUtteranceLatticeFasterClass() {
 
 
 // Takes care of output.  Returns true on success.
+template<template<class, class> class HashListType>
 bool DecodeUtteranceLatticeFaster(
-    LatticeFasterDecoder &decoder, // not const but is really an input.
+    LatticeFasterDecoderTpl<HashListType> &decoder, // not const but is really an input.
     DecodableInterface &decodable, // not const but is really an input.
     const TransitionModel &trans_model,
     const fst::SymbolTable *word_syms,
@@ -208,12 +209,32 @@ bool DecodeUtteranceLatticeFaster(
     CompactLatticeWriter *compact_lattice_writer,
     LatticeWriter *lattice_writer,
     double *like_ptr) { // puts utterance's like in like_ptr on success.
-  using fst::VectorFst;
-
   if (!decoder.Decode(&decodable)) {
     KALDI_WARN << "Failed to decode file " << utt;
     return false;
   }
+  return OutputDecodedUtteranceLatticeFaster(
+      decoder, trans_model, word_syms, utt, acoustic_scale, determinize,
+      allow_partial, alignment_writer, words_writer, compact_lattice_writer,
+      lattice_writer, like_ptr);
+}
+
+template<template<class, class> class HashListType>
+bool OutputDecodedUtteranceLatticeFaster(
+    const LatticeFasterDecoderTpl<HashListType> &decoder,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr) {
+  using fst::VectorFst;
+
   if (!decoder.ReachedFinal()) {
     if (allow_partial) {
       KALDI_WARN << "Outputting partial output for utterance " << utt
@@ -291,6 +312,63 @@ bool DecodeUtteranceLatticeFaster(
   return true;
 }
 
+// Instantiate the templates above for the hash types that
+// LatticeFasterDecoderTpl is instantiated for.
+template bool DecodeUtteranceLatticeFaster(
+    LatticeFasterDecoderTpl<HashList> &decoder,
+    DecodableInterface &decodable,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);
+template bool OutputDecodedUtteranceLatticeFaster(
+    const LatticeFasterDecoderTpl<HashList> &decoder,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);
+template bool DecodeUtteranceLatticeFaster(
+    LatticeFasterDecoderTpl<FlatHashList> &decoder,
+    DecodableInterface &decodable,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);
+template bool OutputDecodedUtteranceLatticeFaster(
+    const LatticeFasterDecoderTpl<FlatHashList> &decoder,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);
+
 // Takes care of output.  Returns true on success.
 bool DecodeUtteranceLatticeSimple(
     LatticeSimpleDecoder &decoder, // not const but is really an input.
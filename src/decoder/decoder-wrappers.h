@@ -94,8 +94,10 @@ void ModifyGraphForCarefulAlignment(
 /// other obvious place to put it.  If determinize == false, it writes to
 /// lattice_writer, else to compact_lattice_writer.  The writers for
 /// alignments and words will only be written to if they are open.
+/// It is templated on the decoder's hash type; see LatticeFasterDecoderTpl.
+template<template<class, class> class HashListType>
 bool DecodeUtteranceLatticeFaster(
-    LatticeFasterDecoder &decoder, // not const but is really an input.
+    LatticeFasterDecoderTpl<HashListType> &decoder, // not const but is really an input.
     DecodableInterface &decodable, // not const but is really an input.
     const TransitionModel &trans_model,
     const fst::SymbolTable *word_syms,
@@ -109,6 +111,26 @@ bool DecodeUtteranceLatticeFaster(
     LatticeWriter *lattice_writer,
     double *like_ptr);  // puts utterance's likelihood in like_ptr on success.
 
+/// This function does the part of DecodeUtteranceLatticeFaster() that comes
+/// after the decoding: it gets the best path and the lattice from "decoder",
+/// which must already have decoded the utterance, and writes them out.  It is
+/// for programs that drive the decoder themselves, e.g. using
+/// LatticeFasterBatchDecoder.  Returns true on success.
+template<template<class, class> class HashListType>
+bool OutputDecodedUtteranceLatticeFaster(
+    const LatticeFasterDecoderTpl<HashListType> &decoder,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignments_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);  // puts utterance's likelihood in like_ptr on success.
+
 /// This class basically does the same job as the function
 /// DecodeUtteranceLatticeFaster, but in a way that allows us
 /// to build a multi-threaded command line program more easily,
@@ -24,6 +24,7 @@
 #include "util/stl-utils.h"
 #include "itf/options-itf.h"
 #include "util/hash-list.h"
+#include "util/flat-hash-list.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "lat/kaldi-lattice.h" // for CompactLatticeArc
@@ -58,19 +59,24 @@ struct FasterDecoderOptions {
   }
 };
 
-class FasterDecoder {
+/// The template argument is the hash type used to index the tokens on the
+/// current frame by state: HashList (hash-list.h) or FlatHashList
+/// (flat-hash-list.h).  Normally you would use the typedef FasterDecoder,
+/// which uses HashList.
+template<template<class, class> class HashListType>
+class FasterDecoderTpl {
  public:
   typedef fst::StdArc Arc;
   typedef Arc::Label Label;
   typedef Arc::StateId StateId;
   typedef Arc::Weight Weight;
 
-  FasterDecoder(const fst::Fst<fst::StdArc> &fst,
-                const FasterDecoderOptions &config);
+  FasterDecoderTpl(const fst::Fst<fst::StdArc> &fst,
+                   const FasterDecoderOptions &config);
 
   void SetOptions(const FasterDecoderOptions &config) { config_ = config; }
   
-  ~FasterDecoder() { ClearToks(toks_.Clear()); }
+  ~FasterDecoderTpl() { ClearToks(toks_.Clear()); }
 
   void Decode(DecodableInterface *decodable);
 
@@ -146,7 +152,7 @@ class FasterDecoder {
 #endif
     }
   };
-  typedef HashList<StateId, Token*>::Elem Elem;
+  typedef typename HashListType<StateId, Token*>::Elem Elem;
 
 
   /// Gets the weight cutoff.  Also counts the active tokens.
@@ -163,10 +169,11 @@ class FasterDecoder {
   // TODO: first time we go through this, could avoid using the queue.
   void ProcessNonemitting(double cutoff);
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
+  // HashList defined in ../util/hash-list.h (or FlatHashList, see
+  // ../util/flat-hash-list.h).  It actually allows us to maintain
   // more than one list (e.g. for current and previous frames), but only one of
   // them at a time can be indexed by StateId.
-  HashList<StateId, Token*> toks_;
+  HashListType<StateId, Token*> toks_;
   const fst::Fst<fst::StdArc> &fst_;
   FasterDecoderOptions config_;
   std::vector<StateId> queue_;  // temp variable used in ProcessNonemitting,
@@ -184,9 +191,11 @@ class FasterDecoder {
   // this way for convenience in propagating tokens from one frame to the next.
   void ClearToks(Elem *list);
 
-  KALDI_DISALLOW_COPY_AND_ASSIGN(FasterDecoder);
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FasterDecoderTpl);
 };
 
+typedef FasterDecoderTpl<HashList> FasterDecoder;
+
 
 } // end namespace kaldi.
 
@@ -0,0 +1,247 @@
+// decoder/lattice-faster-batch-decoder.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "decoder/lattice-faster-batch-decoder.h"
+
+namespace kaldi {
+
+LatticeFasterBatchDecoder::LatticeFasterBatchDecoder(
+    const fst::Fst<fst::StdArc> &fst,
+    const LatticeFasterDecoderConfig &config,
+    int32 num_streams): fst_(fst), config_(config) {
+  KALDI_ASSERT(num_streams > 0);
+  config.Check();
+  decoders_.resize(num_streams);
+  for (int32 s = 0; s < num_streams; s++)
+    decoders_[s] = new LatticeFasterDecoder(fst, config);
+}
+
+LatticeFasterBatchDecoder::~LatticeFasterBatchDecoder() {
+  for (size_t s = 0; s < decoders_.size(); s++)
+    delete decoders_[s];
+}
+
+void LatticeFasterBatchDecoder::AdvanceDecoding(
+    const std::vector<DecodableInterface*> &decodables,
+    int32 max_num_frames) {
+  KALDI_ASSERT(decodables.size() == decoders_.size());
+  int32 num_streams = decoders_.size();
+  // target_frames[s] is the number of frames we want stream s to have
+  // decoded when we return.
+  std::vector<int32> target_frames(num_streams, 0);
+  for (int32 s = 0; s < num_streams; s++) {
+    if (decodables[s] == NULL) continue;
+    LatticeFasterDecoder &decoder = *(decoders_[s]);
+    KALDI_ASSERT(!decoder.active_toks_.empty() && !decoder.decoding_finalized_
+                 && "You must call InitDecoding() before AdvanceDecoding");
+    int32 num_frames_ready = decodables[s]->NumFramesReady(),
+        num_frames_decoded = decoder.NumFramesDecoded();
+    KALDI_ASSERT(num_frames_ready >= num_frames_decoded);
+    target_frames[s] = num_frames_ready;
+    if (max_num_frames >= 0)
+      target_frames[s] = std::min(target_frames[s],
+                                  num_frames_decoded + max_num_frames);
+  }
+  std::vector<int32> streams;
+  while (true) {
+    streams.clear();
+    for (int32 s = 0; s < num_streams; s++)
+      if (decodables[s] != NULL &&
+          decoders_[s]->NumFramesDecoded() < target_frames[s])
+        streams.push_back(s);
+    if (streams.empty()) break;
+    DecodeFrame(streams, decodables);
+  }
+}
+
+void LatticeFasterBatchDecoder::Decode(
+    const std::vector<DecodableInterface*> &decodables,
+    std::vector<bool> *success) {
+  KALDI_ASSERT(decodables.size() == decoders_.size());
+  int32 num_streams = decoders_.size();
+  for (int32 s = 0; s < num_streams; s++)
+    if (decodables[s] != NULL)
+      decoders_[s]->InitDecoding();
+
+  std::vector<int32> streams;
+  while (true) {
+    streams.clear();
+    for (int32 s = 0; s < num_streams; s++)
+      if (decodables[s] != NULL &&
+          !decodables[s]->IsLastFrame(decoders_[s]->NumFramesDecoded() - 1))
+        streams.push_back(s);
+    if (streams.empty()) break;
+    DecodeFrame(streams, decodables);
+  }
+
+  success->clear();
+  success->resize(num_streams, false);
+  for (int32 s = 0; s < num_streams; s++) {
+    if (decodables[s] == NULL) continue;
+    LatticeFasterDecoder &decoder = *(decoders_[s]);
+    decoder.FinalizeDecoding();
+    (*success)[s] = !decoder.active_toks_.empty() &&
+        decoder.active_toks_.back().toks != NULL;
+  }
+}
+
+void LatticeFasterBatchDecoder::DecodeFrame(
+    const std::vector<int32> &streams,
+    const std::vector<DecodableInterface*> &decodables) {
+  for (size_t i = 0; i < streams.size(); i++) {
+    LatticeFasterDecoder &decoder = *(decoders_[streams[i]]);
+    if (decoder.NumFramesDecoded() % config_.prune_interval == 0)
+      decoder.PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
+  }
+  std::vector<BaseFloat> cutoffs;
+  ProcessEmitting(streams, decodables, &cutoffs);
+  for (size_t i = 0; i < streams.size(); i++)
+    decoders_[streams[i]]->ProcessNonemitting(cutoffs[i]);
+}
+
+inline LatticeFasterBatchDecoder::Token*
+LatticeFasterBatchDecoder::FindOrAddToken(LatticeFasterDecoder *decoder,
+                                          StateId state, int32 frame_plus_one,
+                                          BaseFloat tot_cost) {
+  Elem *e_found = decoder->toks_.Find(state);
+  if (e_found == NULL) {  // no such token presently.
+    Token *&toks = decoder->active_toks_[frame_plus_one].toks;
+    Token *new_tok = decoder->NewToken(tot_cost, 0.0, NULL, toks);
+    toks = new_tok;
+    decoder->num_toks_++;
+    decoder->toks_.Insert(state, new_tok);
+    return new_tok;
+  } else {
+    Token *tok = e_found->val;
+    if (tok->tot_cost > tot_cost)
+      tok->tot_cost = tot_cost;
+    return tok;
+  }
+}
+
+void LatticeFasterBatchDecoder::ProcessEmitting(
+    const std::vector<int32> &streams,
+    const std::vector<DecodableInterface*> &decodables,
+    std::vector<BaseFloat> *cutoffs) {
+  int32 num_streams = streams.size();
+  stream_info_.resize(num_streams);
+  batch_toks_.clear();
+
+  // First, for each stream, do the per-stream setup that
+  // LatticeFasterDecoder::ProcessEmitting() does: compute the cutoff, and
+  // process the best token to get the cost offset and an initial value for
+  // the cutoff on the next frame.  Then add the tokens within the cutoff to
+  // batch_toks_.
+  for (int32 i = 0; i < num_streams; i++) {
+    LatticeFasterDecoder *decoder = decoders_[streams[i]];
+    StreamFrameInfo &info = stream_info_[i];
+    info.decoder = decoder;
+    info.decodable = decodables[streams[i]];
+    KALDI_ASSERT(decoder->active_toks_.size() > 0);
+    info.frame = decoder->active_toks_.size() - 1;
+    decoder->active_toks_.resize(decoder->active_toks_.size() + 1);
+    info.prev_toks = decoder->toks_.Clear();
+
+    Elem *best_elem = NULL;
+    size_t tok_cnt;
+    BaseFloat cur_cutoff = decoder->GetCutoff(info.prev_toks, &tok_cnt,
+                                              &info.adaptive_beam, &best_elem);
+    decoder->PossiblyResizeHash(tok_cnt);
+
+    info.next_cutoff = std::numeric_limits<BaseFloat>::infinity();
+    info.cost_offset = 0.0;
+    if (best_elem) {
+      Token *tok = best_elem->val;
+      info.cost_offset = - tok->tot_cost;
+      for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, best_elem->key);
+           !aiter.Done(); aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        if (arc.ilabel != 0) {
+          BaseFloat new_weight = arc.weight.Value() + info.cost_offset -
+              info.decodable->LogLikelihood(info.frame, arc.ilabel) +
+              tok->tot_cost;
+          if (new_weight + info.adaptive_beam < info.next_cutoff)
+            info.next_cutoff = new_weight + info.adaptive_beam;
+        }
+      }
+    }
+    decoder->cost_offsets_.resize(info.frame + 1, 0.0);
+    decoder->cost_offsets_[info.frame] = info.cost_offset;
+
+    for (Elem *e = info.prev_toks; e != NULL; e = e->tail)
+      if (e->val->tot_cost <= cur_cutoff)
+        batch_toks_.push_back(BatchToken(e->key, i, e->val));
+  }
+
+  std::sort(batch_toks_.begin(), batch_toks_.end());
+
+  // Now go through the states that are active in any stream; read the
+  // emitting arcs of each state once and expand them for every stream that
+  // has a token in that state.
+  size_t num_batch_toks = batch_toks_.size();
+  for (size_t begin = 0, end; begin < num_batch_toks; begin = end) {
+    StateId state = batch_toks_[begin].state;
+    for (end = begin + 1;
+         end < num_batch_toks && batch_toks_[end].state == state; ++end);
+
+    arcs_.clear();
+    ilabels_.clear();
+    for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
+         !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.ilabel != 0) {
+        arcs_.push_back(arc);
+        ilabels_.push_back(arc.ilabel);
+      }
+    }
+    if (arcs_.empty()) continue;
+    size_t num_arcs = arcs_.size();
+
+    for (size_t b = begin; b < end; b++) {
+      StreamFrameInfo &info = stream_info_[batch_toks_[b].stream_index];
+      Token *tok = batch_toks_[b].tok;
+      info.decodable->LogLikelihoods(info.frame, ilabels_, &loglikes_);
+      for (size_t a = 0; a < num_arcs; a++) {
+        const Arc &arc = arcs_[a];
+        BaseFloat ac_cost = info.cost_offset - loglikes_[a],
+            graph_cost = arc.weight.Value(),
+            tot_cost = tok->tot_cost + ac_cost + graph_cost;
+        if (tot_cost > info.next_cutoff) continue;
+        else if (tot_cost + info.adaptive_beam < info.next_cutoff)
+          info.next_cutoff = tot_cost + info.adaptive_beam;
+        Token *next_tok = FindOrAddToken(info.decoder, arc.nextstate,
+                                         info.frame + 1, tot_cost);
+        tok->links = info.decoder->NewForwardLink(next_tok, arc.ilabel,
+                                                  arc.olabel, graph_cost,
+                                                  ac_cost, tok->links);
+      }
+    }
+  }
+
+  cutoffs->resize(num_streams);
+  for (int32 i = 0; i < num_streams; i++) {
+    StreamFrameInfo &info = stream_info_[i];
+    info.decoder->DeleteElems(info.prev_toks);
+    (*cutoffs)[i] = info.next_cutoff;
+  }
+}
+
+} // end namespace kaldi.
@@ -0,0 +1,161 @@
+// decoder/lattice-faster-batch-decoder.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_LATTICE_FASTER_BATCH_DECODER_H_
+#define KALDI_DECODER_LATTICE_FASTER_BATCH_DECODER_H_
+
+#include <vector>
+
+#include "decoder/lattice-faster-decoder.h"
+
+namespace kaldi {
+
+/**
+   LatticeFasterBatchDecoder decodes several utterances ("streams") at once
+   against the same decoding graph, advancing all of them by one frame at a
+   time.  Each stream is an ordinary LatticeFasterDecoder, so all the usual
+   functions (GetRawLattice(), GetBestPath(), FinalRelativeCost() and so on)
+   are available through GetDecoder(); what this class changes is the way the
+   emitting arcs are expanded.  On each frame, the surviving tokens of all the
+   streams are merged and sorted by graph state, so the arcs of a state are
+   read from the FST only once however many streams have a token there, and
+   the acoustic log-likelihoods of a state's arcs are requested from each
+   decodable object in a single call to DecodableInterface::LogLikelihoods().
+   This reduces the memory traffic on the graph, which dominates when many
+   streams are decoded on the same machine.
+
+   Pruning is done per stream exactly as in LatticeFasterDecoder; the only
+   difference is the order in which tokens are expanded, which may very
+   slightly affect the "online" beam cutoff used within a frame.
+ */
+class LatticeFasterBatchDecoder {
+ public:
+  typedef fst::StdArc Arc;
+  typedef Arc::Label Label;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+
+  /// Creates "num_streams" decoders, all using "fst" (which must outlive this
+  /// object) and "config".
+  LatticeFasterBatchDecoder(const fst::Fst<fst::StdArc> &fst,
+                            const LatticeFasterDecoderConfig &config,
+                            int32 num_streams);
+
+  ~LatticeFasterBatchDecoder();
+
+  int32 NumStreams() const { return decoders_.size(); }
+
+  /// Starts a new utterance on stream "s", discarding anything that was
+  /// previously being decoded there.
+  void InitDecoding(int32 s) { GetDecoder(s).InitDecoding(); }
+
+  /// Decodes the streams for which decodables[s] is non-NULL (you must have
+  /// called InitDecoding(s) on them), frame by frame, until no such stream has
+  /// any more frames ready (see DecodableInterface::NumFramesReady()).  If
+  /// max_num_frames >= 0, no stream is advanced by more than that many frames.
+  /// Like LatticeFasterDecoder::AdvanceDecoding(), this does not call
+  /// FinalizeDecoding(); do that yourself via GetDecoder(s) once a stream's
+  /// utterance is done.
+  void AdvanceDecoding(const std::vector<DecodableInterface*> &decodables,
+                       int32 max_num_frames = -1);
+
+  /// Decodes one complete utterance on each stream s for which decodables[s]
+  /// is non-NULL, using the "blocking" IsLastFrame() interface, as
+  /// LatticeFasterDecoder::Decode() does; it calls InitDecoding() and
+  /// FinalizeDecoding() itself.  Sets (*success)[s] to true if any kind of
+  /// traceback is available for stream s.
+  void Decode(const std::vector<DecodableInterface*> &decodables,
+              std::vector<bool> *success);
+
+  LatticeFasterDecoder &GetDecoder(int32 s) {
+    KALDI_ASSERT(static_cast<size_t>(s) < decoders_.size());
+    return *(decoders_[s]);
+  }
+  const LatticeFasterDecoder &GetDecoder(int32 s) const {
+    KALDI_ASSERT(static_cast<size_t>(s) < decoders_.size());
+    return *(decoders_[s]);
+  }
+
+ private:
+  typedef LatticeFasterDecoder::Token Token;
+  typedef LatticeFasterDecoder::ForwardLink ForwardLink;
+  typedef LatticeFasterDecoder::Elem Elem;
+
+  // Per-stream quantities used while expanding the emitting arcs of one frame.
+  struct StreamFrameInfo {
+    LatticeFasterDecoder *decoder;
+    DecodableInterface *decodable;
+    int32 frame;  // zero-based frame index used by the decodable object.
+    Elem *prev_toks;  // tokens of the previous frame, taken out of the hash.
+    BaseFloat adaptive_beam;
+    BaseFloat next_cutoff;
+    BaseFloat cost_offset;
+  };
+
+  // A token that survived the beam on the previous frame; these are sorted on
+  // (state, stream) so that tokens in the same state are adjacent.
+  struct BatchToken {
+    StateId state;
+    int32 stream_index;  // index into stream_info_.
+    Token *tok;
+    BatchToken(StateId state, int32 stream_index, Token *tok):
+        state(state), stream_index(stream_index), tok(tok) { }
+    bool operator < (const BatchToken &other) const {
+      if (state != other.state) return state < other.state;
+      return stream_index < other.stream_index;
+    }
+  };
+
+  // Decodes one frame on each stream in "streams" (which are indexes into
+  // decoders_ and decodables).
+  void DecodeFrame(const std::vector<int32> &streams,
+                   const std::vector<DecodableInterface*> &decodables);
+
+  // Does the work of LatticeFasterDecoder::ProcessEmitting() for all the
+  // streams in "streams"; outputs to "cutoffs" the cost cutoff that each
+  // stream's ProcessNonemitting() should use.
+  void ProcessEmitting(const std::vector<int32> &streams,
+                       const std::vector<DecodableInterface*> &decodables,
+                       std::vector<BaseFloat> *cutoffs);
+
+  // This is as LatticeFasterDecoder::FindOrAddToken(), specialized for
+  // emitting arcs, where we don't need the "changed" output.
+  inline static Token *FindOrAddToken(LatticeFasterDecoder *decoder,
+                                      StateId state, int32 frame_plus_one,
+                                      BaseFloat tot_cost);
+
+  const fst::Fst<fst::StdArc> &fst_;
+  LatticeFasterDecoderConfig config_;
+  std::vector<LatticeFasterDecoder*> decoders_;
+
+  // The following are temporaries, kept as class members to avoid
+  // reallocating them on every frame.
+  std::vector<StreamFrameInfo> stream_info_;
+  std::vector<BatchToken> batch_toks_;
+  std::vector<Arc> arcs_;  // emitting arcs of the current state.
+  std::vector<int32> ilabels_;  // their input labels.
+  std::vector<BaseFloat> loglikes_;  // and their log-likelihoods for a stream.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterBatchDecoder);
+};
+
+
+} // end namespace kaldi.
+
+#endif
@@ -30,33 +30,39 @@
 namespace kaldi {
 
 // instantiate this class once for each thing you have to decode.
-LatticeFasterDecoder::LatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
-                                           const LatticeFasterDecoderConfig &config):
+template<template<class, class> class HashListType>
+LatticeFasterDecoderTpl<HashListType>::LatticeFasterDecoderTpl(
+    const fst::Fst<fst::StdArc> &fst, const LatticeFasterDecoderConfig &config):
     fst_(fst), delete_fst_(false), config_(config), num_toks_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
 
-LatticeFasterDecoder::LatticeFasterDecoder(const LatticeFasterDecoderConfig &config,
-                                           fst::Fst<fst::StdArc> *fst):
+template<template<class, class> class HashListType>
+LatticeFasterDecoderTpl<HashListType>::LatticeFasterDecoderTpl(
+    const LatticeFasterDecoderConfig &config, fst::Fst<fst::StdArc> *fst):
     fst_(*fst), delete_fst_(true), config_(config), num_toks_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
 
-LatticeFasterDecoder::~LatticeFasterDecoder() {
+template<template<class, class> class HashListType>
+LatticeFasterDecoderTpl<HashListType>::~LatticeFasterDecoderTpl() {
   DeleteElems(toks_.Clear());
   ClearActiveTokens();
   if (delete_fst_) delete &(fst_);
 }
 
-void LatticeFasterDecoder::InitDecoding() {
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::InitDecoding() {
   // clean up from last time:
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
   ClearActiveTokens();
+  token_pool_.ResetPeak();
+  link_pool_.ResetPeak();
   warned_ = false;
   num_toks_ = 0;
   decoding_finalized_ = false;
@@ -64,7 +70,7 @@ void LatticeFasterDecoder::InitDecoding() {
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL);
+  Token *start_tok = NewToken(0.0, 0.0, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
@@ -74,7 +80,9 @@ void LatticeFasterDecoder::InitDecoding() {
 // Returns true if any kind of traceback is available (not necessarily from
 // a final state).  It should only very rarely return false; this indicates
 // an unusual search error.
-bool LatticeFasterDecoder::Decode(DecodableInterface *decodable) {
+template<template<class, class> class HashListType>
+bool LatticeFasterDecoderTpl<HashListType>::Decode(
+    DecodableInterface *decodable) {
   InitDecoding();
 
   // We use 1-based indexing for frames in this decoder (if you view it in
@@ -96,8 +104,9 @@ bool LatticeFasterDecoder::Decode(DecodableInterface *decodable) {
 
 
 // Outputs an FST corresponding to the single best path through the lattice.
-bool LatticeFasterDecoder::GetBestPath(Lattice *olat,
-                                       bool use_final_probs) const {
+template<template<class, class> class HashListType>
+bool LatticeFasterDecoderTpl<HashListType>::GetBestPath(
+    Lattice *olat, bool use_final_probs) const {
   Lattice raw_lat;
   GetRawLattice(&raw_lat, use_final_probs);
   ShortestPath(raw_lat, olat);
@@ -106,8 +115,9 @@ bool LatticeFasterDecoder::GetBestPath(Lattice *olat,
 
 // Outputs an FST corresponding to the raw, state-level
 // tracebacks.
-bool LatticeFasterDecoder::GetRawLattice(Lattice *ofst,
-                                         bool use_final_probs) const {
+template<template<class, class> class HashListType>
+bool LatticeFasterDecoderTpl<HashListType>::GetRawLattice(
+    Lattice *ofst, bool use_final_probs) const {
   typedef LatticeArc Arc;
   typedef Arc::StateId StateId;
   typedef Arc::Weight Weight;
@@ -161,7 +171,7 @@ bool LatticeFasterDecoder::GetRawLattice(Lattice *ofst,
       for (ForwardLink *l = tok->links;
            l != NULL;
            l = l->next) {
-        unordered_map<Token*, StateId>::const_iterator iter =
+        typename unordered_map<Token*, StateId>::const_iterator iter =
             tok_map.find(l->next_tok);
         StateId nextstate = iter->second;
         KALDI_ASSERT(iter != tok_map.end());
@@ -177,7 +187,7 @@ bool LatticeFasterDecoder::GetRawLattice(Lattice *ofst,
       }
       if (f == num_frames) {
         if (use_final_probs && !final_costs.empty()) {
-          unordered_map<Token*, BaseFloat>::const_iterator iter =
+          typename unordered_map<Token*, BaseFloat>::const_iterator iter =
               final_costs.find(tok);
           if (iter != final_costs.end())
             ofst->SetFinal(cur_state, LatticeWeight(iter->second, 0));
@@ -194,8 +204,9 @@ bool LatticeFasterDecoder::GetRawLattice(Lattice *ofst,
 // This function is now deprecated, since now we do determinization from outside
 // the LatticeFasterDecoder class.  Outputs an FST corresponding to the
 // lattice-determinized lattice (one path per word sequence).
-bool LatticeFasterDecoder::GetLattice(CompactLattice *ofst,
-                                      bool use_final_probs) const {
+template<template<class, class> class HashListType>
+bool LatticeFasterDecoderTpl<HashListType>::GetLattice(
+    CompactLattice *ofst, bool use_final_probs) const {
   Lattice raw_fst;
   GetRawLattice(&raw_fst, use_final_probs);
   Invert(&raw_fst);  // make it so word labels are on the input.
@@ -207,7 +218,8 @@ bool LatticeFasterDecoder::GetLattice(CompactLattice *ofst,
   fst::DeterminizeLatticePrunedOptions lat_opts;
   lat_opts.max_mem = config_.det_opts.max_mem;
 
-  DeterminizeLatticePruned(raw_fst, config_.lattice_beam, ofst, lat_opts);
+  DeterminizeLatticePrunedChunked(raw_fst, config_.lattice_beam, ofst,
+                                  lat_opts, config_.det_chunk_opts);
   raw_fst.DeleteStates();  // Free memory-- raw_fst no longer needed.
   Connect(ofst);  // Remove unreachable states... there might be
   // a small number of these, in some cases.
@@ -216,7 +228,9 @@ bool LatticeFasterDecoder::GetLattice(CompactLattice *ofst,
   return (ofst->NumStates() != 0);
 }
 
-void LatticeFasterDecoder::PossiblyResizeHash(size_t num_toks) {
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::PossiblyResizeHash(
+    size_t num_toks) {
   size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
                                       * config_.hash_ratio);
   if (new_sz > toks_.Size()) {
@@ -229,7 +243,9 @@ void LatticeFasterDecoder::PossiblyResizeHash(size_t num_toks) {
 // for the current frame.  [note: it's inserted if necessary into hash toks_
 // and also into the singly linked list of tokens active on this frame
 // (whose head is at active_toks_[frame]).
-inline LatticeFasterDecoder::Token *LatticeFasterDecoder::FindOrAddToken(
+template<template<class, class> class HashListType>
+inline typename LatticeFasterDecoderTpl<HashListType>::Token*
+LatticeFasterDecoderTpl<HashListType>::FindOrAddToken(
     StateId state, int32 frame_plus_one, BaseFloat tot_cost, bool *changed) {
   // Returns the Token pointer.  Sets "changed" (if non-NULL) to true
   // if the token was newly created or the cost changed.
@@ -241,7 +257,7 @@ inline LatticeFasterDecoder::Token *LatticeFasterDecoder::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks);
+    Token *new_tok = NewToken(tot_cost, extra_cost, NULL, toks);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -270,7 +286,8 @@ inline LatticeFasterDecoder::Token *LatticeFasterDecoder::FindOrAddToken(
 // prunes outgoing links for all tokens in active_toks_[frame]
 // it's called by PruneActiveTokens
 // all links, that have link_extra_cost > lattice_beam are pruned
-void LatticeFasterDecoder::PruneForwardLinks(
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::PruneForwardLinks(
     int32 frame_plus_one, bool *extra_costs_changed,
     bool *links_pruned, BaseFloat delta) {
   // delta is the amount by which the extra_costs must change
@@ -314,7 +331,7 @@ void LatticeFasterDecoder::PruneForwardLinks(
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -346,14 +363,15 @@ void LatticeFasterDecoder::PruneForwardLinks(
 // PruneForwardLinksFinal is a version of PruneForwardLinks that we call
 // on the final frame.  If there are final tokens active, it uses
 // the final-probs for pruning, otherwise it treats all tokens as final.
-void LatticeFasterDecoder::PruneForwardLinksFinal() {
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::PruneForwardLinksFinal() {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame_plus_one = active_toks_.size() - 1;
 
   if (active_toks_[frame_plus_one].toks == NULL)  // empty list; should not happen.
     KALDI_WARN << "No tokens alive at end of file";
   
-  typedef unordered_map<Token*, BaseFloat>::const_iterator IterType;
+  typedef typename unordered_map<Token*, BaseFloat>::const_iterator IterType;
   ComputeFinalCosts(&final_costs_, &final_relative_cost_, &final_best_cost_);
   decoding_finalized_ = true;
   // We call DeleteElems() as a nicety, not because it's really necessary;
@@ -401,7 +419,7 @@ void LatticeFasterDecoder::PruneForwardLinksFinal() {
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -430,7 +448,8 @@ void LatticeFasterDecoder::PruneForwardLinksFinal() {
   } // while changed
 }
 
-BaseFloat LatticeFasterDecoder::FinalRelativeCost() const {
+template<template<class, class> class HashListType>
+BaseFloat LatticeFasterDecoderTpl<HashListType>::FinalRelativeCost() const {
   if (!decoding_finalized_) {
     BaseFloat relative_cost;
     ComputeFinalCosts(NULL, &relative_cost, NULL);
@@ -447,7 +466,9 @@ BaseFloat LatticeFasterDecoder::FinalRelativeCost() const {
 // [we don't do this in PruneForwardLinks because it would give us
 // a problem with dangling pointers].
 // It's called by PruneActiveTokens if any forward links have been pruned
-void LatticeFasterDecoder::PruneTokensForFrame(int32 frame_plus_one) {
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::PruneTokensForFrame(
+    int32 frame_plus_one) {
   KALDI_ASSERT(frame_plus_one >= 0 && frame_plus_one < active_toks_.size());
   Token *&toks = active_toks_[frame_plus_one].toks;
   if (toks == NULL)
@@ -460,7 +481,7 @@ void LatticeFasterDecoder::PruneTokensForFrame(int32 frame_plus_one) {
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      DeleteToken(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -473,7 +494,8 @@ void LatticeFasterDecoder::PruneTokensForFrame(int32 frame_plus_one) {
 // that.  We go backwards through the frames and stop when we reach a point
 // where the delta-costs are not changing (and the delta controls when we consider
 // a cost to have "not changed").
-void LatticeFasterDecoder::PruneActiveTokens(BaseFloat delta) {
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::PruneActiveTokens(BaseFloat delta) {
   int32 cur_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // The index "f" below represents a "frame plus one", i.e. you'd have to subtract
@@ -502,7 +524,8 @@ void LatticeFasterDecoder::PruneActiveTokens(BaseFloat delta) {
                 << " to " << num_toks_;
 }
 
-void LatticeFasterDecoder::ComputeFinalCosts(
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::ComputeFinalCosts(
     unordered_map<Token*, BaseFloat> *final_costs,
     BaseFloat *final_relative_cost,
     BaseFloat *final_best_cost) const {
@@ -544,8 +567,9 @@ void LatticeFasterDecoder::ComputeFinalCosts(
   }
 }
 
-void LatticeFasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
-                                             int32 max_num_frames) {
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::AdvanceDecoding(
+    DecodableInterface *decodable, int32 max_num_frames) {
   KALDI_ASSERT(!active_toks_.empty() && !decoding_finalized_ &&
                "You must call InitDecoding() before AdvanceDecoding");
   int32 num_frames_ready = decodable->NumFramesReady();
@@ -570,7 +594,8 @@ void LatticeFasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
 // FinalizeDecoding() is a version of PruneActiveTokens that we call
 // (optionally) on the final frame.  Takes into account the final-prob of
 // tokens.  This function used to be called PruneActiveTokensFinal().
-void LatticeFasterDecoder::FinalizeDecoding() {
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::FinalizeDecoding() {
   int32 final_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // PruneForwardLinksFinal() prunes final frame (with final-probs), and
@@ -585,11 +610,15 @@ void LatticeFasterDecoder::FinalizeDecoding() {
   PruneTokensForFrame(0);
   KALDI_VLOG(4) << "pruned tokens from " << num_toks_begin
                 << " to " << num_toks_;
+  KALDI_VLOG(4) << "Peak number of tokens was " << token_pool_.PeakInUse()
+                << ", of forward links " << link_pool_.PeakInUse();
 }
 
 /// Gets the weight cutoff.  Also counts the active tokens.
-BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
-                                          BaseFloat *adaptive_beam, Elem **best_elem) {
+template<template<class, class> class HashListType>
+BaseFloat LatticeFasterDecoderTpl<HashListType>::GetCutoff(
+    Elem *list_head, size_t *tok_count,
+    BaseFloat *adaptive_beam, Elem **best_elem) {
   BaseFloat best_weight = std::numeric_limits<BaseFloat>::infinity();
   // positive == high cost == bad.
   size_t count = 0;
@@ -657,7 +686,9 @@ BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
   }
 }
 
-BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
+template<template<class, class> class HashListType>
+BaseFloat LatticeFasterDecoderTpl<HashListType>::ProcessEmitting(
+    DecodableInterface *decodable) {
   KALDI_ASSERT(active_toks_.size() > 0);
   int32 frame = active_toks_.size() - 1; // frame is the frame-index
                                          // (zero-based) used to get likelihoods
@@ -738,7 +769,7 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
           // NULL: no change indicator needed
 
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLink(next_tok, arc.ilabel, arc.olabel,
+          tok->links = NewForwardLink(next_tok, arc.ilabel, arc.olabel,
                                        graph_cost, ac_cost, tok->links);
         }
       } // for all arcs
@@ -749,7 +780,9 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
   return next_cutoff;
 }
 
-void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::ProcessNonemitting(
+    BaseFloat cutoff) {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame = static_cast<int32>(active_toks_.size()) - 2;
   // Note: "frame" is the time-index we just processed, or -1 if
@@ -784,7 +817,7 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
     // but since most states are emitting it's not a huge issue.
-    tok->DeleteForwardLinks(); // necessary when re-visiting
+    tok->DeleteForwardLinks(&link_pool_); // necessary when re-visiting
     tok->links = NULL;
     for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
          !aiter.Done();
@@ -799,7 +832,7 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
           Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           &changed);
 
-          tok->links = new ForwardLink(new_tok, 0, arc.olabel,
+          tok->links = NewForwardLink(new_tok, 0, arc.olabel,
                                        graph_cost, 0, tok->links);
 
           // "changed" tells us whether the new token has a different
@@ -812,21 +845,24 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
 }
 
 
-void LatticeFasterDecoder::DeleteElems(Elem *list) {
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::DeleteElems(Elem *list) {
   for (Elem *e = list, *e_tail; e != NULL; e = e_tail) {
     e_tail = e->tail;
     toks_.Delete(e);
   }
 }
 
-void LatticeFasterDecoder::ClearActiveTokens() { // a cleanup routine, at utt end/begin
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::ClearActiveTokens() {
+  // a cleanup routine, at utt end/begin
   for (size_t i = 0; i < active_toks_.size(); i++) {
     // Delete all tokens alive on this frame, and any forward
     // links they may have.
     for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      tok->DeleteForwardLinks();
+      tok->DeleteForwardLinks(&link_pool_);
       Token *next_tok = tok->next;
-      delete tok;
+      DeleteToken(tok);
       num_toks_--;
       tok = next_tok;
     }
@@ -836,10 +872,11 @@ void LatticeFasterDecoder::ClearActiveTokens() { // a cleanup routine, at utt en
 }
 
 // static
-void LatticeFasterDecoder::TopSortTokens(Token *tok_list,
-                                         std::vector<Token*> *topsorted_list) {
+template<template<class, class> class HashListType>
+void LatticeFasterDecoderTpl<HashListType>::TopSortTokens(
+    Token *tok_list, std::vector<Token*> *topsorted_list) {
   unordered_map<Token*, int32> token2pos;
-  typedef unordered_map<Token*, int32>::iterator IterType;
+  typedef typename unordered_map<Token*, int32>::iterator IterType;
   int32 num_toks = 0;
   for (Token *tok = tok_list; tok != NULL; tok = tok->next)
     num_toks++;
@@ -881,11 +918,11 @@ void LatticeFasterDecoder::TopSortTokens(Token *tok_list,
   for (loop_count = 0;
        !reprocess.empty() && loop_count < max_loop; ++loop_count) {
     std::vector<Token*> reprocess_vec;
-    for (unordered_set<Token*>::iterator iter = reprocess.begin();
+    for (typename unordered_set<Token*>::iterator iter = reprocess.begin();
          iter != reprocess.end(); ++iter)
       reprocess_vec.push_back(*iter);
     reprocess.clear();
-    for (std::vector<Token*>::iterator iter = reprocess_vec.begin();
+    for (typename std::vector<Token*>::iterator iter = reprocess_vec.begin();
          iter != reprocess_vec.end(); ++iter) {
       Token *tok = *iter;
       int32 pos = token2pos[tok];
@@ -913,4 +950,8 @@ void LatticeFasterDecoder::TopSortTokens(Token *tok_list,
     (*topsorted_list)[iter->second] = iter->first;
 }
 
+// Instantiate the template for the hash types we use.
+template class LatticeFasterDecoderTpl<HashList>;
+template class LatticeFasterDecoderTpl<FlatHashList>;
+
 } // end namespace kaldi.
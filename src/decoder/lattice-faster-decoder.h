@@ -28,7 +28,9 @@
 
 
 #include "util/stl-utils.h"
+#include "util/memory-pool.h"
 #include "util/hash-list.h"
+#include "util/flat-hash-list.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -54,6 +56,9 @@ struct LatticeFasterDecoderConfig {
   // LatticeFasterDecoder class itself, but by the code that calls it, for
   // example in the function DecodeUtteranceLatticeFaster.
   fst::DeterminizeLatticePhonePrunedOptions det_opts;
+  // Options for splitting long lattices into pieces to be determinized in
+  // parallel, used in GetLattice().
+  fst::DeterminizeLatticeChunkOptions det_chunk_opts;
   
   LatticeFasterDecoderConfig(): beam(16.0),
                                 max_active(std::numeric_limits<int32>::max()),
@@ -66,6 +71,7 @@ struct LatticeFasterDecoderConfig {
                                 prune_scale(0.1) { }
   void Register(OptionsItf *opts) {
     det_opts.Register(opts);
+    det_chunk_opts.Register(opts);
     opts->Register("beam", &beam, "Decoding beam.");
     opts->Register("max-active", &max_active, "Decoder max active states.");
     opts->Register("min-active", &min_active, "Decoder minimum #active states.");
@@ -92,8 +98,14 @@ struct LatticeFasterDecoderConfig {
 /** A bit more optimized version of the lattice decoder.
    See \ref lattices_generation \ref decoders_faster and \ref decoders_simple
     for more information.
+
+   The template argument is the hash type used to index the tokens on the
+   current frame by state: HashList (hash-list.h), or FlatHashList
+   (flat-hash-list.h), which is faster for large beams.  Normally you would
+   use the typedef LatticeFasterDecoder, which uses HashList.
  */
-class LatticeFasterDecoder {
+template<template<class, class> class HashListType>
+class LatticeFasterDecoderTpl {
  public:
   typedef fst::StdArc Arc;
   typedef Arc::Label Label;
@@ -101,13 +113,13 @@ class LatticeFasterDecoder {
   typedef Arc::Weight Weight;
   
   // instantiate this class once for each thing you have to decode.
-  LatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
-                       const LatticeFasterDecoderConfig &config);
+  LatticeFasterDecoderTpl(const fst::Fst<fst::StdArc> &fst,
+                          const LatticeFasterDecoderConfig &config);
 
   // This version of the initializer "takes ownership" of the fst,
   // and will delete it when this object is destroyed.
-  LatticeFasterDecoder(const LatticeFasterDecoderConfig &config,
-                       fst::Fst<fst::StdArc> *fst);
+  LatticeFasterDecoderTpl(const LatticeFasterDecoderConfig &config,
+                          fst::Fst<fst::StdArc> *fst);
 
 
   void SetOptions(const LatticeFasterDecoderConfig &config) {
@@ -118,7 +130,7 @@ class LatticeFasterDecoder {
     return config_;
   }
   
-  ~LatticeFasterDecoder();
+  ~LatticeFasterDecoderTpl();
 
   /// Decodes until there are no more frames left in the "decodable" object..
   /// note, this may block waiting for input if the "decodable" object blocks.
@@ -205,6 +217,10 @@ class LatticeFasterDecoder {
   inline int32 NumFramesDecoded() const { return active_toks_.size() - 1; }
 
  private:
+  // LatticeFasterBatchDecoder (lattice-faster-batch-decoder.h) drives several
+  // instances of this class in lockstep and needs access to their token lists.
+  friend class LatticeFasterBatchDecoder;
+
   // ForwardLinks are the links from a token to a token on the next frame.
   // or sometimes on the current frame (for input-epsilon links).
   struct Token;
@@ -244,17 +260,35 @@ class LatticeFasterDecoder {
     inline Token(BaseFloat tot_cost, BaseFloat extra_cost, ForwardLink *links,
                  Token *next):
         tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next) { }
-    inline void DeleteForwardLinks() {
+    inline void DeleteForwardLinks(MemoryPool<ForwardLink> *link_pool) {
       ForwardLink *l = links, *m;
       while (l != NULL) {
         m = l->next;
-        delete l;
+        link_pool->Free(l);
         l = m;
       }
       links = NULL;
     }
   };
 
+  // Tokens and ForwardLinks are allocated from token_pool_ and link_pool_
+  // rather than with new and delete, to avoid the overhead of the system
+  // allocator (and contention on it, in multi-threaded programs).
+  inline Token *NewToken(BaseFloat tot_cost, BaseFloat extra_cost,
+                         ForwardLink *links, Token *next) {
+    return new (token_pool_.Allocate()) Token(tot_cost, extra_cost,
+                                              links, next);
+  }
+  inline void DeleteToken(Token *tok) { token_pool_.Free(tok); }
+  inline ForwardLink *NewForwardLink(Token *next_tok, Label ilabel,
+                                     Label olabel, BaseFloat graph_cost,
+                                     BaseFloat acoustic_cost,
+                                     ForwardLink *next) {
+    return new (link_pool_.Allocate()) ForwardLink(
+        next_tok, ilabel, olabel, graph_cost, acoustic_cost, next);
+  }
+  inline void DeleteForwardLink(ForwardLink *link) { link_pool_.Free(link); }
+
   // head of per-frame list of Tokens (list is in topological order),
   // and something saying whether we ever pruned it using PruneForwardLinks.
   struct TokenList {
@@ -265,7 +299,7 @@ class LatticeFasterDecoder {
                  must_prune_tokens(true) { }
   };
 
-  typedef HashList<StateId, Token*>::Elem Elem;
+  typedef typename HashListType<StateId, Token*>::Elem Elem;
 
   void PossiblyResizeHash(size_t num_toks);
 
@@ -347,14 +381,15 @@ class LatticeFasterDecoder {
   /// preceding ProcessEmitting().
   void ProcessNonemitting(BaseFloat cost_cutoff);
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
+  // HashList defined in ../util/hash-list.h (or FlatHashList, see
+  // ../util/flat-hash-list.h).  It actually allows us to maintain
   // more than one list (e.g. for current and previous frames), but only one of
   // them at a time can be indexed by StateId.  It is indexed by frame-index
   // plus one, where the frame-index is zero-based, as used in decodable object.
   // That is, the emitting probs of frame t are accounted for in tokens at
   // toks_[t+1].  The zeroth frame is for nonemitting transition at the start of
   // the graph.
-  HashList<StateId, Token*> toks_;
+  HashListType<StateId, Token*> toks_;
 
   std::vector<TokenList> active_toks_; // Lists of tokens, indexed by
   // frame (members of TokenList are toks, must_prune_forward_links,
@@ -369,6 +404,8 @@ class LatticeFasterDecoder {
   // frame in order to keep everything in a nice dynamic range.
   LatticeFasterDecoderConfig config_;
   int32 num_toks_; // current total #toks allocated...
+  MemoryPool<Token> token_pool_;
+  MemoryPool<ForwardLink> link_pool_;
   bool warned_;
 
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
@@ -409,9 +446,11 @@ class LatticeFasterDecoder {
 
   void ClearActiveTokens();
 
-  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterDecoder);  
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterDecoderTpl);
 };
 
+typedef LatticeFasterDecoderTpl<HashList> LatticeFasterDecoder;
+
 
 
 } // end namespace kaldi.
@@ -57,6 +57,8 @@ void LatticeFasterOnlineDecoder::InitDecoding() {
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
   ClearActiveTokens();
+  token_pool_.ResetPeak();
+  link_pool_.ResetPeak();
   warned_ = false;
   num_toks_ = 0;
   decoding_finalized_ = false;
@@ -64,7 +66,7 @@ void LatticeFasterOnlineDecoder::InitDecoding() {
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL, NULL);
+  Token *start_tok = NewToken(0.0, 0.0, NULL, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
@@ -145,15 +147,31 @@ bool LatticeFasterOnlineDecoder::GetBestPath(Lattice *olat,
 // tracebacks.
 bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
                                                bool use_final_probs) const {
+  return GetRawLatticeRange(0, NumFramesDecoded(), use_final_probs, ofst);
+}
+
+bool LatticeFasterOnlineDecoder::GetRawLatticeRange(
+    int32 begin_frame, int32 end_frame, bool use_final_probs,
+    Lattice *ofst) const {
   typedef LatticeArc Arc;
   typedef Arc::StateId StateId;
   typedef Arc::Weight Weight;
   typedef Arc::Label Label;
 
+  // num-frames plus one (since frames are one-based, and we have
+  // an extra frame for the start-state).
+  int32 num_frames = active_toks_.size() - 1;
+  KALDI_ASSERT(num_frames > 0);
+  KALDI_ASSERT(begin_frame >= 0 && begin_frame < end_frame &&
+               end_frame <= num_frames);
+  KALDI_ASSERT((begin_frame == 0 || HasSingleToken(begin_frame)) &&
+               (end_frame == num_frames || HasSingleToken(end_frame)));
+  bool is_end = (end_frame == num_frames);
+
   // Note: you can't use the old interface (Decode()) if you want to
   // get the lattice with use_final_probs = false.  You'd have to do
   // InitDecoding() and then AdvanceDecoding().
-  if (decoding_finalized_ && !use_final_probs)
+  if (is_end && decoding_finalized_ && !use_final_probs)
     KALDI_ERR << "You cannot call FinalizeDecoding() and then call "
               << "GetRawLattice() with use_final_probs == false";
 
@@ -161,19 +179,15 @@ bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
 
   const unordered_map<Token*, BaseFloat> &final_costs =
       (decoding_finalized_ ? final_costs_ : final_costs_local);
-  if (!decoding_finalized_ && use_final_probs)
+  if (is_end && !decoding_finalized_ && use_final_probs)
     ComputeFinalCosts(&final_costs_local, NULL, NULL);
 
   ofst->DeleteStates();
-  // num-frames plus one (since frames are one-based, and we have
-  // an extra frame for the start-state).
-  int32 num_frames = active_toks_.size() - 1;
-  KALDI_ASSERT(num_frames > 0);
   const int32 bucket_count = num_toks_/2 + 3;
   unordered_map<Token*, StateId> tok_map(bucket_count);
   // First create all states.
   std::vector<Token*> token_list;
-  for (int32 f = 0; f <= num_frames; f++) {
+  for (int32 f = begin_frame; f <= end_frame; f++) {
     if (active_toks_[f].toks == NULL) {
       KALDI_WARN << "GetRawLattice: no tokens active on frame " << f
                  << ": not producing lattice.\n";
@@ -192,9 +206,15 @@ bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
                 << tok_map.bucket_count() << " load:" << tok_map.load_factor()
                 << " max:" << tok_map.max_load_factor();
   // Now create all arcs.
-  for (int32 f = 0; f <= num_frames; f++) {
+  for (int32 f = begin_frame; f <= end_frame; f++) {
     for (Token *tok = active_toks_[f].toks; tok != NULL; tok = tok->next) {
       StateId cur_state = tok_map[tok];
+      if (f == end_frame && !is_end) {
+        // This is the only token on end_frame; the next piece of the lattice
+        // starts here.
+        ofst->SetFinal(cur_state, LatticeWeight::One());
+        continue;
+      }
       for (ForwardLink *l = tok->links;
            l != NULL;
            l = l->next) {
@@ -351,7 +371,7 @@ inline LatticeFasterOnlineDecoder::Token *LatticeFasterOnlineDecoder::FindOrAddT
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks, backpointer);
+    Token *new_tok = NewToken(tot_cost, extra_cost, NULL, toks, backpointer);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -425,7 +445,7 @@ void LatticeFasterOnlineDecoder::PruneForwardLinks(
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -512,7 +532,7 @@ void LatticeFasterOnlineDecoder::PruneForwardLinksFinal() {
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -572,7 +592,7 @@ void LatticeFasterOnlineDecoder::PruneTokensForFrame(int32 frame_plus_one) {
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      DeleteToken(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -787,6 +807,8 @@ void LatticeFasterOnlineDecoder::FinalizeDecoding() {
   PruneTokensForFrame(0);
   KALDI_VLOG(4) << "pruned tokens from " << num_toks_begin
                 << " to " << num_toks_;
+  KALDI_VLOG(4) << "Peak number of tokens was " << token_pool_.PeakInUse()
+                << ", of forward links " << link_pool_.PeakInUse();
 }
 
 /// Gets the weight cutoff.  Also counts the active tokens.
@@ -940,7 +962,7 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
           // NULL: no change indicator needed
 
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLink(next_tok, arc.ilabel, arc.olabel,
+          tok->links = NewForwardLink(next_tok, arc.ilabel, arc.olabel,
                                        graph_cost, ac_cost, tok->links);
         }
       } // for all arcs
@@ -986,7 +1008,7 @@ void LatticeFasterOnlineDecoder::ProcessNonemitting(BaseFloat cutoff) {
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
     // but since most states are emitting it's not a huge issue.
-    tok->DeleteForwardLinks(); // necessary when re-visiting
+    tok->DeleteForwardLinks(&link_pool_); // necessary when re-visiting
     tok->links = NULL;
     for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
          !aiter.Done();
@@ -1001,7 +1023,7 @@ void LatticeFasterOnlineDecoder::ProcessNonemitting(BaseFloat cutoff) {
           Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           tok, &changed);
 
-          tok->links = new ForwardLink(new_tok, 0, arc.olabel,
+          tok->links = NewForwardLink(new_tok, 0, arc.olabel,
                                        graph_cost, 0, tok->links);
 
           // "changed" tells us whether the new token has a different
@@ -1027,9 +1049,9 @@ void LatticeFasterOnlineDecoder::ClearActiveTokens() { // a cleanup routine, at
     // Delete all tokens alive on this frame, and any forward
     // links they may have.
     for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      tok->DeleteForwardLinks();
+      tok->DeleteForwardLinks(&link_pool_);
       Token *next_tok = tok->next;
-      delete tok;
+      DeleteToken(tok);
       num_toks_--;
       tok = next_tok;
     }
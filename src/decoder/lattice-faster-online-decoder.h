@@ -27,6 +27,7 @@
 #define KALDI_DECODER_LATTICE_FASTER_ONLINE_DECODER_H_
 
 #include "util/stl-utils.h"
+#include "util/memory-pool.h"
 #include "util/hash-list.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
@@ -143,6 +144,27 @@ class LatticeFasterOnlineDecoder {
   bool GetRawLattice(Lattice *ofst,
                      bool use_final_probs = true) const;
 
+  /// Like GetRawLattice(), but outputs only the part of the lattice between
+  /// frames begin_frame and end_frame inclusive, where frame 0 is the start
+  /// and frame NumFramesDecoded() is the most recently decoded one.  Unless
+  /// begin_frame is 0, it must have exactly one active token (see
+  /// HasSingleToken()), which will be the start state.  If end_frame is less
+  /// than NumFramesDecoded() it too must have exactly one active token, which
+  /// will be the only final state, with unit weight; otherwise the final-probs
+  /// are as for GetRawLattice().  Because every path passes through those
+  /// tokens, these pieces of the lattice can be determinized separately (see
+  /// class LatticeIncrementalDeterminizer).
+  bool GetRawLatticeRange(int32 begin_frame, int32 end_frame,
+                          bool use_final_probs, Lattice *ofst) const;
+
+  /// Returns true if exactly one token is active on frame "frame" (numbered as
+  /// for GetRawLatticeRange()), so that all paths pass through it.
+  bool HasSingleToken(int32 frame) const {
+    KALDI_ASSERT(frame >= 0 && frame < active_toks_.size());
+    const Token *tok = active_toks_[frame].toks;
+    return (tok != NULL && tok->next == NULL);
+  }
+
   /// Behaves the same like GetRawLattice but only processes tokens whose
   /// extra_cost is smaller than the best-cost plus the specified beam.
   /// It is only worthwhile to call this function if beam is less than
@@ -240,17 +262,35 @@ class LatticeFasterOnlineDecoder {
                  Token *next, Token *backpointer):
         tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next),
         backpointer(backpointer) { }
-    inline void DeleteForwardLinks() {
+    inline void DeleteForwardLinks(MemoryPool<ForwardLink> *link_pool) {
       ForwardLink *l = links, *m;
       while (l != NULL) {
         m = l->next;
-        delete l;
+        link_pool->Free(l);
         l = m;
       }
       links = NULL;
     }
   };
 
+  // Tokens and ForwardLinks are allocated from token_pool_ and link_pool_
+  // rather than with new and delete, to avoid the overhead of the system
+  // allocator (and contention on it, in multi-threaded programs).
+  inline Token *NewToken(BaseFloat tot_cost, BaseFloat extra_cost,
+                         ForwardLink *links, Token *next, Token *backpointer) {
+    return new (token_pool_.Allocate()) Token(tot_cost, extra_cost,
+                                              links, next, backpointer);
+  }
+  inline void DeleteToken(Token *tok) { token_pool_.Free(tok); }
+  inline ForwardLink *NewForwardLink(Token *next_tok, Label ilabel,
+                                     Label olabel, BaseFloat graph_cost,
+                                     BaseFloat acoustic_cost,
+                                     ForwardLink *next) {
+    return new (link_pool_.Allocate()) ForwardLink(
+        next_tok, ilabel, olabel, graph_cost, acoustic_cost, next);
+  }
+  inline void DeleteForwardLink(ForwardLink *link) { link_pool_.Free(link); }
+
   // head of per-frame list of Tokens (list is in topological order),
   // and something saying whether we ever pruned it using PruneForwardLinks.
   struct TokenList {
@@ -366,6 +406,8 @@ class LatticeFasterOnlineDecoder {
   // frame in order to keep everything in a nice dynamic range.
   LatticeFasterDecoderConfig config_;
   int32 num_toks_; // current total #toks allocated...
+  MemoryPool<Token> token_pool_;
+  MemoryPool<ForwardLink> link_pool_;
   bool warned_;
 
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
@@ -0,0 +1,83 @@
+// decoder/lattice-incremental-determinizer-speed-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lattice-incremental-determinizer.h"
+#include "decoder/lattice-incremental-determinizer-test-utils.h"
+#include "decoder/decodable-matrix.h"
+#include "tree/context-dep.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+// Compares the time it takes to get the lattice at the end of a long utterance
+// when it has been determinized incrementally, and when it has not.
+void IncrementalDeterminizationSpeedTest() {
+  std::vector<int32> phones;
+  for (int32 i = 1; i <= 10; i++)
+    phones.push_back(i);
+  std::vector<int32> num_pdf_classes;
+  ContextDependency *ctx_dep =
+      GenRandContextDependencyLarge(phones, 1, 0, true, &num_pdf_classes);
+  TransitionModel trans_model(*ctx_dep, GetDefaultTopology(phones));
+  delete ctx_dep;
+  int32 sil_tid = 1;
+  fst::VectorFst<fst::StdArc> graph;
+  MakeGraph(trans_model, sil_tid, 20, &graph);
+  LatticeFasterDecoderConfig decoder_config;
+  LatticeIncrementalDeterminizerConfig config;
+  config.incremental = true;
+  LatticeFasterOnlineDecoder decoder(graph, decoder_config);
+  LatticeIncrementalDeterminizer determinizer(config, decoder_config,
+                                              trans_model);
+  for (int32 num_frames = 1000; num_frames <= 8000; num_frames *= 2) {
+    Matrix<BaseFloat> loglikes;
+    MakeLoglikes(trans_model, sil_tid, num_frames, 300, &loglikes);
+    DecodableMatrixScaledMapped decodable(trans_model, loglikes, 1.0);
+    decoder.InitDecoding();
+    determinizer.Reset();
+    double incremental_time = 0.0;
+    while (decoder.NumFramesDecoded() < num_frames) {
+      decoder.AdvanceDecoding(&decodable, 20);
+      Timer timer;
+      determinizer.AdvanceDeterminization(decoder);
+      incremental_time += timer.Elapsed();
+    }
+    CompactLattice clat;
+    Timer timer;
+    determinizer.GetLattice(decoder, true, &clat);
+    double incremental_latency = timer.Elapsed();
+    timer.Reset();
+    DeterminizeWhole(trans_model, decoder_config, decoder, &clat);
+    double whole_latency = timer.Elapsed();
+    KALDI_LOG << "For " << num_frames << " frames, time to get the final "
+              << "lattice was " << incremental_latency << " seconds with "
+              << "incremental determinization (plus " << incremental_time
+              << " seconds while decoding), vs. " << whole_latency
+              << " seconds without.";
+  }
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  IncrementalDeterminizationSpeedTest();
+  std::cout << "Test OK.\n";
+  return 0;
+}
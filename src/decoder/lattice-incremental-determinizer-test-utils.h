@@ -0,0 +1,104 @@
+// decoder/lattice-incremental-determinizer-test-utils.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_LATTICE_INCREMENTAL_DETERMINIZER_TEST_UTILS_H_
+#define KALDI_DECODER_LATTICE_INCREMENTAL_DETERMINIZER_TEST_UTILS_H_
+
+// This header contains functions shared by the test and the speed test of
+// LatticeIncrementalDeterminizer; it is not part of the library.
+
+#include <vector>
+#include "decoder/lattice-faster-online-decoder.h"
+#include "hmm/transition-model.h"
+#include "lat/determinize-lattice-pruned.h"
+#include "matrix/kaldi-matrix.h"
+
+namespace kaldi {
+
+// Makes a decoding graph over the transition-ids of "trans_model": a loop
+// through state 0 (the start state, which is final) with a self-loop on
+// "sil_tid", and a few words, each a short chain of states with self-loops,
+// that start and end at state 0.  The other transition-ids on the graph have
+// pdfs different from that of "sil_tid".
+inline void MakeGraph(const TransitionModel &trans_model, int32 sil_tid,
+                      int32 num_words, fst::VectorFst<fst::StdArc> *graph) {
+  typedef fst::StdArc Arc;
+  typedef Arc::StateId StateId;
+  int32 sil_pdf = trans_model.TransitionIdToPdf(sil_tid);
+  std::vector<int32> tids;
+  for (int32 tid = 1; tid <= trans_model.NumTransitionIds(); tid++)
+    if (trans_model.TransitionIdToPdf(tid) != sil_pdf)
+      tids.push_back(tid);
+  KALDI_ASSERT(!tids.empty());
+  graph->DeleteStates();
+  StateId loop_state = graph->AddState();
+  graph->SetStart(loop_state);
+  graph->SetFinal(loop_state, fst::TropicalWeight::One());
+  graph->AddArc(loop_state, Arc(sil_tid, 0, RandUniform(), loop_state));
+  for (int32 word = 1; word <= num_words; word++) {
+    // Each word is one to three states long.  Several words may have the same
+    // transition-ids, so the lattices will have alternatives.
+    int32 length = 1 + Rand() % 3;
+    StateId prev = loop_state;
+    for (int32 i = 0; i < length; i++) {
+      StateId s = graph->AddState();
+      int32 tid = tids[Rand() % tids.size()];
+      graph->AddArc(prev, Arc(tid, (i == 0 ? word : 0), RandUniform(), s));
+      graph->AddArc(s, Arc(tid, 0, RandUniform(), s));
+      prev = s;
+    }
+    graph->AddArc(prev, Arc(tids[Rand() % tids.size()], 0, RandUniform(),
+                            loop_state));
+  }
+}
+
+// Makes log-likelihoods for "num_frames" frames.  Every "boundary_interval"
+// frames, there are two frames on which only the pdf of "sil_tid" is
+// likely, so that after them only the token in the loop state of the graph
+// from MakeGraph() is active: on the first frame the tokens that did not take
+// the silence self-loop are far outside the beam, and on the second they are
+// not even expanded.  This gives the determinizer places to split.
+inline void MakeLoglikes(const TransitionModel &trans_model, int32 sil_tid,
+                         int32 num_frames, int32 boundary_interval,
+                         Matrix<BaseFloat> *loglikes) {
+  int32 sil_pdf = trans_model.TransitionIdToPdf(sil_tid);
+  loglikes->Resize(num_frames, trans_model.NumPdfs());
+  loglikes->SetRandn();
+  for (int32 t = 0; t < num_frames; t++) {
+    if (t % boundary_interval >= boundary_interval - 2) {
+      loglikes->Row(t).Set(-100.0);
+      (*loglikes)(t, sil_pdf) = 0.0;
+    }
+  }
+}
+
+// Determinizes the whole lattice of "decoder", as the decoding programs do.
+inline void DeterminizeWhole(const TransitionModel &trans_model,
+                             const LatticeFasterDecoderConfig &config,
+                             const LatticeFasterOnlineDecoder &decoder,
+                             CompactLattice *clat) {
+  Lattice raw_lat;
+  decoder.GetRawLattice(&raw_lat, true);
+  fst::DeterminizeLatticePhonePrunedWrapper(
+      trans_model, &raw_lat, config.lattice_beam, clat, config.det_opts);
+}
+
+}  // end namespace kaldi
+
+#endif  // KALDI_DECODER_LATTICE_INCREMENTAL_DETERMINIZER_TEST_UTILS_H_
@@ -0,0 +1,275 @@
+// decoder/lattice-incremental-determinizer-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "decoder/lattice-incremental-determinizer.h"
+#include "decoder/lattice-incremental-determinizer-test-utils.h"
+#include "decoder/decodable-matrix.h"
+#include "fstext/fstext-utils.h"
+#include "lat/lattice-functions.h"
+#include "tree/context-dep.h"
+
+namespace kaldi {
+
+// Returns the CompactLatticeWeight with the given costs and string.
+static CompactLatticeWeight MakeWeight(BaseFloat graph_cost,
+                                       BaseFloat acoustic_cost,
+                                       int32 num_tids, int32 first_tid) {
+  std::vector<int32> tids;
+  for (int32 i = 0; i < num_tids; i++)
+    tids.push_back(first_tid + i);
+  return CompactLatticeWeight(LatticeWeight(graph_cost, acoustic_cost), tids);
+}
+
+// Adds an arc with word "word" to "clat".
+static void AddWordArc(CompactLatticeArc::StateId from, int32 word,
+                       const CompactLatticeWeight &weight,
+                       CompactLatticeArc::StateId to, CompactLattice *clat) {
+  clat->AddArc(from, CompactLatticeArc(word, word, weight, to));
+}
+
+// Returns the number of arcs in "clat".
+static int32 NumArcs(const CompactLattice &clat) {
+  int32 num_arcs = 0;
+  for (CompactLatticeArc::StateId s = 0; s < clat.NumStates(); s++)
+    num_arcs += clat.NumArcs(s);
+  return num_arcs;
+}
+
+// Checks that "clat" has no epsilon arcs.
+static void AssertNoEpsilons(const CompactLattice &clat) {
+  for (CompactLatticeArc::StateId s = 0; s < clat.NumStates(); s++)
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next())
+      KALDI_ASSERT(aiter.Value().ilabel != 0);
+}
+
+// Tests JoinCompactLattices() on small hand-built pieces, by comparing with
+// OpenFst's Concat().
+void UnitTestJoinCompactLattices() {
+  // Piece a: words 1 or 2, or 1 3; state 1 is final and also has an arc.
+  CompactLattice a;
+  for (int32 i = 0; i < 3; i++) a.AddState();
+  a.SetStart(0);
+  AddWordArc(0, 1, MakeWeight(1.0, 0.0, 1, 5), 1, &a);
+  AddWordArc(0, 2, MakeWeight(2.0, 0.0, 1, 6), 2, &a);
+  AddWordArc(1, 3, MakeWeight(0.5, 0.0, 1, 7), 2, &a);
+  a.SetFinal(1, MakeWeight(0.0, 0.0, 0, 0));
+  a.SetFinal(2, MakeWeight(0.0, 1.0, 1, 8));
+  // Piece b: words 4 or 5, or nothing (its start state is final).
+  CompactLattice b;
+  for (int32 i = 0; i < 2; i++) b.AddState();
+  b.SetStart(0);
+  AddWordArc(0, 4, MakeWeight(1.0, 1.0, 1, 9), 1, &b);
+  AddWordArc(0, 5, MakeWeight(0.0, 2.5, 2, 10), 1, &b);
+  b.SetFinal(0, MakeWeight(3.0, 0.0, 0, 0));
+  b.SetFinal(1, CompactLatticeWeight::One());
+  // Piece c: word 6.
+  CompactLattice c;
+  for (int32 i = 0; i < 2; i++) c.AddState();
+  c.SetStart(0);
+  AddWordArc(0, 6, MakeWeight(1.0, 0.0, 1, 12), 1, &c);
+  c.SetFinal(1, MakeWeight(0.0, 0.5, 1, 13));
+
+  {  // A single piece is copied.
+    std::vector<const CompactLattice*> pieces;
+    pieces.push_back(&a);
+    CompactLattice joined;
+    JoinCompactLattices(pieces, &joined);
+    KALDI_ASSERT(joined.NumStates() == a.NumStates());
+    KALDI_ASSERT(fst::RandEquivalent(a, joined, 5, 0.01, Rand(), 10));
+  }
+  {  // a followed by b.
+    std::vector<const CompactLattice*> pieces;
+    pieces.push_back(&a);
+    pieces.push_back(&b);
+    CompactLattice joined, ref(a);
+    JoinCompactLattices(pieces, &joined);
+    fst::Concat(&ref, b);
+    // The start state of b is not copied, and no epsilons are added.
+    KALDI_ASSERT(joined.NumStates() == a.NumStates() + b.NumStates() - 1);
+    AssertNoEpsilons(joined);
+    KALDI_ASSERT(fst::RandEquivalent(ref, joined, 20, 0.01, Rand(), 10));
+    // a's final states now have b's arcs, and, because b's start state is
+    // final, they stay final with the final-probs multiplied.
+    KALDI_ASSERT(joined.NumArcs(joined.Start()) == 2);
+    CompactLattice path;
+    CompactLatticeShortestPath(joined, &path);
+    Lattice lat;
+    ConvertLattice(path, &lat);
+    std::vector<int32> tids, words;
+    LatticeWeight weight;
+    fst::GetLinearSymbolSequence(lat, &tids, &words, &weight);
+    // The best path is word 1 followed by word 4, with cost 1 + 2.
+    KALDI_ASSERT(words.size() == 2 && words[0] == 1 && words[1] == 4);
+    KALDI_ASSERT(tids.size() == 2 && tids[0] == 5 && tids[1] == 9);
+    KALDI_ASSERT(ApproxEqual(weight.Value1() + weight.Value2(), 3.0));
+  }
+  {  // a, b and c: since b may be empty, a's final states get c's arcs too.
+    std::vector<const CompactLattice*> pieces;
+    pieces.push_back(&a);
+    pieces.push_back(&b);
+    pieces.push_back(&c);
+    CompactLattice joined, ref(a);
+    JoinCompactLattices(pieces, &joined);
+    fst::Concat(&ref, b);
+    fst::Concat(&ref, c);
+    KALDI_ASSERT(joined.NumStates() ==
+                 a.NumStates() + b.NumStates() + c.NumStates() - 2);
+    AssertNoEpsilons(joined);
+    KALDI_ASSERT(fst::RandEquivalent(ref, joined, 20, 0.01, Rand(), 10));
+    for (CompactLatticeArc::StateId s = 0; s < joined.NumStates(); s++) {
+      // Only the states from c can be final.
+      if (joined.Final(s) != CompactLatticeWeight::Zero())
+        KALDI_ASSERT(joined.NumArcs(s) == 0);
+    }
+  }
+  {  // An empty piece gives empty output.
+    CompactLattice empty;
+    std::vector<const CompactLattice*> pieces;
+    pieces.push_back(&a);
+    pieces.push_back(&empty);
+    pieces.push_back(&c);
+    CompactLattice joined;
+    JoinCompactLattices(pieces, &joined);
+    KALDI_ASSERT(joined.NumStates() == 0);
+  }
+}
+
+// Decodes "loglikes" with "graph", a few frames at a time, calling
+// AdvanceDeterminization() after each call to AdvanceDecoding().
+static void DecodeIncrementally(const TransitionModel &trans_model,
+                                const Matrix<BaseFloat> &loglikes,
+                                LatticeFasterOnlineDecoder *decoder,
+                                LatticeIncrementalDeterminizer *determinizer) {
+  DecodableMatrixScaledMapped decodable(trans_model, loglikes, 1.0);
+  decoder->InitDecoding();
+  determinizer->Reset();
+  while (decoder->NumFramesDecoded() < loglikes.NumRows()) {
+    decoder->AdvanceDecoding(&decodable, 1 + Rand() % 20);
+    determinizer->AdvanceDeterminization(*decoder);
+  }
+}
+
+// Gets the word sequences of the n best paths of "clat", sorted by cost, with
+// their costs and transition-ids, but only those within "beam" of the best.
+static void GetNbest(const CompactLattice &clat, int32 n, BaseFloat beam,
+                     std::vector<std::pair<BaseFloat, std::vector<int32> > >
+                     *words_list,
+                     std::vector<std::vector<int32> > *tids_list) {
+  Lattice lat, nbest_lat;
+  ConvertLattice(clat, &lat);
+  fst::ShortestPath(lat, &nbest_lat, n);
+  std::vector<std::vector<int32> > tids, words;
+  std::vector<LatticeWeight> weights;
+  fst::GetLinearSymbolSequences(nbest_lat, &tids, &words, &weights);
+  std::vector<std::pair<BaseFloat, int32> > sorted;
+  for (size_t i = 0; i < weights.size(); i++)
+    sorted.push_back(std::make_pair(weights[i].Value1() + weights[i].Value2(),
+                                    static_cast<int32>(i)));
+  std::sort(sorted.begin(), sorted.end());
+  words_list->clear();
+  tids_list->clear();
+  for (size_t i = 0; i < sorted.size(); i++) {
+    if (sorted[i].first > sorted[0].first + beam) break;
+    words_list->push_back(std::make_pair(sorted[i].first,
+                                         words[sorted[i].second]));
+    tids_list->push_back(tids[sorted[i].second]);
+  }
+}
+
+// Checks that incremental determinization, with the lattice split every few
+// frames, gives the same lattice as determinizing the whole raw lattice at
+// once with DeterminizeLatticePhonePrunedWrapper().
+void UnitTestIncrementalDeterminization() {
+  std::vector<int32> phones;
+  for (int32 i = 1; i <= 10; i++)
+    phones.push_back(i);
+  std::vector<int32> num_pdf_classes;
+  ContextDependency *ctx_dep =
+      GenRandContextDependencyLarge(phones, 1, 0, true, &num_pdf_classes);
+  TransitionModel trans_model(*ctx_dep, GetDefaultTopology(phones));
+  delete ctx_dep;
+
+  int32 sil_tid = 1;
+  fst::VectorFst<fst::StdArc> graph;
+  MakeGraph(trans_model, sil_tid, 5 + Rand() % 10, &graph);
+
+  int32 boundary_interval = 10 + Rand() % 20,
+      num_frames = 50 + Rand() % 300;
+  Matrix<BaseFloat> loglikes;
+  MakeLoglikes(trans_model, sil_tid, num_frames, boundary_interval, &loglikes);
+
+  LatticeFasterDecoderConfig decoder_config;
+  decoder_config.lattice_beam = 4.0;
+  decoder_config.prune_interval = 5 + Rand() % 10;
+  LatticeIncrementalDeterminizerConfig config;
+  config.incremental = true;
+  config.min_chunk_length = 1 + Rand() % boundary_interval;
+
+  LatticeFasterOnlineDecoder decoder(graph, decoder_config);
+  LatticeIncrementalDeterminizer determinizer(config, decoder_config,
+                                              trans_model);
+  DecodeIncrementally(trans_model, loglikes, &decoder, &determinizer);
+  // Make sure the test splits the lattice.
+  if (num_frames >= boundary_interval + decoder_config.prune_interval)
+    KALDI_ASSERT(determinizer.NumFramesDeterminized() > 0);
+
+  CompactLattice clat_incremental, clat_whole;
+  determinizer.GetLattice(decoder, true, &clat_incremental);
+  DeterminizeWhole(trans_model, decoder_config, decoder, &clat_whole);
+  KALDI_ASSERT(clat_whole.Start() != fst::kNoStateId &&
+               clat_incremental.Start() != fst::kNoStateId);
+  KALDI_VLOG(1) << "Lattice determinized incrementally up to frame "
+                << determinizer.NumFramesDeterminized() << " of "
+                << num_frames << " has " << clat_incremental.NumStates()
+                << " states; determinized as a whole, it has "
+                << clat_whole.NumStates();
+
+  // Both lattices are pruned with the lattice beam relative to the best path
+  // of the whole utterance, so they should have the same paths within the
+  // beam (we use a little less, to avoid rounding problems), and neither
+  // should have anything outside it: pruning again with a little more than
+  // the beam must not remove any arcs.
+  std::vector<std::pair<BaseFloat, std::vector<int32> > > words1, words2;
+  std::vector<std::vector<int32> > tids1, tids2;
+  BaseFloat beam = decoder_config.lattice_beam - 0.1;
+  GetNbest(clat_whole, 20, beam, &words1, &tids1);
+  GetNbest(clat_incremental, 20, beam, &words2, &tids2);
+  KALDI_ASSERT(!words1.empty() && words1.size() == words2.size());
+  for (size_t i = 0; i < words1.size(); i++) {
+    KALDI_ASSERT(words1[i].second == words2[i].second);
+    KALDI_ASSERT(tids1[i] == tids2[i]);
+    KALDI_ASSERT(ApproxEqual(words1[i].first, words2[i].first, 1.0e-04));
+  }
+  CompactLattice clat_pruned(clat_incremental);
+  KALDI_ASSERT(PruneLattice(decoder_config.lattice_beam + 0.1, &clat_pruned));
+  KALDI_ASSERT(NumArcs(clat_pruned) == NumArcs(clat_incremental));
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestJoinCompactLattices();
+  for (int32 i = 0; i < 10; i++)
+    UnitTestIncrementalDeterminization();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,242 @@
+// decoder/lattice-incremental-determinizer.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "decoder/lattice-incremental-determinizer.h"
+#include "lat/determinize-lattice-pruned.h"
+#include "lat/lattice-functions.h"
+#include "lat/minimize-lattice.h"
+#include "lat/push-lattice.h"
+
+namespace kaldi {
+
+void JoinCompactLattices(const std::vector<const CompactLattice*> &pieces,
+                         CompactLattice *clat) {
+  typedef CompactLatticeArc::StateId StateId;
+  clat->DeleteStates();
+  // The states of *clat that are final, or that would be final if this were
+  // the last piece, with their final-probs.
+  std::vector<std::pair<StateId, CompactLatticeWeight> > finals, new_finals;
+  for (size_t k = 0; k < pieces.size(); k++) {
+    const CompactLattice &piece = *(pieces[k]);
+    StateId start = piece.Start();
+    if (start == fst::kNoStateId) {  // Empty piece.
+      clat->DeleteStates();
+      return;
+    }
+    // The start states of the pieces after the first are not copied.
+    std::vector<StateId> state_map(piece.NumStates(), fst::kNoStateId);
+    for (StateId s = 0; s < piece.NumStates(); s++)
+      if (k == 0 || s != start)
+        state_map[s] = clat->AddState();
+    if (k == 0)
+      clat->SetStart(state_map[start]);
+    new_finals.clear();
+    for (StateId s = 0; s < piece.NumStates(); s++) {
+      if (state_map[s] == fst::kNoStateId) continue;
+      for (fst::ArcIterator<CompactLattice> aiter(piece, s); !aiter.Done();
+           aiter.Next()) {
+        CompactLatticeArc arc = aiter.Value();
+        KALDI_ASSERT(state_map[arc.nextstate] != fst::kNoStateId);
+        arc.nextstate = state_map[arc.nextstate];
+        clat->AddArc(state_map[s], arc);
+      }
+      if (piece.Final(s) != CompactLatticeWeight::Zero())
+        new_finals.push_back(std::make_pair(state_map[s], piece.Final(s)));
+    }
+    if (k > 0) {
+      CompactLatticeWeight start_final = piece.Final(start);
+      for (size_t i = 0; i < finals.size(); i++) {
+        StateId s = finals[i].first;
+        const CompactLatticeWeight &final_weight = finals[i].second;
+        for (fst::ArcIterator<CompactLattice> aiter(piece, start);
+             !aiter.Done(); aiter.Next()) {
+          CompactLatticeArc arc = aiter.Value();
+          arc.weight = fst::Times(final_weight, arc.weight);
+          arc.nextstate = state_map[arc.nextstate];
+          clat->AddArc(s, arc);
+        }
+        if (start_final != CompactLatticeWeight::Zero())
+          new_finals.push_back(
+              std::make_pair(s, fst::Times(final_weight, start_final)));
+      }
+    }
+    finals.swap(new_finals);
+  }
+  for (size_t i = 0; i < finals.size(); i++)
+    clat->SetFinal(finals[i].first, finals[i].second);
+}
+
+
+LatticeIncrementalDeterminizer::LatticeIncrementalDeterminizer(
+    const LatticeIncrementalDeterminizerConfig &config,
+    const LatticeFasterDecoderConfig &decoder_config,
+    const TransitionModel &trans_model):
+    config_(config), decoder_config_(decoder_config),
+    trans_model_(trans_model), end_frame_(0), next_frame_to_check_(0) {
+  KALDI_ASSERT(config_.min_chunk_length > 0);
+  decoder_config_.Check();
+}
+
+void LatticeIncrementalDeterminizer::Reset() {
+  for (size_t i = 0; i < pieces_.size(); i++)
+    delete pieces_[i];
+  pieces_.clear();
+  end_frame_ = 0;
+  next_frame_to_check_ = 0;
+}
+
+void LatticeIncrementalDeterminizer::DeterminizeRange(
+    const LatticeFasterOnlineDecoder &decoder,
+    int32 begin_frame, int32 end_frame,
+    bool use_final_probs, CompactLattice *clat) const {
+  Lattice raw_lat;
+  decoder.GetRawLatticeRange(begin_frame, end_frame, use_final_probs,
+                             &raw_lat);
+  fst::DeterminizeLatticePhonePrunedWrapper(
+      trans_model_, &raw_lat, decoder_config_.lattice_beam, clat,
+      decoder_config_.det_opts);
+}
+
+bool LatticeIncrementalDeterminizer::JoinIsAmbiguous(
+    const std::vector<CompactLattice*> &pieces, size_t num_pieces,
+    const CompactLattice &next) {
+  typedef CompactLatticeArc::StateId StateId;
+  typedef CompactLatticeArc::Label Label;
+  // The joined lattice can only be nondeterministic if a state that gets the
+  // arcs of the start state of "next" already has an arc with one of the same
+  // words.  Those states are the final states of the last piece, and, if the
+  // last piece accepts the empty word sequence (its start state is final),
+  // those of the piece before it, and so on.
+  if (next.Start() == fst::kNoStateId)
+    return false;  // empty; JoinCompactLattices() will give empty output.
+  std::vector<Label> start_words;
+  for (fst::ArcIterator<CompactLattice> aiter(next, next.Start());
+       !aiter.Done(); aiter.Next())
+    start_words.push_back(aiter.Value().ilabel);
+  std::sort(start_words.begin(), start_words.end());
+  if (!start_words.empty() && start_words[0] == 0)
+    return true;  // epsilon arcs; should not happen.
+  for (size_t k = num_pieces; k > 0; k--) {
+    const CompactLattice &piece = *(pieces[k - 1]);
+    if (piece.Start() == fst::kNoStateId)
+      break;
+    for (StateId s = 0; s < piece.NumStates(); s++) {
+      if (piece.Final(s) == CompactLatticeWeight::Zero()) continue;
+      for (fst::ArcIterator<CompactLattice> aiter(piece, s); !aiter.Done();
+           aiter.Next()) {
+        Label word = aiter.Value().ilabel;
+        if (word == 0 || std::binary_search(start_words.begin(),
+                                            start_words.end(), word))
+          return true;
+      }
+    }
+    if (piece.Final(piece.Start()) == CompactLatticeWeight::Zero())
+      break;
+  }
+  return false;
+}
+
+void LatticeIncrementalDeterminizer::MergePieces(
+    const CompactLattice &first, CompactLattice *second) const {
+  std::vector<const CompactLattice*> pieces;
+  pieces.push_back(&first);
+  pieces.push_back(second);
+  CompactLattice joined;
+  JoinCompactLattices(pieces, &joined);
+  // Convert to a Lattice with the words on the input side, which is what
+  // DeterminizeLatticePruned() expects.
+  Lattice lat;
+  ConvertLattice(joined, &lat, false);
+  joined.DeleteStates();
+  if (!TopSort(&lat))
+    KALDI_ERR << "Joined lattice has cycles (should not happen).";
+  fst::ArcSort(&lat, fst::ILabelCompare<LatticeArc>());
+  fst::DeterminizeLatticePrunedOptions opts;
+  opts.max_mem = decoder_config_.det_opts.max_mem;
+  if (!fst::DeterminizeLatticePruned(lat, decoder_config_.lattice_beam,
+                                     second, opts))
+    KALDI_WARN << "Determinization finished earlier than the beam";
+  if (decoder_config_.det_opts.minimize) {
+    PushCompactLatticeStrings(second);
+    PushCompactLatticeWeights(second);
+    MinimizeCompactLattice(second);
+  }
+  Connect(second);
+}
+
+void LatticeIncrementalDeterminizer::AdvanceDeterminization(
+    const LatticeFasterOnlineDecoder &decoder) {
+  int32 num_frames = decoder.NumFramesDecoded();
+  // If this fails, you called InitDecoding() on the decoder without calling
+  // Reset().
+  KALDI_ASSERT(num_frames >= end_frame_);
+  // We only split at frames that the decoder has had a chance to prune.
+  int32 last_frame = num_frames - decoder_config_.prune_interval;
+  next_frame_to_check_ = std::max(next_frame_to_check_,
+                                  end_frame_ + config_.min_chunk_length);
+  for (; next_frame_to_check_ <= last_frame; next_frame_to_check_++) {
+    int32 frame = next_frame_to_check_;
+    if (frame - end_frame_ < config_.min_chunk_length ||
+        !decoder.HasSingleToken(frame))
+      continue;
+    CompactLattice *piece = new CompactLattice();
+    DeterminizeRange(decoder, end_frame_, frame, false, piece);
+    KALDI_VLOG(2) << "Determinized frames " << end_frame_ << " to " << frame
+                  << ", giving " << piece->NumStates() << " states.";
+    end_frame_ = frame;
+    while (!pieces_.empty() &&
+           JoinIsAmbiguous(pieces_, pieces_.size(), *piece)) {
+      MergePieces(*(pieces_.back()), piece);
+      delete pieces_.back();
+      pieces_.pop_back();
+    }
+    pieces_.push_back(piece);
+  }
+}
+
+void LatticeIncrementalDeterminizer::GetLattice(
+    const LatticeFasterOnlineDecoder &decoder, bool use_final_probs,
+    CompactLattice *clat) const {
+  int32 num_frames = decoder.NumFramesDecoded();
+  KALDI_ASSERT(num_frames > end_frame_);
+  CompactLattice last_piece;
+  DeterminizeRange(decoder, end_frame_, num_frames, use_final_probs,
+                   &last_piece);
+  // This is like the loop in AdvanceDeterminization(), but we can't change
+  // pieces_.
+  size_t num_pieces = pieces_.size();
+  while (num_pieces > 0 && JoinIsAmbiguous(pieces_, num_pieces, last_piece)) {
+    MergePieces(*(pieces_[num_pieces - 1]), &last_piece);
+    num_pieces--;
+  }
+  std::vector<const CompactLattice*> pieces(pieces_.begin(),
+                                            pieces_.begin() + num_pieces);
+  pieces.push_back(&last_piece);
+  JoinCompactLattices(pieces, clat);
+  // Each piece was pruned relative to its own best path; prune the whole
+  // lattice relative to the best path through all of it, as
+  // DeterminizeLatticePhonePrunedWrapper() would have done.
+  if (clat->NumStates() != 0 &&
+      !PruneLattice(decoder_config_.lattice_beam, clat))
+    KALDI_WARN << "Error pruning the joined lattice.";
+  Connect(clat);
+}
+
+}  // end namespace kaldi
@@ -0,0 +1,144 @@
+// decoder/lattice-incremental-determinizer.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_LATTICE_INCREMENTAL_DETERMINIZER_H_
+#define KALDI_DECODER_LATTICE_INCREMENTAL_DETERMINIZER_H_
+
+#include <vector>
+#include "itf/options-itf.h"
+#include "hmm/transition-model.h"
+#include "lat/kaldi-lattice.h"
+#include "decoder/lattice-faster-online-decoder.h"
+
+namespace kaldi {
+
+struct LatticeIncrementalDeterminizerConfig {
+  bool incremental;
+  int32 min_chunk_length;
+
+  LatticeIncrementalDeterminizerConfig(): incremental(false),
+                                          min_chunk_length(200) { }
+  void Register(OptionsItf *opts) {
+    opts->Register("determinize-incremental", &incremental, "If true, "
+                   "determinize the lattice in pieces as decoding proceeds, "
+                   "so that getting the lattice at the end of a long "
+                   "utterance is fast.");
+    opts->Register("determinize-incremental-chunk", &min_chunk_length,
+                   "Minimum length in frames of the pieces of the lattice "
+                   "that are determinized as decoding proceeds, if "
+                   "--determinize-incremental=true.");
+  }
+};
+
+/**
+   LatticeIncrementalDeterminizer determinizes the lattice of an utterance
+   that is being decoded with LatticeFasterOnlineDecoder a piece at a time,
+   as decoding proceeds, so that when you want the lattice at the end of the
+   utterance, only the part since the end of the last piece needs to be
+   determinized.  Each piece is pruned with lattice_beam relative to its own
+   best path, which keeps every path that is within lattice_beam of the best
+   path of the whole utterance; the joined lattice is then pruned again
+   relative to that best path.  So it has the same paths and weights as
+   getting the raw lattice and calling DeterminizeLatticePhonePrunedWrapper()
+   (up to the usual approximations of pruned determinization), although the
+   states may be numbered differently.
+
+   The lattice is split at frames on which the decoder's pruning has left only
+   one active token, so that every path passes through that token (these are
+   common, e.g. in silences); we wait until the frames are at least
+   "prune_interval" frames behind the decoding front, so that the decoder has
+   pruned them.  Because of this the pieces can be determinized and pruned
+   separately.  The determinized pieces are joined by copying the arcs of the
+   start state of each piece to the final states of the previous one.  If
+   that would make the result nondeterministic (when a word sequence could be
+   split between two pieces in more than one way, which is rare), the two
+   pieces are determinized together instead.
+
+   Call AdvanceDeterminization() after each call to the decoder's
+   AdvanceDecoding() (it is cheap if there is nothing to do), and
+   GetLattice() when you want the lattice.
+*/
+class LatticeIncrementalDeterminizer {
+ public:
+  /// "decoder_config" provides the lattice beam and the determinization
+  /// options.
+  LatticeIncrementalDeterminizer(
+      const LatticeIncrementalDeterminizerConfig &config,
+      const LatticeFasterDecoderConfig &decoder_config,
+      const TransitionModel &trans_model);
+
+  /// Determinizes any new pieces of the lattice of "decoder" that are ready.
+  void AdvanceDeterminization(const LatticeFasterOnlineDecoder &decoder);
+
+  /// Outputs the determinized lattice for all the frames decoded so far.  The
+  /// meaning of "use_final_probs" is as for the decoder's GetRawLattice().
+  /// Requires decoder.NumFramesDecoded() > 0.
+  void GetLattice(const LatticeFasterOnlineDecoder &decoder,
+                  bool use_final_probs, CompactLattice *clat) const;
+
+  /// Returns the number of frames that have been determinized.
+  int32 NumFramesDeterminized() const { return end_frame_; }
+
+  /// Forgets the pieces determinized so far; call this if you call
+  /// InitDecoding() on the decoder.
+  void Reset();
+
+  ~LatticeIncrementalDeterminizer() { Reset(); }
+
+ private:
+  // Determinizes the raw lattice of "decoder" from begin_frame to end_frame
+  // (see LatticeFasterOnlineDecoder::GetRawLatticeRange()).
+  void DeterminizeRange(const LatticeFasterOnlineDecoder &decoder,
+                        int32 begin_frame, int32 end_frame,
+                        bool use_final_probs, CompactLattice *clat) const;
+
+  // Returns true if appending "next" to pieces[0] ... pieces[num_pieces - 1]
+  // might give a lattice that is not deterministic.
+  static bool JoinIsAmbiguous(const std::vector<CompactLattice*> &pieces,
+                              size_t num_pieces, const CompactLattice &next);
+
+  // Determinizes "first" followed by "second", and puts the result in
+  // "second".
+  void MergePieces(const CompactLattice &first, CompactLattice *second) const;
+
+  LatticeIncrementalDeterminizerConfig config_;
+  LatticeFasterDecoderConfig decoder_config_;
+  const TransitionModel &trans_model_;
+
+  // The determinized pieces of the lattice, in order; owned here.
+  std::vector<CompactLattice*> pieces_;
+  // The frame at which the last piece ends (see GetRawLatticeRange()), or zero.
+  int32 end_frame_;
+  // The frames before this have been checked for being a place to split.
+  int32 next_frame_to_check_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeIncrementalDeterminizer);
+};
+
+/// Joins the determinized lattices "pieces" together in order, as
+/// LatticeIncrementalDeterminizer does: the arcs and final-prob of the start
+/// state of each piece are copied to the final states of the previous one
+/// (with their final-probs multiplied in), so there are no epsilon arcs.  The
+/// start states of the pieces must have no arcs entering them.
+void JoinCompactLattices(const std::vector<const CompactLattice*> &pieces,
+                         CompactLattice *clat);
+
+}  // end namespace kaldi
+
+#endif  // KALDI_DECODER_LATTICE_INCREMENTAL_DETERMINIZER_H_
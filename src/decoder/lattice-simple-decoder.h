@@ -24,6 +24,7 @@
 
 
 #include "util/stl-utils.h"
+#include "util/memory-pool.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -199,17 +200,35 @@ class LatticeSimpleDecoder {
           Token *next): tot_cost(tot_cost), extra_cost(extra_cost), links(links),
                         next(next) { }
     Token() {}
-    void DeleteForwardLinks() {
+    void DeleteForwardLinks(MemoryPool<ForwardLink> *link_pool) {
       ForwardLink *l = links, *m; 
       while (l != NULL) {
         m = l->next;
-        delete l;
+        link_pool->Free(l);
         l = m;
       }
       links = NULL;
     }
   };
   
+  // Tokens and ForwardLinks are allocated from token_pool_ and link_pool_
+  // rather than with new and delete, to avoid the overhead of the system
+  // allocator (and contention on it, in multi-threaded programs).
+  inline Token *NewToken(BaseFloat tot_cost, BaseFloat extra_cost,
+                         ForwardLink *links, Token *next) {
+    return new (token_pool_.Allocate()) Token(tot_cost, extra_cost,
+                                              links, next);
+  }
+  inline void DeleteToken(Token *tok) { token_pool_.Free(tok); }
+  inline ForwardLink *NewForwardLink(Token *next_tok, Label ilabel,
+                                     Label olabel, BaseFloat graph_cost,
+                                     BaseFloat acoustic_cost,
+                                     ForwardLink *next) {
+    return new (link_pool_.Allocate()) ForwardLink(
+        next_tok, ilabel, olabel, graph_cost, acoustic_cost, next);
+  }
+  inline void DeleteForwardLink(ForwardLink *link) { link_pool_.Free(link); }
+
   // head and tail of per-frame list of Tokens (list is in topological order),
   // and something saying whether we ever pruned it using PruneForwardLinks.
   struct TokenList {
@@ -293,6 +312,8 @@ class LatticeSimpleDecoder {
   const fst::Fst<fst::StdArc> &fst_;
   LatticeSimpleDecoderConfig config_;
   int32 num_toks_; // current total #toks allocated...
+  MemoryPool<Token> token_pool_;
+  MemoryPool<ForwardLink> link_pool_;
   bool warned_;
 
 
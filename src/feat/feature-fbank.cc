@@ -122,62 +122,77 @@ void Fbank::ComputeInternal(const VectorBase<BaseFloat> &wave,
   if (wave_remainder != NULL)
     ExtractWaveformRemainder(wave, opts_.frame_opts, wave_remainder);
 
-  // Buffers
-  Vector<BaseFloat> window;  // windowed waveform.
-  Vector<BaseFloat> mel_energies;
-  std::vector<BaseFloat> temp_buffer;  // used by srfft.  
-  BaseFloat log_energy;
-
-  // Compute all the freames, r is frame index..
-  for (int32 r = 0; r < rows_out; r++) {
-    // Cut the window, apply window function
-    ExtractWindow(wave, r, opts_.frame_opts, feature_window_function_, &window,
-                  (opts_.use_energy && opts_.raw_energy ? &log_energy : NULL));
-
-    // Compute energy after window function (not the raw one)
-    if (opts_.use_energy && !opts_.raw_energy)
-      log_energy = Log(std::max(VecVec(window, window),
-                                std::numeric_limits<BaseFloat>::min()));
-
-    if (srfft_ != NULL)  // Compute FFT using split-radix algorithm.
-      srfft_->Compute(window.Data(), true, &temp_buffer);
-    else  // An alternative algorithm that works for non-powers-of-two.
-      RealFft(&window, true);
-
-    // Convert the FFT into a power spectrum.
-    ComputePowerSpectrum(&window);
-    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
-
-    // Sum with MelFiterbank over power spectrum
-    mel_banks.Compute(power_spectrum, &mel_energies);
-    if (opts_.use_log_fbank) {
-      // avoid log of zero (which should be prevented anyway by dithering).
-      mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
-      mel_energies.ApplyLog();  // take the log.
+  // We process the frames in blocks, so that the windowing, the FFTs and the
+  // mel banks each run over a whole block, without any per-frame
+  // allocation; the blocks are limited in size so that for long files we
+  // don't need a lot of memory for the windowed frames.  Each frame goes
+  // through exactly the same operations as if it were processed on its own.
+  int32 block_size = std::min<int32>(rows_out, 256),
+      padded_window_size = opts_.frame_opts.PaddedWindowSize(),
+      num_bins = opts_.mel_opts.num_bins;
+  Matrix<BaseFloat> windows(block_size, padded_window_size, kUndefined);
+  Vector<BaseFloat> log_energy(block_size);
+  std::vector<BaseFloat> temp_buffer;  // used by srfft.
+
+  for (int32 start = 0; start < rows_out; start += block_size) {
+    int32 num_frames = std::min(block_size, rows_out - start);
+    SubMatrix<BaseFloat> this_windows(windows, 0, num_frames,
+                                      0, padded_window_size);
+    SubVector<BaseFloat> this_log_energy(log_energy, 0, num_frames);
+    // Cut the windows, apply window function
+    ExtractWindows(wave, start, opts_.frame_opts, feature_window_function_,
+                   &this_windows,
+                   (opts_.use_energy && opts_.raw_energy ? &this_log_energy :
+                    NULL));
+
+    for (int32 r = 0; r < num_frames; r++) {
+      SubVector<BaseFloat> window(this_windows, r);
+      // Compute energy after window function (not the raw one)
+      if (opts_.use_energy && !opts_.raw_energy)
+        this_log_energy(r) = Log(std::max(VecVec(window, window),
+                                 std::numeric_limits<BaseFloat>::min()));
+
+      if (srfft_ != NULL)  // Compute FFT using split-radix algorithm.
+        srfft_->Compute(window.Data(), true, &temp_buffer);
+      else  // An alternative algorithm that works for non-powers-of-two.
+        RealFft(&window, true);
+
+      // Convert the FFT into a power spectrum, in the first
+      // padded_window_size / 2 + 1 elements of the row.
+      ComputePowerSpectrum(&window);
     }
+    SubMatrix<BaseFloat> power_spectra(this_windows, 0, num_frames,
+                                       0, padded_window_size / 2 + 1);
 
     // Output buffers
-    SubVector<BaseFloat> this_output(output->Row(r));
-    SubVector<BaseFloat> this_fbank(this_output.Range((opts_.use_energy? 1 : 0),
-                                                      opts_.mel_opts.num_bins));
+    SubMatrix<BaseFloat> this_output(*output, start, num_frames, 0, cols_out),
+        this_fbank(this_output, 0, num_frames,
+                   (opts_.use_energy ? 1 : 0), num_bins);
 
-    // Copy to output
-    this_fbank.CopyFromVec(mel_energies);
-    // Copy energy as first value
-    if (opts_.use_energy) {
-      if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_) {
-        log_energy = log_energy_floor_;
-      }
-      this_output(0) = log_energy;
+    // Sum with MelFiterbank over power spectrum, directly into the output.
+    mel_banks.Compute(power_spectra, &this_fbank);
+    if (opts_.use_log_fbank) {
+      // avoid log of zero (which should be prevented anyway by dithering).
+      this_fbank.ApplyFloor(std::numeric_limits<BaseFloat>::min());
+      this_fbank.ApplyLog();  // take the log.
     }
 
-    // HTK compat: Shift features, so energy is last value
-    if (opts_.htk_compat && opts_.use_energy) {
-      BaseFloat energy = this_output(0);
-      for (int32 i = 0; i < opts_.mel_opts.num_bins; i++) {
-        this_output(i) = this_output(i+1);
+    if (opts_.use_energy) {
+      for (int32 r = 0; r < num_frames; r++) {
+        SubVector<BaseFloat> this_output_row(this_output, r);
+        // Copy energy as first value
+        BaseFloat energy = this_log_energy(r);
+        if (opts_.energy_floor > 0.0 && energy < log_energy_floor_)
+          energy = log_energy_floor_;
+        this_output_row(0) = energy;
+
+        // HTK compat: Shift features, so energy is last value
+        if (opts_.htk_compat) {
+          for (int32 i = 0; i < num_bins; i++)
+            this_output_row(i) = this_output_row(i+1);
+          this_output_row(num_bins) = energy;
+        }
       }
-      this_output(opts_.mel_opts.num_bins) = energy;
     }
   }
 }
@@ -84,26 +84,28 @@ FeatureWindowFunction::FeatureWindowFunction(const FrameExtractionOptions &opts)
   }
 }
 
-// ExtractWindow extracts a windowed frame of waveform with a power-of-two,
-// padded size.  It does mean subtraction, pre-emphasis and dithering as
-// requested.
-
-void ExtractWindow(const VectorBase<BaseFloat> &wave,
-                   int32 f,  // with 0 <= f < NumFrames(feats, opts)
-                   const FrameExtractionOptions &opts,
-                   const FeatureWindowFunction &window_function,
-                   Vector<BaseFloat> *window,
-                   BaseFloat *log_energy_pre_window) {
+// This does the work of ExtractWindow(); "window" must already have dimension
+// opts.PaddedWindowSize().  It does mean subtraction, pre-emphasis and
+// dithering as requested.
+static void ExtractWindowInternal(const VectorBase<BaseFloat> &wave,
+                                  int32 f,
+                                  const FrameExtractionOptions &opts,
+                                  const FeatureWindowFunction &window_function,
+                                  VectorBase<BaseFloat> *window,
+                                  BaseFloat *log_energy_pre_window) {
   int32 frame_shift = opts.WindowShift();
   int32 frame_length = opts.WindowSize();
   KALDI_ASSERT(window_function.window.Dim() == frame_length);
   KALDI_ASSERT(frame_shift != 0 && frame_length != 0);
+  int32 frame_length_padded = opts.PaddedWindowSize();
+  KALDI_ASSERT(window->Dim() == frame_length_padded);
 
-  Vector<BaseFloat> wave_part(frame_length);
+  // We copy the waveform directly to the start of "window".
+  SubVector<BaseFloat> window_part(*window, 0, frame_length);
   if (opts.snip_edges) {
     int32 start = frame_shift*f, end = start + frame_length;
     KALDI_ASSERT(start >= 0 && end <= wave.Dim());
-    wave_part.CopyFromVec(wave.Range(start, frame_length));
+    window_part.CopyFromVec(wave.Range(start, frame_length));
   } else {
     // If opts.snip_edges = false, we allow the frames to go slightly over the
     // edges of the file; we'll extend the data by reflection.
@@ -115,7 +117,7 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
         length_limited = end_limited - begin_limited;
 
     // Copy the main part.  Usually this will be the entire window.
-    wave_part.Range(begin_limited - begin, length_limited).
+    window_part.Range(begin_limited - begin, length_limited).
         CopyFromVec(wave.Range(begin_limited, length_limited));
     
     // Deal with any end effects by reflection, if needed.  This code will
@@ -125,7 +127,7 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
       // The next statement will only have an effect in the case of files
       // shorter than a single frame, it's to avoid a crash in those cases.
       reflected_f = reflected_f % wave.Dim(); 
-      wave_part(f - begin) = wave(reflected_f);
+      window_part(f - begin) = wave(reflected_f);
     }
     for (int32 f = wave.Dim(); f < end; f++) {
       int32 distance_to_end = f - wave.Dim();
@@ -133,17 +135,9 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
       // shorter than a single frame, it's to avoid a crash in those cases.
       distance_to_end = distance_to_end % wave.Dim();
       int32 reflected_f = wave.Dim() - 1 - distance_to_end;
-      wave_part(f - begin) = wave(reflected_f);
+      window_part(f - begin) = wave(reflected_f);
     }
   }
-  KALDI_ASSERT(window != NULL);
-  int32 frame_length_padded = opts.PaddedWindowSize();
-
-  if (window->Dim() != frame_length_padded)
-    window->Resize(frame_length_padded);
-
-  SubVector<BaseFloat> window_part(*window, 0, frame_length);
-  window_part.CopyFromVec(wave_part);
 
   if (opts.dither != 0.0) Dither(&window_part, opts.dither);
 
@@ -166,6 +160,38 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
                          frame_length_padded-frame_length).SetZero();
 }
 
+void ExtractWindow(const VectorBase<BaseFloat> &wave,
+                   int32 f,  // with 0 <= f < NumFrames(feats, opts)
+                   const FrameExtractionOptions &opts,
+                   const FeatureWindowFunction &window_function,
+                   Vector<BaseFloat> *window,
+                   BaseFloat *log_energy_pre_window) {
+  KALDI_ASSERT(window != NULL);
+  int32 frame_length_padded = opts.PaddedWindowSize();
+  if (window->Dim() != frame_length_padded)
+    window->Resize(frame_length_padded, kUndefined);
+  ExtractWindowInternal(wave, f, opts, window_function, window,
+                        log_energy_pre_window);
+}
+
+void ExtractWindows(const VectorBase<BaseFloat> &wave,
+                    int32 first_frame,
+                    const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    MatrixBase<BaseFloat> *windows,
+                    VectorBase<BaseFloat> *log_energy_pre_window) {
+  int32 num_frames = windows->NumRows();
+  KALDI_ASSERT(windows->NumCols() == opts.PaddedWindowSize());
+  KALDI_ASSERT(log_energy_pre_window == NULL ||
+               log_energy_pre_window->Dim() == num_frames);
+  for (int32 r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> window(*windows, r);
+    ExtractWindowInternal(wave, first_frame + r, opts, window_function,
+                          &window, (log_energy_pre_window != NULL ?
+                                    &((*log_energy_pre_window)(r)) : NULL));
+  }
+}
+
 void ExtractWaveformRemainder(const VectorBase<BaseFloat> &wave,
                               const FrameExtractionOptions &opts,
                               Vector<BaseFloat> *wave_remainder) {
@@ -153,6 +153,18 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
                    Vector<BaseFloat> *window,
                    BaseFloat *log_energy_pre_window = NULL);
 
+// ExtractWindows is as ExtractWindow, but extracts the frames first_frame,
+// first_frame + 1, ... into the rows of "windows", which must have
+// opts.PaddedWindowSize() columns.  This is for computing features for many
+// frames at once.  If log_energy_pre_window != NULL, it must have the same
+// dimension as the number of rows of "windows".
+void ExtractWindows(const VectorBase<BaseFloat> &wave,
+                    int32 first_frame,
+                    const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    MatrixBase<BaseFloat> *windows,
+                    VectorBase<BaseFloat> *log_energy_pre_window = NULL);
+
 // ExtractWaveformRemainder is useful if the waveform is coming in segments.
 // It extracts the bit of the waveform at the end of this block that you
 // would have to append the next bit of waveform to, if you wanted to have
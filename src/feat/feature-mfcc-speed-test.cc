@@ -0,0 +1,68 @@
+// feat/feature-mfcc-speed-test.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <iostream>
+
+#include "feat/feature-mfcc.h"
+#include "feat/feature-test-utils.h"
+#include "base/timer.h"
+
+using namespace kaldi;
+
+
+// Prints the speed of Mfcc::Compute(), and of computing the MFCCs frame by
+// frame as it used to, in frames per second (on one core).
+static void MfccSpeedTest() {
+  MfccOptions opts;
+  opts.frame_opts.dither = 0.0;
+  Vector<BaseFloat> wave(16000 * 60);  // one minute at 16kHz.
+  wave.SetRandn();
+  wave.Scale(1000.0);
+  Mfcc mfcc(opts);
+  Matrix<BaseFloat> output;
+  int32 num_iters = 3;
+
+  Timer timer;
+  for (int32 i = 0; i < num_iters; i++)
+    ComputeMfccFrameByFrame(opts, wave, &output);
+  double frame_by_frame_time = timer.Elapsed();
+
+  timer.Reset();
+  for (int32 i = 0; i < num_iters; i++)
+    mfcc.Compute(wave, 1.0, &output, NULL);
+  double block_time = timer.Elapsed();
+
+  int32 num_frames = num_iters * output.NumRows();
+  KALDI_LOG << "MFCC computation speed: frame by frame, "
+            << (num_frames / frame_by_frame_time) << " frames/sec; "
+            << "Mfcc::Compute(), " << (num_frames / block_time)
+            << " frames/sec.";
+}
+
+int main() {
+  try {
+    MfccSpeedTest();
+    std::cout << "Tests succeeded.\n";
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << e.what();
+    return 1;
+  }
+}
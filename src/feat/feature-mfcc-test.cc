@@ -24,6 +24,8 @@
 #include "base/kaldi-math.h"
 #include "matrix/kaldi-matrix-inl.h"
 #include "feat/wave-reader.h"
+#include "feat/mel-computations.h"
+#include "feat/feature-test-utils.h"
 
 using namespace kaldi;
 
@@ -653,6 +655,34 @@ void UnitTestVtln() {
   }
 }
 
+// Checks that Mfcc::Compute(), which processes the frames in blocks, gives
+// exactly the same output as processing them one by one.
+static void UnitTestCompareFrameByFrame() {
+  std::cout << "=== UnitTestCompareFrameByFrame() ===\n";
+  for (int32 i = 0; i < 10; i++) {
+    MfccOptions opts;
+    opts.frame_opts.dither = 0.0;
+    opts.frame_opts.round_to_power_of_two = (Rand() % 2 == 0);
+    opts.frame_opts.snip_edges = (Rand() % 2 == 0);
+    opts.use_energy = (Rand() % 2 == 0);
+    opts.raw_energy = (Rand() % 2 == 0);
+    opts.htk_compat = (Rand() % 2 == 0);
+    opts.energy_floor = (Rand() % 2 == 0 ? 0.0 : 1.0);
+    opts.cepstral_lifter = (Rand() % 2 == 0 ? 0.0 : 22.0);
+    // Enough frames to need more than one block.
+    Vector<BaseFloat> wave(400 + Rand() % 100000);
+    wave.SetRandn();
+    wave.Scale(1000.0);
+
+    Mfcc mfcc(opts);
+    Matrix<BaseFloat> output, ref_output;
+    mfcc.Compute(wave, 1.0, &output, NULL);
+    ComputeMfccFrameByFrame(opts, wave, &ref_output);
+    AssertBitIdentical(output, ref_output);
+  }
+  std::cout << "Test passed :)\n\n";
+}
+
 static void UnitTestFeat() {
   UnitTestVtln();
   UnitTestReadWave();
@@ -666,6 +696,7 @@ static void UnitTestFeat() {
   UnitTestHTKCompare4();
   UnitTestHTKCompare5();
   UnitTestHTKCompare6();
+  UnitTestCompareFrameByFrame();
   std::cout << "Tests succeeded.\n";
 }
 
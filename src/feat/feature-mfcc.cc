@@ -129,56 +129,84 @@ void Mfcc::ComputeInternal(const VectorBase<BaseFloat> &wave,
   output->Resize(rows_out, cols_out);
   if (wave_remainder != NULL)
     ExtractWaveformRemainder(wave, opts_.frame_opts, wave_remainder);
-  Vector<BaseFloat> window;  // windowed waveform.
-  Vector<BaseFloat> mel_energies;
-  std::vector<BaseFloat> temp_buffer;  // used by srfft.
-  for (int32 r = 0; r < rows_out; r++) {  // r is frame index..
-    BaseFloat log_energy;
-    ExtractWindow(wave, r, opts_.frame_opts, feature_window_function_, &window,
-                  (opts_.use_energy && opts_.raw_energy ? &log_energy : NULL));
-
-    if (opts_.use_energy && !opts_.raw_energy)
-      log_energy = Log(std::max(VecVec(window, window),
-                                std::numeric_limits<BaseFloat>::min()));
-
-    if (srfft_ != NULL)  // Compute FFT using the split-radix algorithm.
-      srfft_->Compute(window.Data(), true, &temp_buffer);
-    else  // An alternative algorithm that works for non-powers-of-two.
-      RealFft(&window, true);
 
-    // Convert the FFT into a power spectrum.
-    ComputePowerSpectrum(&window);
-    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
-
-    mel_banks.Compute(power_spectrum, &mel_energies);
-
-    // avoid log of zero (which should be prevented anyway by dithering).
-    mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
-    mel_energies.ApplyLog();  // take the log.
-
-    SubVector<BaseFloat> this_mfcc(output->Row(r));
-
-    // this_mfcc = dct_matrix_ * mel_energies [which now have log]
-    this_mfcc.AddMatVec(1.0, dct_matrix_, kNoTrans, mel_energies, 0.0);
-
-    if (opts_.cepstral_lifter != 0.0)
-      this_mfcc.MulElements(lifter_coeffs_);
+  // We process the frames in blocks, so that the windowing, the FFTs and the
+  // mel banks each run over a whole block, without any per-frame
+  // allocation; the blocks are limited in size so that for long files we
+  // don't need a lot of memory for the windowed frames.  Each frame goes
+  // through exactly the same operations, in the same order, as if it were
+  // processed on its own, so the output does not depend on the blocking.
+  int32 block_size = std::min<int32>(rows_out, 256),
+      padded_window_size = opts_.frame_opts.PaddedWindowSize(),
+      num_bins = opts_.mel_opts.num_bins;
+  Matrix<BaseFloat> windows(block_size, padded_window_size, kUndefined),
+      mel_energies(block_size, num_bins, kUndefined);
+  Vector<BaseFloat> log_energy(block_size);
+  std::vector<BaseFloat> temp_buffer;  // used by srfft.
 
-    if (opts_.use_energy) {
-      if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_)
-        log_energy = log_energy_floor_;
-      this_mfcc(0) = log_energy;
+  for (int32 start = 0; start < rows_out; start += block_size) {
+    int32 num_frames = std::min(block_size, rows_out - start);
+    SubMatrix<BaseFloat> this_windows(windows, 0, num_frames,
+                                      0, padded_window_size),
+        this_mel_energies(mel_energies, 0, num_frames, 0, num_bins);
+    SubVector<BaseFloat> this_log_energy(log_energy, 0, num_frames);
+    ExtractWindows(wave, start, opts_.frame_opts, feature_window_function_,
+                   &this_windows,
+                   (opts_.use_energy && opts_.raw_energy ? &this_log_energy :
+                    NULL));
+
+    for (int32 r = 0; r < num_frames; r++) {
+      SubVector<BaseFloat> window(this_windows, r);
+      if (opts_.use_energy && !opts_.raw_energy)
+        this_log_energy(r) = Log(std::max(VecVec(window, window),
+                                 std::numeric_limits<BaseFloat>::min()));
+
+      if (srfft_ != NULL)  // Compute FFT using the split-radix algorithm.
+        srfft_->Compute(window.Data(), true, &temp_buffer);
+      else  // An alternative algorithm that works for non-powers-of-two.
+        RealFft(&window, true);
+
+      // Convert the FFT into a power spectrum, in the first
+      // padded_window_size / 2 + 1 elements of the row.
+      ComputePowerSpectrum(&window);
     }
+    SubMatrix<BaseFloat> power_spectra(this_windows, 0, num_frames,
+                                       0, padded_window_size / 2 + 1);
+    mel_banks.Compute(power_spectra, &this_mel_energies);
 
-    if (opts_.htk_compat) {
-      BaseFloat energy = this_mfcc(0);
-      for (int32 i = 0; i < opts_.num_ceps-1; i++)
-        this_mfcc(i) = this_mfcc(i+1);
-      if (!opts_.use_energy)
-        energy *= M_SQRT2;  // scale on C0 (actually removing scale
-      // we previously added that's part of one common definition of
-      // cosine transform.)
-      this_mfcc(opts_.num_ceps-1)  = energy;
+    // avoid log of zero (which should be prevented anyway by dithering).
+    this_mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
+    this_mel_energies.ApplyLog();  // take the log.
+
+    SubMatrix<BaseFloat> this_output(*output, start, num_frames, 0, cols_out);
+    for (int32 r = 0; r < num_frames; r++) {
+      SubVector<BaseFloat> this_mfcc(this_output, r);
+      // this_mfcc = dct_matrix_ * mel_energies [which now have log].  We do
+      // this one frame at a time, as a matrix multiplication would sum the
+      // terms in a different order.
+      this_mfcc.AddMatVec(1.0, dct_matrix_, kNoTrans,
+                          this_mel_energies.Row(r), 0.0);
+
+      if (opts_.cepstral_lifter != 0.0)
+        this_mfcc.MulElements(lifter_coeffs_);
+
+      if (opts_.use_energy) {
+        BaseFloat log_energy = this_log_energy(r);
+        if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_)
+          log_energy = log_energy_floor_;
+        this_mfcc(0) = log_energy;
+      }
+
+      if (opts_.htk_compat) {
+        BaseFloat energy = this_mfcc(0);
+        for (int32 i = 0; i < opts_.num_ceps-1; i++)
+          this_mfcc(i) = this_mfcc(i+1);
+        if (!opts_.use_energy)
+          energy *= M_SQRT2;  // scale on C0 (actually removing scale
+        // we previously added that's part of one common definition of
+        // cosine transform.)
+        this_mfcc(opts_.num_ceps-1)  = energy;
+      }
     }
   }
 }
@@ -0,0 +1,161 @@
+// feat/feature-test-utils.h
+
+// Copyright 2009-2011  Karel Vesely;  Petr Motlicek
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FEAT_FEATURE_TEST_UTILS_H_
+#define KALDI_FEAT_FEATURE_TEST_UTILS_H_
+
+// This header contains functions shared by the tests and speed tests of the
+// feature extraction code; it is not part of the library.
+
+#include <limits>
+#include <vector>
+#include "feat/feature-fbank.h"
+#include "feat/feature-mfcc.h"
+#include "feat/mel-computations.h"
+
+namespace kaldi {
+
+// Computes MFCCs the way Mfcc::Compute() used to, one frame at a time, to
+// compare the block-based version with.
+inline void ComputeMfccFrameByFrame(const MfccOptions &opts,
+                                    const VectorBase<BaseFloat> &wave,
+                                    Matrix<BaseFloat> *output) {
+  FeatureWindowFunction window_function(opts.frame_opts);
+  MelBanks mel_banks(opts.mel_opts, opts.frame_opts, 1.0);
+  int32 num_bins = opts.mel_opts.num_bins;
+  Matrix<BaseFloat> dct_matrix(num_bins, num_bins);
+  ComputeDctMatrix(&dct_matrix);
+  SubMatrix<BaseFloat> dct_rows(dct_matrix, 0, opts.num_ceps, 0, num_bins);
+  Vector<BaseFloat> lifter_coeffs(opts.num_ceps);
+  if (opts.cepstral_lifter != 0.0)
+    ComputeLifterCoeffs(opts.cepstral_lifter, &lifter_coeffs);
+
+  int32 padded_window_size = opts.frame_opts.PaddedWindowSize();
+  SplitRadixRealFft<BaseFloat> *srfft = NULL;
+  if ((padded_window_size & (padded_window_size-1)) == 0)
+    srfft = new SplitRadixRealFft<BaseFloat>(padded_window_size);
+  std::vector<BaseFloat> temp_buffer;
+
+  int32 num_frames = NumFrames(wave.Dim(), opts.frame_opts);
+  output->Resize(num_frames, opts.num_ceps);
+  Vector<BaseFloat> window, mel_energies;
+  for (int32 r = 0; r < num_frames; r++) {
+    BaseFloat log_energy;
+    ExtractWindow(wave, r, opts.frame_opts, window_function, &window,
+                  (opts.use_energy && opts.raw_energy ? &log_energy : NULL));
+    if (opts.use_energy && !opts.raw_energy)
+      log_energy = Log(std::max(VecVec(window, window),
+                                std::numeric_limits<BaseFloat>::min()));
+    if (srfft != NULL)
+      srfft->Compute(window.Data(), true, &temp_buffer);
+    else
+      RealFft(&window, true);
+    ComputePowerSpectrum(&window);
+    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
+    mel_banks.Compute(power_spectrum, &mel_energies);
+    mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
+    mel_energies.ApplyLog();
+    SubVector<BaseFloat> this_mfcc(output->Row(r));
+    this_mfcc.AddMatVec(1.0, dct_rows, kNoTrans, mel_energies, 0.0);
+    if (opts.cepstral_lifter != 0.0)
+      this_mfcc.MulElements(lifter_coeffs);
+    if (opts.use_energy) {
+      if (opts.energy_floor > 0.0 && log_energy < Log(opts.energy_floor))
+        log_energy = Log(opts.energy_floor);
+      this_mfcc(0) = log_energy;
+    }
+    if (opts.htk_compat) {
+      BaseFloat energy = this_mfcc(0);
+      for (int32 i = 0; i < opts.num_ceps-1; i++)
+        this_mfcc(i) = this_mfcc(i+1);
+      if (!opts.use_energy)
+        energy *= M_SQRT2;
+      this_mfcc(opts.num_ceps-1)  = energy;
+    }
+  }
+  delete srfft;
+}
+
+// Computes filterbank features the way Fbank::Compute() used to, one frame
+// at a time, to compare the block-based version with.
+inline void ComputeFbankFrameByFrame(const FbankOptions &opts,
+                                     const VectorBase<BaseFloat> &wave,
+                                     Matrix<BaseFloat> *output) {
+  FeatureWindowFunction window_function(opts.frame_opts);
+  MelBanks mel_banks(opts.mel_opts, opts.frame_opts, 1.0);
+  int32 num_bins = opts.mel_opts.num_bins;
+
+  int32 padded_window_size = opts.frame_opts.PaddedWindowSize();
+  SplitRadixRealFft<BaseFloat> *srfft = NULL;
+  if ((padded_window_size & (padded_window_size-1)) == 0)
+    srfft = new SplitRadixRealFft<BaseFloat>(padded_window_size);
+  std::vector<BaseFloat> temp_buffer;
+
+  int32 num_frames = NumFrames(wave.Dim(), opts.frame_opts);
+  output->Resize(num_frames, num_bins + (opts.use_energy ? 1 : 0));
+  Vector<BaseFloat> window, mel_energies;
+  for (int32 r = 0; r < num_frames; r++) {
+    BaseFloat log_energy;
+    ExtractWindow(wave, r, opts.frame_opts, window_function, &window,
+                  (opts.use_energy && opts.raw_energy ? &log_energy : NULL));
+    if (opts.use_energy && !opts.raw_energy)
+      log_energy = Log(std::max(VecVec(window, window),
+                                std::numeric_limits<BaseFloat>::min()));
+    if (srfft != NULL)
+      srfft->Compute(window.Data(), true, &temp_buffer);
+    else
+      RealFft(&window, true);
+    ComputePowerSpectrum(&window);
+    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
+    mel_banks.Compute(power_spectrum, &mel_energies);
+    if (opts.use_log_fbank) {
+      mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
+      mel_energies.ApplyLog();
+    }
+    SubVector<BaseFloat> this_output(output->Row(r));
+    this_output.Range((opts.use_energy ? 1 : 0),
+                      num_bins).CopyFromVec(mel_energies);
+    if (opts.use_energy) {
+      if (opts.energy_floor > 0.0 && log_energy < Log(opts.energy_floor))
+        log_energy = Log(opts.energy_floor);
+      this_output(0) = log_energy;
+    }
+    if (opts.htk_compat && opts.use_energy) {
+      BaseFloat energy = this_output(0);
+      for (int32 i = 0; i < num_bins; i++)
+        this_output(i) = this_output(i+1);
+      this_output(num_bins) = energy;
+    }
+  }
+  delete srfft;
+}
+
+// Checks that "a" and "b" have the same dimensions and exactly the same
+// elements.
+inline void AssertBitIdentical(const MatrixBase<BaseFloat> &a,
+                               const MatrixBase<BaseFloat> &b) {
+  KALDI_ASSERT(a.NumRows() == b.NumRows() && a.NumCols() == b.NumCols());
+  for (int32 r = 0; r < a.NumRows(); r++)
+    for (int32 c = 0; c < a.NumCols(); c++)
+      KALDI_ASSERT(a(r, c) == b(r, c));
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_FEAT_FEATURE_TEST_UTILS_H_
@@ -222,6 +222,24 @@ void MelBanks::Compute(const VectorBase<BaseFloat> &power_spectrum,
   int32 num_bins = bins_.size();
   if (mel_energies_out->Dim() != num_bins)
     mel_energies_out->Resize(num_bins);
+  ComputeInternal(power_spectrum, mel_energies_out);
+}
+
+void MelBanks::Compute(const MatrixBase<BaseFloat> &power_spectra,
+                       MatrixBase<BaseFloat> *mel_energies_out) const {
+  int32 num_frames = power_spectra.NumRows();
+  KALDI_ASSERT(mel_energies_out->NumRows() == num_frames &&
+               mel_energies_out->NumCols() == NumBins());
+  for (int32 r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> mel_energies(*mel_energies_out, r);
+    ComputeInternal(power_spectra.Row(r), &mel_energies);
+  }
+}
+
+void MelBanks::ComputeInternal(const VectorBase<BaseFloat> &power_spectrum,
+                               VectorBase<BaseFloat> *mel_energies_out) const {
+  int32 num_bins = bins_.size();
+  KALDI_ASSERT(mel_energies_out->Dim() == num_bins);
 
   for (int32 i = 0; i < num_bins; i++) {
     int32 offset = bins_[i].first;
@@ -76,6 +76,14 @@ class MelBanks {
   void Compute(const VectorBase<BaseFloat> &fft_energies,
                Vector<BaseFloat> *mel_energies_out) const;
 
+  /// This version computes the Mel energies for many frames at once.  Each
+  /// row of "power_spectra" is the power spectrum of a frame, as given to the
+  /// version above (it may have extra columns at the end, which are ignored);
+  /// "mel_energies_out" must have the same number of rows, and NumBins()
+  /// columns.  The output is exactly the same as from the version above.
+  void Compute(const MatrixBase<BaseFloat> &power_spectra,
+               MatrixBase<BaseFloat> *mel_energies_out) const;
+
   int32 NumBins() const { return bins_.size(); }
 
   // returns vector of central freq of each bin; needed by plp code.
@@ -90,6 +98,11 @@ class MelBanks {
   // (the first nonzero fft-bin), (the vector of weights).
   std::vector<std::pair<int32, Vector<BaseFloat> > > bins_;
 
+  // Does the work of both versions of Compute(); "mel_energies_out" must have
+  // dimension NumBins().
+  void ComputeInternal(const VectorBase<BaseFloat> &power_spectrum,
+                       VectorBase<BaseFloat> *mel_energies_out) const;
+
   bool debug_;
   bool htk_mode_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(MelBanks);
@@ -0,0 +1,94 @@
+// feat/pitch-functions-speed-test.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <iostream>
+
+#include "base/kaldi-math.h"
+#include "feat/pitch-functions.h"
+#include "sys/resource.h"
+#include "base/timer.h"
+
+
+namespace kaldi {
+
+// Returns the peak resident memory of this process in megabytes.
+static double PeakMemoryMb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;  // ru_maxrss is in kilobytes.
+}
+
+// Streams a long recording through OnlinePitchFeature in chunks of 0.1
+// seconds, reading the frames as they become ready, and reports the speed
+// and the peak memory part of the way through and at the end; with
+// max_frames_lookback set, the memory should not grow after the start.
+static void LongInputSpeedTest() {
+  PitchExtractionOptions op;
+  op.max_frames_lookback = 500;
+  op.max_frames_latency = 100;
+  BaseFloat duration = 600.0;  // ten minutes.
+  int32 chunk_size = op.samp_freq / 10,
+      num_chunks = duration * op.samp_freq / chunk_size;
+  OnlinePitchFeature pitch_extractor(op);
+  Vector<BaseFloat> chunk(chunk_size), frame(2);
+  double cur_freq = 200.0, normalized_time = 0.0, generate_time = 0.0,
+      memory_at_start = 0.0;
+  int32 num_frames_out = 0;
+  Timer timer;
+  for (int32 c = 0; c < num_chunks; c++) {
+    Timer generate_timer;
+    for (int32 i = 0; i < chunk_size; i++) {
+      chunk(i) = RandGauss() + cos(normalized_time * M_2PI);
+      cur_freq += RandGauss();
+      if (cur_freq < 100.0) cur_freq = 100.0;
+      if (cur_freq > 300.0) cur_freq = 300.0;
+      normalized_time += cur_freq / op.samp_freq;
+    }
+    generate_time += generate_timer.Elapsed();
+    pitch_extractor.AcceptWaveform(op.samp_freq, chunk);
+    if (c == num_chunks - 1)
+      pitch_extractor.InputFinished();
+    for (; num_frames_out < pitch_extractor.NumFramesReady(); num_frames_out++)
+      pitch_extractor.GetFrame(num_frames_out, &frame);
+    if (c == num_chunks / 10)
+      memory_at_start = PeakMemoryMb();
+  }
+  double elapsed = timer.Elapsed() - generate_time;
+  KALDI_ASSERT(num_frames_out > duration * 99);
+  KALDI_LOG << "Computed pitch for " << duration << " seconds of audio ("
+            << num_frames_out << " frames) in " << elapsed << " seconds, "
+            << "real-time factor " << (elapsed / duration) << "; peak memory "
+            << "was " << memory_at_start << " MB after " << (duration / 10)
+            << " seconds, " << PeakMemoryMb() << " MB at the end.";
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  try {
+    LongInputSpeedTest();
+    KALDI_LOG << "Tests succeeded.";
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return 1;
+  }
+}
@@ -241,6 +241,95 @@ static void UnitTestSearch() {
   KALDI_LOG << "Test passed :)\n";
 }
 
+// Outputs to "v" "size" samples of noise plus a sine wave whose frequency
+// wanders randomly between 100 and 300 Hz.
+static void MakeWanderingSineWave(int32 size, BaseFloat samp_freq,
+                                  Vector<BaseFloat> *v) {
+  v->Resize(size);
+  double cur_freq = 200.0, normalized_time = 0.0;
+  for (int32 i = 0; i < size; i++) {
+    (*v)(i) = RandGauss() + cos(normalized_time * M_2PI);
+    cur_freq += RandGauss();  // let the frequency wander a little.
+    if (cur_freq < 100.0) cur_freq = 100.0;
+    if (cur_freq > 300.0) cur_freq = 300.0;
+    normalized_time += cur_freq / samp_freq;
+  }
+}
+
+// Make sure that the different ways of computing the correlations for the
+// NCCF give the same results, up to roundoff.
+static void UnitTestCorrelation() {
+  KALDI_LOG << "=== UnitTestCorrelation() ===\n";
+  for (int32 n = 0; n < 6; n++) {
+    PitchExtractionOptions op;
+    if (n % 2 == 1)  // a larger window, relative to the lags.
+      op.resample_freq = 8000.0;
+    op.nccf_ballast_online = (n % 3 == 0);
+
+    int32 size = 10000 + rand() % 10000;
+    Vector<BaseFloat> v;
+    MakeWanderingSineWave(size, op.samp_freq, &v);
+    if (n == 2)  // some silence, to check we handle zero windows.
+      v.Range(size / 4, size / 4).SetZero();
+
+    Matrix<BaseFloat> m[3];
+    for (int32 method = 0; method < 3; method++) {
+      op.correlation_method = method;
+      ComputeKaldiPitch(op, v, &m[method]);
+    }
+    AssertEqual(m[0], m[1], 1.0e-03);
+    AssertEqual(m[0], m[2], 1.0e-03);
+  }
+  KALDI_LOG << "Test passed :)\n";
+}
+
+// Make sure that limiting the history kept for the traceback (with
+// max_frames_lookback) doesn't change the output when the lookback is
+// reasonably large.
+static void UnitTestLookback() {
+  KALDI_LOG << "=== UnitTestLookback() ===\n";
+  for (int32 n = 0; n < 5; n++) {
+    PitchExtractionOptions op1;
+    op1.recompute_frame = 100 + rand() % 400;
+    op1.nccf_ballast_online = (n % 2 == 0);
+    if (n == 4) op1.max_frames_latency = 20;
+    PitchExtractionOptions op2(op1);
+    op2.max_frames_lookback = 200 + rand() % 300;
+
+    int32 size = 50000 + rand() % 50000;
+    Vector<BaseFloat> v;
+    MakeWanderingSineWave(size, op1.samp_freq, &v);
+
+    Matrix<BaseFloat> m1;
+    ComputeKaldiPitch(op1, v, &m1);
+
+    Matrix<BaseFloat> m2;
+    {  // compute it online with multiple pieces, with the limited lookback.
+      OnlinePitchFeature pitch_extractor(op2);
+      int32 start_samp = 0;
+      while (start_samp < v.Dim()) {
+        int32 num_samp = rand() % std::min(v.Dim() + 1 - start_samp, 8000);
+        SubVector<BaseFloat> v_part(v, start_samp, num_samp);
+        pitch_extractor.AcceptWaveform(op2.samp_freq, v_part);
+        start_samp += num_samp;
+      }
+      pitch_extractor.InputFinished();
+      int32 num_frames = pitch_extractor.NumFramesReady();
+      m2.Resize(num_frames, 2);
+      for (int32 frame = 0; frame < num_frames; frame++) {
+        SubVector<BaseFloat> row(m2, frame);
+        pitch_extractor.GetFrame(frame, &row);
+      }
+    }
+    KALDI_ASSERT(m1.NumRows() == m2.NumRows());
+    // Without nccf_ballast_online, the energy normalization depends on the
+    // chunk sizes, so only the number of frames is expected to match.
+    if (op1.nccf_ballast_online)
+      AssertEqual(m1, m2);
+  }
+  KALDI_LOG << "Test passed :)\n";
+}
+
 static void UnitTestComputeGPE() {
   KALDI_LOG << "=== UnitTestComputeGPE ===\n";
   int32 wrong_pitch = 0, tot_voiced = 0, tot_unvoiced = 0, num_frames = 0;
@@ -515,6 +604,8 @@ static void UnitTestFeatNoKeele() {
   UnitTestPieces();
   UnitTestDelay();
   UnitTestSearch();
+  UnitTestCorrelation();
+  UnitTestLookback();
 }
 
 static void UnitTestFeatWithKeele() {
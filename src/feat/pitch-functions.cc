@@ -121,6 +121,156 @@ void ComputeCorrelation(const VectorBase<BaseFloat> &wave,
   }
 }
 
+/**
+   This class computes the same quantities as ComputeCorrelation(), but more
+   efficiently.  It gets the energies of the shifted windows (e2) from a
+   running sum of squares, instead of as a separate dot product for each lag,
+   and if it is cheaper it gets the inner products for all the lags at once,
+   as a cross-correlation computed with FFTs whose size is the full frame
+   length, nccf_window_size + last_lag, rounded up to a power of two.  That
+   makes the cost per frame O(N log N) in the full frame length, rather than
+   O(nccf_window_size * num_lags); but the dot products are fast enough that
+   the FFT only wins for quite large windows (e.g. with a high
+   --resample-frequency), so for the default configuration we compute them
+   directly.  The results are the same as ComputeCorrelation() up to
+   roundoff.
+ */
+class NccfCorrelation {
+ public:
+  /// If use_fft is true, we compute the inner products with FFTs, otherwise
+  /// directly.  See FftIsFaster().
+  NccfCorrelation(int32 full_frame_length, int32 nccf_window_size,
+                  bool use_fft);
+
+  /// Returns true if we estimate that the FFT computation will be faster than
+  /// the direct computation for these window and lag sizes.
+  static bool FftIsFaster(int32 nccf_window_size, int32 first_lag,
+                          int32 last_lag);
+
+  /// "wave" is the full frame, of dimension at most the full_frame_length
+  /// given to the constructor; the other arguments are as for
+  /// ComputeCorrelation(), and first_lag and last_lag must be as given to the
+  /// constructor.
+  void Compute(const VectorBase<BaseFloat> &wave,
+               int32 first_lag, int32 last_lag,
+               VectorBase<BaseFloat> *inner_prod,
+               VectorBase<BaseFloat> *norm_prod);
+
+  bool UsingFft() const { return srfft_ != NULL; }
+
+  ~NccfCorrelation() { delete srfft_; }
+ private:
+  int32 nccf_window_size_;
+  int32 fft_size_;
+  SplitRadixRealFft<BaseFloat> *srfft_;  // NULL if we're not using the FFT.
+  Vector<BaseFloat> window_fft_;  // FFT of the (mean-subtracted) first window.
+  Vector<BaseFloat> wave_fft_;  // FFT of the (mean-subtracted) full frame.
+  Vector<BaseFloat> zero_mean_wave_;  // used if we're not using the FFT.
+  std::vector<BaseFloat> temp_buffer_;  // used by srfft_.
+  std::vector<double> cumulative_sumsq_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NccfCorrelation);
+};
+
+NccfCorrelation::NccfCorrelation(int32 full_frame_length,
+                                 int32 nccf_window_size, bool use_fft):
+    nccf_window_size_(nccf_window_size),
+    fft_size_(RoundUpToNearestPowerOfTwo(std::max(full_frame_length, 4))),
+    srfft_(NULL) {
+  KALDI_ASSERT(full_frame_length >= nccf_window_size);
+  if (use_fft) {
+    srfft_ = new SplitRadixRealFft<BaseFloat>(fft_size_);
+    window_fft_.Resize(fft_size_);
+    wave_fft_.Resize(fft_size_);
+  }
+}
+
+bool NccfCorrelation::FftIsFaster(int32 nccf_window_size,
+                                  int32 first_lag, int32 last_lag) {
+  int32 fft_size = RoundUpToNearestPowerOfTwo(nccf_window_size + last_lag);
+  // The direct computation needs nccf_window_size multiply-adds per lag; the
+  // FFT computation needs three real FFTs of size fft_size.  The constant
+  // factor was measured: the dot products are much faster per operation than
+  // the FFT, as they vectorize well.
+  double direct_cost = static_cast<double>(nccf_window_size) *
+      (last_lag + 1 - first_lag),
+      fft_cost = 50.0 * fft_size * Log(static_cast<double>(fft_size)) /
+      Log(2.0);
+  return fft_cost < direct_cost;
+}
+
+void NccfCorrelation::Compute(const VectorBase<BaseFloat> &wave,
+                              int32 first_lag, int32 last_lag,
+                              VectorBase<BaseFloat> *inner_prod,
+                              VectorBase<BaseFloat> *norm_prod) {
+  int32 window_size = nccf_window_size_, dim = wave.Dim();
+  KALDI_ASSERT(dim <= fft_size_ && last_lag + window_size <= dim);
+  // Subtract the mean of the first window, as ComputeCorrelation() does.
+  BaseFloat mean = SubVector<BaseFloat>(wave, 0, window_size).Sum() /
+      window_size;
+  Vector<BaseFloat> &zero_mean_wave = (srfft_ != NULL ? wave_fft_ :
+                                       zero_mean_wave_);
+  if (srfft_ != NULL) zero_mean_wave.SetZero();
+  else zero_mean_wave.Resize(dim, kUndefined);
+  SubVector<BaseFloat> wave_part(zero_mean_wave, 0, dim);
+  wave_part.CopyFromVec(wave);
+  wave_part.Add(-mean);
+  SubVector<BaseFloat> window_part(wave_part, 0, window_size);
+  BaseFloat e1 = VecVec(window_part, window_part);
+
+  // cumulative_sumsq_[i] is the sum of squares of the first i samples.
+  cumulative_sumsq_.resize(dim + 1);
+  cumulative_sumsq_[0] = 0.0;
+  for (int32 i = 0; i < dim; i++)
+    cumulative_sumsq_[i + 1] = cumulative_sumsq_[i] +
+        wave_part(i) * static_cast<double>(wave_part(i));
+
+  if (srfft_ == NULL) {
+    for (int32 lag = first_lag; lag <= last_lag; lag++) {
+      SubVector<BaseFloat> shifted_part(wave_part, lag, window_size);
+      double e2 = cumulative_sumsq_[lag + window_size] -
+          cumulative_sumsq_[lag];
+      (*inner_prod)(lag - first_lag) = VecVec(window_part, shifted_part);
+      (*norm_prod)(lag - first_lag) = e1 * std::max(e2, 0.0);
+    }
+    return;
+  }
+
+  // The cross-correlation of the window with the frame is the inverse FFT of
+  // conj(window_fft) * wave_fft.  The FFT size is at least the frame length,
+  // so for the lags we want there is no wrap-around.
+  window_fft_.SetZero();
+  window_fft_.Range(0, window_size).CopyFromVec(window_part);
+  srfft_->Compute(window_fft_.Data(), true, &temp_buffer_);
+  srfft_->Compute(wave_fft_.Data(), true, &temp_buffer_);
+  BaseFloat *a = window_fft_.Data(), *b = wave_fft_.Data();
+  b[0] *= a[0];  // the zero and Nyquist frequencies are real.
+  b[1] *= a[1];
+  for (int32 k = 2; k < fft_size_; k += 2) {
+    BaseFloat re = a[k] * b[k] + a[k+1] * b[k+1],
+        im = a[k] * b[k+1] - a[k+1] * b[k];
+    b[k] = re;
+    b[k+1] = im;
+  }
+  srfft_->Compute(b, false, &temp_buffer_);
+  BaseFloat scale = 1.0 / fft_size_;
+
+  for (int32 lag = first_lag; lag <= last_lag; lag++) {
+    double e2 = std::max(cumulative_sumsq_[lag + window_size] -
+                         cumulative_sumsq_[lag], 0.0),
+        prod = b[lag] * scale;
+    // The roundoff error of the FFT is relative to the energy of the whole
+    // frame, so for a quiet part of the frame it could take the product past
+    // the Cauchy-Schwarz bound, which we enforce.  This also makes the product
+    // exactly zero if either window is all zeros, which ComputeNccf() relies
+    // on.
+    double bound = std::sqrt(e1 * e2);
+    if (prod > bound) prod = bound;
+    if (prod < -bound) prod = -bound;
+    (*inner_prod)(lag - first_lag) = prod;
+    (*norm_prod)(lag - first_lag) = e1 * e2;
+  }
+}
+
 /**
    Computes the NCCF as a fraction of the numerator term (a dot product between
    two vectors) and a denominator term which equals sqrt(e1*e2 + nccf_ballast)
@@ -225,6 +375,12 @@ class PitchFrameInfo {
   /// This function updates
   bool UpdatePreviousBestState(PitchFrameInfo *prev_frame);
 
+  /// This is called when the frames before this one have been discarded (see
+  /// PitchExtractionOptions::max_frames_lookback); after this, SetBestState()
+  /// and ComputeLatency() treat this frame the way they treat frame -1, as
+  /// the start of the traceback.
+  void SetFirstFrame() { prev_info_ = NULL; }
+
   /// This constructor is used for frame -1; it sets the costs to be all zeros
   /// the pov_nccf's to zero and the backpointers to -1.
   explicit PitchFrameInfo(int32 num_states);
@@ -638,6 +794,17 @@ class OnlinePitchFeatureImpl {
   /// from AcceptWaveform().
   void UpdateRemainder(const VectorBase<BaseFloat> &downsampled_wave_part);
 
+  /// If opts_.max_frames_lookback > 0, this function discards the traceback
+  /// information for frames that are too far in the past, after fixing their
+  /// output to the current best path.  It's called from AcceptWaveform().
+  void DiscardOldFrames();
+
+  /// Returns the total number of frames we have done the Viterbi computation
+  /// for.
+  int32 NumFramesProcessed() const {
+    return frame_offset_ + static_cast<int32>(frame_info_.size()) - 1;
+  }
+
 
   // The following variables don't change throughout the lifetime
   // of this object.
@@ -656,15 +823,25 @@ class OnlinePitchFeatureImpl {
   // have to use the initializer from the constructor.
   ArbitraryResample *nccf_resampler_;
 
+  // This object computes the un-normalized cross-correlations we need for
+  // the NCCF.
+  NccfCorrelation *nccf_correlation_;
+
   // The following objects may change during the lifetime of this object.
 
   // This object is used to resample the signal.
   LinearResample *signal_resampler_;
 
-  // frame_info_ is indexed by [frame-index + 1].  frame_info_[0] is an object
-  // that corresponds to frame -1, which is not a real frame.
+  // frame_info_ is indexed by [frame-index - frame_offset_ + 1].
+  // frame_info_[0] is an object that corresponds to frame -1, which is not a
+  // real frame, or if we have discarded old frames (see DiscardOldFrames()),
+  // to the last discarded frame.
   std::vector<PitchFrameInfo*> frame_info_;
 
+  // The number of frames whose PitchFrameInfo we have discarded; this is
+  // always zero unless opts_.max_frames_lookback > 0.
+  int32 frame_offset_;
+
 
   // nccf_info_ is indexed by frame-index, from frame 0 to at most
   // opts_.recompute_frame - 1.  It contains some information we'll
@@ -712,8 +889,14 @@ class OnlinePitchFeatureImpl {
 
 OnlinePitchFeatureImpl::OnlinePitchFeatureImpl(
     const PitchExtractionOptions &opts):
-    opts_(opts), forward_cost_remainder_(0.0), input_finished_(false),
-    signal_sumsq_(0.0), signal_sum_(0.0), downsampled_samples_processed_(0) {
+    opts_(opts), frame_offset_(0), forward_cost_remainder_(0.0),
+    input_finished_(false), signal_sumsq_(0.0), signal_sum_(0.0),
+    downsampled_samples_processed_(0) {
+  if (opts.max_frames_lookback != 0 &&
+      opts.max_frames_lookback <= opts.max_frames_latency)
+    KALDI_ERR << "--max-frames-lookback=" << opts.max_frames_lookback
+              << " must be zero or exceed --max-frames-latency="
+              << opts.max_frames_latency;
   signal_resampler_ = new LinearResample(opts.samp_freq, opts.resample_freq,
                                          opts.lowpass_cutoff,
                                          opts.lowpass_filter_width);
@@ -756,6 +939,13 @@ OnlinePitchFeatureImpl::OnlinePitchFeatureImpl(
                                           upsample_cutoff, lags_offset,
                                           opts.upsample_filter_width);
 
+  nccf_correlation_ = new NccfCorrelation(
+      opts.NccfWindowSize() + nccf_last_lag_, opts.NccfWindowSize(),
+      opts.correlation_method == 2 ||
+      (opts.correlation_method == 0 &&
+       NccfCorrelation::FftIsFaster(opts.NccfWindowSize(), nccf_first_lag_,
+                                    nccf_last_lag_)));
+
   // add a PitchInfo object for frame -1 (not a real frame).
   frame_info_.push_back(new PitchFrameInfo(lags_.Dim()));
   // zeroes forward_cost_; this is what we want for the fake frame -1.
@@ -784,7 +974,7 @@ void OnlinePitchFeatureImpl::UpdateRemainder(
     const VectorBase<BaseFloat> &downsampled_wave_part) {
   // frame_info_ has an extra element at frame-1, so subtract
   // one from the length.
-  int64 num_frames = static_cast<int64>(frame_info_.size()) - 1,
+  int64 num_frames = NumFramesProcessed(),
       next_frame = num_frames,
       frame_shift = opts_.NccfWindowShift(),
       next_frame_sample = frame_shift * next_frame;
@@ -882,6 +1072,7 @@ bool OnlinePitchFeatureImpl::IsLastFrame(int32 frame) const {
 int32 OnlinePitchFeatureImpl::NumFramesReady() const {
   int32 num_frames = lag_nccf_.size(),
       latency = frames_latency_;
+  KALDI_ASSERT(num_frames == NumFramesProcessed());
   KALDI_ASSERT(latency <= num_frames);
   return num_frames - latency;
 }
@@ -900,7 +1091,7 @@ void OnlinePitchFeatureImpl::InputFinished() {
   // after setting input_finished_ to true, NumFramesAvailable()
   // will return a slightly larger number.
   AcceptWaveform(opts_.samp_freq, Vector<BaseFloat>());
-  int32 num_frames = static_cast<size_t>(frame_info_.size() - 1);
+  int32 num_frames = NumFramesProcessed();
   if (num_frames < opts_.recompute_frame && !opts_.nccf_ballast_online)
     RecomputeBacktraces();
   frames_latency_ = 0;
@@ -913,6 +1104,8 @@ void OnlinePitchFeatureImpl::InputFinished() {
 // operation (it gets called for non-online mode, but is a no-op).
 void OnlinePitchFeatureImpl::RecomputeBacktraces() {
   KALDI_ASSERT(!opts_.nccf_ballast_online);
+  // We don't discard any frames before we have done this.
+  KALDI_ASSERT(frame_offset_ == 0);
   int32 num_frames = static_cast<int32>(frame_info_.size()) - 1;
   
   // The assertion reflects how we believe this function will be called.
@@ -1003,8 +1196,36 @@ void OnlinePitchFeatureImpl::RecomputeBacktraces() {
   nccf_info_.clear();  
 }
 
+void OnlinePitchFeatureImpl::DiscardOldFrames() {
+  int32 lookback = opts_.max_frames_lookback,
+      num_frames = NumFramesProcessed(),
+      num_kept_frames = static_cast<int32>(frame_info_.size()) - 1;
+  // We don't discard anything until we are past opts_.recompute_frame, as
+  // RecomputeBacktraces() needs all the frames.  To keep the cost down, we
+  // only do this when we have twice as many frames as we need to keep.
+  if (lookback <= 0 || num_frames < opts_.recompute_frame ||
+      num_kept_frames < 2 * lookback)
+    return;
+  // Fix the output for the frames we are discarding to their values on the
+  // current best path.
+  int32 best_final_state;
+  forward_cost_.Min(&best_final_state);
+  lag_nccf_.resize(num_frames);  // will keep any existing data.
+  frame_info_.back()->SetBestState(best_final_state, lag_nccf_);
+
+  // We keep "lookback" real frames, plus the one before them, which takes the
+  // place of frame -1.
+  int32 num_discard = num_kept_frames - lookback;
+  for (int32 i = 0; i < num_discard; i++)
+    delete frame_info_[i];
+  frame_info_.erase(frame_info_.begin(), frame_info_.begin() + num_discard);
+  frame_info_[0]->SetFirstFrame();
+  frame_offset_ += num_discard;
+}
+
 OnlinePitchFeatureImpl::~OnlinePitchFeatureImpl() {
   delete nccf_resampler_;
+  delete nccf_correlation_;
   delete signal_resampler_;
   for (size_t i = 0; i < frame_info_.size(); i++)
     delete frame_info_[i];
@@ -1038,7 +1259,7 @@ void OnlinePitchFeatureImpl::AcceptWaveform(
   int32 end_frame = NumFramesAvailable(
       downsampled_samples_processed_ + downsampled_wave.Dim(), opts_.snip_edges);
   // "start_frame" is the first frame-index we process
-  int32 start_frame = frame_info_.size() - 1,
+  int32 start_frame = NumFramesProcessed(),
       num_new_frames = end_frame - start_frame;
 
   if (num_new_frames == 0) {
@@ -1095,8 +1316,12 @@ void OnlinePitchFeatureImpl::AcceptWaveform(
     double mean_square = cur_sumsq / cur_num_samp -
         pow(cur_sum / cur_num_samp, 2.0);
 
-    ComputeCorrelation(window, nccf_first_lag_, nccf_last_lag_,
-                       basic_frame_length, &inner_prod, &norm_prod);
+    if (opts_.correlation_method == 1)
+      ComputeCorrelation(window, nccf_first_lag_, nccf_last_lag_,
+                         basic_frame_length, &inner_prod, &norm_prod);
+    else
+      nccf_correlation_->Compute(window, nccf_first_lag_, nccf_last_lag_,
+                                 &inner_prod, &norm_prod);
     double nccf_ballast_pov = 0.0,
         nccf_ballast_pitch = pow(mean_square * basic_frame_length, 2) *
              opts_.nccf_ballast,
@@ -1111,45 +1336,62 @@ void OnlinePitchFeatureImpl::AcceptWaveform(
       nccf_info_.push_back(new NccfInfo(avg_norm_prod, mean_square));
   }
 
-  Matrix<BaseFloat> nccf_pitch_resampled(num_new_frames, num_resampled_lags);
-  nccf_resampler_->Resample(nccf_pitch, &nccf_pitch_resampled);
-  nccf_pitch.Resize(0, 0);  // no longer needed.
-  Matrix<BaseFloat> nccf_pov_resampled(num_new_frames, num_resampled_lags);
-  nccf_resampler_->Resample(nccf_pov, &nccf_pov_resampled);
-  nccf_pov.Resize(0, 0);  // no longer needed.
-
   // We've finished dealing with the waveform so we can call UpdateRemainder
   // now; we need to call it before we possibly call RecomputeBacktraces()
   // below, which is why we don't do it at the very end.
   UpdateRemainder(downsampled_wave);
 
+  // We resample the NCCF and do the Viterbi in blocks of frames, so that if
+  // we were given a lot of signal at once, we don't need a lot of memory for
+  // the resampled NCCF (which has many more lags than the NCCF we measured).
+  int32 block_size = std::min(num_new_frames, 256);
+  Matrix<BaseFloat> nccf_pitch_resampled(block_size, num_resampled_lags),
+      nccf_pov_resampled(block_size, num_resampled_lags);
   std::vector<std::pair<int32, int32 > > index_info;
-  
-  for (int32 frame = start_frame; frame < end_frame; frame++) {
-    int32 frame_idx = frame - start_frame;
-    PitchFrameInfo *prev_info = frame_info_.back(),
-        *cur_info = new PitchFrameInfo(prev_info);
-    cur_info->SetNccfPov(nccf_pov_resampled.Row(frame_idx));
-    cur_info->ComputeBacktraces(opts_, nccf_pitch_resampled.Row(frame_idx),
-                                lags_, forward_cost_, &index_info,
-                                &cur_forward_cost);
-    forward_cost_.Swap(&cur_forward_cost);
-    // Renormalize forward_cost so smallest element is zero.
-    BaseFloat remainder = forward_cost_.Min();
-    forward_cost_remainder_ += remainder;
-    forward_cost_.Add(-remainder);
-    frame_info_.push_back(cur_info);
-    if (frame < opts_.recompute_frame)
-      nccf_info_[frame]->nccf_pitch_resampled =
-          nccf_pitch_resampled.Row(frame_idx);
-    if (frame == opts_.recompute_frame - 1 && !opts_.nccf_ballast_online)
-      RecomputeBacktraces();
+
+  for (int32 block_start = start_frame; block_start < end_frame;
+       block_start += block_size) {
+    int32 this_block_size = std::min(block_size, end_frame - block_start);
+    SubMatrix<BaseFloat> pitch_resampled(nccf_pitch_resampled, 0,
+                                         this_block_size, 0,
+                                         num_resampled_lags),
+        pov_resampled(nccf_pov_resampled, 0, this_block_size, 0,
+                      num_resampled_lags);
+    nccf_resampler_->Resample(nccf_pitch.RowRange(block_start - start_frame,
+                                                  this_block_size),
+                              &pitch_resampled);
+    nccf_resampler_->Resample(nccf_pov.RowRange(block_start - start_frame,
+                                                this_block_size),
+                              &pov_resampled);
+
+    for (int32 frame = block_start; frame < block_start + this_block_size;
+         frame++) {
+      int32 frame_idx = frame - block_start;
+      PitchFrameInfo *prev_info = frame_info_.back(),
+          *cur_info = new PitchFrameInfo(prev_info);
+      cur_info->SetNccfPov(pov_resampled.Row(frame_idx));
+      cur_info->ComputeBacktraces(opts_, pitch_resampled.Row(frame_idx),
+                                  lags_, forward_cost_, &index_info,
+                                  &cur_forward_cost);
+      forward_cost_.Swap(&cur_forward_cost);
+      // Renormalize forward_cost so smallest element is zero.
+      BaseFloat remainder = forward_cost_.Min();
+      forward_cost_remainder_ += remainder;
+      forward_cost_.Add(-remainder);
+      frame_info_.push_back(cur_info);
+      if (frame < opts_.recompute_frame)
+        nccf_info_[frame]->nccf_pitch_resampled =
+            pitch_resampled.Row(frame_idx);
+      if (frame == opts_.recompute_frame - 1 && !opts_.nccf_ballast_online)
+        RecomputeBacktraces();
+      DiscardOldFrames();
+    }
   }
   
   // Trace back the best-path.
   int32 best_final_state;
   forward_cost_.Min(&best_final_state);
-  lag_nccf_.resize(frame_info_.size() - 1);  // will keep any existing data.
+  lag_nccf_.resize(NumFramesProcessed());  // will keep any existing data.
   frame_info_.back()->SetBestState(best_final_state, lag_nccf_);
   frames_latency_ =
       frame_info_.back()->ComputeLatency(opts_.max_frames_latency);
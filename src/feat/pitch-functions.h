@@ -73,6 +73,16 @@ struct PitchExtractionOptions {
   // can just leave this value at zero.
   int32 max_frames_latency;
 
+  // If nonzero, the maximum number of frames of history that the pitch
+  // extractor keeps for the Viterbi traceback.  Older frames are fixed to
+  // their values on the best path at that point, and their traceback
+  // information is discarded, so the memory used no longer grows with the
+  // length of the input (apart from 8 bytes per frame for the output).  This
+  // is for long recordings.  Values of a few hundred frames won't normally
+  // change the output, as the traceback converges much faster than that.  It
+  // must exceed max_frames_latency.
+  int32 max_frames_lookback;
+
   // Only relevant for the function ComputeKaldiPitch which is called by
   // compute-kaldi-pitch-feats. If nonzero, we provide the input as chunks of
   // this size. This affects the energy normalization which has a small effect
@@ -110,6 +120,12 @@ struct PitchExtractionOptions {
   // chunking, which is useful for testing purposes.
   bool nccf_ballast_online;
   bool snip_edges;
+
+  // This is a "hidden config" used only for testing, and is not registered.
+  // It says how the correlations for the NCCF are computed: 0 means choose
+  // automatically, 1 means directly (ComputeCorrelation()), and 2 means with
+  // the FFT.
+  int32 correlation_method;
   PitchExtractionOptions():
       samp_freq(16000),
       frame_shift_ms(10.0),
@@ -126,11 +142,13 @@ struct PitchExtractionOptions {
       lowpass_filter_width(1),
       upsample_filter_width(5),
       max_frames_latency(0),
+      max_frames_lookback(0),
       frames_per_chunk(0),
       simulate_first_pass_online(false),
       recompute_frame(500),
       nccf_ballast_online(false),
-      snip_edges(true) { }
+      snip_edges(true),
+      correlation_method(0) { }
 
   void Register(OptionsItf *opts) {
     opts->Register("sample-frequency", &samp_freq,
@@ -189,6 +207,11 @@ struct PitchExtractionOptions {
                    "introduce into the feature processing (affects output only "
                    "if --frames-per-chunk > 0 and "
                    "--simulate-first-pass-online=true");
+    opts->Register("max-frames-lookback", &max_frames_lookback, "If nonzero, "
+                   "the number of frames of history the pitch tracker keeps for "
+                   "the Viterbi traceback; older frames are fixed.  Setting "
+                   "this (e.g. to 500) bounds the memory used for long "
+                   "recordings.  Must exceed --max-frames-latency.");
     opts->Register("snip-edges", &snip_edges, "If this is set to false, the "
                    "incomplete frames near the ending edge won't be snipped, so "
                    "that the number of frames is the file size divided by the "
@@ -22,6 +22,7 @@
 
 
 #include "feat/resample.h"
+#include "base/timer.h"
 
 using namespace kaldi;
 
@@ -275,6 +276,54 @@ void UnitTestLinearResample2() {
   AssertEqual(self1, cross, 0.001);
 }
 
+// Checks that resampling a signal in pieces, using the version of Resample()
+// that outputs to a preallocated buffer, gives the same result as resampling
+// it all at once, for some typical sampling rates; and prints the speed.
+void UnitTestLinearResampleStreaming() {
+  int32 rates[][2] = { { 16000, 8000 }, { 8000, 16000 }, { 44100, 16000 },
+                       { 16000, 4000 } };
+  for (int32 r = 0; r < 4; r++) {
+    int32 samp_freq = rates[r][0], resamp_freq = rates[r][1];
+    BaseFloat lowpass_freq = 0.45 * std::min(samp_freq, resamp_freq);
+    int32 num_zeros = 1 + rand() % 10;
+    Vector<BaseFloat> signal(samp_freq * 20);  // 20 seconds.
+    signal.SetRandn();
+
+    LinearResample resampler(samp_freq, resamp_freq, lowpass_freq,
+                             num_zeros);
+    Vector<BaseFloat> resampled;
+    Timer timer;
+    resampler.Resample(signal, true, &resampled);
+    double elapsed = timer.Elapsed();
+
+    // A second object with the same parameters, to which we give the signal
+    // in pieces.
+    LinearResample resampler2(samp_freq, resamp_freq, lowpass_freq,
+                              num_zeros);
+    Vector<BaseFloat> resampled2(resampled.Dim()),
+        buffer(resampled.Dim());  // bigger than we need.
+    int32 input_dim_seen = 0, output_dim_seen = 0;
+    while (input_dim_seen < signal.Dim()) {
+      int32 dim_remaining = signal.Dim() - input_dim_seen,
+          piece_size = std::min(dim_remaining, rand() % 2000);
+      bool flush = (piece_size == dim_remaining);
+      SubVector<BaseFloat> in_piece(signal, input_dim_seen, piece_size);
+      SubVector<BaseFloat> out_piece(buffer, 0,
+          resampler2.NumOutputSamples(piece_size, flush));
+      resampler2.Resample(in_piece, flush, &out_piece);
+      resampled2.Range(output_dim_seen, out_piece.Dim()).CopyFromVec(
+          out_piece);
+      input_dim_seen += piece_size;
+      output_dim_seen += out_piece.Dim();
+    }
+    KALDI_ASSERT(output_dim_seen == resampled.Dim());
+    AssertEqual(resampled, resampled2);
+    KALDI_LOG << "Resampling from " << samp_freq << " to " << resamp_freq
+              << " Hz with num-zeros=" << num_zeros << " took "
+              << (elapsed / 20.0) << " seconds per second of signal.";
+  }
+}
+
 int main() {
   try {
     for (int32 x = 0; x < 50; x++)
@@ -283,6 +332,7 @@ int main() {
       UnitTestLinearResample2();    
     for (int32 x = 0; x < 50; x++)
       UnitTestArbitraryResample();
+    UnitTestLinearResampleStreaming();
 
     KALDI_LOG << "Tests succeeded.\n";
     return 0;
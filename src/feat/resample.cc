@@ -21,8 +21,11 @@
 // limitations under the License.
 
 
+#include <pthread.h>
 #include <algorithm>
+#include <cstring>
 #include <limits>
+#include <map>
 #include "feat/feature-functions.h"
 #include "matrix/matrix-functions.h"
 #include "feat/resample.h"
@@ -51,7 +54,16 @@ LinearResample::LinearResample(int32 samp_rate_in_hz,
   input_samples_in_unit_ = samp_rate_in_ / base_freq;
   output_samples_in_unit_ = samp_rate_out_ / base_freq;
 
-  SetIndexesAndWeights();
+  filters_ = GetFilters(samp_rate_in_hz, samp_rate_out_hz, filter_cutoff_hz,
+                        num_zeros);
+  // max_remainder_needed is the width of the filter from side to side,
+  // measured in input samples.  you might think it should be half that,
+  // but you have to consider that you might be wanting to output samples
+  // that are "in the past" relative to the beginning of the latest
+  // input... anyway, storing more remainder than needed is not harmful.
+  int32 max_remainder_needed = ceil(samp_rate_in_ * num_zeros_ /
+                                    filter_cutoff_);
+  input_remainder_.Resize(max_remainder_needed);
   Reset();
 }
 
@@ -101,14 +113,49 @@ int64 LinearResample::GetNumOutputSamples(int64 input_num_samp,
   return num_output_samp;
 }
 
-void LinearResample::SetIndexesAndWeights() {
-  first_index_.resize(output_samples_in_unit_);
-  weights_.resize(output_samples_in_unit_);
+// The key of the cache in LinearResample::GetFilters().
+typedef std::pair<std::pair<int32, int32>, std::pair<BaseFloat, int32> >
+    ResampleFiltersKey;
+static pthread_mutex_t resample_filters_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+const LinearResample::Filters *LinearResample::GetFilters(
+    int32 samp_rate_in_hz, int32 samp_rate_out_hz,
+    BaseFloat filter_cutoff_hz, int32 num_zeros) {
+  ResampleFiltersKey key(std::make_pair(samp_rate_in_hz, samp_rate_out_hz),
+                         std::make_pair(filter_cutoff_hz, num_zeros));
+  pthread_mutex_lock(&resample_filters_mutex);
+  // The cache is constructed the first time we get here, which is while we
+  // hold the lock; its entries are never deleted.
+  static std::map<ResampleFiltersKey, Filters*> cache;
+  Filters *&filters = cache[key];
+  if (filters == NULL) {
+    // We hold the lock while computing the weights, so that other threads
+    // wanting the same weights wait for them instead of computing them too.
+    int32 output_samples_in_unit =
+        samp_rate_out_hz / Gcd(samp_rate_in_hz, samp_rate_out_hz);
+    filters = new Filters;
+    SetIndexesAndWeights(samp_rate_in_hz, samp_rate_out_hz, filter_cutoff_hz,
+                         num_zeros, output_samples_in_unit, filters);
+  }
+  const Filters *ans = filters;
+  pthread_mutex_unlock(&resample_filters_mutex);
+  return ans;
+}
+
+void LinearResample::SetIndexesAndWeights(int32 samp_rate_in_hz,
+                                          int32 samp_rate_out_hz,
+                                          BaseFloat filter_cutoff_hz,
+                                          int32 num_zeros,
+                                          int32 output_samples_in_unit,
+                                          Filters *filters) {
+  std::vector<int32> &first_index = filters->first_index;
+  first_index.resize(output_samples_in_unit);
 
-  double window_width = num_zeros_ / (2.0 * filter_cutoff_);
+  double window_width = num_zeros / (2.0 * filter_cutoff_hz);
 
-  for (int32 i = 0; i < output_samples_in_unit_; i++) {
-    double output_t = i / static_cast<double>(samp_rate_out_);
+  std::vector<int32> num_indices(output_samples_in_unit);
+  for (int32 i = 0; i < output_samples_in_unit; i++) {
+    double output_t = i / static_cast<double>(samp_rate_out_hz);
     double min_t = output_t - window_width, max_t = output_t + window_width;
     // we do ceil on the min and floor on the max, because if we did it
     // the other way around we would unnecessarily include indexes just
@@ -117,22 +164,28 @@ void LinearResample::SetIndexesAndWeights() {
     // (e.g. if filter_cutoff_ has an exact ratio with the sample rates),
     // that we unnecessarily include something with a zero coefficient,
     // but this is only a slight efficiency issue.
-    int32 min_input_index = ceil(min_t * samp_rate_in_),
-        max_input_index = floor(max_t * samp_rate_in_),
-        num_indices = max_input_index - min_input_index + 1;
-    first_index_[i] = min_input_index;
-    weights_[i].Resize(num_indices);
-    for (int32 j = 0; j < num_indices; j++) {
-      int32 input_index = min_input_index + j;
-      double input_t = input_index / static_cast<double>(samp_rate_in_),
+    int32 min_input_index = ceil(min_t * samp_rate_in_hz),
+        max_input_index = floor(max_t * samp_rate_in_hz);
+    first_index[i] = min_input_index;
+    num_indices[i] = max_input_index - min_input_index + 1;
+  }
+  // The rows differ in length by at most one; we pad them with zeros.
+  int32 max_num_indices = *std::max_element(num_indices.begin(),
+                                            num_indices.end());
+  filters->weights.Resize(output_samples_in_unit, max_num_indices);
+  for (int32 i = 0; i < output_samples_in_unit; i++) {
+    double output_t = i / static_cast<double>(samp_rate_out_hz);
+    for (int32 j = 0; j < num_indices[i]; j++) {
+      int32 input_index = first_index[i] + j;
+      double input_t = input_index / static_cast<double>(samp_rate_in_hz),
           delta_t = input_t - output_t;
       // sign of delta_t doesn't matter.
-      weights_[i](j) = FilterFunc(delta_t) / samp_rate_in_;
+      filters->weights(i, j) = FilterFunc(filter_cutoff_hz, num_zeros,
+                                          delta_t) / samp_rate_in_hz;
     }
   }
 }
 
-
 // inline
 void LinearResample::GetIndexes(int64 samp_out,
                                 int64 *first_samp_in,
@@ -144,21 +197,53 @@ void LinearResample::GetIndexes(int64 samp_out,
   // samp_out_wrapped is equal to samp_out % output_samples_in_unit_
   *samp_out_wrapped = static_cast<int32>(samp_out -
                                          unit_index * output_samples_in_unit_);
-  *first_samp_in = first_index_[*samp_out_wrapped] +
+  *first_samp_in = filters_->first_index[*samp_out_wrapped] +
       unit_index * input_samples_in_unit_;
 }
 
 
+// Returns the dot product of a and b, which have dimension n.  We use this
+// rather than VecVec() because the filters are short, so the overhead of the
+// BLAS call matters; the four separate sums allow the compiler to vectorize
+// the loop, and break the dependency between consecutive additions.
+static inline BaseFloat ShortDotProduct(const BaseFloat *a,
+                                        const BaseFloat *b, int32 n) {
+  BaseFloat sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+  int32 i = 0;
+  for (; i + 4 <= n; i += 4) {
+    sum0 += a[i] * b[i];
+    sum1 += a[i + 1] * b[i + 1];
+    sum2 += a[i + 2] * b[i + 2];
+    sum3 += a[i + 3] * b[i + 3];
+  }
+  for (; i < n; i++)
+    sum0 += a[i] * b[i];
+  return (sum0 + sum1) + (sum2 + sum3);
+}
+
 void LinearResample::Resample(const VectorBase<BaseFloat> &input,
                               bool flush,
                               Vector<BaseFloat> *output) {
+  output->Resize(NumOutputSamples(input.Dim(), flush), kUndefined);
+  Resample(input, flush, static_cast<VectorBase<BaseFloat>*>(output));
+}
+
+void LinearResample::Resample(const VectorBase<BaseFloat> &input,
+                              bool flush,
+                              VectorBase<BaseFloat> *output) {
   int32 input_dim = input.Dim();
   int64 tot_input_samp = input_sample_offset_ + input_dim,
       tot_output_samp = GetNumOutputSamples(tot_input_samp, flush);
-  
-  KALDI_ASSERT(tot_output_samp >= output_sample_offset_);
 
-  output->Resize(tot_output_samp - output_sample_offset_);
+  KALDI_ASSERT(tot_output_samp >= output_sample_offset_ &&
+               output->Dim() == tot_output_samp - output_sample_offset_);
+
+  const Matrix<BaseFloat> &weights = filters_->weights;
+  int32 num_weights = weights.NumCols(),
+      remainder_dim = input_remainder_.Dim();
+  const BaseFloat *input_data = input.Data(),
+      *remainder_data = input_remainder_.Data();
+  BaseFloat *output_data = output->Data();
 
   // samp_out is the index into the total output signal, not just the part
   // of it we are producing here.
@@ -168,36 +253,36 @@ void LinearResample::Resample(const VectorBase<BaseFloat> &input,
     int64 first_samp_in;
     int32 samp_out_wrapped;
     GetIndexes(samp_out, &first_samp_in, &samp_out_wrapped);
-    const Vector<BaseFloat> &weights = weights_[samp_out_wrapped];
+    const BaseFloat *weights_data = weights.RowData(samp_out_wrapped);
     // first_input_index is the first index into "input" that we have a weight
     // for.
     int32 first_input_index = static_cast<int32>(first_samp_in -
                                                  input_sample_offset_);
     BaseFloat this_output;
     if (first_input_index >= 0 &&
-        first_input_index + weights.Dim() <= input_dim) {
-      SubVector<BaseFloat> input_part(input, first_input_index, weights.Dim());
-      this_output = VecVec(input_part, weights);
+        first_input_index + num_weights <= input_dim) {
+      this_output = ShortDotProduct(input_data + first_input_index,
+                                    weights_data, num_weights);
     } else {  // Handle edge cases.
       this_output = 0.0;
-      for (int32 i = 0; i < weights.Dim(); i++) {
-        BaseFloat weight = weights(i);
+      for (int32 i = 0; i < num_weights; i++) {
+        BaseFloat weight = weights_data[i];
         int32 input_index = first_input_index + i;
-        if (input_index < 0 && input_remainder_.Dim() + input_index >= 0) {
-          this_output += weight *
-              input_remainder_(input_remainder_.Dim() + input_index);
+        if (input_index < 0 && remainder_dim + input_index >= 0) {
+          this_output += weight * remainder_data[remainder_dim + input_index];
         } else if (input_index >= 0 && input_index < input_dim) {
-          this_output += weight * input(input_index);
+          this_output += weight * input_data[input_index];
         } else if (input_index >= input_dim) {
           // We're past the end of the input and are adding zero; should only
           // happen if the user specified flush == true, or else we would not
-          // be trying to output this sample.
-          KALDI_ASSERT(flush);
+          // be trying to output this sample (or if this is the zero padding
+          // at the end of the weights).
+          KALDI_ASSERT(flush || weight == 0.0);
         }
       }
     }
     int32 output_index = static_cast<int32>(samp_out - output_sample_offset_);
-    (*output)(output_index) = this_output;
+    output_data[output_index] = this_output;
   }
 
   if (flush) {
@@ -210,32 +295,27 @@ void LinearResample::Resample(const VectorBase<BaseFloat> &input,
 }
 
 void LinearResample::SetRemainder(const VectorBase<BaseFloat> &input) {
-  Vector<BaseFloat> old_remainder(input_remainder_);
-  // max_remainder_needed is the width of the filter from side to side,
-  // measured in input samples.  you might think it should be half that,
-  // but you have to consider that you might be wanting to output samples
-  // that are "in the past" relative to the beginning of the latest
-  // input... anyway, storing more remainder than needed is not harmful.
-  int32 max_remainder_needed = ceil(samp_rate_in_ * num_zeros_ /
-                                    filter_cutoff_);
-  input_remainder_.Resize(max_remainder_needed);
-  for (int32 index = - input_remainder_.Dim(); index < 0; index++) {
-    // we interpret "index" as an offset from the end of "input" and
-    // from the end of input_remainder_.
-    int32 input_index = index + input.Dim();
-    if (input_index >= 0)
-      input_remainder_(index + input_remainder_.Dim()) = input(input_index);
-    else if (input_index + old_remainder.Dim() >= 0)
-      input_remainder_(index + input_remainder_.Dim()) =
-          old_remainder(input_index + old_remainder.Dim());
-    // else leave it at zero.
+  // We shift the remainder left and append the input to it, keeping the last
+  // input_remainder_.Dim() samples; this is done in place so that we don't
+  // allocate memory.
+  int32 remainder_dim = input_remainder_.Dim(), input_dim = input.Dim();
+  BaseFloat *remainder_data = input_remainder_.Data();
+  if (input_dim >= remainder_dim) {
+    std::memcpy(remainder_data, input.Data() + input_dim - remainder_dim,
+                sizeof(BaseFloat) * remainder_dim);
+  } else {
+    std::memmove(remainder_data, remainder_data + input_dim,
+                 sizeof(BaseFloat) * (remainder_dim - input_dim));
+    std::memcpy(remainder_data + remainder_dim - input_dim, input.Data(),
+                sizeof(BaseFloat) * input_dim);
   }
 }
 
 void LinearResample::Reset() {
   input_sample_offset_ = 0;
   output_sample_offset_ = 0;
-  input_remainder_.Resize(0);
+  // The signal is treated as zero before its start.
+  input_remainder_.SetZero();
 }
 
 /** Here, t is a time in seconds representing an offset from
@@ -243,18 +323,19 @@ void LinearResample::Reset() {
     returns the windowed filter function, described
     in the header as h(t) = f(t)g(t), evaluated at t.
 */
-BaseFloat LinearResample::FilterFunc(BaseFloat t) const {
+BaseFloat LinearResample::FilterFunc(BaseFloat filter_cutoff, int32 num_zeros,
+                                     BaseFloat t) {
   BaseFloat window,  // raised-cosine (Hanning) window of width
-                  // num_zeros_/2*filter_cutoff_
+                  // num_zeros/2*filter_cutoff
       filter;  // sinc filter function
-  if (fabs(t) < num_zeros_ / (2.0 * filter_cutoff_))
-    window = 0.5 * (1 + cos(M_2PI * filter_cutoff_ / num_zeros_ * t));
+  if (fabs(t) < num_zeros / (2.0 * filter_cutoff))
+    window = 0.5 * (1 + cos(M_2PI * filter_cutoff / num_zeros * t));
   else
     window = 0.0;  // outside support of window function
   if (t != 0)
-    filter = sin(M_2PI * filter_cutoff_ * t) / (M_PI * t);
+    filter = sin(M_2PI * filter_cutoff * t) / (M_PI * t);
   else
-    filter = 2 * filter_cutoff_;  // limit of the function at t = 0
+    filter = 2 * filter_cutoff;  // limit of the function at t = 0
   return filter * window;
 }
 
@@ -142,6 +142,14 @@ class ArbitraryResample {
 
    We require that the input and output sampling rate be specified as
    integers, as this is an easy way to specify that their ratio be rational.
+
+   It is a polyphase resampler: the output samples fall into a small number
+   of "phases" (the number of output samples in the smallest repeating unit of
+   time, e.g. 1 for 16k to 8k, 160 for 44.1k to 16k), and all the output
+   samples in the same phase use the same filter weights.  The weights depend
+   only on the constructor arguments, and they are computed once per process
+   and shared between all LinearResample objects with the same arguments, so
+   constructing these objects (e.g. once per file) is cheap.
 */
 
 class LinearResample {
@@ -178,6 +186,22 @@ class LinearResample {
                 bool flush,
                 Vector<BaseFloat> *output);
 
+  /// This version of Resample() is as the one above, except that "output"
+  /// must already have the right dimension, NumOutputSamples(input.Dim(),
+  /// flush).  It does not allocate any memory, so when processing a stream
+  /// in chunks you can use it with a preallocated output buffer.
+  void Resample(const VectorBase<BaseFloat> &input,
+                bool flush,
+                VectorBase<BaseFloat> *output);
+
+  /// Returns the number of samples that the next call to Resample() will
+  /// output if you give it "input_dim" input samples.
+  int32 NumOutputSamples(int32 input_dim, bool flush) const {
+    return static_cast<int32>(
+        GetNumOutputSamples(input_sample_offset_ + input_dim, flush) -
+        output_sample_offset_);
+  }
+
   /// Calling the function Reset() resets the state of the object prior to
   /// processing a new signal; it is only necessary if you have called
   /// Resample(x, y, false) for some signal, leading to a remainder of the
@@ -207,9 +231,36 @@ class LinearResample {
 
   void SetRemainder(const VectorBase<BaseFloat> &input);
 
-  void SetIndexesAndWeights();
-
-  BaseFloat FilterFunc(BaseFloat) const;
+  /// The filter weights for one set of constructor arguments.  Only the first
+  /// unit of output samples is stored (see GetIndexes()).
+  struct Filters {
+    /// The first input-sample index that we sum over, for this output-sample
+    /// index.  May be negative; any truncation at the beginning is handled
+    /// separately.
+    std::vector<int32> first_index;
+    /// Row i contains the weights on the input samples for output-sample
+    /// index i.  The rows are zero-padded to the same length, so the inner
+    /// loop over the weights always has the same length.
+    Matrix<BaseFloat> weights;
+  };
+
+  /// Returns the filter weights for these arguments to the constructor.  The
+  /// result is computed the first time it is requested, and is cached for the
+  /// lifetime of the program; this function is thread-safe.
+  static const Filters *GetFilters(int32 samp_rate_in_hz,
+                                   int32 samp_rate_out_hz,
+                                   BaseFloat filter_cutoff_hz,
+                                   int32 num_zeros);
+
+  static void SetIndexesAndWeights(int32 samp_rate_in_hz,
+                                   int32 samp_rate_out_hz,
+                                   BaseFloat filter_cutoff_hz,
+                                   int32 num_zeros,
+                                   int32 output_samples_in_unit,
+                                   Filters *filters);
+
+  static BaseFloat FilterFunc(BaseFloat filter_cutoff_hz, int32 num_zeros,
+                              BaseFloat t);
 
   // The following variables are provided by the user.
   int32 samp_rate_in_;
@@ -227,14 +278,9 @@ class LinearResample {
                                   ///< samp_rate_out_hz)
 
 
-  /// The first input-sample index that we sum over, for this output-sample
-  /// index.  May be negative; any truncation at the beginning is handled
-  /// separately.  This is just for the first few output samples, but we can
-  /// extrapolate the correct input-sample index for arbitrary output samples.
-  std::vector<int32> first_index_;
-
-  /// Weights on the input samples, for this output-sample index.
-  std::vector<Vector<BaseFloat> > weights_;
+  /// The filter weights, which are shared with other LinearResample objects
+  /// with the same parameters; owned by the cache in GetFilters().
+  const Filters *filters_;
 
   // the following variables keep track of where we are in a particular signal,
   // if it is being provided over multiple calls to Resample().
@@ -245,7 +291,9 @@ class LinearResample {
   int64 output_sample_offset_;  ///< The number of samples we have already
                                 ///< output for this signal.
   Vector<BaseFloat> input_remainder_;  ///< A small trailing part of the
-                                       ///< previously seen input signal.
+                                       ///< previously seen input signal
+                                       ///< (zero-padded at the start of a
+                                       ///< signal); its size is fixed.
 };
 
 
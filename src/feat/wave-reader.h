@@ -89,6 +89,13 @@ class WaveData {
     samp_freq_ = 0.0;
   }
 
+  /// Sets the sampling frequency to "samp_freq" and the data to "data",
+  /// which is swapped in rather than copied; "data" gets the previous data.
+  void SwapData(BaseFloat samp_freq, Matrix<BaseFloat> *data) {
+    data_.Swap(data);
+    samp_freq_ = samp_freq;
+  }
+
  private:
   static const uint32 kBlockSize = 1048576;  // 1024 * 1024, use 1M bytes
   Matrix<BaseFloat> data_;
@@ -22,6 +22,84 @@
 #include "util/common-utils.h"
 #include "matrix/kaldi-matrix.h"
 #include "transform/cmvn.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-table-pipeline.h"
+
+namespace kaldi {
+
+typedef KaldiObjectHolder<Matrix<BaseFloat> > MatrixHolder;
+
+// Applies CMVN to the features, in parallel if --num-threads > 1.
+class ApplyCmvnPipeline: public TablePipeline<MatrixHolder,
+                                              Matrix<BaseFloat> > {
+ public:
+  // If cmvn_reader is NULL, the stats "cmvn_stats" are used for all
+  // utterances.
+  ApplyCmvnPipeline(const TaskSequencerConfig &config,
+                    RandomAccessDoubleMatrixReaderMapped *cmvn_reader,
+                    const Matrix<double> &cmvn_stats,
+                    const std::vector<int32> &skip_dims,
+                    bool norm_means, bool norm_vars, bool reverse,
+                    BaseFloatMatrixWriter *feat_writer):
+      TablePipeline<MatrixHolder, Matrix<BaseFloat> >(config),
+      cmvn_reader_(cmvn_reader), cmvn_stats_(cmvn_stats),
+      skip_dims_(skip_dims), norm_means_(norm_means), norm_vars_(norm_vars),
+      reverse_(reverse), feat_writer_(feat_writer), num_done_(0),
+      num_err_(0) { }
+
+  virtual bool Process(const std::string &utt, const Matrix<BaseFloat> &feat,
+                       Matrix<BaseFloat> *output) {
+    *output = feat;
+    if (!norm_means_) return true;
+    Matrix<double> cmvn_stats;
+    if (cmvn_reader_ != NULL) {
+      mutex_.Lock();  // the reader is not thread-safe.
+      bool has_key = cmvn_reader_->HasKey(utt);
+      if (has_key)
+        cmvn_stats = cmvn_reader_->Value(utt);
+      else
+        num_err_++;
+      mutex_.Unlock();
+      if (!has_key) {
+        KALDI_WARN << "No normalization statistics available for key "
+                   << utt << ", producing no output for this utterance";
+        return false;
+      }
+      if (!skip_dims_.empty())
+        FakeStatsForSomeDims(skip_dims_, &cmvn_stats);
+    }
+    const Matrix<double> &stats = (cmvn_reader_ != NULL ? cmvn_stats :
+                                   cmvn_stats_);
+    if (reverse_) {
+      ApplyCmvnReverse(stats, norm_vars_, output);
+    } else {
+      ApplyCmvn(stats, norm_vars_, output);
+    }
+    return true;
+  }
+
+  virtual void Output(const std::string &utt, const Matrix<BaseFloat> &feat) {
+    feat_writer_->Write(utt, feat);
+    num_done_++;
+  }
+
+  int32 NumDone() const { return num_done_; }
+  int32 NumErr() const { return num_err_; }
+
+ private:
+  RandomAccessDoubleMatrixReaderMapped *cmvn_reader_;
+  Mutex mutex_;
+  Matrix<double> cmvn_stats_;
+  std::vector<int32> skip_dims_;
+  bool norm_means_;
+  bool norm_vars_;
+  bool reverse_;
+  BaseFloatMatrixWriter *feat_writer_;
+  int32 num_done_;
+  int32 num_err_;
+};
+
+}  // namespace kaldi
 
 
 int main(int argc, char *argv[]) {
@@ -41,6 +119,7 @@ int main(int argc, char *argv[]) {
     bool norm_means = true;
     bool reverse = false;
     std::string skip_dims_str;
+    TaskSequencerConfig sequencer_config;
     
     po.Register("utt2spk", &utt2spk_rspecifier,
                 "rspecifier for utterance to speaker map");
@@ -53,6 +132,7 @@ int main(int argc, char *argv[]) {
     po.Register("reverse", &reverse, "If true, apply CMVN in a reverse sense, "
                 "so as to transform zero-mean, unit-variance input into data "
                 "with the given mean and variance.");
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
 
@@ -87,32 +167,13 @@ int main(int argc, char *argv[]) {
 
       RandomAccessDoubleMatrixReaderMapped cmvn_reader(cmvn_rspecifier,
                                                        utt2spk_rspecifier);
-      
-      for (; !feat_reader.Done(); feat_reader.Next()) {
-        std::string utt = feat_reader.Key();
-        Matrix<BaseFloat> feat(feat_reader.Value());
-        if (norm_means) {
-          if (!cmvn_reader.HasKey(utt)) {
-            KALDI_WARN << "No normalization statistics available for key "
-                       << utt << ", producing no output for this utterance";
-            num_err++;
-            continue;
-          }
-          Matrix<double> cmvn_stats = cmvn_reader.Value(utt);
-          if (!skip_dims.empty())
-            FakeStatsForSomeDims(skip_dims, &cmvn_stats);
-          
-          if (reverse) {
-            ApplyCmvnReverse(cmvn_stats, norm_vars, &feat);
-          } else {
-            ApplyCmvn(cmvn_stats, norm_vars, &feat);
-          }
-          feat_writer.Write(utt, feat);
-        } else {
-          feat_writer.Write(utt, feat);
-        }
-        num_done++;
-      }
+
+      ApplyCmvnPipeline pipeline(sequencer_config, &cmvn_reader,
+                                 Matrix<double>(), skip_dims, norm_means,
+                                 norm_vars, reverse, &feat_writer);
+      pipeline.Run(&feat_reader);
+      num_done = pipeline.NumDone();
+      num_err = pipeline.NumErr();
     } else {
       if (utt2spk_rspecifier != "")
         KALDI_ERR << "--utt2spk option not compatible with rxfilename as input "
@@ -124,20 +185,12 @@ int main(int argc, char *argv[]) {
       cmvn_stats.Read(ki.Stream(), binary);
       if (!skip_dims.empty())
         FakeStatsForSomeDims(skip_dims, &cmvn_stats);
-      
-      for (;!feat_reader.Done(); feat_reader.Next()) {
-        std::string utt = feat_reader.Key();
-        Matrix<BaseFloat> feat(feat_reader.Value());
-        if (norm_means) {
-          if (reverse) {
-            ApplyCmvnReverse(cmvn_stats, norm_vars, &feat);
-          } else {
-            ApplyCmvn(cmvn_stats, norm_vars, &feat);
-          }
-        }
-        feat_writer.Write(utt, feat);
-        num_done++;
-      }
+
+      ApplyCmvnPipeline pipeline(sequencer_config, NULL, cmvn_stats,
+                                 skip_dims, norm_means, norm_vars, reverse,
+                                 &feat_writer);
+      pipeline.Run(&feat_reader);
+      num_done = pipeline.NumDone();
     }
     if (norm_vars) 
       KALDI_LOG << "Applied cepstral mean and variance normalization to "
@@ -22,6 +22,172 @@
 #include "util/common-utils.h"
 #include "feat/feature-mfcc.h"
 #include "feat/wave-reader.h"
+#include "base/timer.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-table-pipeline.h"
+
+namespace kaldi {
+
+// Computes the features for each utterance, in parallel if --num-threads > 1.
+class MfccPipeline: public TablePipeline<WaveHolder, Matrix<BaseFloat> > {
+ public:
+  // If vtln_map_reader is NULL, "vtln_warp" is used for all utterances.
+  // Exactly one of kaldi_writer and htk_writer should be non-NULL.
+  MfccPipeline(const TaskSequencerConfig &config, const MfccOptions &mfcc_opts,
+               bool subtract_mean, BaseFloat vtln_warp,
+               RandomAccessBaseFloatReaderMapped *vtln_map_reader,
+               int32 channel, BaseFloat min_duration,
+               BaseFloatMatrixWriter *kaldi_writer,
+               TableWriter<HtkMatrixHolder> *htk_writer):
+      TablePipeline<WaveHolder, Matrix<BaseFloat> >(config),
+      mfcc_opts_(mfcc_opts), subtract_mean_(subtract_mean),
+      vtln_warp_(vtln_warp), vtln_map_reader_(vtln_map_reader),
+      channel_(channel), min_duration_(min_duration),
+      kaldi_writer_(kaldi_writer), htk_writer_(htk_writer), num_utts_(0),
+      num_success_(0), num_frames_(0) { }
+
+  virtual bool Process(const std::string &utt, const WaveData &wave_data,
+                       Matrix<BaseFloat> *features) {
+    mutex_.Lock();
+    num_utts_++;
+    mutex_.Unlock();
+    if (wave_data.Duration() < min_duration_) {
+      KALDI_WARN << "File: " << utt << " is too short ("
+                 << wave_data.Duration() << " sec): producing no output.";
+      return false;
+    }
+    int32 num_chan = wave_data.Data().NumRows(), this_chan = channel_;
+    {  // This block works out the channel (0=left, 1=right...)
+      KALDI_ASSERT(num_chan > 0);  // should have been caught in
+      // reading code if no channels.
+      if (channel_ == -1) {
+        this_chan = 0;
+        if (num_chan != 1)
+          KALDI_WARN << "Channel not specified but you have data with "
+                     << num_chan  << " channels; defaulting to zero";
+      } else {
+        if (this_chan >= num_chan) {
+          KALDI_WARN << "File with id " << utt << " has "
+                     << num_chan << " channels but you specified channel "
+                     << channel_ << ", producing no output.";
+          return false;
+        }
+      }
+    }
+    BaseFloat vtln_warp_local = vtln_warp_;  // Work out VTLN warp factor.
+    if (vtln_map_reader_ != NULL) {
+      mutex_.Lock();  // the reader is not thread-safe.
+      bool has_key = vtln_map_reader_->HasKey(utt);
+      if (has_key)
+        vtln_warp_local = vtln_map_reader_->Value(utt);
+      mutex_.Unlock();
+      if (!has_key) {
+        KALDI_WARN << "No vtln-map entry for utterance-id (or speaker-id) "
+                   << utt;
+        return false;
+      }
+    }
+    if (mfcc_opts_.frame_opts.samp_freq != wave_data.SampFreq())
+      KALDI_ERR << "Sample frequency mismatch: you specified "
+                << mfcc_opts_.frame_opts.samp_freq << " but data has "
+                << wave_data.SampFreq() << " (use --sample-frequency "
+                << "option).  Utterance is " << utt;
+
+    SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
+    Mfcc *mfcc = GetMfcc();
+    bool ok = true;
+    try {
+      mfcc->Compute(waveform, vtln_warp_local, features, NULL);
+    } catch (...) {
+      KALDI_WARN << "Failed to compute features for utterance "
+                 << utt;
+      ok = false;
+    }
+    ReleaseMfcc(mfcc);
+    if (!ok) return false;
+    if (subtract_mean_) {
+      Vector<BaseFloat> mean(features->NumCols());
+      mean.AddRowSumMat(1.0, *features);
+      mean.Scale(1.0 / features->NumRows());
+      for (int32 i = 0; i < features->NumRows(); i++)
+        features->Row(i).AddVec(-1.0, mean);
+    }
+    return true;
+  }
+
+  virtual void Output(const std::string &utt,
+                      const Matrix<BaseFloat> &features) {
+    if (kaldi_writer_ != NULL) {
+      kaldi_writer_->Write(utt, features);
+    } else {
+      std::pair<Matrix<BaseFloat>, HtkHeader> p;
+      p.first.Resize(features.NumRows(), features.NumCols());
+      p.first.CopyFromMat(features);
+      HtkHeader header = {
+        features.NumRows(),
+        100000,  // 10ms shift
+        static_cast<int16>(sizeof(float)*(features.NumCols())),
+        static_cast<uint16>( 006 | // MFCC
+        (mfcc_opts_.use_energy ? 0100 : 020000)) // energy; otherwise c0
+      };
+      p.second = header;
+      htk_writer_->Write(utt, p);
+    }
+    num_success_++;
+    num_frames_ += features.NumRows();
+    if (num_success_ % 10 == 0)
+      KALDI_LOG << "Processed " << num_success_ << " utterances";
+    KALDI_VLOG(2) << "Processed features for key " << utt;
+  }
+
+  int32 NumUtts() const { return num_utts_; }
+  int32 NumSuccess() const { return num_success_; }
+  int64 NumFrames() const { return num_frames_; }
+
+  ~MfccPipeline() {
+    for (size_t i = 0; i < mfcc_free_.size(); i++)
+      delete mfcc_free_[i];
+  }
+
+ private:
+  // Mfcc::Compute() is not thread-safe, so each thread needs its own Mfcc
+  // object while computing; we keep a list of the ones not in use.
+  Mfcc *GetMfcc() {
+    mutex_.Lock();
+    Mfcc *ans;
+    if (mfcc_free_.empty()) {
+      ans = new Mfcc(mfcc_opts_);
+    } else {
+      ans = mfcc_free_.back();
+      mfcc_free_.pop_back();
+    }
+    mutex_.Unlock();
+    return ans;
+  }
+  void ReleaseMfcc(Mfcc *mfcc) {
+    mutex_.Lock();
+    mfcc_free_.push_back(mfcc);
+    mutex_.Unlock();
+  }
+
+  MfccOptions mfcc_opts_;
+  bool subtract_mean_;
+  BaseFloat vtln_warp_;
+  RandomAccessBaseFloatReaderMapped *vtln_map_reader_;
+  int32 channel_;
+  BaseFloat min_duration_;
+  BaseFloatMatrixWriter *kaldi_writer_;
+  TableWriter<HtkMatrixHolder> *htk_writer_;
+
+  Mutex mutex_;  // protects the members below, and vtln_map_reader_.
+  std::vector<Mfcc*> mfcc_free_;
+  int32 num_utts_;
+
+  int32 num_success_;  // only accessed in Output().
+  int64 num_frames_;  // only accessed in Output().
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -41,6 +207,7 @@ int main(int argc, char *argv[]) {
     BaseFloat min_duration = 0.0;
     // Define defaults for gobal options
     std::string output_format = "kaldi";
+    TaskSequencerConfig sequencer_config;
 
     // Register the MFCC option struct
     mfcc_opts.Register(&po);
@@ -60,6 +227,7 @@ int main(int argc, char *argv[]) {
                 "0 -> left, 1 -> right)");
     po.Register("min-duration", &min_duration, "Minimum duration of segments "
                 "to process (in seconds).");
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -72,8 +240,6 @@ int main(int argc, char *argv[]) {
 
     std::string output_wspecifier = po.GetArg(2);
 
-    Mfcc mfcc(mfcc_opts);
-
     SequentialTableReader<WaveHolder> reader(wav_rspecifier);
     BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
     TableWriter<HtkMatrixHolder> htk_writer;
@@ -96,90 +262,25 @@ int main(int argc, char *argv[]) {
       KALDI_ERR << "Invalid output_format string " << output_format;
     }
 
-    int32 num_utts = 0, num_success = 0;
-    for (; !reader.Done(); reader.Next()) {
-      num_utts++;
-      std::string utt = reader.Key();
-      const WaveData &wave_data = reader.Value();
-      if (wave_data.Duration() < min_duration) {
-        KALDI_WARN << "File: " << utt << " is too short ("
-                   << wave_data.Duration() << " sec): producing no output.";
-        continue;
-      }
-      int32 num_chan = wave_data.Data().NumRows(), this_chan = channel;
-      {  // This block works out the channel (0=left, 1=right...)
-        KALDI_ASSERT(num_chan > 0);  // should have been caught in
-        // reading code if no channels.
-        if (channel == -1) {
-          this_chan = 0;
-          if (num_chan != 1)
-            KALDI_WARN << "Channel not specified but you have data with "
-                       << num_chan  << " channels; defaulting to zero";
-        } else {
-          if (this_chan >= num_chan) {
-            KALDI_WARN << "File with id " << utt << " has "
-                       << num_chan << " channels but you specified channel "
-                       << channel << ", producing no output.";
-            continue;
-          }
-        }
-      }
-      BaseFloat vtln_warp_local;  // Work out VTLN warp factor.
-      if (vtln_map_rspecifier != "") {
-        if (!vtln_map_reader.HasKey(utt)) {
-          KALDI_WARN << "No vtln-map entry for utterance-id (or speaker-id) "
-                     << utt;
-          continue;
-        }
-        vtln_warp_local = vtln_map_reader.Value(utt);
-      } else {
-        vtln_warp_local = vtln_warp;
-      }
-      if (mfcc_opts.frame_opts.samp_freq != wave_data.SampFreq())
-        KALDI_ERR << "Sample frequency mismatch: you specified "
-                  << mfcc_opts.frame_opts.samp_freq << " but data has "
-                  << wave_data.SampFreq() << " (use --sample-frequency "
-                  << "option).  Utterance is " << utt;
-
-      SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
-      Matrix<BaseFloat> features;
-      try {
-        mfcc.Compute(waveform, vtln_warp_local, &features, NULL);
-      } catch (...) {
-        KALDI_WARN << "Failed to compute features for utterance "
-                   << utt;
-        continue;
-      }
-      if (subtract_mean) {
-        Vector<BaseFloat> mean(features.NumCols());
-        mean.AddRowSumMat(1.0, features);
-        mean.Scale(1.0 / features.NumRows());
-        for (int32 i = 0; i < features.NumRows(); i++)
-          features.Row(i).AddVec(-1.0, mean);
-      }
-      if (output_format == "kaldi") {
-        kaldi_writer.Write(utt, features);
-      } else {
-        std::pair<Matrix<BaseFloat>, HtkHeader> p;
-        p.first.Resize(features.NumRows(), features.NumCols());
-        p.first.CopyFromMat(features);
-        HtkHeader header = {
-          features.NumRows(),
-          100000,  // 10ms shift
-          static_cast<int16>(sizeof(float)*(features.NumCols())),
-          static_cast<uint16>( 006 | // MFCC
-          (mfcc_opts.use_energy ? 0100 : 020000)) // energy; otherwise c0
-        };
-        p.second = header;
-        htk_writer.Write(utt, p);
-      }
-      if (num_utts % 10 == 0)
-        KALDI_LOG << "Processed " << num_utts << " utterances";
-      KALDI_VLOG(2) << "Processed features for key " << utt;
-      num_success++;
-    }
+    MfccPipeline pipeline(sequencer_config, mfcc_opts, subtract_mean,
+                          vtln_warp, (vtln_map_rspecifier != "" ?
+                                      &vtln_map_reader : NULL),
+                          channel, min_duration,
+                          (output_format == "kaldi" ? &kaldi_writer : NULL),
+                          (output_format == "htk" ? &htk_writer : NULL));
+    Timer timer;
+    pipeline.Run(&reader);
+    double elapsed = timer.Elapsed();
+    int32 num_utts = pipeline.NumUtts(), num_success = pipeline.NumSuccess();
+    int64 num_frames = pipeline.NumFrames();
     KALDI_LOG << " Done " << num_success << " out of " << num_utts
               << " utterances.";
+    // This is the throughput including reading and writing the tables.
+    KALDI_LOG << "Computed " << num_frames << " frames in " << elapsed
+              << " seconds: " << (num_frames / elapsed) << " frames/sec, or "
+              << (num_frames / elapsed /
+                  std::max<int32>(1, sequencer_config.num_threads))
+              << " frames/sec per thread.";
     return (num_success != 0 ? 0 : 1);
   } catch(const std::exception &e) {
     std::cerr << e.what();
@@ -21,7 +21,40 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "matrix/kaldi-matrix.h"
+#include "thread/kaldi-table-pipeline.h"
 
+namespace kaldi {
+
+typedef KaldiObjectHolder<Matrix<BaseFloat> > MatrixHolder;
+
+// Compresses the features, in parallel if --num-threads > 1.
+class CompressFeatsPipeline: public TablePipeline<MatrixHolder,
+                                                  CompressedMatrix> {
+ public:
+  CompressFeatsPipeline(const TaskSequencerConfig &config,
+                        CompressedMatrixWriter *writer):
+      TablePipeline<MatrixHolder, CompressedMatrix>(config),
+      writer_(writer), num_done_(0) { }
+
+  virtual bool Process(const std::string &key, const Matrix<BaseFloat> &feats,
+                       CompressedMatrix *output) {
+    output->CopyFromMat(feats);
+    return true;
+  }
+
+  virtual void Output(const std::string &key, const CompressedMatrix &output) {
+    writer_->Write(key, output);
+    num_done_++;
+  }
+
+  int32 NumDone() const { return num_done_; }
+
+ private:
+  CompressedMatrixWriter *writer_;
+  int32 num_done_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -41,6 +74,7 @@ int main(int argc, char *argv[]) {
     bool htk_in = false;
     bool sphinx_in = false;
     bool compress = false;
+    TaskSequencerConfig sequencer_config;
     po.Register("htk-in", &htk_in, "Read input as HTK features");
     po.Register("sphinx-in", &sphinx_in, "Read input as Sphinx features");
     po.Register("binary", &binary, "Binary-mode output (not relevant if writing "
@@ -48,6 +82,7 @@ int main(int argc, char *argv[]) {
     po.Register("compress", &compress, "If true, write output in compressed form"
                 "(only currently supported for wxfilename, i.e. archive/script,"
                 "output)");
+    sequencer_config.Register(&po);  // only relevant with --compress=true.
     
     po.Read(argc, argv);
 
@@ -92,9 +127,9 @@ int main(int argc, char *argv[]) {
                                CompressedMatrix(sphinx_reader.Value()));
         } else {
           SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
-          for (; !kaldi_reader.Done(); kaldi_reader.Next(), num_done++)
-            kaldi_writer.Write(kaldi_reader.Key(),
-                               CompressedMatrix(kaldi_reader.Value()));
+          CompressFeatsPipeline pipeline(sequencer_config, &kaldi_writer);
+          pipeline.Run(&kaldi_reader);
+          num_done = pipeline.NumDone();
         }
       }
       KALDI_LOG << "Copied " << num_done << " feature matrices.";
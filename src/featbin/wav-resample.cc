@@ -0,0 +1,180 @@
+// featbin/wav-resample.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/resample.h"
+#include "feat/wave-reader.h"
+#include "base/timer.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-table-pipeline.h"
+
+namespace kaldi {
+
+// Resamples each wave file, in parallel if --num-threads > 1.
+class ResamplePipeline: public TablePipeline<WaveHolder, WaveData> {
+ public:
+  ResamplePipeline(const TaskSequencerConfig &config, int32 new_samp_freq,
+                   BaseFloat lowpass_cutoff, int32 num_zeros,
+                   TableWriter<WaveHolder> *writer):
+      TablePipeline<WaveHolder, WaveData>(config),
+      new_samp_freq_(new_samp_freq), lowpass_cutoff_(lowpass_cutoff),
+      num_zeros_(num_zeros), writer_(writer), num_done_(0),
+      num_clipped_(0), tot_input_duration_(0.0) { }
+
+  virtual bool Process(const std::string &utt, const WaveData &wave_data,
+                       WaveData *output) {
+    int32 samp_freq = static_cast<int32>(wave_data.SampFreq());
+    if (samp_freq != wave_data.SampFreq() || samp_freq <= 0) {
+      KALDI_WARN << "Sampling frequency " << wave_data.SampFreq()
+                 << " of utterance " << utt << " is not a positive integer.";
+      return false;
+    }
+    BaseFloat cutoff = lowpass_cutoff_;
+    if (cutoff <= 0.0)  // the default: a little below the lower Nyquist.
+      cutoff = 0.99 * 0.5 * std::min(samp_freq, new_samp_freq_);
+    if (2.0 * cutoff > std::min(samp_freq, new_samp_freq_)) {
+      KALDI_WARN << "--lowpass-cutoff=" << cutoff << " is too high for "
+                 << "resampling utterance " << utt << " from " << samp_freq
+                 << " to " << new_samp_freq_ << " Hz.";
+      return false;
+    }
+    // The filter weights are cached, so it is cheap to construct this for
+    // each utterance.
+    LinearResample resampler(samp_freq, new_samp_freq_, cutoff, num_zeros_);
+    const Matrix<BaseFloat> &data = wave_data.Data();
+    int32 num_chan = data.NumRows(),
+        num_samp_out = resampler.NumOutputSamples(data.NumCols(), true);
+    if (num_samp_out == 0) {
+      KALDI_WARN << "Utterance " << utt << " is too short to resample.";
+      return false;
+    }
+    Matrix<BaseFloat> new_data(num_chan, num_samp_out, kUndefined);
+    int32 num_clipped = 0;
+    for (int32 c = 0; c < num_chan; c++) {
+      SubVector<BaseFloat> new_row(new_data, c);
+      resampler.Resample(data.Row(c), true, &new_row);
+      // The filter can overshoot, so limit the samples to the 16-bit range
+      // that WaveData::Write() requires.
+      BaseFloat *row_data = new_row.Data();
+      for (int32 i = 0; i < num_samp_out; i++) {
+        if (row_data[i] > 32767.0) {
+          row_data[i] = 32767.0;
+          num_clipped++;
+        } else if (row_data[i] < -32768.0) {
+          row_data[i] = -32768.0;
+          num_clipped++;
+        }
+      }
+    }
+    if (num_clipped > 0)
+      KALDI_WARN << "Clipped " << num_clipped << " samples of utterance "
+                 << utt;
+    output->SwapData(new_samp_freq_, &new_data);
+    mutex_.Lock();
+    num_clipped_ += num_clipped;
+    tot_input_duration_ += wave_data.Duration();
+    mutex_.Unlock();
+    return true;
+  }
+
+  virtual void Output(const std::string &utt, const WaveData &output) {
+    writer_->Write(utt, output);
+    num_done_++;
+  }
+
+  int32 NumDone() const { return num_done_; }
+  int64 NumClipped() const { return num_clipped_; }
+  double TotInputDuration() const { return tot_input_duration_; }
+
+ private:
+  int32 new_samp_freq_;
+  BaseFloat lowpass_cutoff_;
+  int32 num_zeros_;
+  TableWriter<WaveHolder> *writer_;
+
+  int32 num_done_;  // only accessed in Output().
+
+  Mutex mutex_;  // protects the members below.
+  int64 num_clipped_;
+  double tot_input_duration_;
+};
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    const char *usage =
+        "Resample wave files to a new sampling frequency.  All channels are\n"
+        "resampled.\n"
+        "\n"
+        "Usage:  wav-resample [options...] <wav-rspecifier> <wav-wspecifier>\n"
+        "e.g. wav-resample --new-sample-frequency=8000 scp:wav.scp ark:-\n"
+        "See also: wav-copy\n";
+
+    ParseOptions po(usage);
+    int32 new_samp_freq = 0, num_zeros = 10;
+    BaseFloat lowpass_cutoff = -1.0;
+    TaskSequencerConfig sequencer_config;
+
+    po.Register("new-sample-frequency", &new_samp_freq, "Sampling frequency "
+                "(in Hz) of the output (required).");
+    po.Register("lowpass-cutoff", &lowpass_cutoff, "Cutoff frequency (in Hz) "
+                "of the anti-aliasing filter; must be at most half of the "
+                "lower of the sampling frequencies.  If <= 0, 99% of that is "
+                "used.");
+    po.Register("num-zeros", &num_zeros, "Number of zeros of the sinc "
+                "function on each side of the filter; larger is sharper but "
+                "slower.");
+    sequencer_config.Register(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+    if (new_samp_freq <= 0)
+      KALDI_ERR << "You must specify --new-sample-frequency";
+    if (num_zeros <= 0)
+      KALDI_ERR << "Invalid --num-zeros=" << num_zeros;
+
+    std::string wav_rspecifier = po.GetArg(1),
+        wav_wspecifier = po.GetArg(2);
+
+    SequentialTableReader<WaveHolder> wav_reader(wav_rspecifier);
+    TableWriter<WaveHolder> wav_writer(wav_wspecifier);
+
+    ResamplePipeline pipeline(sequencer_config, new_samp_freq, lowpass_cutoff,
+                              num_zeros, &wav_writer);
+    Timer timer;
+    pipeline.Run(&wav_reader);
+    double elapsed = timer.Elapsed();
+
+    KALDI_LOG << "Resampled " << pipeline.NumDone() << " wave files ("
+              << pipeline.TotInputDuration() << " seconds of audio) in "
+              << elapsed << " seconds; clipped " << pipeline.NumClipped()
+              << " samples.";
+    return (pipeline.NumDone() != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
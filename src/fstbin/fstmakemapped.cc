@@ -0,0 +1,73 @@
+// fstbin/fstmakemapped.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/kaldi-io.h"
+#include "util/parse-options.h"
+#include "fst/fstlib.h"
+#include "fstext/fstext-utils.h"
+#include "fstext/mapped-fst.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+    using kaldi::int32;
+
+    const char *usage =
+        "Converts an FST (e.g. a decoding graph HCLG.fst) to the memory-mappable\n"
+        "format of class MappedFst.  Decoding programs that read their graph\n"
+        "with ReadFstKaldiGeneric() (e.g. gmm-latgen-faster, nnet-latgen-faster,\n"
+        "online2-wav-nnet2-latgen-faster) can then memory-map it instead of\n"
+        "reading it, which makes startup almost instant and lets processes on the\n"
+        "same machine share one copy of the graph.  The output should be an\n"
+        "ordinary file for this to work, and it is only readable on machines with\n"
+        "the same byte order.\n"
+        "\n"
+        "Usage:  fstmakemapped [in.fst [out.fst] ]\n"
+        " e.g.: fstmakemapped exp/tri3/graph/HCLG.fst exp/tri3/graph/HCLG.mapped.fst\n";
+
+    ParseOptions po(usage);
+    po.Read(argc, argv);
+
+    if (po.NumArgs() > 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string fst_in_filename = po.GetOptArg(1),
+        fst_out_filename = po.GetOptArg(2);
+
+    if (fst_out_filename == "") fst_out_filename = "-";
+
+    VectorFst<StdArc> *fst = ReadFstKaldi(fst_in_filename);
+
+    bool binary = true, write_header = false;
+    Output ko(fst_out_filename, binary, write_header);
+    MappedFst::Write(*fst, ko.Stream());
+    KALDI_LOG << "Wrote FST with " << fst->NumStates() << " states in mapped "
+              << "format to " << PrintableWxfilename(fst_out_filename);
+    delete fst;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
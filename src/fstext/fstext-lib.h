@@ -32,4 +32,6 @@
 #include "lattice-utils.h"
 #include "determinize-lattice.h"
 #include "deterministic-fst.h"
+#include "mapped-fst.h"
+#include "lookahead-compose-fst.h"
 #endif
@@ -0,0 +1,303 @@
+// fstext/lookahead-compose-fst-inl.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_LOOKAHEAD_COMPOSE_FST_INL_H_
+#define KALDI_FSTEXT_LOOKAHEAD_COMPOSE_FST_INL_H_
+
+// Do not include this file directly.  It is included by
+// lookahead-compose-fst.h
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+namespace fst {
+
+template<class Arc>
+LookaheadComposeFst<Arc>::Impl::Impl(const Fst<Arc> &fst1,
+                                     DeterministicOnDemandFst<Arc> *fst2,
+                                     const LookaheadComposeOptions &opts):
+    fst1_(fst1), fst2_(fst2), opts_(opts), num_cached_arcs_(0),
+    start_state_(kNoStateId), start_potential_(0.0) {
+  if (opts_.lookahead) ComputePotentials();
+}
+
+template<class Arc>
+LookaheadComposeFst<Arc>::Impl::~Impl() {
+  for (size_t i = 0; i < cache_.size(); i++)
+    delete cache_[i];
+}
+
+template<class Arc>
+typename Arc::StateId LookaheadComposeFst<Arc>::Impl::Start() {
+  if (start_state_ == kNoStateId) {
+    StateId s1 = fst1_.Start(), s2 = fst2_->Start();
+    if (s1 == kNoStateId || s2 == kNoStateId) return kNoStateId;
+    start_state_ = FindState(s1, s2);
+  }
+  return start_state_;
+}
+
+template<class Arc>
+typename Arc::Weight LookaheadComposeFst<Arc>::Impl::Final(StateId s) {
+  KALDI_ASSERT(static_cast<size_t>(s) < state_vec_.size());
+  StateId s1 = state_vec_[s].first, s2 = state_vec_[s].second;
+  Weight final1 = fst1_.Final(s1);
+  if (final1 == Weight::Zero()) return final1;
+  Weight final2 = fst2_->Final(s2);
+  if (final2 == Weight::Zero()) return final2;
+  Weight ans = Times(final1, final2);
+  if (!potentials_.empty())  // correct for the weight we pushed.
+    ans = Times(ans, Weight(start_potential_ - potentials_[s1]));
+  return ans;
+}
+
+template<class Arc>
+inline typename Arc::StateId LookaheadComposeFst<Arc>::Impl::FindState(
+    StateId s1, StateId s2) {
+  std::pair<StateId, StateId> pr(s1, s2);
+  typename MapType::iterator iter = state_map_.find(pr);
+  if (iter != state_map_.end())
+    return iter->second;
+  StateId ans = state_vec_.size();
+  state_map_[pr] = ans;
+  state_vec_.push_back(pr);
+  cache_.push_back(new CacheState());
+  return ans;
+}
+
+template<class Arc>
+void LookaheadComposeFst<Arc>::Impl::Expand(StateId s) {
+  if (num_cached_arcs_ > opts_.cache_size)
+    GarbageCollect();
+  StateId s1 = state_vec_[s].first, s2 = state_vec_[s].second;
+  bool lookahead = !potentials_.empty();
+  float potential = (lookahead ? potentials_[s1] : 0.0);
+  // Note: FindState() may add to cache_, so we can't keep a reference to
+  // cache_[s] until we've finished.
+  std::vector<Arc> arcs;
+  size_t niepsilons = 0, noepsilons = 0;
+  for (ArcIterator<Fst<Arc> > aiter(fst1_, s1); !aiter.Done(); aiter.Next()) {
+    const Arc &arc1 = aiter.Value();
+    Arc arc(arc1.ilabel, arc1.olabel, arc1.weight, kNoStateId);
+    if (arc1.olabel == 0) {
+      arc.nextstate = FindState(arc1.nextstate, s2);
+    } else {
+      Arc arc2;
+      if (!fst2_->GetArc(s2, arc1.olabel, &arc2))
+        continue;  // the word is not allowed here.
+      arc.weight = Times(arc1.weight, arc2.weight);
+      arc.nextstate = FindState(arc1.nextstate, arc2.nextstate);
+    }
+    if (lookahead)
+      arc.weight = Times(arc.weight,
+                         Weight(potentials_[arc1.nextstate] - potential));
+    if (arc.ilabel == 0) niepsilons++;
+    if (arc.olabel == 0) noepsilons++;
+    arcs.push_back(arc);
+  }
+  CacheState *state = cache_[s];
+  state->arcs.swap(arcs);
+  state->niepsilons = niepsilons;
+  state->noepsilons = noepsilons;
+  state->expanded = true;
+  num_cached_arcs_ += state->arcs.size();
+}
+
+template<class Arc>
+void LookaheadComposeFst<Arc>::Impl::GarbageCollect() {
+  for (size_t i = 0; i < cache_.size(); i++) {
+    CacheState *state = cache_[i];
+    if (state->expanded && state->ref_count == 0) {
+      num_cached_arcs_ -= state->arcs.size();
+      std::vector<Arc> empty;
+      state->arcs.swap(empty);
+      state->expanded = false;
+    }
+  }
+  KALDI_VLOG(2) << "LookaheadComposeFst: after garbage collection, "
+                << num_cached_arcs_ << " arcs are cached.";
+}
+
+template<class Arc>
+void LookaheadComposeFst<Arc>::Impl::ComputePotentials() {
+  const float inf = std::numeric_limits<float>::infinity();
+  StateId num_states = CountStates(fst1_), start2 = fst2_->Start();
+  potentials_.clear();
+  potentials_.resize(num_states, inf);
+  if (start2 == kNoStateId) return;
+
+  // lookahead_cost[w] is the cost of word w from the start state of fst2.
+  unordered_map<Label, float> lookahead_cost;
+  // The states that can reach each state via arcs with epsilon output label,
+  // stored as [source-state, dest-state] pairs, sorted by dest-state.
+  std::vector<std::pair<StateId, StateId> > eps_arcs;
+  for (StateId s = 0; s < num_states; s++) {
+    float &p = potentials_[s];
+    if (fst1_.Final(s) != Weight::Zero()) p = 0.0;
+    for (ArcIterator<Fst<Arc> > aiter(fst1_, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.olabel == 0) {
+        eps_arcs.push_back(std::make_pair(arc.nextstate, s));
+      } else {
+        typename unordered_map<Label, float>::iterator iter =
+            lookahead_cost.find(arc.olabel);
+        float cost;
+        if (iter != lookahead_cost.end()) {
+          cost = iter->second;
+        } else {
+          Arc arc2;
+          cost = (fst2_->GetArc(start2, arc.olabel, &arc2) ?
+                  arc2.weight.Value() : inf);
+          lookahead_cost[arc.olabel] = cost;
+        }
+        if (cost < p) p = cost;
+      }
+    }
+  }
+  std::sort(eps_arcs.begin(), eps_arcs.end());
+
+  // Now propagate the potentials backward along the epsilon-output arcs; this
+  // is a shortest-path problem with zero-cost edges, which we solve with
+  // Dijkstra's algorithm.
+  typedef std::pair<float, StateId> QueueElem;
+  std::priority_queue<QueueElem, std::vector<QueueElem>,
+                      std::greater<QueueElem> > queue;
+  for (StateId s = 0; s < num_states; s++)
+    if (potentials_[s] != inf)
+      queue.push(QueueElem(potentials_[s], s));
+  while (!queue.empty()) {
+    QueueElem elem = queue.top();
+    queue.pop();
+    StateId s = elem.second;
+    if (elem.first != potentials_[s]) continue;  // stale.
+    typename std::vector<std::pair<StateId, StateId> >::iterator iter =
+        std::lower_bound(eps_arcs.begin(), eps_arcs.end(),
+                         std::make_pair(s, static_cast<StateId>(0)));
+    for (; iter != eps_arcs.end() && iter->first == s; ++iter) {
+      StateId prev_s = iter->second;
+      if (elem.first < potentials_[prev_s]) {
+        potentials_[prev_s] = elem.first;
+        queue.push(QueueElem(elem.first, prev_s));
+      }
+    }
+  }
+  // States that can't reach any word or final-state are dead anyway; any
+  // finite potential will do for them.
+  for (StateId s = 0; s < num_states; s++)
+    if (potentials_[s] == inf) potentials_[s] = 0.0;
+  if (fst1_.Start() != kNoStateId)
+    start_potential_ = potentials_[fst1_.Start()];
+  KALDI_VLOG(1) << "LookaheadComposeFst: computed potentials for "
+                << num_states << " states, " << lookahead_cost.size()
+                << " words.";
+}
+
+
+template<class Arc>
+class LookaheadComposeFst<Arc>::StateIterator:
+      public StateIteratorBase<Arc> {
+ public:
+  explicit StateIterator(Impl *impl): impl_(impl), s_(0), num_visited_(0) {
+    impl_->Start();
+  }
+
+  bool Done() const {
+    // Expand states until we find a new one or run out; states are numbered
+    // in the order they were discovered.
+    while (static_cast<size_t>(s_) >= impl_->state_vec_.size() &&
+           static_cast<size_t>(num_visited_) < impl_->state_vec_.size()) {
+      impl_->GetState(num_visited_);
+      num_visited_++;
+    }
+    return (static_cast<size_t>(s_) >= impl_->state_vec_.size());
+  }
+
+  StateId Value() const { return s_; }
+
+  void Next() { s_++; }
+
+  void Reset() { s_ = 0; }
+
+ private:
+  virtual bool Done_() const { return Done(); }
+  virtual StateId Value_() const { return Value(); }
+  virtual void Next_() { Next(); }
+  virtual void Reset_() { Reset(); }
+
+  Impl *impl_;
+  StateId s_;
+  mutable StateId num_visited_;  // states < num_visited_ have been expanded.
+};
+
+
+template<class Arc>
+LookaheadComposeFst<Arc>::LookaheadComposeFst(
+    const Fst<Arc> &fst1, DeterministicOnDemandFst<Arc> *fst2,
+    const LookaheadComposeOptions &opts):
+    impl_(new Impl(fst1, fst2, opts)) { }
+
+template<class Arc>
+LookaheadComposeFst<Arc>::LookaheadComposeFst(
+    const LookaheadComposeFst<Arc> &other): Fst<Arc>(), impl_(other.impl_) {
+  impl_->ref_count_.Incr();
+}
+
+template<class Arc>
+LookaheadComposeFst<Arc>::~LookaheadComposeFst() {
+  if (!impl_->ref_count_.Decr())
+    delete impl_;
+}
+
+template<class Arc>
+const string &LookaheadComposeFst<Arc>::Type() const {
+  static const string type = "lookahead-compose";
+  return type;
+}
+
+template<class Arc>
+LookaheadComposeFst<Arc> *LookaheadComposeFst<Arc>::Copy(bool safe) const {
+  if (safe)
+    KALDI_ERR << "LookaheadComposeFst does not support thread-safe copying.";
+  return new LookaheadComposeFst<Arc>(*this);
+}
+
+template<class Arc>
+void LookaheadComposeFst<Arc>::InitStateIterator(
+    StateIteratorData<Arc> *data) const {
+  data->base = new StateIterator(impl_);
+}
+
+template<class Arc>
+void LookaheadComposeFst<Arc>::InitArcIterator(
+    StateId s, ArcIteratorData<Arc> *data) const {
+  CacheState *state = impl_->GetState(s);
+  data->base = NULL;
+  data->arcs = (state->arcs.empty() ? NULL : &(state->arcs[0]));
+  data->narcs = state->arcs.size();
+  // The ArcIterator decrements this when it is destroyed; while it is
+  // nonzero, GarbageCollect() won't free the arcs.
+  data->ref_count = &(state->ref_count);
+  state->ref_count++;
+}
+
+}  // namespace fst
+
+#endif  // KALDI_FSTEXT_LOOKAHEAD_COMPOSE_FST_INL_H_
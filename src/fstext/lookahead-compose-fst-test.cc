@@ -0,0 +1,103 @@
+// fstext/lookahead-compose-fst-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "fstext/lookahead-compose-fst.h"
+#include "fstext/rand-fst.h"
+#include "fstext/fstext-utils.h"
+#include "base/kaldi-math.h"
+
+namespace fst
+{
+
+// Creates a random deterministic, epsilon-free acceptor over the labels
+// 1 .. num_syms - 1, that looks a bit like a language model.
+static VectorFst<StdArc> *RandDeterministicAcceptor(int32 num_syms) {
+  VectorFst<StdArc> *fst = new VectorFst<StdArc>();
+  int32 num_states = 1 + kaldi::Rand() % 5;
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    if (kaldi::Rand() % 2 == 0)
+      fst->SetFinal(s, kaldi::RandUniform());
+    for (int32 label = 1; label < num_syms; label++) {
+      if (kaldi::Rand() % 4 == 0) continue;  // leave some words out.
+      fst->AddArc(s, StdArc(label, label, 2.0 * kaldi::RandUniform(),
+                            kaldi::Rand() % num_states));
+    }
+  }
+  return fst;
+}
+
+static void TestLookaheadComposeFst() {
+  RandFstOptions rand_opts;
+  rand_opts.allow_empty = false;
+  VectorFst<StdArc> *fst1 = RandFst<StdArc>(rand_opts),
+      *fst2 = RandDeterministicAcceptor(rand_opts.n_syms);
+  ArcSort(fst2, ILabelCompare<StdArc>());
+
+  VectorFst<StdArc> composed;
+  Compose(*fst1, *fst2, &composed);
+
+  BackoffDeterministicOnDemandFst<StdArc> dfst2(*fst2);
+  for (int32 lookahead = 0; lookahead < 2; lookahead++) {
+    LookaheadComposeOptions opts;
+    opts.lookahead = (lookahead != 0);
+    if (kaldi::Rand() % 2 == 0)
+      opts.cache_size = kaldi::Rand() % 10;  // exercise garbage collection.
+    LookaheadComposeFst<StdArc> lookahead_fst(*fst1, &dfst2, opts);
+    KALDI_ASSERT(lookahead_fst.Type() == "lookahead-compose");
+    {
+      // Iterate over some arcs before expanding everything, with a copy.
+      LookaheadComposeFst<StdArc> lookahead_fst2(lookahead_fst);
+      StdArc::StateId s = lookahead_fst2.Start();
+      if (s != kNoStateId) {
+        ArcIterator<Fst<StdArc> > aiter(lookahead_fst2, s);
+        size_t num_arcs = 0;
+        for (; !aiter.Done(); aiter.Next())
+          num_arcs++;
+        KALDI_ASSERT(num_arcs == lookahead_fst2.NumArcs(s));
+      }
+    }
+    VectorFst<StdArc> composed2(lookahead_fst);
+    KALDI_ASSERT(composed2.NumStates() == lookahead_fst.NumStatesCreated());
+    KALDI_ASSERT(RandEquivalent(composed, composed2, 5/*paths*/,
+                                0.01/*delta*/, kaldi::Rand()/*seed*/,
+                                100/*path length*/));
+    // The shortest path through the composition should have the same cost
+    // whether or not we did lookahead.
+    VectorFst<StdArc> best_path1, best_path2;
+    ShortestPath(composed, &best_path1);
+    ShortestPath(composed2, &best_path2);
+    KALDI_ASSERT(ApproxEqual(ShortestDistance(best_path1),
+                             ShortestDistance(best_path2)));
+  }
+  delete fst1;
+  delete fst2;
+}
+
+} // namespace fst
+
+int main() {
+  for (int i = 0; i < 20; i++) {
+    fst::TestLookaheadComposeFst();
+  }
+  std::cout << "Test OK\n";
+}
@@ -0,0 +1,222 @@
+// fstext/lookahead-compose-fst.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_LOOKAHEAD_COMPOSE_FST_H_
+#define KALDI_FSTEXT_LOOKAHEAD_COMPOSE_FST_H_
+
+#include <utility>
+#include <vector>
+#include <fst/fstlib.h>
+#include <fst/fst-decl.h>
+#include "base/kaldi-common.h"
+#include "util/stl-utils.h"
+#include "fstext/deterministic-fst.h"
+
+namespace fst {
+
+/// \addtogroup deterministic_fst_group
+/// @{
+
+struct LookaheadComposeOptions {
+  /// If true, push an estimate of the language-model cost of the next word
+  /// back through the word-internal arcs of fst1 (see below).
+  bool lookahead;
+  /// When more than this many arcs of the composed FST are cached, we free the
+  /// cached arcs of all states that are not currently being iterated over.
+  size_t cache_size;
+  LookaheadComposeOptions(): lookahead(true), cache_size(20000000) { }
+};
+
+/**
+   LookaheadComposeFst is the composition of an ordinary FST fst1 (typically
+   HCL, i.e. a decoding graph without the grammar) with a
+   DeterministicOnDemandFst fst2 (typically the grammar G, e.g. a
+   BackoffDeterministicOnDemandFst wrapping G.fst, or a
+   ConstArpaLmDeterministicFst), computed on demand as the decoder visits its
+   states.  It is a normal Fst<Arc>, so it can be given to LatticeFasterDecoder
+   (or any other decoder) in place of a static HCLG; the LM can then be
+   changed without rebuilding the graph, and we never build the whole HCLG.
+
+   The output labels of fst1 are the input labels of fst2: they must be words,
+   with no disambiguation symbols (remove them with fstrmsymbols
+   --remove-from-output=true).  The composed state for a pair (s1, s2) has an
+   arc for each arc of s1: if its olabel is epsilon we just move in fst1; if
+   not, we take fst2's arc for that word and add its weight (if fst2 has no
+   arc for the word, the arc is dropped).
+
+   Lookahead: in a composition like this, the LM cost of a word only appears on
+   the arc where its output label is, which in HCL is usually near the end of
+   the word, so partial words compete in the beam without their LM cost, and
+   pruning is much worse than with a static HCLG whose weights have been
+   pushed.  If opts.lookahead is true, we compute, for each state s1 of fst1, a
+   potential p(s1), which is the lowest "lookahead cost" h(w) of any word w
+   whose output label can be reached from s1 via arcs with epsilon output
+   labels, where h(w) is the cost of w from the start state of fst2.  We add
+   p(n1) - p(s1) to each arc from s1 to n1, and correct for it in the
+   final-probs, so the cost of every complete path is exactly the same as in
+   the un-pushed composition (and the same as in HCLG = HCL o G), but
+   hypotheses carry an estimate of the LM cost of the word they are in.
+
+   The composed states and their arcs are cached; the cache of arcs is limited
+   to opts.cache_size arcs, but the mapping from state pairs to state-ids
+   grows with the number of distinct pairs visited.  This class is not
+   thread-safe: use one object per decoding thread (Copy() shares the cache).
+*/
+template<class Arc>
+class LookaheadComposeFst: public Fst<Arc> {
+ public:
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  typedef typename Arc::Label Label;
+
+  /// We don't take ownership of fst1 or fst2.  fst1 must be an expanded FST
+  /// (e.g. VectorFst, ConstFst or MappedFst); the constructor takes time
+  /// linear in its size if opts.lookahead is true.
+  LookaheadComposeFst(const Fst<Arc> &fst1,
+                      DeterministicOnDemandFst<Arc> *fst2,
+                      const LookaheadComposeOptions &opts =
+                      LookaheadComposeOptions());
+
+  /// Copy constructor; shares the cache with "other".
+  LookaheadComposeFst(const LookaheadComposeFst<Arc> &other);
+
+  virtual StateId Start() const { return impl_->Start(); }
+
+  virtual Weight Final(StateId s) const { return impl_->Final(s); }
+
+  virtual size_t NumArcs(StateId s) const {
+    return impl_->GetState(s)->arcs.size();
+  }
+
+  virtual size_t NumInputEpsilons(StateId s) const {
+    return impl_->GetState(s)->niepsilons;
+  }
+
+  virtual size_t NumOutputEpsilons(StateId s) const {
+    return impl_->GetState(s)->noepsilons;
+  }
+
+  /// We don't know any properties, and we won't test them as that would
+  /// involve expanding the whole FST.
+  virtual uint64 Properties(uint64 mask, bool test) const { return 0; }
+
+  virtual const string &Type() const;
+
+  /// Only non-thread-safe copies (safe == false) are supported; the copy
+  /// shares the cache with this object.
+  virtual LookaheadComposeFst<Arc> *Copy(bool safe = false) const;
+
+  virtual const SymbolTable *InputSymbols() const {
+    return impl_->fst1_.InputSymbols();
+  }
+
+  virtual const SymbolTable *OutputSymbols() const {
+    return impl_->fst1_.OutputSymbols();
+  }
+
+  /// Note: iterating over the states expands the whole FST.
+  virtual void InitStateIterator(StateIteratorData<Arc> *data) const;
+
+  virtual void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) const;
+
+  /// Returns the number of states of the composed FST created so far.
+  StateId NumStatesCreated() const { return impl_->state_vec_.size(); }
+
+  /// Returns the number of arcs currently cached.
+  size_t NumCachedArcs() const { return impl_->num_cached_arcs_; }
+
+  virtual ~LookaheadComposeFst();
+
+ private:
+  struct CacheState {
+    std::vector<Arc> arcs;
+    bool expanded;
+    int ref_count;  // number of arc iterators using "arcs".
+    size_t niepsilons;
+    size_t noepsilons;
+    CacheState(): expanded(false), ref_count(0), niepsilons(0),
+                  noepsilons(0) { }
+  };
+
+  class Impl {
+   public:
+    Impl(const Fst<Arc> &fst1, DeterministicOnDemandFst<Arc> *fst2,
+         const LookaheadComposeOptions &opts);
+
+    StateId Start();
+
+    Weight Final(StateId s);
+
+    // Returns the state, expanding it if necessary.
+    inline CacheState *GetState(StateId s) {
+      CacheState *state = cache_[s];
+      if (!state->expanded) Expand(s);
+      return state;
+    }
+
+    ~Impl();
+
+    RefCounter ref_count_;
+    const Fst<Arc> &fst1_;
+    DeterministicOnDemandFst<Arc> *fst2_;
+    LookaheadComposeOptions opts_;
+
+    typedef unordered_map<std::pair<StateId, StateId>, StateId,
+                          kaldi::PairHasher<StateId> > MapType;
+    MapType state_map_;
+    // maps from composed state-id to the pair (s1, s2).
+    std::vector<std::pair<StateId, StateId> > state_vec_;
+    std::vector<CacheState*> cache_;  // indexed by composed state-id.
+    size_t num_cached_arcs_;
+    StateId start_state_;
+
+    // potentials_[s1] is the potential p(s1) described above; empty if
+    // !opts_.lookahead.
+    std::vector<float> potentials_;
+    float start_potential_;
+
+   private:
+    // Returns the composed state-id for the pair (s1, s2), creating it if
+    // necessary.
+    inline StateId FindState(StateId s1, StateId s2);
+
+    void Expand(StateId s);
+
+    // Frees the arcs of all cached states that are not in use.
+    void GarbageCollect();
+
+    void ComputePotentials();
+
+    KALDI_DISALLOW_COPY_AND_ASSIGN(Impl);
+  };
+
+  class StateIterator;
+
+  Impl *impl_;
+
+  void operator = (const LookaheadComposeFst<Arc> &other);  // Disallow.
+};
+
+/// @}
+
+}  // namespace fst
+
+#include "fstext/lookahead-compose-fst-inl.h"
+
+#endif  // KALDI_FSTEXT_LOOKAHEAD_COMPOSE_FST_H_
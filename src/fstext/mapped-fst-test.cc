@@ -0,0 +1,147 @@
+// fstext/mapped-fst-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "fstext/mapped-fst.h"
+#include "fstext/rand-fst.h"
+#include "fstext/fstext-utils.h"
+#include "util/kaldi-io.h"
+#include "base/kaldi-math.h"
+#include <fstream>
+#include <sstream>
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+namespace fst
+{
+
+// Checks that the two FSTs are identical, state by state and arc by arc.
+static void AssertIdentical(const Fst<StdArc> &fst1,
+                            const ExpandedFst<StdArc> &fst2) {
+  typedef StdArc Arc;
+  KALDI_ASSERT(fst1.Start() == fst2.Start());
+  KALDI_ASSERT(CountStates(fst1) == fst2.NumStates());
+  for (StateIterator<Fst<Arc> > siter(fst1); !siter.Done(); siter.Next()) {
+    Arc::StateId s = siter.Value();
+    KALDI_ASSERT(fst1.Final(s) == fst2.Final(s));
+    KALDI_ASSERT(fst1.NumArcs(s) == fst2.NumArcs(s));
+    KALDI_ASSERT(fst1.NumInputEpsilons(s) == fst2.NumInputEpsilons(s));
+    KALDI_ASSERT(fst1.NumOutputEpsilons(s) == fst2.NumOutputEpsilons(s));
+    ArcIterator<Fst<Arc> > aiter1(fst1, s), aiter2(fst2, s);
+    for (; !aiter1.Done(); aiter1.Next(), aiter2.Next()) {
+      KALDI_ASSERT(!aiter2.Done());
+      const Arc &arc1 = aiter1.Value(), &arc2 = aiter2.Value();
+      KALDI_ASSERT(arc1.ilabel == arc2.ilabel && arc1.olabel == arc2.olabel &&
+                   arc1.nextstate == arc2.nextstate &&
+                   arc1.weight == arc2.weight);
+    }
+    KALDI_ASSERT(aiter2.Done());
+  }
+}
+
+static void TestMappedFst() {
+  VectorFst<StdArc> *fst = RandFst<StdArc>();
+  const char *filename = "tmpf.mapped.fst";
+  {
+    kaldi::Output ko(filename, true, false);
+    MappedFst::Write(*fst, ko.Stream());
+  }
+  {  // Read via ReadFstKaldiGeneric(); this should memory-map the file.
+    Fst<StdArc> *fst2 = ReadFstKaldiGeneric(filename);
+    KALDI_ASSERT(fst2->Type() == "mapped");
+    const MappedFst &mapped_fst = dynamic_cast<const MappedFst&>(*fst2);
+#ifndef _MSC_VER
+    KALDI_ASSERT(mapped_fst.IsMapped());
+#endif
+    AssertIdentical(*fst, mapped_fst);
+    KALDI_ASSERT(RandEquivalent(*fst, *fst2, 5/*paths*/, 0.01/*delta*/,
+                                kaldi::Rand()/*seed*/, 100/*path length*/));
+    Fst<StdArc> *fst3 = fst2->Copy();
+    delete fst2;
+    AssertIdentical(*fst, dynamic_cast<const MappedFst&>(*fst3));
+    // Test that VectorFst can be constructed from it.
+    VectorFst<StdArc> fst4(*fst3);
+    AssertIdentical(*fst, fst4);
+    delete fst3;
+  }
+  {  // Read through a pipe; this will read it into memory.
+    Fst<StdArc> *fst2 = ReadFstKaldiGeneric(std::string("cat ") + filename +
+                                            " |");
+    const MappedFst &mapped_fst = dynamic_cast<const MappedFst&>(*fst2);
+    KALDI_ASSERT(!mapped_fst.IsMapped());
+    AssertIdentical(*fst, mapped_fst);
+    delete fst2;
+  }
+  {  // ReadFstKaldiGeneric() should also read normal FSTs.
+    WriteFstKaldi(*fst, filename);
+    Fst<StdArc> *fst2 = ReadFstKaldiGeneric(filename);
+    KALDI_ASSERT(fst2->Type() == "vector");
+    AssertIdentical(*fst, dynamic_cast<const VectorFst<StdArc>&>(*fst2));
+    delete fst2;
+  }
+  unlink(filename);
+  delete fst;
+}
+
+// Checks that iterating over the arcs of a MappedFst state that points past
+// the end of the arcs fails, rather than reading outside the file.
+static void TestMappedFstCorrupted() {
+  VectorFst<StdArc> fst;
+  fst.AddState();
+  fst.AddState();
+  fst.SetStart(0);
+  fst.AddArc(0, StdArc(1, 1, 0.5, 1));
+  fst.SetFinal(1, 0.0);
+  std::ostringstream os;
+  MappedFst::Write(fst, os);
+  std::string data = os.str();
+  MappedFst::State *states = reinterpret_cast<MappedFst::State*>(
+      &(data[sizeof(MappedFst::Header)]));
+  states[1].pos = 1;
+  states[1].narcs = 1;  // there is only one arc, so this is out of range.
+  const char *filename = "tmpf.mapped.fst";
+  {
+    std::ofstream ofs(filename, std::ios::binary);
+    ofs.write(data.data(), data.size());
+  }
+  // The states are only checked when they are used, so reading succeeds and
+  // state 0 is fine.
+  MappedFst *fst2 = MappedFst::Read(filename);
+  KALDI_ASSERT(ArcIterator<MappedFst>(*fst2, 0).Value().nextstate == 1);
+  bool threw = false;
+  try {
+    ArcIterator<MappedFst> aiter(*fst2, 1);
+  } catch (const std::runtime_error &e) {
+    threw = true;
+  }
+  KALDI_ASSERT(threw);
+  delete fst2;
+  unlink(filename);
+}
+
+} // namespace fst
+
+int main() {
+  for (int i = 0; i < 10; i++) {
+    fst::TestMappedFst();
+  }
+  fst::TestMappedFstCorrupted();
+  std::cout << "Test OK\n";
+}
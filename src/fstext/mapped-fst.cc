@@ -0,0 +1,204 @@
+// fstext/mapped-fst.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <limits>
+#include <fst/test-properties.h>
+#include "fstext/mapped-fst.h"
+#include "util/kaldi-io.h"
+
+namespace fst {
+
+static const char kMagic[8] = { 'K', 'a', 'l', 'd', 'i', 'M', 'F', '\0' };
+static const int32 kVersion = 1;
+static const uint32 kByteOrder = 0x01020304;
+
+size_t MappedFst::ArcsOffset(int64 num_states) {
+  size_t offset = sizeof(Header) + sizeof(State) * num_states;
+  return (offset + 7) / 8 * 8;
+}
+
+void MappedFst::Impl::Init(const std::string &source) {
+  const char *data = file.Data();
+  size_t size = file.Size();
+  if (size < sizeof(Header) || memcmp(data, kMagic, sizeof(kMagic)) != 0)
+    KALDI_ERR << "File " << source << " is not a MappedFst.";
+  header = reinterpret_cast<const Header*>(data);
+  if (header->byte_order != kByteOrder)
+    KALDI_ERR << "MappedFst " << source << " was written on a machine with "
+              << "a different byte order.";
+  if (header->version != kVersion)
+    KALDI_ERR << "MappedFst " << source << " has unsupported version "
+              << header->version;
+  if (header->arc_size != static_cast<int32>(sizeof(Arc)))
+    KALDI_ERR << "MappedFst " << source << " has arcs of size "
+              << header->arc_size << ", expected " << sizeof(Arc);
+  size_t arcs_offset = ArcsOffset(header->num_states),
+      expected_size = arcs_offset + sizeof(Arc) * header->num_arcs;
+  if (header->num_states < 0 || header->num_arcs < 0 || size != expected_size)
+    KALDI_ERR << "MappedFst " << source << " has the wrong size (" << size
+              << " bytes vs. " << expected_size << " expected): truncated?";
+  states = reinterpret_cast<const State*>(data + sizeof(Header));
+  arcs = reinterpret_cast<const Arc*>(data + arcs_offset);
+  // We don't check the states here, as that would touch every page of the
+  // file; InitArcIterator() checks each state's arc range when it is used.
+  if (header->start != kNoStateId &&
+      (header->start < 0 || header->start >= header->num_states))
+    KALDI_ERR << "MappedFst " << source << " is corrupted: start state "
+              << header->start << " out of range.";
+}
+
+void MappedFst::CorruptedState(StateId s) const {
+  const State &state = impl_->states[s];
+  KALDI_ERR << "MappedFst is corrupted: state " << s << " has arcs "
+            << state.pos << " to "
+            << (static_cast<uint64>(state.pos) + state.narcs)
+            << " but there are only " << impl_->header->num_arcs << " arcs.";
+}
+
+MappedFst *MappedFst::Read(const std::string &rxfilename) {
+  Impl *impl = new Impl();
+  try {
+    if (!impl->file.Open(rxfilename))
+      KALDI_ERR << "Error reading MappedFst from "
+                << kaldi::PrintableRxfilename(rxfilename);
+    impl->Init(kaldi::PrintableRxfilename(rxfilename));
+  } catch (...) {
+    delete impl;
+    throw;
+  }
+  return new MappedFst(impl);
+}
+
+MappedFst *MappedFst::Read(std::istream &is, const std::string &source) {
+  Impl *impl = new Impl();
+  try {
+    if (!impl->file.Read(is))
+      KALDI_ERR << "Error reading MappedFst from " << source;
+    impl->Init(source);
+  } catch (...) {
+    delete impl;
+    throw;
+  }
+  return new MappedFst(impl);
+}
+
+bool MappedFst::IsMappedFst(std::istream &is) {
+  return is.peek() == kMagic[0];
+}
+
+MappedFst::~MappedFst() {
+  if (!impl_->ref_count.Decr())
+    delete impl_;
+}
+
+uint64 MappedFst::Properties(uint64 mask, bool test) const {
+  if (test) {
+    uint64 known;
+    return TestProperties(*this, mask, &known) & mask;
+  } else {
+    return impl_->header->properties & mask;
+  }
+}
+
+const string &MappedFst::Type() const {
+  static const string type = "mapped";
+  return type;
+}
+
+void MappedFst::Write(const Fst<StdArc> &fst, std::ostream &os) {
+  Header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrder;
+  header.arc_size = sizeof(Arc);
+  header.start = fst.Start();
+  header.properties = fst.Properties(kCopyProperties, true) | kExpanded;
+  header.num_states = CountStates(fst);
+
+  // First pass: work out the states.  We don't keep the arcs in memory.
+  std::vector<State> states(header.num_states);
+  uint64 num_arcs = 0;
+  for (StateIterator<Fst<Arc> > siter(fst); !siter.Done(); siter.Next()) {
+    StateId s = siter.Value();
+    if (s < 0 || s >= header.num_states)
+      KALDI_ERR << "MappedFst::Write: states of FST are not numbered "
+                << "consecutively from zero.";
+    State &state = states[s];
+    state.final = fst.Final(s).Value();
+    state.pos = num_arcs;
+    state.narcs = state.niepsilons = state.noepsilons = 0;
+    for (ArcIterator<Fst<Arc> > aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      state.narcs++;
+      if (arc.ilabel == 0) state.niepsilons++;
+      if (arc.olabel == 0) state.noepsilons++;
+    }
+    num_arcs += state.narcs;
+    if (num_arcs > std::numeric_limits<uint32>::max())
+      KALDI_ERR << "MappedFst::Write: FST has too many arcs.";
+  }
+  header.num_arcs = num_arcs;
+
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!states.empty())
+    os.write(reinterpret_cast<const char*>(&(states[0])),
+             sizeof(State) * states.size());
+  size_t padding = ArcsOffset(header.num_states) -
+      (sizeof(Header) + sizeof(State) * header.num_states);
+  for (size_t i = 0; i < padding; i++)
+    os.put('\0');
+  // Second pass: write the arcs, in state order.
+  for (StateId s = 0; s < header.num_states; s++) {
+    for (ArcIterator<Fst<Arc> > aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      os.write(reinterpret_cast<const char*>(&arc), sizeof(Arc));
+    }
+  }
+  if (!os.good())
+    KALDI_ERR << "MappedFst::Write: error writing FST.";
+}
+
+
+Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename) {
+  if (rxfilename == "") rxfilename = "-"; // interpret "" as stdin,
+  // for compatibility with OpenFst conventions.
+  kaldi::Input ki(rxfilename);
+  if (MappedFst::IsMappedFst(ki.Stream())) {
+    if (kaldi::ClassifyRxfilename(rxfilename) == kaldi::kFileInput) {
+      ki.Close();
+      return MappedFst::Read(rxfilename);  // memory-maps it.
+    } else {
+      return MappedFst::Read(ki.Stream(),
+                             kaldi::PrintableRxfilename(rxfilename));
+    }
+  }
+  fst::FstHeader hdr;
+  if (!hdr.Read(ki.Stream(), rxfilename))
+    KALDI_ERR << "Reading FST: error reading FST header from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  FstReadOptions ropts("<unspecified>", &hdr);
+  VectorFst<StdArc> *fst = VectorFst<StdArc>::Read(ki.Stream(), ropts);
+  if (!fst)
+    KALDI_ERR << "Could not read fst from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  return fst;
+}
+
+}  // end namespace fst
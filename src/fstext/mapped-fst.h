@@ -0,0 +1,192 @@
+// fstext/mapped-fst.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_MAPPED_FST_H_
+#define KALDI_FSTEXT_MAPPED_FST_H_
+
+#include <string>
+#include <fst/fstlib.h>
+#include <fst/fst-decl.h>
+#include "base/kaldi-common.h"
+#include "util/kaldi-mapped-file.h"
+
+namespace fst {
+
+/**
+   MappedFst is a read-only FST (like ConstFst) whose on-disk format is the
+   same as its in-memory format, so it can be used directly from a
+   memory-mapped file without being deserialized.  It is intended for large
+   decoding graphs (HCLG): loading one takes almost no time however big it is,
+   only the parts of the graph the decoder visits are ever read from disk, and
+   all the processes on a machine that decode with the same graph share one
+   copy of it in the page cache instead of each having a private copy on the
+   heap.
+
+   Create the file with fstmakemapped (or MappedFst::Write()), and read it
+   with ReadFstKaldiGeneric(), which also accepts ordinary FSTs, so decoding
+   programs that use it work with either format.  If the file is not an
+   ordinary file (e.g. it is a pipe), it is read into memory instead.
+
+   The format is: a header (see MappedFst::Header), an array of
+   MappedFst::State, padding to a multiple of 8 bytes, and an array of StdArc;
+   the arcs of each state are contiguous.  It is written in the native byte
+   order and is not portable between machines with different byte orders.
+   Symbol tables are not stored.
+*/
+class MappedFst : public ExpandedFst<StdArc> {
+ public:
+  typedef StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+
+  /// Reads a MappedFst from "rxfilename", memory-mapping it if it is an
+  /// ordinary file.  Throws on error.
+  static MappedFst *Read(const std::string &rxfilename);
+
+  /// Reads a MappedFst from the stream into memory; "source" is only used
+  /// in error messages.  Throws on error.
+  static MappedFst *Read(std::istream &is, const std::string &source);
+
+  /// Writes "fst" to the stream in the format MappedFst reads.  The states of
+  /// "fst" must be numbered 0, 1, ... NumStates() - 1 (as for VectorFst).
+  /// Throws on error.
+  static void Write(const Fst<StdArc> &fst, std::ostream &os);
+
+  /// Returns true if the next character in the stream is the first character
+  /// of a MappedFst file (OpenFst's binary FSTs start with a different one).
+  static bool IsMappedFst(std::istream &is);
+
+  /// Returns true if the data is memory-mapped rather than read into memory.
+  bool IsMapped() const { return impl_->file.IsMapped(); }
+
+  virtual StateId Start() const { return impl_->header->start; }
+
+  virtual Weight Final(StateId s) const {
+    return Weight(impl_->states[s].final);
+  }
+
+  virtual StateId NumStates() const { return impl_->header->num_states; }
+
+  virtual size_t NumArcs(StateId s) const {
+    return impl_->states[s].narcs;
+  }
+
+  virtual size_t NumInputEpsilons(StateId s) const {
+    return impl_->states[s].niepsilons;
+  }
+
+  virtual size_t NumOutputEpsilons(StateId s) const {
+    return impl_->states[s].noepsilons;
+  }
+
+  virtual uint64 Properties(uint64 mask, bool test) const;
+
+  virtual const string &Type() const;
+
+  virtual MappedFst *Copy(bool safe = false) const {
+    return new MappedFst(*this);
+  }
+
+  virtual const SymbolTable *InputSymbols() const { return NULL; }
+
+  virtual const SymbolTable *OutputSymbols() const { return NULL; }
+
+  virtual void InitStateIterator(StateIteratorData<Arc> *data) const {
+    data->base = NULL;
+    data->nstates = impl_->header->num_states;
+  }
+
+  virtual void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) const {
+    const State &state = impl_->states[s];
+    // Make sure a corrupted file cannot make us access arcs outside the file.
+    if (static_cast<uint64>(state.pos) + state.narcs >
+        static_cast<uint64>(impl_->header->num_arcs))
+      CorruptedState(s);
+    data->base = NULL;
+    data->arcs = impl_->arcs + state.pos;
+    data->narcs = state.narcs;
+    data->ref_count = NULL;
+  }
+
+  virtual ~MappedFst();
+
+  // The on-disk header.
+  struct Header {
+    char magic[8];  // kMagic.
+    int32 version;
+    uint32 byte_order;  // kByteOrder, in the native byte order of the writer.
+    int32 arc_size;  // sizeof(StdArc).
+    int32 start;
+    uint64 properties;
+    int64 num_states;
+    int64 num_arcs;
+  };
+
+  // The on-disk (and in-memory) representation of a state, as in ConstFst.
+  struct State {
+    float final;  // final-cost.
+    uint32 pos;  // index of the first arc of this state.
+    uint32 narcs;
+    uint32 niepsilons;
+    uint32 noepsilons;
+  };
+
+ private:
+  struct Impl {
+    kaldi::MappedFile file;
+    const Header *header;
+    const State *states;
+    const Arc *arcs;
+    RefCounter ref_count;
+    Impl(): header(NULL), states(NULL), arcs(NULL) { }
+    // Sets up the pointers from the contents of "file"; "source" is for error
+    // messages.  Throws on error.
+    void Init(const std::string &source);
+  };
+
+  explicit MappedFst(Impl *impl): impl_(impl) { }
+  MappedFst(const MappedFst &other): ExpandedFst<StdArc>(),
+                                     impl_(other.impl_) {
+    impl_->ref_count.Incr();
+  }
+
+  // Called by InitArcIterator() if state "s" has arcs outside the arc array;
+  // throws.
+  void CorruptedState(StateId s) const;
+
+  // Returns the offset of the arcs in the file.
+  static size_t ArcsOffset(int64 num_states);
+
+  Impl *impl_;
+
+  void operator = (const MappedFst &other);  // Disallow.
+};
+
+
+/// Reads an FST for decoding using Kaldi I/O mechanisms (pipes, etc.).  If
+/// the file is in MappedFst format it returns a MappedFst (memory-mapped, if
+/// rxfilename is an ordinary file), otherwise it reads the FST as
+/// ReadFstKaldi() does and returns a VectorFst.  On error, throws using
+/// KALDI_ERR.
+Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename);
+
+
+}  // end namespace fst
+
+#endif  // KALDI_FSTEXT_MAPPED_FST_H_
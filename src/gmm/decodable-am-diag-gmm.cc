@@ -18,6 +18,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <vector>
 using std::vector;
 
@@ -80,5 +81,45 @@ void DecodableAmDiagGmmUnmapped::ResetLogLikeCache() {
   for (; it != end; ++it) { it->hit_time = -1; }
 }
 
+DecodableAmDiagGmmBatched::DecodableAmDiagGmmBatched(
+    const AmDiagGmm &am, const TransitionModel &tm,
+    const Matrix<BaseFloat> &feats, BaseFloat scale, int32 batch_size,
+    BaseFloat log_sum_exp_prune):
+    acoustic_model_(am), trans_model_(tm), feature_matrix_(feats),
+    scale_(scale), batch_size_(batch_size),
+    log_sum_exp_prune_(log_sum_exp_prune), block_start_(-1), block_size_(0),
+    data_squared_(batch_size, feats.NumCols(), kUndefined),
+    log_likes_(am.NumPdfs(), batch_size, kUndefined),
+    pdf_block_(am.NumPdfs(), -1) {
+  KALDI_ASSERT(batch_size > 0);
+  if (am.NumPdfs() != 0 && am.Dim() != feats.NumCols())
+    KALDI_ERR << "Dim mismatch: data dim = "  << feats.NumCols()
+              << " vs. model dim = " << am.Dim();
+}
+
+void DecodableAmDiagGmmBatched::SetBlock(int32 frame) {
+  KALDI_ASSERT(static_cast<size_t>(frame) <
+               static_cast<size_t>(NumFramesReady()));
+  block_start_ = frame;
+  block_size_ = std::min(batch_size_, NumFramesReady() - frame);
+  SubMatrix<BaseFloat> data_sq(data_squared_, 0, block_size_,
+                               0, data_squared_.NumCols());
+  data_sq.CopyFromMat(feature_matrix_.RowRange(frame, block_size_));
+  data_sq.ApplyPow(2.0);
+}
+
+void DecodableAmDiagGmmBatched::ComputeForBlock(int32 pdf_id) {
+  KALDI_ASSERT(static_cast<size_t>(pdf_id) < pdf_block_.size() &&
+               "Likely graph/model mismatch, e.g. using wrong HCLG.fst");
+  const DiagGmm &pdf = acoustic_model_.GetPdf(pdf_id);
+  SubVector<BaseFloat> log_likes(log_likes_.Row(pdf_id), 0, block_size_);
+  pdf.TotalLogLikelihoods(feature_matrix_.RowRange(block_start_, block_size_),
+                          data_squared_.RowRange(0, block_size_),
+                          log_sum_exp_prune_, &log_likes);
+  for (int32 i = 0; i < block_size_; i++)
+    if (KALDI_ISNAN(log_likes(i)) || KALDI_ISINF(log_likes(i)))
+      KALDI_ERR << "Invalid answer (overflow or invalid variances/features?)";
+  pdf_block_[pdf_id] = block_start_;
+}
 
 }  // namespace kaldi
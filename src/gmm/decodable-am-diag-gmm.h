@@ -159,6 +159,85 @@ class DecodableAmDiagGmmScaled: public DecodableAmDiagGmmUnmapped {
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmDiagGmmScaled);
 };
 
+
+/// DecodableAmDiagGmmBatched computes the same (scaled) log-likelihoods as
+/// DecodableAmDiagGmmScaled, but in blocks of "batch_size" frames: a block
+/// starts at the first frame requested that is not in the current block, and
+/// when a pdf is first requested within a block, it is evaluated on all the
+/// frames of the block (from the block's first frame, not the frame it was
+/// requested on), using matrix-matrix operations (see
+/// DiagGmm::TotalLogLikelihoods()); its likelihoods on the other frames of
+/// the block are then looked up.  Since the set of active pdfs changes slowly
+/// from frame to frame, most of these are used, and the BLAS matrix-multiply
+/// is much faster per frame than the matrix-vector products of the
+/// frame-by-frame computation.  Some computation is wasted on pdfs that
+/// become active part of the way through the block or are pruned away before
+/// its end, so don't make the batch size too large; something like 8 or 16
+/// is reasonable.
+class DecodableAmDiagGmmBatched: public DecodableInterface {
+ public:
+  DecodableAmDiagGmmBatched(const AmDiagGmm &am,
+                            const TransitionModel &tm,
+                            const Matrix<BaseFloat> &feats,
+                            BaseFloat scale,
+                            int32 batch_size = 8,
+                            BaseFloat log_sum_exp_prune = -1.0);
+
+  // Note, frames are numbered from zero but transition-ids from one.
+  virtual BaseFloat LogLikelihood(int32 frame, int32 tid) {
+    return scale_ * LogLikelihoodZeroBased(frame,
+                                           trans_model_.TransitionIdToPdf(tid));
+  }
+
+  virtual int32 NumFramesReady() const { return feature_matrix_.NumRows(); }
+
+  // Indices are one-based!  This is for compatibility with OpenFst.
+  virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
+
+  virtual bool IsLastFrame(int32 frame) const {
+    KALDI_ASSERT(frame < NumFramesReady());
+    return (frame == NumFramesReady() - 1);
+  }
+
+  const TransitionModel *TransModel() { return &trans_model_; }
+
+ private:
+  // Returns the unscaled log-likelihood of pdf "pdf_id" on frame "frame".
+  inline BaseFloat LogLikelihoodZeroBased(int32 frame, int32 pdf_id) {
+    int32 offset = frame - block_start_;
+    if (offset < 0 || offset >= block_size_) {
+      SetBlock(frame);
+      offset = 0;
+    }
+    if (pdf_block_[pdf_id] != block_start_)
+      ComputeForBlock(pdf_id);
+    return log_likes_(pdf_id, offset);
+  }
+
+  // Sets the current block to start at frame "frame".
+  void SetBlock(int32 frame);
+
+  // Computes the log-likelihoods of this pdf for the current block.
+  void ComputeForBlock(int32 pdf_id);
+
+  const AmDiagGmm &acoustic_model_;
+  const TransitionModel &trans_model_;
+  const Matrix<BaseFloat> &feature_matrix_;
+  BaseFloat scale_;
+  int32 batch_size_;
+  BaseFloat log_sum_exp_prune_;
+
+  int32 block_start_;  // first frame of the current block.
+  int32 block_size_;  // number of frames in the current block.
+  Matrix<BaseFloat> data_squared_;  // squared features of the current block.
+  // log_likes_(p, i) is the log-likelihood of pdf p on frame
+  // block_start_ + i, if pdf_block_[p] == block_start_.
+  Matrix<BaseFloat> log_likes_;
+  std::vector<int32> pdf_block_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmDiagGmmBatched);
+};
+
 }  // namespace kaldi
 
 #endif  // KALDI_GMM_DECODABLE_AM_DIAG_GMM_H_
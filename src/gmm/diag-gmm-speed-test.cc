@@ -0,0 +1,60 @@
+// gmm/diag-gmm-speed-test.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gmm/diag-gmm.h"
+#include "gmm/model-test-common.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+// Compares the speed of TotalLogLikelihoods() with that of calling
+// LogLikelihood() on each frame.
+void DiagGmmTotalLogLikelihoodsSpeedTest() {
+  int32 dim = 40, num_frames = 100, num_iters = 20;
+  for (int32 num_gauss = 16; num_gauss <= 1024; num_gauss *= 4) {
+    DiagGmm gmm;
+    unittest::InitRandDiagGmm(dim, num_gauss, &gmm);
+    Matrix<BaseFloat> data(num_frames, dim);
+    data.SetRandn();
+    Matrix<BaseFloat> data_sq(data);
+    data_sq.ApplyPow(2.0);
+    Vector<BaseFloat> loglikes(num_frames);
+
+    Timer timer;
+    for (int32 i = 0; i < num_iters; i++)
+      for (int32 t = 0; t < num_frames; t++)
+        loglikes(t) = gmm.LogLikelihood(data.Row(t));
+    double frame_time = timer.Elapsed();
+    timer.Reset();
+    for (int32 i = 0; i < num_iters; i++)
+      gmm.TotalLogLikelihoods(data, data_sq, -1.0, &loglikes);
+    double batch_time = timer.Elapsed();
+    KALDI_LOG << "For " << num_gauss << " Gaussians, dim = " << dim
+              << ", frame-by-frame computation took " << frame_time
+              << "s, batched took " << batch_time << "s; speedup is "
+              << (frame_time / batch_time);
+  }
+}
+
+}  // end namespace kaldi
+
+int main() {
+  kaldi::DiagGmmTotalLogLikelihoodsSpeedTest();
+  std::cout << "Test OK.\n";
+}
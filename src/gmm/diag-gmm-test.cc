@@ -296,6 +296,28 @@ void UnitTestDiagGmm() {
   unlink("tmpfb");
 }
 
+// Tests TotalLogLikelihoods() against LogLikelihood().
+void UnitTestDiagGmmTotalLogLikelihoods() {
+  DiagGmm gmm;
+  InitRandomGmm(&gmm);
+  int32 dim = gmm.Dim(), num_frames = 1 + Rand() % 20;
+  Matrix<BaseFloat> data(num_frames, dim);
+  data.SetRandn();
+  Matrix<BaseFloat> data_sq(data);
+  data_sq.ApplyPow(2.0);
+  Vector<BaseFloat> loglikes(num_frames);
+  gmm.TotalLogLikelihoods(data, data_sq, -1.0, &loglikes);
+  for (int32 t = 0; t < num_frames; t++)
+    AssertEqual(loglikes(t), gmm.LogLikelihood(data.Row(t)), 0.001);
+
+  // With pruning in the LogSumExp, the answer is a little smaller.
+  Vector<BaseFloat> loglikes_pruned(num_frames);
+  gmm.TotalLogLikelihoods(data, data_sq, 5.0, &loglikes_pruned);
+  for (int32 t = 0; t < num_frames; t++)
+    KALDI_ASSERT(loglikes_pruned(t) <= loglikes(t) + 0.001 &&
+                 loglikes_pruned(t) > loglikes(t) - 0.1);
+}
+
 }  // end namespace kaldi
 
 int main() {
@@ -304,6 +326,8 @@ int main() {
     kaldi::UnitTestDiagGmm();
     kaldi::UnitTestDiagGmmGenerate();
   }
+  for (int i = 0; i < 5; i++)
+    kaldi::UnitTestDiagGmmTotalLogLikelihoods();
   std::cout << "Test OK.\n";
 }
 
@@ -561,6 +561,30 @@ void DiagGmm::LogLikelihoods(const MatrixBase<BaseFloat> &data,
   loglikes->AddMatMat(-0.5, data_sq, kNoTrans, inv_vars_, kTrans, 1.0);
 }
 
+void DiagGmm::TotalLogLikelihoods(const MatrixBase<BaseFloat> &data,
+                                  const MatrixBase<BaseFloat> &data_sq,
+                                  BaseFloat log_sum_exp_prune,
+                                  VectorBase<BaseFloat> *loglikes) const {
+  int32 num_frames = data.NumRows();
+  KALDI_ASSERT(data_sq.NumRows() == num_frames &&
+               data_sq.NumCols() == data.NumCols() &&
+               loglikes->Dim() == num_frames);
+  if (data.NumCols() != Dim()) {
+    KALDI_ERR << "DiagGmm::TotalLogLikelihoods, dimension "
+              << "mismatch " << data.NumCols() << " vs. "<< Dim();
+  }
+  if (!valid_gconsts_)
+    KALDI_ERR << "Must call ComputeGconsts() before computing likelihood";
+  Matrix<BaseFloat> comp_loglikes(num_frames, gconsts_.Dim(), kUndefined);
+  comp_loglikes.CopyRowsFromVec(gconsts_);
+  // comp_loglikes +=  data * inv(vars) * means.
+  comp_loglikes.AddMatMat(1.0, data, kNoTrans, means_invvars_, kTrans, 1.0);
+  // comp_loglikes += -0.5 * data_sq * inv(vars).
+  comp_loglikes.AddMatMat(-0.5, data_sq, kNoTrans, inv_vars_, kTrans, 1.0);
+  for (int32 t = 0; t < num_frames; t++)
+    (*loglikes)(t) = comp_loglikes.Row(t).LogSumExp(log_sum_exp_prune);
+}
+
 
 
 void DiagGmm::LogLikelihoodsPreselect(const VectorBase<BaseFloat> &data,
@@ -92,6 +92,18 @@ class DiagGmm {
   void LogLikelihoods(const MatrixBase<BaseFloat> &data,
                       Matrix<BaseFloat> *loglikes) const;
 
+  /// Outputs the total log-likelihood (i.e. the log-sum over the Gaussians)
+  /// of each row of "data" to the corresponding element of "loglikes".
+  /// "data_sq" must contain the elementwise squares of "data"; it is passed
+  /// in so that it can be computed once for a block of frames and reused for
+  /// many GMMs.  This uses matrix-matrix products, so it is much faster than
+  /// calling LogLikelihood() for each row.  "log_sum_exp_prune" is as for
+  /// VectorBase::LogSumExp().
+  void TotalLogLikelihoods(const MatrixBase<BaseFloat> &data,
+                           const MatrixBase<BaseFloat> &data_sq,
+                           BaseFloat log_sum_exp_prune,
+                           VectorBase<BaseFloat> *loglikes) const;
+
   
   /// Outputs the per-component log-likelihoods of a subset of mixture
   /// components.  Note: at output, loglikes->Dim() will equal indices.size().
@@ -77,6 +77,7 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     bool allow_partial = true;
     BaseFloat acoustic_scale = 0.1;
+    int32 batch_size = 0;
     
     std::string word_syms_filename;
     FasterDecoderOptions decoder_opts;
@@ -87,6 +88,9 @@ int main(int argc, char *argv[]) {
                 "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial,
                 "Produce output even when final state was not reached");
+    po.Register("batch-size", &batch_size,
+                "If >0, evaluate each GMM on blocks of this many frames at a "
+                "time, using matrix-matrix operations (faster; e.g. try 8)");
     po.Read(argc, argv);
 
     if (po.NumArgs() < 4 || po.NumArgs() > 6) {
@@ -148,9 +152,15 @@ int main(int argc, char *argv[]) {
         continue;
       }
 
-      DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
-                                             acoustic_scale);
-      decoder.Decode(&gmm_decodable);
+      if (batch_size > 0) {
+        DecodableAmDiagGmmBatched gmm_decodable(am_gmm, trans_model, features,
+                                                acoustic_scale, batch_size);
+        decoder.Decode(&gmm_decodable);
+      } else {
+        DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
+                                               acoustic_scale);
+        decoder.Decode(&gmm_decodable);
+      }
 
       fst::VectorFst<LatticeArc> decoded;  // linear FST.
 
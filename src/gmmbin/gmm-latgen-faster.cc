@@ -106,7 +106,7 @@ int main(int argc, char *argv[]) {
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
-      VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+      fst::Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
       
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
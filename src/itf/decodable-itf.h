@@ -87,6 +87,21 @@ class DecodableInterface {
   /// returns false before calling this.
   virtual BaseFloat LogLikelihood(int32 frame, int32 index) = 0;
 
+  /// Outputs the log-likelihoods for a list of indices on a single frame, to
+  /// "loglikes" (which is resized as needed).  This exists for decoders that
+  /// advance several utterances at once (see
+  /// ../decoder/lattice-faster-batch-decoder.h) and want to amortize the
+  /// per-call overhead; the default implementation just calls LogLikelihood()
+  /// for each index, but subclasses may override it with something faster.
+  virtual void LogLikelihoods(int32 frame,
+                              const std::vector<int32> &indices,
+                              std::vector<BaseFloat> *loglikes) {
+    size_t size = indices.size();
+    loglikes->resize(size);
+    for (size_t i = 0; i < size; i++)
+      (*loglikes)[i] = LogLikelihood(frame, indices[i]);
+  }
+
   /// Returns true if this is the last frame.  Frames are zero-based, so the
   /// first frame is zero.  IsLastFrame(-1) will return false, unless the file
   /// is empty (which is a case that I'm not sure all the code will handle, so
@@ -0,0 +1,88 @@
+// ivector/plda-speed-test.cc
+
+// Copyright 2013  Daniel Povey
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ivector/plda.h"
+#include "ivector/plda-test-utils.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+// Compares the speed of Plda::LogLikelihoodRatio() with that of
+// PldaBatchScorer, on all the (train, test) pairs and on one in "sparsity" of
+// them.
+void PldaBatchScorerSpeedTest(int32 dim, int32 num_train, int32 num_test,
+                              int32 sparsity) {
+  Plda plda;
+  InitRandomPlda(dim, &plda);
+  PldaConfig config;
+  Matrix<double> train(num_train, dim), test(num_test, dim);
+  std::vector<int32> num_utts(num_train);
+  for (int32 i = 0; i < num_train; i++) {
+    Vector<double> ivector(dim);
+    ivector.SetRandn();
+    SubVector<double> row(train, i);
+    plda.TransformIvector(config, ivector, &row);
+    num_utts[i] = 1 + Rand() % 5;
+  }
+  for (int32 i = 0; i < num_test; i++) {
+    Vector<double> ivector(dim);
+    ivector.SetRandn();
+    SubVector<double> row(test, i);
+    plda.TransformIvector(config, ivector, &row);
+  }
+  std::vector<std::pair<int32, int32> > trials;
+  for (int32 i = 0; i < num_train; i++)
+    for (int32 j = 0; j < num_test; j++)
+      if (Rand() % sparsity == 0)
+        trials.push_back(std::make_pair(i, j));
+
+  Timer timer;
+  double sum = 0.0;
+  for (size_t k = 0; k < trials.size(); k++)
+    sum += plda.LogLikelihoodRatio(train.Row(trials[k].first),
+                                   num_utts[trials[k].first],
+                                   test.Row(trials[k].second));
+  double ref_time = timer.Elapsed();
+
+  PldaBatchScorer scorer(plda, train, num_utts);
+  int32 block_size = 256;
+  for (int32 num_threads = 1; num_threads <= 4; num_threads *= 2) {
+    timer.Reset();
+    std::vector<double> scores;
+    scorer.ScoreTrials(test, trials, block_size, num_threads, &scores);
+    double batch_time = timer.Elapsed();
+    KALDI_LOG << "Scored " << trials.size() << " trials (1 in " << sparsity
+              << " of the pairs) of dim " << dim << " at "
+              << (trials.size() / ref_time) << " trials/sec one at a time, "
+              << "and " << (trials.size() / batch_time) << " trials/sec "
+              << "batched (block size " << block_size << ", " << num_threads
+              << " threads).";
+  }
+  KALDI_VLOG(2) << "Sum of scores is " << sum;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  PldaBatchScorerSpeedTest(200, 300, 1000, 1);
+  PldaBatchScorerSpeedTest(200, 300, 1000, 100);
+  std::cout << "Test OK.\n";
+  return 0;
+}
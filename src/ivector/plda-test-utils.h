@@ -0,0 +1,53 @@
+// ivector/plda-test-utils.h
+
+// Copyright 2013  Daniel Povey
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_IVECTOR_PLDA_TEST_UTILS_H_
+#define KALDI_IVECTOR_PLDA_TEST_UTILS_H_
+
+// This header contains functions shared by plda-test.cc and
+// plda-speed-test.cc; it is not part of the library.
+
+#include <functional>
+#include <sstream>
+#include "ivector/plda.h"
+
+namespace kaldi {
+
+// Creates a PLDA model with random parameters.
+inline void InitRandomPlda(int32 dim, Plda *plda) {
+  Vector<double> mean(dim), psi(dim);
+  Matrix<double> transform(dim, dim);
+  mean.SetRandn();
+  transform.SetRandn();
+  for (int32 i = 0; i < dim; i++)
+    psi(i) = 0.1 + 10.0 * RandUniform();
+  std::sort(psi.Data(), psi.Data() + dim, std::greater<double>());
+  std::ostringstream os;
+  WriteToken(os, true, "<Plda>");
+  mean.Write(os, true);
+  transform.Write(os, true);
+  psi.Write(os, true);
+  WriteToken(os, true, "</Plda>");
+  std::istringstream is(os.str());
+  plda->Read(is, true);
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_IVECTOR_PLDA_TEST_UTILS_H_
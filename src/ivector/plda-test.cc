@@ -18,6 +18,7 @@
 // limitations under the License.
 
 #include "ivector/plda.h"
+#include "ivector/plda-test-utils.h"
 
 
 namespace kaldi {
@@ -89,6 +90,62 @@ void UnitTestPldaEstimation(int32 dim) {
   
 }
 
+void UnitTestPldaBatchScorer(int32 dim, int32 num_train, int32 num_test) {
+  Plda plda;
+  InitRandomPlda(dim, &plda);
+  PldaConfig config;
+
+  Matrix<double> train(num_train, dim), test(num_test, dim);
+  std::vector<int32> num_utts(num_train);
+  for (int32 i = 0; i < num_train; i++) {
+    Vector<double> ivector(dim);
+    ivector.SetRandn();
+    SubVector<double> row(train, i);
+    plda.TransformIvector(config, ivector, &row);
+    num_utts[i] = 1 + Rand() % 5;
+  }
+  for (int32 i = 0; i < num_test; i++) {
+    Vector<double> ivector(dim);
+    ivector.SetRandn();
+    SubVector<double> row(test, i);
+    plda.TransformIvector(config, ivector, &row);
+  }
+
+  // All the trials, or a random subset of them, so that some tiles are
+  // scored one trial at a time.
+  bool sparse = (Rand() % 2 == 0);
+  std::vector<std::pair<int32, int32> > trials;
+  for (int32 i = 0; i < num_train; i++)
+    for (int32 j = 0; j < num_test; j++)
+      if (!sparse || Rand() % 20 == 0)
+        trials.push_back(std::make_pair(i, j));
+
+  std::vector<double> ref_scores(trials.size());
+  for (size_t k = 0; k < trials.size(); k++)
+    ref_scores[k] = plda.LogLikelihoodRatio(
+        train.Row(trials[k].first), num_utts[trials[k].first],
+        test.Row(trials[k].second));
+
+  PldaBatchScorer scorer(plda, train, num_utts);
+  int32 block_size = 1 + Rand() % 10, num_threads = 1 + Rand() % 4;
+  std::vector<double> scores;
+  scorer.ScoreTrials(test, trials, block_size, num_threads, &scores);
+  KALDI_ASSERT(scores.size() == trials.size());
+  for (size_t k = 0; k < trials.size(); k++)
+    KALDI_ASSERT(ApproxEqual(scores[k], ref_scores[k], 1.0e-06) ||
+                 fabs(scores[k] - ref_scores[k]) < 1.0e-06);
+
+  Matrix<double> score_mat(num_test, num_train);
+  scorer.Score(test, &score_mat);
+  for (size_t k = 0; k < trials.size(); k++) {
+    const std::pair<int32, int32> &trial = trials[k];
+    KALDI_ASSERT(fabs(score_mat(trial.second, trial.first) -
+                      scores[k]) < 1.0e-06);
+    KALDI_ASSERT(fabs(scorer.ScoreOne(test.Row(trial.second), trial.first) -
+                      scores[k]) < 1.0e-06);
+  }
+}
+
 }
 
 
@@ -110,6 +167,9 @@ int main() {
 
   // UnitTestPldaEstimation(400);
   UnitTestPldaEstimation(80);
+  for (int i = 0; i < 10; i++)
+    UnitTestPldaBatchScorer(1 + Rand() % 10, 1 + Rand() % 50,
+                            1 + Rand() % 50);
   std::cout << "Test OK.\n";
   return 0;
 }
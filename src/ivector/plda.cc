@@ -150,6 +150,203 @@ double Plda::LogLikelihoodRatio(
 }
 
 
+PldaBatchScorer::PldaBatchScorer(
+    const Plda &plda,
+    const MatrixBase<double> &transformed_train_ivectors,
+    const std::vector<int32> &num_train_utts) {
+  int32 dim = plda.Dim(), num_train = transformed_train_ivectors.NumRows();
+  KALDI_ASSERT(transformed_train_ivectors.NumCols() == dim &&
+               static_cast<int32>(num_train_utts.size()) == num_train);
+  const Vector<double> &psi = plda.psi_;
+  // The terms of the log-likelihood ratio that do not depend on the train
+  // iVector or the test iVector; see the comment above TransformIvector().
+  Vector<double> between_plus_within(psi);
+  between_plus_within.Add(1.0);
+  double logdet_without_class = between_plus_within.SumLog();
+  between_plus_within.InvertElements();
+
+  train_linear_.Resize(num_train, dim, kUndefined);
+  train_offset_.Resize(num_train, kUndefined);
+  train_group_.resize(num_train);
+  std::vector<int32> group_num_utts;
+  std::vector<Vector<double> > group_scale, group_inv_variance;
+  std::vector<double> group_offset;
+  for (int32 t = 0; t < num_train; t++) {
+    int32 n = num_train_utts[t];
+    KALDI_ASSERT(n > 0);
+    size_t g = 0;
+    for (; g < group_num_utts.size(); g++)
+      if (group_num_utts[g] == n) break;
+    if (g == group_num_utts.size()) {
+      // The mean given the class is scale * u; the variance is
+      // I + \frac{\Psi}{n\Psi + I}.
+      Vector<double> scale(dim, kUndefined), variance(dim, kUndefined);
+      for (int32 i = 0; i < dim; i++) {
+        scale(i) = n * psi(i) / (n * psi(i) + 1.0);
+        variance(i) = 1.0 + psi(i) / (n * psi(i) + 1.0);
+      }
+      group_num_utts.push_back(n);
+      group_offset.push_back(-0.5 * (variance.SumLog() -
+                                     logdet_without_class));
+      variance.InvertElements();
+      group_scale.push_back(scale);
+      group_inv_variance.push_back(variance);
+    }
+    train_group_[t] = g;
+    // a_n u = scale * u / variance, and
+    // c(u, n) = -0.5 (scale * u)^2 / variance + group_offset.
+    SubVector<double> linear(train_linear_, t);
+    linear.CopyFromVec(transformed_train_ivectors.Row(t));
+    linear.MulElements(group_scale[g]);
+    Vector<double> mean(linear);
+    linear.MulElements(group_inv_variance[g]);
+    train_offset_(t) = -0.5 * VecVec(mean, linear) + group_offset[g];
+  }
+  // w_n = 0.5 ((I + \Psi)^{-1} - variance^{-1}).
+  quadratic_.Resize(group_num_utts.size(), dim, kUndefined);
+  for (size_t g = 0; g < group_num_utts.size(); g++) {
+    SubVector<double> w(quadratic_, g);
+    w.CopyFromVec(between_plus_within);
+    w.AddVec(-1.0, group_inv_variance[g]);
+    w.Scale(0.5);
+  }
+}
+
+void PldaBatchScorer::Score(
+    const MatrixBase<double> &transformed_test_ivectors,
+    int32 train_offset, MatrixBase<double> *scores) const {
+  int32 num_test = transformed_test_ivectors.NumRows(),
+      num_train = scores->NumCols();
+  KALDI_ASSERT(transformed_test_ivectors.NumCols() == Dim() &&
+               scores->NumRows() == num_test && train_offset >= 0 &&
+               train_offset + num_train <= NumTrain());
+  if (num_train == 0) return;
+  SubMatrix<double> train_linear(train_linear_, train_offset, num_train,
+                                 0, Dim());
+  scores->AddMatMat(1.0, transformed_test_ivectors, kNoTrans,
+                    train_linear, kTrans, 0.0);
+  Matrix<double> test_sq(transformed_test_ivectors);
+  test_sq.ApplyPow(2.0);
+  Matrix<double> quadratic(num_test, quadratic_.NumRows(), kUndefined);
+  quadratic.AddMatMat(1.0, test_sq, kNoTrans, quadratic_, kTrans, 0.0);
+  const double *offset = train_offset_.Data() + train_offset;
+  const int32 *group = &(train_group_[train_offset]);
+  for (int32 r = 0; r < num_test; r++) {
+    double *row = scores->RowData(r);
+    const double *quad = quadratic.RowData(r);
+    for (int32 t = 0; t < num_train; t++)
+      row[t] += offset[t] + quad[group[t]];
+  }
+}
+
+double PldaBatchScorer::ScoreOne(
+    const VectorBase<double> &transformed_test_ivector, int32 t) const {
+  KALDI_ASSERT(transformed_test_ivector.Dim() == Dim() &&
+               t >= 0 && t < NumTrain());
+  const double *v = transformed_test_ivector.Data(),
+      *linear = train_linear_.RowData(t),
+      *quad = quadratic_.RowData(train_group_[t]);
+  double ans = train_offset_(t);
+  for (int32 i = 0; i < Dim(); i++)
+    ans += v[i] * (linear[i] + v[i] * quad[i]);
+  return ans;
+}
+
+// Scores the trials in some of the tiles of (test, train) iVector pairs;
+// thread i of n does tiles i, i + n, i + 2n, ...  The trials of tile k are
+// trials_[order_[j]] for tile_begin_[k] <= j < tile_begin_[k + 1].
+class PldaScoreBlocksClass: public MultiThreadable {
+ public:
+  PldaScoreBlocksClass(const PldaBatchScorer &scorer,
+                       const MatrixBase<double> &test_ivectors,
+                       const std::vector<std::pair<int32, int32> > &trials,
+                       const std::vector<int32> &order,
+                       const std::vector<int32> &tile_begin,
+                       int32 block_size,
+                       std::vector<double> *scores):
+      scorer_(scorer), test_ivectors_(test_ivectors), trials_(trials),
+      order_(order), tile_begin_(tile_begin), block_size_(block_size),
+      scores_(scores) { }
+
+  void operator () () {
+    int32 num_tiles = static_cast<int32>(tile_begin_.size()) - 1;
+    Matrix<double> tile_scores;
+    for (int32 k = thread_id_; k < num_tiles; k += num_threads_) {
+      int32 begin = tile_begin_[k], end = tile_begin_[k + 1];
+      const std::pair<int32, int32> &first = trials_[order_[begin]];
+      int32 test_offset = (first.second / block_size_) * block_size_,
+          train_offset = (first.first / block_size_) * block_size_,
+          rows = std::min(block_size_, test_ivectors_.NumRows() - test_offset),
+          cols = std::min(block_size_, scorer_.NumTrain() - train_offset);
+      // A matrix multiplication is much faster per score than scoring the
+      // trials one by one, but not if only a few of the scores are needed.
+      if ((end - begin) * 8.0 < static_cast<double>(rows) * cols) {
+        for (int32 j = begin; j < end; j++) {
+          const std::pair<int32, int32> &trial = trials_[order_[j]];
+          (*scores_)[order_[j]] = scorer_.ScoreOne(
+              test_ivectors_.Row(trial.second), trial.first);
+        }
+      } else {
+        SubMatrix<double> block(test_ivectors_, test_offset, rows,
+                                0, test_ivectors_.NumCols());
+        tile_scores.Resize(rows, cols, kUndefined);
+        scorer_.Score(block, train_offset, &tile_scores);
+        for (int32 j = begin; j < end; j++) {
+          const std::pair<int32, int32> &trial = trials_[order_[j]];
+          (*scores_)[order_[j]] = tile_scores(trial.second - test_offset,
+                                              trial.first - train_offset);
+        }
+      }
+    }
+  }
+ private:
+  const PldaBatchScorer &scorer_;
+  const MatrixBase<double> &test_ivectors_;
+  const std::vector<std::pair<int32, int32> > &trials_;
+  const std::vector<int32> &order_;
+  const std::vector<int32> &tile_begin_;
+  int32 block_size_;
+  std::vector<double> *scores_;
+};
+
+void PldaBatchScorer::ScoreTrials(
+    const MatrixBase<double> &transformed_test_ivectors,
+    const std::vector<std::pair<int32, int32> > &trials,
+    int32 block_size, int32 num_threads,
+    std::vector<double> *scores) const {
+  KALDI_ASSERT(block_size > 0);
+  int32 num_test = transformed_test_ivectors.NumRows(),
+      num_train_blocks = (NumTrain() + block_size - 1) / block_size,
+      num_trials = trials.size();
+  // Sort the trials on their tile, in the order (test block, train block).
+  std::vector<std::pair<int64, int32> > sorted_trials(num_trials);
+  for (int32 i = 0; i < num_trials; i++) {
+    KALDI_ASSERT(trials[i].first >= 0 && trials[i].first < NumTrain() &&
+                 trials[i].second >= 0 && trials[i].second < num_test);
+    int64 tile = static_cast<int64>(trials[i].second / block_size) *
+        num_train_blocks + trials[i].first / block_size;
+    sorted_trials[i] = std::make_pair(tile, i);
+  }
+  std::sort(sorted_trials.begin(), sorted_trials.end());
+  std::vector<int32> order(num_trials), tile_begin;
+  for (int32 i = 0; i < num_trials; i++) {
+    if (i == 0 || sorted_trials[i].first != sorted_trials[i - 1].first)
+      tile_begin.push_back(i);
+    order[i] = sorted_trials[i].second;
+  }
+  int32 num_tiles = tile_begin.size();
+  tile_begin.push_back(num_trials);
+  std::vector<std::pair<int64, int32> >().swap(sorted_trials);
+
+  scores->resize(num_trials);
+  PldaScoreBlocksClass c(*this, transformed_test_ivectors, trials, order,
+                         tile_begin, block_size, scores);
+  // Using more threads than tiles would not help.
+  MultiThreader<PldaScoreBlocksClass> m(
+      std::min(num_threads, std::max(num_tiles, 1)), c);
+}
+
+
 void Plda::SmoothWithinClassCovariance(double smoothing_factor) {
   KALDI_ASSERT(smoothing_factor >= 0.0 && smoothing_factor <= 1.0);
   // smoothing_factor > 1.0 is possible but wouldn't really make sense.
@@ -31,6 +31,7 @@
 #include "gmm/full-gmm.h"
 #include "itf/options-itf.h"
 #include "util/common-utils.h"
+#include "thread/kaldi-thread.h"
 
 namespace kaldi {
 
@@ -116,6 +117,7 @@ class Plda {
   void ComputeDerivedVars(); // computes offset_.
   friend class PldaEstimator;
   friend class PldaUnsupervisedAdaptor;
+  friend class PldaBatchScorer;
   
   Vector<double> mean_;  // mean of samples in original space.
   Matrix<double> transform_; // of dimension Dim() by Dim();
@@ -131,6 +133,70 @@ class Plda {
 };
 
 
+/**
+   PldaBatchScorer computes the same log-likelihood ratios as
+   Plda::LogLikelihoodRatio(), but for many trials at once.  Because Psi is
+   diagonal, the log-likelihood ratio of test iVector v against train iVector
+   u (with n utterances) is
+      v . (a_n u)  +  v^2 . w_n  +  c(u, n),
+   where a_n and w_n are vectors that depend only on n.  We precompute a_n u
+   and c(u, n) for all the train iVectors, so scoring a block of test iVectors
+   against all the train iVectors is a matrix multiplication, plus one more
+   for the v^2 . w_n terms (one column per distinct n).
+ */
+class PldaBatchScorer {
+ public:
+  /// The rows of "transformed_train_ivectors" are the train iVectors,
+  /// transformed by Plda::TransformIvector(); num_train_utts[i] is the
+  /// number of utterances the i'th was averaged over.
+  PldaBatchScorer(const Plda &plda,
+                  const MatrixBase<double> &transformed_train_ivectors,
+                  const std::vector<int32> &num_train_utts);
+
+  int32 NumTrain() const { return train_linear_.NumRows(); }
+  int32 Dim() const { return train_linear_.NumCols(); }
+
+  /// Sets (*scores)(i, j) to the log-likelihood ratio of the i'th row of
+  /// "transformed_test_ivectors" against the j'th train iVector.  "scores"
+  /// must be of dimension transformed_test_ivectors.NumRows() by NumTrain().
+  void Score(const MatrixBase<double> &transformed_test_ivectors,
+             MatrixBase<double> *scores) const {
+    Score(transformed_test_ivectors, 0, scores);
+  }
+
+  /// As Score() above, but only against scores->NumCols() train iVectors,
+  /// starting from the "train_offset"'th.
+  void Score(const MatrixBase<double> &transformed_test_ivectors,
+             int32 train_offset, MatrixBase<double> *scores) const;
+
+  /// Returns the log-likelihood ratio of one test iVector against the t'th
+  /// train iVector, without any matrix multiplication.
+  double ScoreOne(const VectorBase<double> &transformed_test_ivector,
+                  int32 t) const;
+
+  /// Computes the log-likelihood ratio of each trial, a pair (train index,
+  /// test index), into (*scores)[i].  The trials are grouped into tiles of
+  /// "block_size" test iVectors by "block_size" train iVectors, and the
+  /// tiles are divided among "num_threads" threads.  A tile is scored with a
+  /// matrix multiplication if it has enough trials, otherwise the trials are
+  /// scored one at a time; so the memory used is at most block_size^2 doubles
+  /// per thread, plus some per trial.  For very large trial lists, call this
+  /// on a chunk of the trials at a time.
+  void ScoreTrials(const MatrixBase<double> &transformed_test_ivectors,
+                   const std::vector<std::pair<int32, int32> > &trials,
+                   int32 block_size, int32 num_threads,
+                   std::vector<double> *scores) const;
+
+ private:
+  Matrix<double> train_linear_;  // row i is a_n u for the i'th train iVector.
+  Vector<double> train_offset_;  // c(u, n) for each train iVector.
+  std::vector<int32> train_group_;  // index into the rows of quadratic_.
+  Matrix<double> quadratic_;  // w_n for each distinct n.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(PldaBatchScorer);
+};
+
+
 class PldaStats {
  public:
   PldaStats(): dim_(0) { } /// The dimension is set up the first time you add samples.
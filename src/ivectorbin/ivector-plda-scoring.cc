@@ -19,6 +19,7 @@
 
 
 #include "base/kaldi-common.h"
+#include "base/timer.h"
 #include "util/common-utils.h"
 #include "ivector/plda.h"
 
@@ -51,11 +52,18 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
 
     std::string num_utts_rspecifier;
+    int32 block_size = 256, num_threads = 1, chunk_size = 100000;
     
     PldaConfig plda_config;
     plda_config.Register(&po);
     po.Register("num-utts", &num_utts_rspecifier, "Table to read the number of "
                 "utterances per speaker, e.g. ark:num_utts.ark\n");
+    po.Register("block-size", &block_size, "We score tiles of this many test "
+                "iVectors by this many training iVectors together.");
+    po.Register("chunk-size", &chunk_size, "Number of trials we read, score "
+                "and write at a time.");
+    po.Register("num-threads", &num_threads, "Number of threads used to "
+                "score tiles of trials in parallel.");
     
     po.Read(argc, argv);
     
@@ -85,26 +93,28 @@ int main(int argc, char *argv[]) {
     SequentialBaseFloatVectorReader test_ivector_reader(test_ivector_rspecifier);
     RandomAccessInt32Reader num_utts_reader(num_utts_rspecifier);
 
-    typedef unordered_map<string, Vector<BaseFloat>*, StringHasher> HashType;
+    typedef unordered_map<string, int32, StringHasher> HashType;
 
-    // These hashes will contain the iVectors in the PLDA subspace
-    // (that makes the within-class variance unit and diagonalizes the
-    // between-class covariance).  They will also possibly be length-normalized,
-    // depending on the config.
-    HashType train_ivectors, test_ivectors;
+    // These hashes map keys to indexes into the vectors of iVectors below,
+    // which are in the PLDA subspace (that makes the within-class variance
+    // unit and diagonalizes the between-class covariance).  They will also
+    // possibly be length-normalized, depending on the config.
+    HashType train_index, test_index;
+    std::vector<Vector<double> > train_ivectors, test_ivectors;
+    std::vector<std::string> train_keys, test_keys;
 
     KALDI_LOG << "Reading train iVectors";
     for (; !train_ivector_reader.Done(); train_ivector_reader.Next()) {
       std::string spk = train_ivector_reader.Key();
-      if (train_ivectors.count(spk) != 0) {
+      if (train_index.count(spk) != 0) {
         KALDI_ERR << "Duplicate training iVector found for speaker " << spk;
       }
-      const Vector<BaseFloat> &ivector = train_ivector_reader.Value();
-      Vector<BaseFloat> *transformed_ivector = new Vector<BaseFloat>(dim);
-
+      Vector<double> ivector(train_ivector_reader.Value());
+      train_ivectors.push_back(Vector<double>(dim));
       tot_train_renorm_scale += plda.TransformIvector(plda_config, ivector,
-                                                      transformed_ivector);
-      train_ivectors[spk] = transformed_ivector;
+                                                      &(train_ivectors.back()));
+      train_index[spk] = train_keys.size();
+      train_keys.push_back(spk);
       num_train_ivectors++;
     }
     KALDI_LOG << "Read " << num_train_ivectors << " training iVectors, "
@@ -117,15 +127,15 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Reading test iVectors";
     for (; !test_ivector_reader.Done(); test_ivector_reader.Next()) {
       std::string utt = test_ivector_reader.Key();
-      if (test_ivectors.count(utt) != 0) {
+      if (test_index.count(utt) != 0) {
         KALDI_ERR << "Duplicate test iVector found for utterance " << utt;
       }
-      const Vector<BaseFloat> &ivector = test_ivector_reader.Value();
-      Vector<BaseFloat> *transformed_ivector = new Vector<BaseFloat>(dim);
-
+      Vector<double> ivector(test_ivector_reader.Value());
+      test_ivectors.push_back(Vector<double>(dim));
       tot_test_renorm_scale += plda.TransformIvector(plda_config, ivector,
-                                                     transformed_ivector);
-      test_ivectors[utt] = transformed_ivector;
+                                                     &(test_ivectors.back()));
+      test_index[utt] = test_keys.size();
+      test_keys.push_back(utt);
       num_test_ivectors++;
     }
     KALDI_LOG << "Read " << num_test_ivectors << " test iVectors.";
@@ -134,64 +144,94 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Average renormalization scale on test iVectors was "
               << (tot_test_renorm_scale / num_test_ivectors);
     
-    
+    // We need the number of utterances of each training speaker before we
+    // start scoring.  It is only an error for it to be missing if the speaker
+    // appears in a trial.
+    std::vector<int32> num_train_examples(train_keys.size(), 1);
+    std::vector<bool> num_utts_missing(train_keys.size(), false);
+    if (!num_utts_rspecifier.empty()) {
+      for (size_t t = 0; t < train_keys.size(); t++) {
+        if (num_utts_reader.HasKey(train_keys[t]))
+          num_train_examples[t] = num_utts_reader.Value(train_keys[t]);
+        else
+          num_utts_missing[t] = true;
+      }
+    }
+
+    Matrix<double> train_mat(train_ivectors.size(), dim, kUndefined),
+        test_mat(test_ivectors.size(), dim, kUndefined);
+    for (size_t i = 0; i < train_ivectors.size(); i++)
+      train_mat.Row(i).CopyFromVec(train_ivectors[i]);
+    for (size_t i = 0; i < test_ivectors.size(); i++)
+      test_mat.Row(i).CopyFromVec(test_ivectors[i]);
+    train_ivectors.clear();
+    test_ivectors.clear();
+    PldaBatchScorer scorer(plda, train_mat, num_train_examples);
+
+    // We read the trials a chunk at a time, score them in batches, and write
+    // the scores before reading the next chunk.
+    KALDI_ASSERT(chunk_size > 0);
     Input ki(trials_rxfilename);
     bool binary = false;
     Output ko(scores_wxfilename, binary);
-    
-    double sum = 0.0, sumsq = 0.0;
+    std::vector<std::pair<int32, int32> > trials;
+    std::vector<double> scores;
+    trials.reserve(chunk_size);
+    double sum = 0.0, sumsq = 0.0, scoring_time = 0.0;
     std::string line;
-
-    while (std::getline(ki.Stream(), line)) {
-      std::vector<std::string> fields;
-      SplitStringToVector(line, " \t\n\r", true, &fields);
-      if (fields.size() != 2) {
-        KALDI_ERR << "Bad line " << (num_trials_done + num_trials_err)
-                  << "in input (expected two fields: key1 key2): " << line;
-      }
-      std::string key1 = fields[0], key2 = fields[1];
-      if (train_ivectors.count(key1) == 0) {
-        KALDI_WARN << "Key " << key1 << " not present in training iVectors.";
-        num_trials_err++;
-        continue;
-      }
-      if (test_ivectors.count(key2) == 0) {
-        KALDI_WARN << "Key " << key2 << " not present in test iVectors.";
-        num_trials_err++;
-        continue;
+    bool eof = false;
+    while (!eof) {
+      trials.clear();
+      while (trials.size() < static_cast<size_t>(chunk_size)) {
+        if (!std::getline(ki.Stream(), line)) {
+          eof = true;
+          break;
+        }
+        std::vector<std::string> fields;
+        SplitStringToVector(line, " \t\n\r", true, &fields);
+        if (fields.size() != 2) {
+          KALDI_ERR << "Bad line " << (num_trials_done + trials.size() +
+                                       num_trials_err)
+                    << "in input (expected two fields: key1 key2): " << line;
+        }
+        std::string key1 = fields[0], key2 = fields[1];
+        HashType::iterator train_iter = train_index.find(key1),
+            test_iter = test_index.find(key2);
+        if (train_iter == train_index.end()) {
+          KALDI_WARN << "Key " << key1 << " not present in training iVectors.";
+          num_trials_err++;
+          continue;
+        }
+        if (test_iter == test_index.end()) {
+          KALDI_WARN << "Key " << key2 << " not present in test iVectors.";
+          num_trials_err++;
+          continue;
+        }
+        if (num_utts_missing[train_iter->second])
+          KALDI_ERR << "Number of utterances not found for speaker " << key1
+                    << " in " << num_utts_rspecifier;
+        trials.push_back(std::make_pair(train_iter->second,
+                                        test_iter->second));
       }
-      const Vector<BaseFloat> *train_ivector = train_ivectors[key1],
-          *test_ivector = test_ivectors[key2];
-          
-      Vector<double> train_ivector_dbl(*train_ivector),
-          test_ivector_dbl(*test_ivector);
-
-      int32 num_train_examples;
-      if (!num_utts_rspecifier.empty()) {
-        // we already checked that it has this key.
-        num_train_examples = num_utts_reader.Value(key1);
-      } else {
-        num_train_examples = 1;
+
+      Timer timer;
+      scorer.ScoreTrials(test_mat, trials, block_size, num_threads, &scores);
+      scoring_time += timer.Elapsed();
+      for (size_t i = 0; i < trials.size(); i++) {
+        BaseFloat score = scores[i];
+        sum += score;
+        sumsq += score * score;
+        num_trials_done++;
+        ko.Stream() << train_keys[trials[i].first] << ' '
+                    << test_keys[trials[i].second]
+                    << ' ' << score << std::endl;
       }
-      
-      
-      BaseFloat score = plda.LogLikelihoodRatio(train_ivector_dbl,
-                                                num_train_examples,
-                                                test_ivector_dbl);
-      sum += score;
-      sumsq += score * score;
-      num_trials_done++;
-      ko.Stream() << key1 << ' ' << key2 << ' ' << score << std::endl;
     }
+    KALDI_LOG << "Scored " << num_trials_done << " trials in " << scoring_time
+              << " seconds (" << (num_trials_done /
+                                  std::max(scoring_time, 1.0e-06))
+              << " trials/sec)";
 
-    for (HashType::iterator iter = train_ivectors.begin();
-         iter != train_ivectors.end(); ++iter)
-      delete iter->second;
-    for (HashType::iterator iter = test_ivectors.begin();
-         iter != test_ivectors.end(); ++iter)
-      delete iter->second;
-
-    
     if (num_trials_done != 0) {
       BaseFloat mean = sum / num_trials_done, scatter = sumsq / num_trials_done,
           variance = scatter - mean * mean, stddev = sqrt(variance);
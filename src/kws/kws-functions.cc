@@ -22,6 +22,7 @@
 #include "kws/kws-functions.h"
 #include "fstext/determinize-star.h"
 #include "fstext/epsilon-property.h"
+#include "util/stl-utils.h"
 
 namespace kaldi {
 
@@ -489,5 +490,210 @@ void OptimizeFactorTransducer(KwsLexicographicFst *index_transducer,
 }
 
 
+bool CreateUtteranceIndex(const KwsIndexOptions &opts,
+                          int32 utterance_id,
+                          CompactLattice *clat,
+                          KwsLexicographicFst *index_transducer) {
+  int32 max_states = -1;
+  if (opts.max_states_scale > 0) {
+    max_states = static_cast<int32>(
+        opts.max_states_scale * static_cast<BaseFloat>(clat->NumStates()));
+  }
+
+  // Topologically sort the lattice, if not already sorted.
+  uint64 props = clat->Properties(fst::kFstProperties, false);
+  if (!(props & fst::kTopSorted)) {
+    if (fst::TopSort(clat) == false) {
+      KALDI_WARN << "Cycles detected in lattice";
+      return false;
+    }
+  }
+
+  // Get the alignments
+  vector<int32> state_times;
+  CompactLatticeStateTimes(*clat, &state_times);
+
+  // Cluster the arcs in the CompactLattice, write the cluster_id on the
+  // output label side.
+  // ClusterLattice() corresponds to the second part of the preprocessing in
+  // Dogan and Murat's paper -- clustering. Note that we do the first part
+  // of preprocessing (the weight pushing step) later when generating the
+  // factor transducer.
+  KALDI_VLOG(1) << "Arc clustering...";
+  if (!ClusterLattice(clat, state_times)) {
+    KALDI_WARN << "State id's and alignments do not match";
+    return false;
+  }
+
+  // The next part is something new, not in the Dogan and Can paper.  It is
+  // necessary because we have epsilon arcs, due to silences, in our
+  // lattices.  We modify the factor transducer, while maintaining
+  // equivalence, to ensure that states don't have both epsilon *and*
+  // non-epsilon arcs entering them.  (and the same, with "entering"
+  // replaced with "leaving").  Later we will find out which states have
+  // non-epsilon arcs leaving/entering them and use it to be more selective
+  // in adding arcs to connect them with the initial/final states.  The goal
+  // here is to disallow silences at the beginning or ending of a keyword
+  // occurrence.
+  EnsureEpsilonProperty(clat);
+  fst::TopSort(clat);
+  // We have to recompute the state times because they will have changed.
+  CompactLatticeStateTimes(*clat, &state_times);
+
+  // Generate factor transducer
+  // CreateFactorTransducer() corresponds to the "Factor Generation" part of
+  // Dogan and Murat's paper. But we also move the weight pushing step to
+  // this function as we have to compute the alphas and betas anyway.
+  KALDI_VLOG(1) << "Generating factor transducer...";
+  KwsProductFst factor_transducer;
+  if (!CreateFactorTransducer(*clat, state_times, utterance_id,
+                              &factor_transducer)) {
+    KALDI_WARN << "Cannot generate factor transducer";
+    return false;
+  }
+
+  MaybeDoSanityCheck(factor_transducer);
+
+  // Remove long silence arc
+  // We add the filtering step in our implementation. This is because gap
+  // between two successive words in a query term should be less than 0.5s
+  KALDI_VLOG(1) << "Removing long silence...";
+  RemoveLongSilences(opts.max_silence_frames, state_times, &factor_transducer);
+
+  MaybeDoSanityCheck(factor_transducer);
+
+  // Do factor merging, and return a transducer in T*T*T semiring. This step
+  // corresponds to the "Factor Merging" part in Dogan and Murat's paper.
+  KALDI_VLOG(1) << "Merging factors...";
+  DoFactorMerging(&factor_transducer, index_transducer);
+
+  MaybeDoSanityCheck(*index_transducer);
+
+  // Do factor disambiguation. It corresponds to the "Factor Disambiguation"
+  // step in Dogan and Murat's paper.
+  KALDI_VLOG(1) << "Doing factor disambiguation...";
+  DoFactorDisambiguation(index_transducer);
+
+  MaybeDoSanityCheck(*index_transducer);
+
+  // Optimize the above factor transducer. It corresponds to the
+  // "Optimization" step in the paper.
+  KALDI_VLOG(1) << "Optimizing factor transducer...";
+  OptimizeFactorTransducer(index_transducer, max_states, opts.allow_partial);
+
+  MaybeDoSanityCheck(*index_transducer);
+  return true;
+}
+
+
+// Maps keyword FSTs to the T*T*T semiring, for composition with the index.
+class VectorFstToKwsLexicographicFstMapper {
+ public:
+  typedef fst::StdArc FromArc;
+  typedef FromArc::Weight FromWeight;
+  typedef KwsLexicographicArc ToArc;
+  typedef KwsLexicographicWeight ToWeight;
+
+  VectorFstToKwsLexicographicFstMapper() {}
+
+  ToArc operator()(const FromArc &arc) const {
+    return ToArc(arc.ilabel,
+                 arc.olabel,
+                 (arc.weight == FromWeight::Zero() ?
+                  ToWeight::Zero() :
+                  ToWeight(arc.weight.Value(),
+                           StdLStdWeight::One())),
+                 arc.nextstate);
+  }
+
+  fst::MapFinalAction FinalAction() const { return fst::MAP_NO_SUPERFINAL; }
+
+  fst::MapSymbolsAction InputSymbolsAction() const {
+    return fst::MAP_COPY_SYMBOLS;
+  }
+
+  fst::MapSymbolsAction OutputSymbolsAction() const {
+    return fst::MAP_COPY_SYMBOLS;
+  }
+
+  uint64 Properties(uint64 props) const { return props; }
+};
+
+KwsIndexSearcher::KwsIndexSearcher(const KwsLexicographicFst &index):
+    index_(index) {
+  using namespace fst;
+  typedef KwsLexicographicArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+  // We encode the input and output label of each final arc (the
+  // disambiguation symbol and the utterance id) as the new output label of
+  // the arc, and set the input label to <epsilon>.
+  unordered_map<uint64, uint32> label_encoder;
+  label_decoder_.resize(1);  // label zero is epsilon.
+  for (StateIterator<KwsLexicographicFst> siter(index_); !siter.Done();
+       siter.Next()) {
+    StateId state_id = siter.Value();
+    for (MutableArcIterator<KwsLexicographicFst>
+         aiter(&index_, state_id); !aiter.Done(); aiter.Next()) {
+      Arc arc = aiter.Value();
+      // Skip the non-final arcs
+      if (index_.Final(arc.nextstate) == Weight::Zero())
+        continue;
+      uint64 osymbol = (static_cast<uint64>(arc.olabel) << 32) +
+          static_cast<uint64>(arc.ilabel);
+      arc.ilabel = 0;
+      unordered_map<uint64, uint32>::iterator iter =
+          label_encoder.find(osymbol);
+      if (iter == label_encoder.end()) {
+        arc.olabel = label_decoder_.size();
+        label_encoder[osymbol] = label_decoder_.size();
+        label_decoder_.push_back(osymbol);
+      } else {
+        arc.olabel = iter->second;
+      }
+      aiter.SetValue(arc);
+    }
+  }
+  ArcSort(&index_, fst::ILabelCompare<KwsLexicographicArc>());
+}
+
+void KwsIndexSearcher::Search(const fst::VectorFst<fst::StdArc> &keyword,
+                              int32 n_best,
+                              std::vector<KwsSearchResult> *results) const {
+  using namespace fst;
+  typedef KwsLexicographicArc Arc;
+  typedef Arc::Weight Weight;
+  KwsLexicographicFst keyword_fst;
+  KwsLexicographicFst result_fst;
+  Map(keyword, &keyword_fst, VectorFstToKwsLexicographicFstMapper());
+  Compose(keyword_fst, index_, &result_fst);
+  Project(&result_fst, PROJECT_OUTPUT);
+  Minimize(&result_fst);
+  ShortestPath(result_fst, &result_fst, n_best);
+  RmEpsilon(&result_fst);
+
+  // No result found
+  if (result_fst.Start() == kNoStateId)
+    return;
+
+  for (ArcIterator<KwsLexicographicFst>
+       aiter(result_fst, result_fst.Start()); !aiter.Done(); aiter.Next()) {
+    const Arc &arc = aiter.Value();
+
+    // We're expecting a two-state FST
+    if (result_fst.Final(arc.nextstate) != Weight::One() ||
+        arc.olabel <= 0 || arc.olabel >= label_decoder_.size()) {
+      KALDI_WARN << "The resulting FST does not have the expected structure";
+      continue;
+    }
+    // We only need the utterance id from the label.
+    int32 utterance_id = static_cast<int32>(label_decoder_[arc.olabel] >> 32);
+    int32 start_frame = static_cast<int32>(
+        arc.weight.Value2().Value1().Value()),
+        end_frame = static_cast<int32>(arc.weight.Value2().Value2().Value());
+    results->push_back(KwsSearchResult(utterance_id, start_frame, end_frame,
+                                       arc.weight.Value1().Value()));
+  }
+}
 
 } // end namespace kaldi
@@ -21,6 +21,8 @@
 #ifndef KALDI_KWS_KWS_FUNCTIONS_H_
 #define KALDI_KWS_KWS_FUNCTIONS_H_
 
+#include <vector>
+#include "itf/options-itf.h"
 #include "lat/kaldi-lattice.h"
 #include "kws/kaldi-kws.h"
 
@@ -108,6 +110,79 @@ void OptimizeFactorTransducer(KwsLexicographicFst *index_transducer,
 void MaybeDoSanityCheck(const KwsProductFst &factor_transducer);
 void MaybeDoSanityCheck(const KwsLexicographicFst &index_transducer);
 
+struct KwsIndexOptions {
+  int32 max_silence_frames;
+  BaseFloat max_states_scale;
+  bool allow_partial;
+  KwsIndexOptions(): max_silence_frames(50), max_states_scale(4),
+                     allow_partial(true) { }
+  void Register(OptionsItf *opts) {
+    opts->Register("max-silence-frames", &max_silence_frames, "Maximum "
+                   "#frames for silence arc.");
+    opts->Register("max-states-scale", &max_states_scale, "Number of states "
+                   "in the original lattice times this scale is the number of "
+                   "states allowed when optimizing the index. Negative number "
+                   "means no limit on the number of states.");
+    opts->Register("allow-partial", &allow_partial, "Allow partial output if "
+                   "fails to determinize, otherwise skip determinization if "
+                   "it fails.");
+  }
+};
+
+// This function creates the index of one utterance from its lattice, doing
+// all the steps above from ClusterLattice() to OptimizeFactorTransducer().  It
+// modifies "clat".  It returns false, after printing a warning, if it fails.
+// It is safe to call this from several threads at once on different lattices;
+// lattice-to-kws-index does that if --num-threads > 1.
+bool CreateUtteranceIndex(const KwsIndexOptions &opts,
+                          int32 utterance_id,
+                          CompactLattice *clat,
+                          KwsLexicographicFst *index_transducer);
+
+// One occurrence of a keyword, as found by KwsIndexSearcher.
+struct KwsSearchResult {
+  int32 utterance_id;
+  int32 start_frame;
+  int32 end_frame;
+  double score;  // the negated log-probability.
+  KwsSearchResult(int32 utterance_id, int32 start_frame, int32 end_frame,
+                  double score): utterance_id(utterance_id),
+                                 start_frame(start_frame),
+                                 end_frame(end_frame), score(score) { }
+  bool operator < (const KwsSearchResult &other) const {
+    return score < other.score;
+  }
+};
+
+// KwsIndexSearcher searches for keywords in an index: the output of
+// kws-index-union, or one shard of it (see its --shard-size option).  Do not
+// call Search() on the same object from several threads at once (OpenFst's
+// reference counting is not thread-safe), but different objects, e.g. for
+// different shards, may be used in different threads.
+class KwsIndexSearcher {
+ public:
+  // Prepares a copy of "index" for searching: rather than removing the
+  // disambiguation symbols, it moves them from the input side to the output
+  // side of the final arcs, combined with the utterance id's.  Note that in
+  // Dogan and Murat's original paper, they simply remove the disambiguation
+  // symbol on the input symbol side, which will not allow us to do epsilon
+  // removal after composition with the keyword FST.
+  explicit KwsIndexSearcher(const KwsLexicographicFst &index);
+
+  // Searches for "keyword" (an acceptor of word sequences) and appends the
+  // occurrences found to "results", keeping only the n_best best if
+  // n_best != -1.  Prints a warning if the result is not of the expected
+  // form.
+  void Search(const fst::VectorFst<fst::StdArc> &keyword, int32 n_best,
+              std::vector<KwsSearchResult> *results) const;
+
+ private:
+  KwsLexicographicFst index_;
+  // Maps the labels we put on the output side of the final arcs to the
+  // (utterance id, disambiguation symbol) they encode; see the .cc file.
+  std::vector<uint64> label_decoder_;
+};
+
 
 } // namespace kaldi
 
@@ -0,0 +1,275 @@
+// kws/kws-inverted-index-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kws/kws-inverted-index.h"
+
+namespace kaldi {
+
+// Adds to "index" a path for one occurrence of the word sequence "words", of
+// the form that KwsInvertedIndexBuilder expects: the words, then an arc with
+// a disambiguation symbol and the utterance id on it to a final state.
+static void AddOccurrence(const std::vector<int32> &words, int32 utt,
+                          int32 start_frame, int32 end_frame, double score,
+                          KwsLexicographicFst *index) {
+  typedef KwsLexicographicArc Arc;
+  const int32 disambig = 1000;
+  if (index->Start() == fst::kNoStateId)
+    index->SetStart(index->AddState());
+  Arc::StateId cur = index->Start();
+  for (size_t i = 0; i < words.size(); i++) {
+    Arc::StateId next = index->AddState();
+    // We put the whole weight on the first arc.
+    KwsLexicographicWeight weight = (i == 0 ?
+        KwsLexicographicWeight(TropicalWeight(score),
+                               StdLStdWeight(TropicalWeight(start_frame),
+                                             TropicalWeight(end_frame))) :
+        KwsLexicographicWeight::One());
+    index->AddArc(cur, Arc(words[i], words[i], weight, next));
+    cur = next;
+  }
+  Arc::StateId final_state = index->AddState();
+  index->AddArc(cur, Arc(disambig, utt, KwsLexicographicWeight::One(),
+                         final_state));
+  index->SetFinal(final_state, KwsLexicographicWeight::One());
+}
+
+static std::vector<int32> Words(int32 w1, int32 w2 = -1, int32 w3 = -1) {
+  std::vector<int32> ans(1, w1);
+  if (w2 != -1) ans.push_back(w2);
+  if (w3 != -1) ans.push_back(w3);
+  return ans;
+}
+
+static void AssertEqual(const KwsSearchResult &a, const KwsSearchResult &b) {
+  KALDI_ASSERT(a.utterance_id == b.utterance_id &&
+               a.start_frame == b.start_frame &&
+               a.end_frame == b.end_frame &&
+               ApproxEqual(a.score, b.score));
+}
+
+// The word sequences, in sorted order, are [1], [1 2], [2], [2 3], [3], with
+// MaxOrder() == 2.  The 3-word sequence [1 2 3] is also in the index FST but
+// is too long to be included.
+static void MakeTestIndex(KwsInvertedIndex *inverted_index) {
+  KwsLexicographicFst index;
+  AddOccurrence(Words(1), 2, 5, 15, 1.0, &index);
+  AddOccurrence(Words(1), 1, 0, 10, 0.5, &index);
+  AddOccurrence(Words(1, 2), 1, 0, 20, 0.3, &index);
+  AddOccurrence(Words(2), 1, 12, 20, 0.25, &index);
+  AddOccurrence(Words(2), 2, 40, 50, 0.1, &index);
+  AddOccurrence(Words(2, 3), 1, 12, 30, 0.7, &index);
+  AddOccurrence(Words(3), 3, 0, 5, 2.0, &index);
+  AddOccurrence(Words(3), 1, 22, 30, 0.2, &index);
+  AddOccurrence(Words(1, 2, 3), 1, 0, 30, 0.4, &index);
+  KwsInvertedIndexBuilder builder(2);
+  builder.AddIndex(index);
+  builder.Finish(inverted_index);
+}
+
+void UnitTestFindPrefix() {
+  KwsInvertedIndex inverted_index;
+  MakeTestIndex(&inverted_index);
+  KALDI_ASSERT(inverted_index.MaxOrder() == 2 &&
+               inverted_index.NumNgrams() == 5 &&
+               inverted_index.NumPostings() == 8);
+  std::vector<int32> words;
+  inverted_index.GetNgram(1, &words);
+  KALDI_ASSERT(words == Words(1, 2));
+  inverted_index.GetNgram(4, &words);
+  KALDI_ASSERT(words == Words(3));
+
+  int32 begin, end;
+  inverted_index.FindPrefix(std::vector<int32>(), &begin, &end);
+  KALDI_ASSERT(begin == 0 && end == 5);
+  inverted_index.FindPrefix(Words(1), &begin, &end);
+  KALDI_ASSERT(begin == 0 && end == 2);
+  inverted_index.FindPrefix(Words(2), &begin, &end);
+  KALDI_ASSERT(begin == 2 && end == 4);
+  inverted_index.FindPrefix(Words(2, 3), &begin, &end);
+  KALDI_ASSERT(begin == 3 && end == 4);
+  inverted_index.FindPrefix(Words(1, 2, 3), &begin, &end);
+  KALDI_ASSERT(begin == end);
+  inverted_index.FindPrefix(Words(0), &begin, &end);
+  KALDI_ASSERT(begin == 0 && end == 0);
+  inverted_index.FindPrefix(Words(4), &begin, &end);
+  KALDI_ASSERT(begin == 5 && end == 5);
+}
+
+void UnitTestFindNgram() {
+  KwsInvertedIndex inverted_index;
+  MakeTestIndex(&inverted_index);
+  KALDI_ASSERT(inverted_index.FindNgram(Words(1)) == 0);
+  KALDI_ASSERT(inverted_index.FindNgram(Words(1, 2)) == 1);
+  KALDI_ASSERT(inverted_index.FindNgram(Words(3)) == 4);
+  KALDI_ASSERT(inverted_index.FindNgram(Words(2, 1)) == -1);
+  KALDI_ASSERT(inverted_index.FindNgram(Words(1, 3)) == -1);
+  KALDI_ASSERT(inverted_index.FindNgram(Words(1, 2, 3)) == -1);
+  KALDI_ASSERT(inverted_index.FindNgram(Words(4)) == -1);
+
+  // The postings are sorted on utterance id.
+  std::vector<KwsSearchResult> postings;
+  inverted_index.GetPostings(inverted_index.FindNgram(Words(1)), &postings);
+  KALDI_ASSERT(postings.size() == 2);
+  AssertEqual(postings[0], KwsSearchResult(1, 0, 10, 0.5));
+  AssertEqual(postings[1], KwsSearchResult(2, 5, 15, 1.0));
+}
+
+void UnitTestJoinPostings() {
+  std::vector<KwsSearchResult> a, b, out;
+  a.push_back(KwsSearchResult(1, 0, 10, 1.0));
+  a.push_back(KwsSearchResult(1, 20, 30, 2.0));
+  a.push_back(KwsSearchResult(3, 0, 5, 0.5));
+  b.push_back(KwsSearchResult(1, 12, 15, 0.5));
+  b.push_back(KwsSearchResult(2, 0, 1, 1.0));
+  b.push_back(KwsSearchResult(3, 5, 9, 0.25));
+  b.push_back(KwsSearchResult(3, 8, 9, 0.25));
+  out.push_back(KwsSearchResult(7, 0, 0, 0.0));  // should be cleared.
+  JoinPostings(a, b, 2, &out);
+  KALDI_ASSERT(out.size() == 2);
+  AssertEqual(out[0], KwsSearchResult(1, 0, 15, 1.5));
+  AssertEqual(out[1], KwsSearchResult(3, 0, 9, 0.75));
+
+  JoinPostings(a, b, 1, &out);
+  KALDI_ASSERT(out.size() == 1);
+  AssertEqual(out[0], KwsSearchResult(3, 0, 9, 0.75));
+
+  JoinPostings(a, b, 3, &out);
+  KALDI_ASSERT(out.size() == 3);
+  AssertEqual(out[2], KwsSearchResult(3, 0, 9, 0.75));
+
+  JoinPostings(a, std::vector<KwsSearchResult>(), 100, &out);
+  KALDI_ASSERT(out.empty());
+}
+
+void UnitTestSearch() {
+  KwsInvertedIndex inverted_index;
+  MakeTestIndex(&inverted_index);
+  std::vector<KwsSearchResult> results;
+
+  // A word sequence in the index; results best first.
+  inverted_index.Search(Words(1), 5, -1, &results);
+  KALDI_ASSERT(results.size() == 2);
+  AssertEqual(results[0], KwsSearchResult(1, 0, 10, 0.5));
+  AssertEqual(results[1], KwsSearchResult(2, 5, 15, 1.0));
+
+  // n-best; Search() appends to "results".
+  inverted_index.Search(Words(2), 5, 1, &results);
+  KALDI_ASSERT(results.size() == 3);
+  AssertEqual(results[2], KwsSearchResult(2, 40, 50, 0.1));
+
+  results.clear();
+  inverted_index.Search(Words(1, 2), 5, -1, &results);
+  KALDI_ASSERT(results.size() == 1);
+  AssertEqual(results[0], KwsSearchResult(1, 0, 20, 0.3));
+
+  // Longer than MaxOrder(): [1 2] joined with [3], 2 frames later.
+  results.clear();
+  inverted_index.Search(Words(1, 2, 3), 5, -1, &results);
+  KALDI_ASSERT(results.size() == 1);
+  AssertEqual(results[0], KwsSearchResult(1, 0, 30, 0.5));
+  results.clear();
+  inverted_index.Search(Words(1, 2, 3), 1, -1, &results);
+  KALDI_ASSERT(results.empty());
+
+  // Not in the index.
+  inverted_index.Search(Words(4), 5, -1, &results);
+  KALDI_ASSERT(results.empty());
+  inverted_index.Search(Words(3, 1, 2), 5, -1, &results);
+  KALDI_ASSERT(results.empty());
+}
+
+void UnitTestReadWrite(bool binary) {
+  KwsInvertedIndex inverted_index;
+  MakeTestIndex(&inverted_index);
+  std::ostringstream os;
+  inverted_index.Write(os, binary);
+  KwsInvertedIndex inverted_index2;
+  std::istringstream is(os.str());
+  inverted_index2.Read(is, binary);
+
+  KALDI_ASSERT(inverted_index2.MaxOrder() == inverted_index.MaxOrder() &&
+               inverted_index2.NumNgrams() == inverted_index.NumNgrams() &&
+               inverted_index2.NumPostings() == inverted_index.NumPostings());
+  for (int32 i = 0; i < inverted_index.NumNgrams(); i++) {
+    std::vector<int32> words, words2;
+    inverted_index.GetNgram(i, &words);
+    inverted_index2.GetNgram(i, &words2);
+    KALDI_ASSERT(words == words2);
+    std::vector<KwsSearchResult> postings, postings2;
+    inverted_index.GetPostings(i, &postings);
+    inverted_index2.GetPostings(i, &postings2);
+    KALDI_ASSERT(postings.size() == postings2.size());
+    for (size_t p = 0; p < postings.size(); p++)
+      AssertEqual(postings[p], postings2[p]);
+  }
+
+  // An empty index can be written and read too.
+  KwsInvertedIndex empty_index;
+  std::ostringstream os2;
+  empty_index.Write(os2, binary);
+  std::istringstream is2(os2.str());
+  inverted_index2.Read(is2, binary);
+  KALDI_ASSERT(inverted_index2.NumNgrams() == 0 &&
+               inverted_index2.NumPostings() == 0);
+}
+
+// Checks that Read() rejects an index whose offsets are out of order or do
+// not start at zero, or whose MaxOrder() is negative.
+void UnitTestReadCorrupted() {
+  KwsInvertedIndex inverted_index;
+  MakeTestIndex(&inverted_index);
+  std::ostringstream os;
+  inverted_index.Write(os, false);
+  // The word sequences are [1], [1 2], [2], [2 3], [3], so the ngram offsets
+  // are 0 1 3 4 6 7.
+  std::string from[3] = { "<NgramOffsets> [ 0 1 3 ", "<PostingOffsets> [ 0 ",
+                          "<MaxOrder> 2 " },
+      to[3] = { "<NgramOffsets> [ 0 4 3 ", "<PostingOffsets> [ 1 ",
+                "<MaxOrder> -2 " };
+  for (int32 i = 0; i < 3; i++) {
+    std::string str = os.str();
+    size_t pos = str.find(from[i]);
+    KALDI_ASSERT(pos != std::string::npos);
+    str.replace(pos, from[i].size(), to[i]);
+    std::istringstream is(str);
+    KwsInvertedIndex inverted_index2;
+    bool threw = false;
+    try {
+      inverted_index2.Read(is, false);
+    } catch (const std::runtime_error &e) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw);
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestFindPrefix();
+  UnitTestFindNgram();
+  UnitTestJoinPostings();
+  UnitTestSearch();
+  for (int32 i = 0; i < 2; i++)
+    UnitTestReadWrite(i == 0);
+  UnitTestReadCorrupted();
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -0,0 +1,316 @@
+// kws/kws-inverted-index.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "kws/kws-inverted-index.h"
+
+namespace kaldi {
+
+int32 KwsInvertedIndex::ComparePrefix(int32 i,
+                                      const std::vector<int32> &prefix) const {
+  const int32 *words = (ngram_words_.empty() ? NULL :
+                        &(ngram_words_[0]) + ngram_offsets_[i]);
+  int32 length = ngram_offsets_[i + 1] - ngram_offsets_[i];
+  for (size_t k = 0; k < prefix.size(); k++) {
+    if (static_cast<int32>(k) == length) return -1;
+    if (words[k] != prefix[k])
+      return (words[k] < prefix[k] ? -1 : 1);
+  }
+  return 0;
+}
+
+void KwsInvertedIndex::FindPrefix(const std::vector<int32> &prefix,
+                                  int32 *begin, int32 *end) const {
+  // Binary search for the first sequence that does not compare less, and
+  // the first that compares greater.
+  int32 lo = 0, hi = NumNgrams();
+  while (lo < hi) {
+    int32 mid = lo + (hi - lo) / 2;
+    if (ComparePrefix(mid, prefix) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  *begin = lo;
+  hi = NumNgrams();
+  while (lo < hi) {
+    int32 mid = lo + (hi - lo) / 2;
+    if (ComparePrefix(mid, prefix) <= 0) lo = mid + 1;
+    else hi = mid;
+  }
+  *end = lo;
+}
+
+int32 KwsInvertedIndex::FindNgram(const std::vector<int32> &words) const {
+  int32 begin, end;
+  FindPrefix(words, &begin, &end);
+  // If "words" is there it comes first, as it is a prefix of the others.
+  if (begin < end && ngram_offsets_[begin + 1] - ngram_offsets_[begin] ==
+      static_cast<int32>(words.size()))
+    return begin;
+  return -1;
+}
+
+void KwsInvertedIndex::GetNgram(int32 i, std::vector<int32> *words) const {
+  KALDI_ASSERT(i >= 0 && i < NumNgrams());
+  words->assign(ngram_words_.begin() + ngram_offsets_[i],
+                ngram_words_.begin() + ngram_offsets_[i + 1]);
+}
+
+void KwsInvertedIndex::GetPostings(
+    int32 i, std::vector<KwsSearchResult> *postings) const {
+  KALDI_ASSERT(i >= 0 && i < NumNgrams());
+  for (int32 p = posting_offsets_[i]; p < posting_offsets_[i + 1]; p++)
+    postings->push_back(KwsSearchResult(posting_utts_[p], posting_starts_[p],
+                                        posting_ends_[p],
+                                        posting_scores_(p)));
+}
+
+void JoinPostings(const std::vector<KwsSearchResult> &a,
+                  const std::vector<KwsSearchResult> &b,
+                  int32 max_gap,
+                  std::vector<KwsSearchResult> *out) {
+  out->clear();
+  size_t j = 0;
+  for (size_t i = 0; i < a.size(); ) {
+    int32 utt = a[i].utterance_id;
+    size_t i_end = i;
+    while (i_end < a.size() && a[i_end].utterance_id == utt) i_end++;
+    while (j < b.size() && b[j].utterance_id < utt) j++;
+    size_t j_end = j;
+    while (j_end < b.size() && b[j_end].utterance_id == utt) j_end++;
+    for (size_t ii = i; ii < i_end; ii++) {
+      for (size_t jj = j; jj < j_end; jj++) {
+        int32 gap = b[jj].start_frame - a[ii].end_frame;
+        if (gap >= 0 && gap <= max_gap)
+          out->push_back(KwsSearchResult(utt, a[ii].start_frame,
+                                         b[jj].end_frame,
+                                         a[ii].score + b[jj].score));
+      }
+    }
+    i = i_end;
+    j = j_end;
+  }
+}
+
+void KwsInvertedIndex::Search(const std::vector<int32> &words,
+                              int32 max_gap, int32 n_best,
+                              std::vector<KwsSearchResult> *results) const {
+  KALDI_ASSERT(!words.empty() && max_order_ > 0);
+  std::vector<KwsSearchResult> cur, next, joined;
+  for (size_t pos = 0; pos < words.size(); pos += max_order_) {
+    std::vector<int32> piece(words.begin() + pos,
+                             words.begin() + std::min(words.size(),
+                                                      pos + max_order_));
+    int32 i = FindNgram(piece);
+    if (i == -1) return;  // no occurrences.
+    if (pos == 0) {
+      GetPostings(i, &cur);
+    } else {
+      next.clear();
+      GetPostings(i, &next);
+      JoinPostings(cur, next, max_gap, &joined);
+      cur.swap(joined);
+    }
+    if (cur.empty()) return;
+  }
+  std::stable_sort(cur.begin(), cur.end());
+  if (n_best != -1 && cur.size() > static_cast<size_t>(n_best))
+    cur.resize(n_best);
+  results->insert(results->end(), cur.begin(), cur.end());
+}
+
+void KwsInvertedIndex::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<KwsInvertedIndex>");
+  WriteToken(os, binary, "<MaxOrder>");
+  WriteBasicType(os, binary, max_order_);
+  WriteToken(os, binary, "<NgramOffsets>");
+  WriteIntegerVector(os, binary, ngram_offsets_);
+  WriteToken(os, binary, "<NgramWords>");
+  WriteIntegerVector(os, binary, ngram_words_);
+  WriteToken(os, binary, "<PostingOffsets>");
+  WriteIntegerVector(os, binary, posting_offsets_);
+  WriteToken(os, binary, "<PostingUtts>");
+  WriteIntegerVector(os, binary, posting_utts_);
+  WriteToken(os, binary, "<PostingStarts>");
+  WriteIntegerVector(os, binary, posting_starts_);
+  WriteToken(os, binary, "<PostingEnds>");
+  WriteIntegerVector(os, binary, posting_ends_);
+  WriteToken(os, binary, "<PostingScores>");
+  posting_scores_.Write(os, binary);
+  WriteToken(os, binary, "</KwsInvertedIndex>");
+}
+
+void KwsInvertedIndex::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<KwsInvertedIndex>");
+  ExpectToken(is, binary, "<MaxOrder>");
+  ReadBasicType(is, binary, &max_order_);
+  ExpectToken(is, binary, "<NgramOffsets>");
+  ReadIntegerVector(is, binary, &ngram_offsets_);
+  ExpectToken(is, binary, "<NgramWords>");
+  ReadIntegerVector(is, binary, &ngram_words_);
+  ExpectToken(is, binary, "<PostingOffsets>");
+  ReadIntegerVector(is, binary, &posting_offsets_);
+  ExpectToken(is, binary, "<PostingUtts>");
+  ReadIntegerVector(is, binary, &posting_utts_);
+  ExpectToken(is, binary, "<PostingStarts>");
+  ReadIntegerVector(is, binary, &posting_starts_);
+  ExpectToken(is, binary, "<PostingEnds>");
+  ReadIntegerVector(is, binary, &posting_ends_);
+  ExpectToken(is, binary, "<PostingScores>");
+  posting_scores_.Read(is, binary);
+  ExpectToken(is, binary, "</KwsInvertedIndex>");
+  size_t num_postings = posting_utts_.size();
+  if (ngram_offsets_.empty() ||
+      ngram_offsets_.size() != posting_offsets_.size() ||
+      ngram_offsets_.back() != static_cast<int32>(ngram_words_.size()) ||
+      posting_offsets_.back() != static_cast<int32>(num_postings) ||
+      posting_starts_.size() != num_postings ||
+      posting_ends_.size() != num_postings ||
+      posting_scores_.Dim() != static_cast<MatrixIndexT>(num_postings))
+    KALDI_ERR << "Inconsistent KwsInvertedIndex read.";
+  // The lookup code does not check the offsets, so make sure they can't make
+  // it index outside the arrays.  Together with the checks above, this means
+  // each offset is within its array.
+  if (max_order_ < 0 || ngram_offsets_[0] != 0 || posting_offsets_[0] != 0)
+    KALDI_ERR << "Corrupted KwsInvertedIndex read.";
+  for (size_t i = 1; i < ngram_offsets_.size(); i++)
+    if (ngram_offsets_[i] < ngram_offsets_[i - 1] ||
+        posting_offsets_[i] < posting_offsets_[i - 1])
+      KALDI_ERR << "Corrupted KwsInvertedIndex read: offsets of word "
+                << "sequence " << (i - 1) << " are not in order.";
+}
+
+
+KwsInvertedIndexBuilder::KwsInvertedIndexBuilder(int32 max_order):
+    max_order_(max_order) {
+  KALDI_ASSERT(max_order > 0);
+}
+
+void KwsInvertedIndexBuilder::AddIndex(const KwsLexicographicFst &index) {
+  if (index.Start() == fst::kNoStateId) return;
+  std::vector<int32> words;
+  AddPaths(index, index.Start(), 0.0, 0.0, 0.0, &words);
+}
+
+void KwsInvertedIndexBuilder::AddPaths(const KwsLexicographicFst &index,
+                                       KwsLexicographicArc::StateId s,
+                                       double score, double start, double end,
+                                       std::vector<int32> *words) {
+  // The paths of the index are a word sequence followed by an arc to a final
+  // state, with a disambiguation symbol and the utterance id on it (see
+  // DoFactorDisambiguation()).  The weights are in the T*T*T semiring, where
+  // Times() adds each of the three parts.
+  for (fst::ArcIterator<KwsLexicographicFst> aiter(index, s); !aiter.Done();
+       aiter.Next()) {
+    const KwsLexicographicArc &arc = aiter.Value();
+    double arc_score = score + arc.weight.Value1().Value(),
+        arc_start = start + arc.weight.Value2().Value1().Value(),
+        arc_end = end + arc.weight.Value2().Value2().Value();
+    const KwsLexicographicWeight &final_weight = index.Final(arc.nextstate);
+    if (final_weight != KwsLexicographicWeight::Zero()) {
+      if (words->empty()) continue;
+      Posting posting;
+      posting.utterance_id = arc.olabel;
+      posting.start_frame = static_cast<int32>(
+          arc_start + final_weight.Value2().Value1().Value());
+      posting.end_frame = static_cast<int32>(
+          arc_end + final_weight.Value2().Value2().Value());
+      posting.score = arc_score + final_weight.Value1().Value();
+      std::pair<unordered_map<std::vector<int32>, int32,
+                              VectorHasher<int32> >::iterator, bool> ret =
+          ngram_ids_.insert(std::make_pair(*words, ngrams_.size()));
+      if (ret.second) {
+        ngrams_.push_back(*words);
+        postings_.resize(postings_.size() + 1);
+      }
+      postings_[ret.first->second].push_back(posting);
+    } else if (arc.ilabel == 0) {
+      AddPaths(index, arc.nextstate, arc_score, arc_start, arc_end, words);
+    } else if (static_cast<int32>(words->size()) < max_order_) {
+      words->push_back(arc.ilabel);
+      AddPaths(index, arc.nextstate, arc_score, arc_start, arc_end, words);
+      words->pop_back();
+    }
+  }
+}
+
+void KwsInvertedIndexBuilder::Finish(KwsInvertedIndex *inverted_index) {
+  std::vector<int32> order(ngrams_.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  NgramCompare compare;
+  compare.ngrams = &ngrams_;
+  std::sort(order.begin(), order.end(), compare);
+
+  KwsInvertedIndex &ans = *inverted_index;
+  ans.max_order_ = max_order_;
+  ans.ngram_offsets_.assign(1, 0);
+  ans.ngram_words_.clear();
+  ans.posting_offsets_.assign(1, 0);
+  ans.posting_utts_.clear();
+  ans.posting_starts_.clear();
+  ans.posting_ends_.clear();
+  std::vector<BaseFloat> scores;
+  for (size_t i = 0; i < order.size(); i++) {
+    const std::vector<int32> &words = ngrams_[order[i]];
+    std::vector<Posting> &postings = postings_[order[i]];
+    std::sort(postings.begin(), postings.end());
+    ans.ngram_words_.insert(ans.ngram_words_.end(), words.begin(),
+                            words.end());
+    ans.ngram_offsets_.push_back(ans.ngram_words_.size());
+    for (size_t p = 0; p < postings.size(); p++) {
+      ans.posting_utts_.push_back(postings[p].utterance_id);
+      ans.posting_starts_.push_back(postings[p].start_frame);
+      ans.posting_ends_.push_back(postings[p].end_frame);
+      scores.push_back(postings[p].score);
+    }
+    ans.posting_offsets_.push_back(ans.posting_utts_.size());
+  }
+  ans.posting_scores_.Resize(scores.size(), kUndefined);
+  for (size_t p = 0; p < scores.size(); p++)
+    ans.posting_scores_(p) = scores[p];
+}
+
+
+bool GetLinearKeyword(const fst::VectorFst<fst::StdArc> &keyword,
+                      std::vector<int32> *words, double *cost) {
+  typedef fst::StdArc::StateId StateId;
+  words->clear();
+  *cost = 0.0;
+  StateId s = keyword.Start();
+  // The number of steps is limited in case of cycles.
+  for (StateId step = 0; s != fst::kNoStateId && step <= keyword.NumStates();
+       step++) {
+    if (keyword.Final(s) != fst::TropicalWeight::Zero()) {
+      if (keyword.NumArcs(s) != 0) return false;
+      *cost += keyword.Final(s).Value();
+      return !words->empty();
+    }
+    if (keyword.NumArcs(s) != 1) return false;
+    fst::ArcIterator<fst::VectorFst<fst::StdArc> > aiter(keyword, s);
+    const fst::StdArc &arc = aiter.Value();
+    if (arc.ilabel != arc.olabel) return false;
+    if (arc.ilabel != 0)
+      words->push_back(arc.ilabel);
+    *cost += arc.weight.Value();
+    s = arc.nextstate;
+  }
+  return false;
+}
+
+}  // namespace kaldi
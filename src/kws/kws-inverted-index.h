@@ -0,0 +1,167 @@
+// kws/kws-inverted-index.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_KWS_KWS_INVERTED_INDEX_H_
+#define KALDI_KWS_KWS_INVERTED_INDEX_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-vector.h"
+#include "util/stl-utils.h"
+#include "kws/kaldi-kws.h"
+#include "kws/kws-functions.h"
+
+namespace kaldi {
+
+// KwsInvertedIndex is an alternative to searching the index FST (see
+// KwsIndexSearcher), for which the time to search for a keyword does not
+// depend on the size of the index.  For each word sequence of up to
+// MaxOrder() words that occurs in the index, it stores the list of its
+// occurrences (utterance id, start frame, end frame, score), which are the
+// same as KwsIndexSearcher would find for that word sequence.  The word
+// sequences are sorted, so you can also look up all the word sequences that
+// start with a given prefix.  Keywords longer than MaxOrder() words are
+// searched for by joining the occurrences of their pieces, requiring each
+// piece to start at most "max_gap" frames after the previous one ends; the
+// scores of these are approximate (the product of the pieces' posteriors).
+// Use KwsInvertedIndexBuilder to create it.
+class KwsInvertedIndex {
+ public:
+  KwsInvertedIndex(): max_order_(0), ngram_offsets_(1, 0),
+                      posting_offsets_(1, 0) { }
+
+  int32 MaxOrder() const { return max_order_; }
+  int32 NumNgrams() const { return ngram_offsets_.size() - 1; }
+  int32 NumPostings() const { return posting_utts_.size(); }
+
+  // Outputs the range [*begin, *end) of the (sorted) word sequences that
+  // start with "prefix", which may be empty.
+  void FindPrefix(const std::vector<int32> &prefix,
+                  int32 *begin, int32 *end) const;
+
+  // Returns the index of the word sequence "words", or -1 if it does not
+  // occur.
+  int32 FindNgram(const std::vector<int32> &words) const;
+
+  // Outputs the i'th word sequence.
+  void GetNgram(int32 i, std::vector<int32> *words) const;
+
+  // Appends the occurrences of the i'th word sequence to "postings"; they
+  // are sorted on utterance id and then start frame.
+  void GetPostings(int32 i, std::vector<KwsSearchResult> *postings) const;
+
+  // Searches for the word sequence "words" (see the comment above the class
+  // for keywords longer than MaxOrder()), and appends the occurrences found
+  // to "results", best first; if n_best != -1, only the n_best best.
+  void Search(const std::vector<int32> &words, int32 max_gap, int32 n_best,
+              std::vector<KwsSearchResult> *results) const;
+
+  void Write(std::ostream &os, bool binary) const;
+  void Read(std::istream &is, bool binary);
+
+ private:
+  friend class KwsInvertedIndexBuilder;
+
+  // Compares the first prefix.size() words of the i'th word sequence with
+  // "prefix", returning -1, 0 or 1; a sequence shorter than "prefix" that
+  // matches as far as it goes compares less.
+  int32 ComparePrefix(int32 i, const std::vector<int32> &prefix) const;
+
+  int32 max_order_;
+  // The words of the i'th word sequence are ngram_words_[ngram_offsets_[i]]
+  // to ngram_words_[ngram_offsets_[i+1] - 1].
+  std::vector<int32> ngram_offsets_;
+  std::vector<int32> ngram_words_;
+  // The occurrences of the i'th word sequence are numbered
+  // posting_offsets_[i] to posting_offsets_[i+1] - 1 in the arrays below.
+  std::vector<int32> posting_offsets_;
+  std::vector<int32> posting_utts_;
+  std::vector<int32> posting_starts_;
+  std::vector<int32> posting_ends_;
+  Vector<BaseFloat> posting_scores_;
+};
+
+// Creates a KwsInvertedIndex from the index FSTs created by
+// lattice-to-kws-index (or kws-index-union, or the shards of it).
+class KwsInvertedIndexBuilder {
+ public:
+  explicit KwsInvertedIndexBuilder(int32 max_order);
+
+  // Adds the occurrences of all the word sequences of up to max_order words
+  // in "index".
+  void AddIndex(const KwsLexicographicFst &index);
+
+  // Outputs the inverted index of everything added so far.
+  void Finish(KwsInvertedIndex *inverted_index);
+
+ private:
+  struct Posting {
+    int32 utterance_id;
+    int32 start_frame;
+    int32 end_frame;
+    BaseFloat score;
+    bool operator < (const Posting &other) const {
+      if (utterance_id != other.utterance_id)
+        return utterance_id < other.utterance_id;
+      if (start_frame != other.start_frame)
+        return start_frame < other.start_frame;
+      return end_frame < other.end_frame;
+    }
+  };
+
+  // Adds the word sequences of the paths from state "s", given the words and
+  // the weight (in its three parts) of the path to "s".
+  void AddPaths(const KwsLexicographicFst &index,
+                KwsLexicographicArc::StateId s, double score, double start,
+                double end, std::vector<int32> *words);
+
+  // Orders word sequences by their words, given their indexes into ngrams_.
+  struct NgramCompare {
+    const std::vector<std::vector<int32> > *ngrams;
+    bool operator () (int32 i, int32 j) const {
+      return (*ngrams)[i] < (*ngrams)[j];
+    }
+  };
+
+  int32 max_order_;
+  unordered_map<std::vector<int32>, int32, VectorHasher<int32> > ngram_ids_;
+  std::vector<std::vector<int32> > ngrams_;  // indexed by id.
+  std::vector<std::vector<Posting> > postings_;  // indexed by id.
+};
+
+// Outputs the occurrences in "a" joined with those in "b" that start at most
+// "max_gap" frames after they end, in the same utterance, with the scores
+// added.  Both must be grouped by utterance, in increasing order of
+// utterance id, as the output of KwsInvertedIndex::GetPostings() is.  This
+// is used by KwsInvertedIndex::Search() for keywords longer than MaxOrder().
+void JoinPostings(const std::vector<KwsSearchResult> &a,
+                  const std::vector<KwsSearchResult> &b,
+                  int32 max_gap,
+                  std::vector<KwsSearchResult> *out);
+
+// If "keyword" is a single path of words, as it is for in-vocabulary
+// keywords (but not, for instance, for proxy keywords), outputs its words and
+// its cost and returns true; otherwise returns false.
+bool GetLinearKeyword(const fst::VectorFst<fst::StdArc> &keyword,
+                      std::vector<int32> *words, double *cost);
+
+}  // namespace kaldi
+
+#endif  // KALDI_KWS_KWS_INVERTED_INDEX_H_
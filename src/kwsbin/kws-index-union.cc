@@ -23,6 +23,66 @@
 #include "fstext/fstext-utils.h"
 #include "kws/kaldi-kws.h"
 #include "kws/kws-functions.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+typedef TableWriter< fst::VectorFstTplHolder<KwsLexicographicArc> >
+    KwsIndexWriter;
+
+// Optimizes one index (or shard of the index) and writes it; this is run by
+// TaskSequencer, so the optimization of several shards may be done in
+// parallel, and they are written in order.
+class IndexUnionJob {
+ public:
+  // Takes ownership of "index".
+  IndexUnionJob(bool skip_opt, int32 max_states, const std::string &key,
+                KwsLexicographicFst *index, KwsIndexWriter *writer):
+      skip_opt_(skip_opt), max_states_(max_states), key_(key), index_(index),
+      writer_(writer) { }
+
+  void operator () () {
+    if (skip_opt_) {
+      KALDI_LOG << "Skipping index optimization...";
+      return;
+    }
+    using namespace fst;
+    // Do the encoded epsilon removal, determinization and minimization
+    KwsLexicographicFst ifst = *index_;
+    EncodeMapper<KwsLexicographicArc> encoder(kEncodeLabels, ENCODE);
+    Encode(&ifst, &encoder);
+    try {
+      DeterminizeStar(ifst, index_, kDelta, NULL, max_states_);
+    } catch(const std::exception &e) {
+      KALDI_WARN << e.what()
+                 << " (should affect speed of search but not results)";
+      *index_ = ifst;
+    }
+    Minimize(index_);
+    Decode(index_, encoder);
+  }
+
+  ~IndexUnionJob() {
+    writer_->Write(key_, *index_);
+    delete index_;
+  }
+
+ private:
+  bool skip_opt_;
+  int32 max_states_;
+  std::string key_;
+  KwsLexicographicFst *index_;
+  KwsIndexWriter *writer_;
+};
+
+// Returns the key of the n'th shard, e.g. "global.1".
+std::string ShardKey(int32 n) {
+  std::ostringstream os;
+  os << "global." << n;
+  return os.str();
+}
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -35,6 +95,11 @@ int main(int argc, char *argv[]) {
         "Take a union of the indexed lattices. The input index is in the T*T*T semiring and\n"
         "the output index is also in the T*T*T semiring. At the end of this program, encoded\n"
         "epsilon removal, determinization and minimization will be applied.\n"
+        "If --shard-size is set, instead of one index with key \"global\", it writes\n"
+        "shards with keys \"global.1\", \"global.2\" and so on, each of which is the\n"
+        "union of --shard-size input indices.  This avoids building (and optimizing) one\n"
+        "very large index, and the shards can be searched in parallel by kws-search.\n"
+        "The shards are optimized in parallel if --num-threads > 1.\n"
         "\n"
         "Usage: kws-index-union [options]  index-rspecifier index-wspecifier\n"
         " e.g.: kws-index-union ark:input.idx ark:global.idx\n";
@@ -44,9 +109,14 @@ int main(int argc, char *argv[]) {
     bool strict = true;
     bool skip_opt = false;
     int32 max_states = -1;
+    int32 shard_size = 0;
+    TaskSequencerConfig sequencer_config;
     po.Register("strict", &strict, "Will allow 0 lattice if it is set to false.");
     po.Register("skip-optimization", &skip_opt, "Skip optimization if it's set to true.");
     po.Register("max-states", &max_states, "Maximum states for DeterminizeStar.");
+    po.Register("shard-size", &shard_size, "If > 0, write the index in shards "
+                "that are each the union of this many input indices.");
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -59,42 +129,49 @@ int main(int argc, char *argv[]) {
         index_wspecifier = po.GetOptArg(2);
 
     SequentialTableReader< VectorFstTplHolder<KwsLexicographicArc> > index_reader(index_rspecifier);
-    TableWriter< VectorFstTplHolder<KwsLexicographicArc> > index_writer(index_wspecifier);
-
-    int32 n_done = 0;
-    KwsLexicographicFst global_index;
-    for (; !index_reader.Done(); index_reader.Next()) {
-      std::string key = index_reader.Key();
-      KwsLexicographicFst index = index_reader.Value();
-      index_reader.FreeCurrent();
-
-      Union(&global_index, index);
-
-      n_done++;
-    }
-
-    if (skip_opt == false) {
-      // Do the encoded epsilon removal, determinization and minimization
-      KwsLexicographicFst ifst = global_index;
-      EncodeMapper<KwsLexicographicArc> encoder(kEncodeLabels, ENCODE);
-      Encode(&ifst, &encoder);
-      try {
-        DeterminizeStar(ifst, &global_index, kDelta, NULL, max_states);
-      } catch(const std::exception &e) {
-        KALDI_WARN << e.what()
-                   << " (should affect speed of search but not results)";
-        global_index = ifst;
+    KwsIndexWriter index_writer(index_wspecifier);
+
+    int32 n_done = 0, n_shards = 0, shard_n_done = 0;
+    KwsLexicographicFst *global_index = new KwsLexicographicFst();
+    {
+      TaskSequencer<IndexUnionJob> sequencer(sequencer_config);
+      for (; !index_reader.Done(); index_reader.Next()) {
+        std::string key = index_reader.Key();
+        KwsLexicographicFst index = index_reader.Value();
+        index_reader.FreeCurrent();
+
+        Union(global_index, index);
+
+        n_done++;
+        shard_n_done++;
+        if (shard_size > 0 && shard_n_done == shard_size) {
+          n_shards++;
+          sequencer.Run(new IndexUnionJob(skip_opt, max_states,
+                                          ShardKey(n_shards),
+                                          global_index, &index_writer));
+          global_index = new KwsLexicographicFst();
+          shard_n_done = 0;
+        }
       }
-      Minimize(&global_index);
-      Decode(&global_index, encoder);
-    } else {
-      KALDI_LOG << "Skipping index optimization...";
+      if (shard_size <= 0) {
+        sequencer.Run(new IndexUnionJob(skip_opt, max_states, "global",
+                                        global_index, &index_writer));
+      } else if (shard_n_done > 0) {
+        n_shards++;
+        sequencer.Run(new IndexUnionJob(skip_opt, max_states,
+                                        ShardKey(n_shards),
+                                        global_index, &index_writer));
+      } else {
+        delete global_index;
+      }
+      sequencer.Wait();
     }
 
-    // Write the result
-    index_writer.Write("global", global_index);
-
-    KALDI_LOG << "Done " << n_done << " indices";
+    if (shard_size > 0)
+      KALDI_LOG << "Done " << n_done << " indices in " << n_shards
+                << " shards";
+    else
+      KALDI_LOG << "Done " << n_done << " indices";
     if (strict == true)
       return (n_done != 0 ? 0 : 1);
     else
@@ -0,0 +1,82 @@
+// kwsbin/kws-make-inverted-index.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "kws/kaldi-kws.h"
+#include "kws/kws-inverted-index.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Create an inverted index from KWS indices (from lattice-to-kws-index or\n"
+        "kws-index-union): for each word sequence of up to --max-order words, the\n"
+        "list of its occurrences.  See kws-search --inverted-index.\n"
+        "\n"
+        "Usage: kws-make-inverted-index [options] index-rspecifier inverted-index-wxfilename\n"
+        " e.g.: kws-make-inverted-index ark:index.idx inverted.idx\n";
+
+    ParseOptions po(usage);
+
+    int32 max_order = 3;
+    bool binary = true;
+
+    po.Register("max-order", &max_order, "Maximum number of words in the "
+                "word sequences we store the occurrences of.");
+    po.Register("binary", &binary, "Write output in binary mode");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string index_rspecifier = po.GetArg(1),
+        inverted_index_wxfilename = po.GetArg(2);
+
+    SequentialTableReader< VectorFstTplHolder<KwsLexicographicArc> >
+        index_reader(index_rspecifier);
+
+    KwsInvertedIndexBuilder builder(max_order);
+    int32 n_done = 0;
+    for (; !index_reader.Done(); index_reader.Next()) {
+      builder.AddIndex(index_reader.Value());
+      index_reader.FreeCurrent();
+      n_done++;
+    }
+
+    KwsInvertedIndex inverted_index;
+    builder.Finish(&inverted_index);
+    WriteKaldiObject(inverted_index, inverted_index_wxfilename, binary);
+
+    KALDI_LOG << "Created inverted index of " << inverted_index.NumNgrams()
+              << " word sequences with " << inverted_index.NumPostings()
+              << " occurrences from " << n_done << " indices.";
+    return (n_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
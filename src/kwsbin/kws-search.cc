@@ -18,54 +18,37 @@
 // limitations under the License.
 
 
+#include <algorithm>
 #include "base/kaldi-common.h"
+#include "base/timer.h"
 #include "util/common-utils.h"
 #include "fstext/fstext-utils.h"
 #include "kws/kaldi-kws.h"
+#include "kws/kws-functions.h"
+#include "kws/kws-inverted-index.h"
+#include "thread/kaldi-thread.h"
+#include "thread/kaldi-thread-pool.h"
 
 namespace kaldi {
 
-typedef KwsLexicographicArc Arc;
-typedef Arc::Weight Weight;
-typedef Arc::StateId StateId;
-
-uint64 EncodeLabel(StateId ilabel,
-                   StateId olabel) {
-  return (((int64)olabel)<<32)+((int64)ilabel);
-
-}
-
-StateId DecodeLabelUid(uint64 osymbol) {
-  // We only need the utterance id
-  return ((StateId)(osymbol>>32));
-}
-
-class VectorFstToKwsLexicographicFstMapper {
- public:
-  typedef fst::StdArc FromArc;
-  typedef FromArc::Weight FromWeight;
-  typedef KwsLexicographicArc ToArc;
-  typedef KwsLexicographicWeight ToWeight;
-
-  VectorFstToKwsLexicographicFstMapper() {}
-
-  ToArc operator()(const FromArc &arc) const {
-    return ToArc(arc.ilabel, 
-                 arc.olabel,
-                 (arc.weight == FromWeight::Zero() ?
-                  ToWeight::Zero() :
-                  ToWeight(arc.weight.Value(),
-                           StdLStdWeight::One())),
-                 arc.nextstate);
+// Searches for all the keywords in one shard of the index.
+struct SearchShardTask {
+  const KwsIndexSearcher *searcher;
+  const std::vector<fst::VectorFst<fst::StdArc> > *keywords;
+  // Keywords for which this is true were answered from the inverted index.
+  const std::vector<bool> *skip;
+  int32 n_best;
+  std::vector<std::vector<KwsSearchResult> > results;  // indexed by keyword.
+
+  static void *Run(void *arg) {
+    SearchShardTask *task = static_cast<SearchShardTask*>(arg);
+    task->results.resize(task->keywords->size());
+    for (size_t i = 0; i < task->keywords->size(); i++)
+      if (!(*(task->skip))[i])
+        task->searcher->Search((*(task->keywords))[i], task->n_best,
+                               &(task->results[i]));
+    return NULL;
   }
-
-  fst::MapFinalAction FinalAction() const { return fst::MAP_NO_SUPERFINAL; }
-
-  fst::MapSymbolsAction InputSymbolsAction() const { return fst::MAP_COPY_SYMBOLS; }
-
-  fst::MapSymbolsAction OutputSymbolsAction() const { return fst::MAP_COPY_SYMBOLS;}
-
-  uint64 Properties(uint64 props) const { return props; }
 };
 
 }
@@ -77,14 +60,16 @@ int main(int argc, char *argv[]) {
     typedef kaldi::int32 int32;
     typedef kaldi::uint32 uint32;
     typedef kaldi::uint64 uint64;
-    typedef KwsLexicographicArc Arc;
-    typedef Arc::Weight Weight;
-    typedef Arc::StateId StateId;
 
     const char *usage =
         "Search the keywords over the index. This program can be executed parallely, either\n"
         "on the index side or the keywords side; we use a script to combine the final search\n"
-        "results. Note that the index archive has a only key \"global\".\n"
+        "results. The index archive normally has only the key \"global\", but it may\n"
+        "instead contain several shards (see kws-index-union --shard-size), which are\n"
+        "searched in parallel if --num-threads > 1.  With --inverted-index (see\n"
+        "kws-make-inverted-index), keywords that are a single word sequence are looked\n"
+        "up in the inverted index instead, and only the others (e.g. proxy keywords)\n"
+        "are searched for in the index.\n"
         "The output file is in the format:\n"
         "kw utterance_id beg_frame end_frame negated_log_probs\n"
         " e.g.: KW1 1 23 67 0.6074219\n"
@@ -99,7 +84,9 @@ int main(int argc, char *argv[]) {
     bool strict = true;
     double negative_tolerance = -0.1;
     double keyword_beam = -1;
-    
+    std::string inverted_index_rxfilename;
+    int32 max_word_gap = 50;
+
     po.Register("nbest", &n_best, "Return the best n hypotheses.");
     po.Register("keyword-nbest", &keyword_nbest,
                 "Pick the best n keywords if the FST contains multiple keywords.");
@@ -109,6 +96,14 @@ int main(int argc, char *argv[]) {
                 "than this tolerance.");
     po.Register("keyword-beam", &keyword_beam,
                 "Prune the FST with the given beam if the FST contains multiple keywords.");
+    po.Register("num-threads", &g_num_threads, "Number of threads used to "
+                "search the shards of a sharded index in parallel.");
+    po.Register("inverted-index", &inverted_index_rxfilename, "If supplied, "
+                "inverted index (from kws-make-inverted-index) in which to look "
+                "up keywords that are a single word sequence.");
+    po.Register("max-word-gap", &max_word_gap, "For keywords longer than the "
+                "order of the inverted index, the maximum number of frames "
+                "between the pieces we join.");
 
     if (n_best < 0 && n_best != -1) {
       KALDI_ERR << "Bad number for nbest";
@@ -134,55 +129,18 @@ int main(int argc, char *argv[]) {
         keyword_rspecifier = po.GetOptArg(2),
         result_wspecifier = po.GetOptArg(3);
 
-    RandomAccessTableReader< VectorFstTplHolder<KwsLexicographicArc> > index_reader(index_rspecifier);
     SequentialTableReader<VectorFstHolder> keyword_reader(keyword_rspecifier);
     TableWriter< BasicVectorHolder<double> > result_writer(result_wspecifier);
 
-    // Index has key "global"
-    KwsLexicographicFst index = index_reader.Value("global");
-    
-    // First we have to remove the disambiguation symbols. But rather than
-    // removing them totally, we actually move them from input side to output
-    // side, making the output symbol a "combined" symbol of the disambiguation
-    // symbols and the utterance id's.
-    // Note that in Dogan and Murat's original paper, they simply remove the
-    // disambiguation symbol on the input symbol side, which will not allow us
-    // to do epsilon removal after composition with the keyword FST. They have
-    // to traverse the resulting FST.
-    int32 label_count = 1;
-    unordered_map<uint64, uint32> label_encoder;
-    unordered_map<uint32, uint64> label_decoder;
-    for (StateIterator<KwsLexicographicFst> siter(index); !siter.Done(); siter.Next()) {
-      StateId state_id = siter.Value();
-      for (MutableArcIterator<KwsLexicographicFst> 
-           aiter(&index, state_id); !aiter.Done(); aiter.Next()) {
-        Arc arc = aiter.Value();
-        // Skip the non-final arcs
-        if (index.Final(arc.nextstate) == Weight::Zero())
-          continue;
-        // Encode the input and output label of the final arc, and this is the
-        // new output label for this arc; set the input label to <epsilon>
-        uint64 osymbol = EncodeLabel(arc.ilabel, arc.olabel);
-        arc.ilabel = 0;
-        if (label_encoder.find(osymbol) == label_encoder.end()) {
-          arc.olabel = label_count;
-          label_encoder[osymbol] = label_count;
-          label_decoder[label_count] = osymbol;
-          label_count++;
-        } else { 
-          arc.olabel = label_encoder[osymbol];
-        }
-        aiter.SetValue(arc);
-      }
-    }
-    ArcSort(&index, fst::ILabelCompare<KwsLexicographicArc>());
-    
-    int32 n_done = 0;
-    int32 n_fail = 0;
+    // Read the keywords.  We search for all of them in each shard, so we
+    // don't have to synchronize the threads for each keyword.
+    std::vector<std::string> keys;
+    std::vector<VectorFst<StdArc> > keywords;
     for (; !keyword_reader.Done(); keyword_reader.Next()) {
-      std::string key = keyword_reader.Key();
-      VectorFst<StdArc> keyword = keyword_reader.Value();
+      keys.push_back(keyword_reader.Key());
+      keywords.push_back(keyword_reader.Value());
       keyword_reader.FreeCurrent();
+      VectorFst<StdArc> &keyword = keywords.back();
 
       // Process the case where we have confusion for keywords
       if (keyword_beam != -1) {
@@ -193,40 +151,89 @@ int main(int argc, char *argv[]) {
         ShortestPath(keyword, &tmp, keyword_nbest, true, true);
         keyword = tmp;
       }
+    }
+
+    // Answer what we can from the inverted index.
+    std::vector<bool> skip(keywords.size(), false);
+    std::vector<std::vector<KwsSearchResult> > inverted_results(
+        keywords.size());
+    if (inverted_index_rxfilename != "") {
+      KwsInvertedIndex inverted_index;
+      ReadKaldiObject(inverted_index_rxfilename, &inverted_index);
+      Timer timer;
+      int32 num_inverted = 0;
+      for (size_t k = 0; k < keywords.size(); k++) {
+        std::vector<int32> words;
+        double cost;
+        if (!GetLinearKeyword(keywords[k], &words, &cost))
+          continue;
+        inverted_index.Search(words, max_word_gap, n_best,
+                              &(inverted_results[k]));
+        for (size_t i = 0; i < inverted_results[k].size(); i++)
+          inverted_results[k][i].score += cost;
+        skip[k] = true;
+        num_inverted++;
+      }
+      KALDI_LOG << "Searched for " << num_inverted << " of " << keywords.size()
+                << " keywords in the inverted index in " << timer.Elapsed()
+                << " seconds.";
+    }
 
-      KwsLexicographicFst keyword_fst;
-      KwsLexicographicFst result_fst;
-      Map(keyword, &keyword_fst, VectorFstToKwsLexicographicFstMapper());
-      Compose(keyword_fst, index, &result_fst);
-      Project(&result_fst, PROJECT_OUTPUT);
-      Minimize(&result_fst);
-      ShortestPath(result_fst, &result_fst, n_best);
-      RmEpsilon(&result_fst);
+    // Read the index, or the shards of it, and prepare them for searching;
+    // we don't need them if all the keywords were looked up in the inverted
+    // index.
+    std::vector<KwsIndexSearcher*> searchers;
+    if (std::find(skip.begin(), skip.end(), false) != skip.end()) {
+      SequentialTableReader< VectorFstTplHolder<KwsLexicographicArc> >
+          index_reader(index_rspecifier);
+      for (; !index_reader.Done(); index_reader.Next()) {
+        searchers.push_back(new KwsIndexSearcher(index_reader.Value()));
+        index_reader.FreeCurrent();
+      }
+      if (searchers.empty())
+        KALDI_ERR << "No index was read from " << index_rspecifier;
+    }
 
+    std::vector<SearchShardTask> tasks(searchers.size());
+    for (size_t i = 0; i < searchers.size(); i++) {
+      tasks[i].searcher = searchers[i];
+      tasks[i].keywords = &keywords;
+      tasks[i].skip = &skip;
+      tasks[i].n_best = n_best;
+    }
+    if (g_num_threads > 1 && searchers.size() > 1) {
+      // This runs in the process-wide thread pool, which has g_num_threads
+      // threads.
+      TaskGroup group;
+      for (size_t i = 0; i < tasks.size(); i++)
+        group.Run(&SearchShardTask::Run, &(tasks[i]));
+      group.Wait();
+    } else {
+      for (size_t i = 0; i < tasks.size(); i++)
+        SearchShardTask::Run(&(tasks[i]));
+    }
+    
+    int32 n_done = 0;
+    for (size_t k = 0; k < keywords.size(); k++) {
+      const std::string &key = keys[k];
+      std::vector<KwsSearchResult> results;
+      results.swap(inverted_results[k]);
+      for (size_t i = 0; i < tasks.size(); i++)
+        results.insert(results.end(), tasks[i].results[k].begin(),
+                       tasks[i].results[k].end());
       // No result found
-      if (result_fst.Start() == kNoStateId)
+      if (results.empty())
         continue;
+      if (tasks.size() > 1 && n_best != -1 &&
+          results.size() > static_cast<size_t>(n_best)) {
+        // Each shard gave its n best; keep the n best overall.
+        std::stable_sort(results.begin(), results.end());
+        results.resize(n_best);
+      }
 
       // Got something here
-      double score;
-      int32 tbeg, tend, uid;
-      for (ArcIterator<KwsLexicographicFst> 
-           aiter(result_fst, result_fst.Start()); !aiter.Done(); aiter.Next()) {
-        const Arc &arc = aiter.Value();
-
-        // We're expecting a two-state FST
-        if (result_fst.Final(arc.nextstate) != Weight::One()) {
-          KALDI_WARN << "The resulting FST does not have the expected structure for key " << key;
-          n_fail++;
-          continue;
-        }
-
-        uint64 osymbol = label_decoder[arc.olabel];
-        uid = (int32)DecodeLabelUid(osymbol);
-        tbeg = arc.weight.Value2().Value1().Value();
-        tend = arc.weight.Value2().Value2().Value();
-        score = arc.weight.Value1().Value();
-
+      for (size_t i = 0; i < results.size(); i++) {
+        double score = results[i].score;
         if (score < 0) {
           if (score < negative_tolerance) {
             KALDI_WARN << "Score out of expected range: " << score;
@@ -234,15 +241,16 @@ int main(int argc, char *argv[]) {
           score = 0.0;
         }
         vector<double> result;
-        result.push_back(uid);
-        result.push_back(tbeg);
-        result.push_back(tend);
+        result.push_back(results[i].utterance_id);
+        result.push_back(results[i].start_frame);
+        result.push_back(results[i].end_frame);
         result.push_back(score);
         result_writer.Write(key, result);
       }
 
       n_done++;
     }
+    DeletePointers(&searchers);
 
     KALDI_LOG << "Done " << n_done << " keywords";
     if (strict == true)
@@ -26,7 +26,83 @@
 #include "lat/lattice-functions.h"
 #include "kws/kaldi-kws.h"
 #include "kws/kws-functions.h"
-#include "fstext/epsilon-property.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-table-pipeline.h"
+
+namespace kaldi {
+
+// Creates the index for each lattice, in parallel if --num-threads > 1.
+class KwsIndexPipeline:
+      public TablePipeline<CompactLatticeHolder, KwsLexicographicFst> {
+ public:
+  KwsIndexPipeline(const TaskSequencerConfig &config,
+                   const KwsIndexOptions &opts,
+                   RandomAccessInt32Reader *usymtab_reader,
+                   TableWriter< fst::VectorFstTplHolder<KwsLexicographicArc> >
+                   *index_writer):
+      TablePipeline<CompactLatticeHolder, KwsLexicographicFst>(config),
+      opts_(opts), usymtab_reader_(usymtab_reader),
+      index_writer_(index_writer), num_done_(0), num_fail_(0) { }
+
+  virtual bool Process(const std::string &key, const CompactLattice &input,
+                       KwsLexicographicFst *index) {
+    KALDI_LOG << "Processing lattice " << key;
+    // Check if we have the corresponding utterance id.
+    mutex_.Lock();  // the reader is not thread-safe.
+    bool has_key = usymtab_reader_->HasKey(key);
+    int32 utterance_id = (has_key ? usymtab_reader_->Value(key) : -1);
+    mutex_.Unlock();
+    if (!has_key) {
+      KALDI_WARN << "Cannot find utterance id for " << key;
+      NoteFailure();
+      return false;
+    }
+    CompactLattice clat(input);
+    // CreateUtteranceIndex() returns false for the lattices we skip (e.g. if
+    // they have cycles).  We also skip, with a warning, the lattices for which
+    // it throws, as this program always has.
+    bool success;
+    try {
+      success = CreateUtteranceIndex(opts_, utterance_id, &clat, index);
+    } catch (const std::exception &e) {
+      KALDI_WARN << "Error creating index for lattice " << key << ": "
+                 << e.what();
+      success = false;
+    }
+    if (!success) {
+      KALDI_WARN << "Failed to create index for lattice " << key;
+      NoteFailure();
+    }
+    return success;
+  }
+
+  virtual void Output(const std::string &key,
+                      const KwsLexicographicFst &index) {
+    index_writer_->Write(key, index);
+    num_done_++;
+  }
+
+  int32 NumDone() const { return num_done_; }
+  int32 NumFail() const { return num_fail_; }
+
+ private:
+  void NoteFailure() {
+    mutex_.Lock();
+    num_fail_++;
+    mutex_.Unlock();
+  }
+
+  KwsIndexOptions opts_;
+  RandomAccessInt32Reader *usymtab_reader_;
+  TableWriter< fst::VectorFstTplHolder<KwsLexicographicArc> > *index_writer_;
+
+  int32 num_done_;  // only accessed in Output().
+
+  Mutex mutex_;  // protects the member below, and usymtab_reader_.
+  int32 num_fail_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -38,27 +114,21 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Create an inverted index of the given lattices. The output index is in the T*T*T\n"
         "semiring. For details for the semiring, please refer to Dogan Can and Muran Saraclar's"
-        "lattice indexing paper."
+        "lattice indexing paper.  With --num-threads > 1, several lattices are indexed\n"
+        "in parallel (the output order is unchanged).\n"
         "\n"
         "Usage: lattice-to-kws-index [options]  utter-symtab-rspecifier lattice-rspecifier index-wspecifier\n"
         " e.g.: lattice-to-kws-index ark:utter.symtab ark:1.lats ark:global.idx\n";
 
     ParseOptions po(usage);
 
-    int32 max_silence_frames = 50;
     bool strict = true;
-    bool allow_partial = true;
-    BaseFloat max_states_scale = 4;
-    po.Register("max-silence-frames", &max_silence_frames, "Maximum #frames for"
-                " silence arc.");
+    KwsIndexOptions index_opts;
+    TaskSequencerConfig sequencer_config;
     po.Register("strict", &strict, "Setting --strict=false will cause successful "
                 "termination even if we processed no lattices.");
-    po.Register("max-states-scale", &max_states_scale, "Number of states in the"
-                " original lattice times this scale is the number of states "
-                "allowed when optimizing the index. Negative number means no "
-                "limit on the number of states.");
-    po.Register("allow-partial", &allow_partial, "Allow partial output if fails"
-                " to determinize, otherwise skip determinization if it fails.");
+    index_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -79,125 +149,10 @@ int main(int argc, char *argv[]) {
     SequentialCompactLatticeReader clat_reader(lats_rspecifier);
     TableWriter< fst::VectorFstTplHolder<KwsLexicographicArc> > index_writer(index_wspecifier);
 
-    int32 n_done = 0;
-    int32 n_fail = 0;
-
-    int32 max_states = -1;
-
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      CompactLattice clat = clat_reader.Value();
-      clat_reader.FreeCurrent();
-      KALDI_LOG << "Processing lattice " << key;
-
-      if (max_states_scale > 0) {
-        max_states = static_cast<int32>(
-            max_states_scale * static_cast<BaseFloat>(clat.NumStates()));
-      }
-
-      // Check if we have the corresponding utterance id.
-      if (!usymtab_reader.HasKey(key)) {
-        KALDI_WARN << "Cannot find utterance id for " << key;
-        n_fail++;
-        continue;
-      }
-
-      // Topologically sort the lattice, if not already sorted.
-      uint64 props = clat.Properties(fst::kFstProperties, false);
-      if (!(props & fst::kTopSorted)) {
-        if (fst::TopSort(&clat) == false) {
-          KALDI_WARN << "Cycles detected in lattice " << key;
-          n_fail++;
-          continue;
-        }
-      } 
-
-      // Get the alignments
-      vector<int32> state_times;
-      CompactLatticeStateTimes(clat, &state_times);
-
-      // Cluster the arcs in the CompactLattice, write the cluster_id on the
-      // output label side.
-      // ClusterLattice() corresponds to the second part of the preprocessing in
-      // Dogan and Murat's paper -- clustering. Note that we do the first part
-      // of preprocessing (the weight pushing step) later when generating the
-      // factor transducer.
-      KALDI_VLOG(1) << "Arc clustering...";
-      bool success = false;
-      success = ClusterLattice(&clat, state_times);
-      if (!success) {
-        KALDI_WARN << "State id's and alignments do not match for lattice " << key;
-        n_fail++;
-        continue;
-      }
-
-      // The next part is something new, not in the Dogan and Can paper.  It is
-      // necessary because we have epsilon arcs, due to silences, in our
-      // lattices.  We modify the factor transducer, while maintaining
-      // equivalence, to ensure that states don't have both epsilon *and*
-      // non-epsilon arcs entering them.  (and the same, with "entering"
-      // replaced with "leaving").  Later we will find out which states have
-      // non-epsilon arcs leaving/entering them and use it to be more selective
-      // in adding arcs to connect them with the initial/final states.  The goal
-      // here is to disallow silences at the beginning or ending of a keyword
-      // occurrence.
-      if (true) {
-        EnsureEpsilonProperty(&clat);
-        fst::TopSort(&clat);
-        // We have to recompute the state times because they will have changed.
-        CompactLatticeStateTimes(clat, &state_times);        
-      }
-      
-      // Generate factor transducer
-      // CreateFactorTransducer() corresponds to the "Factor Generation" part of
-      // Dogan and Murat's paper. But we also move the weight pushing step to
-      // this function as we have to compute the alphas and betas anyway.
-      KALDI_VLOG(1) << "Generating factor transducer...";
-      KwsProductFst factor_transducer;
-      int32 utterance_id = usymtab_reader.Value(key);
-      success = CreateFactorTransducer(clat, state_times, utterance_id, &factor_transducer);
-      if (!success) {
-        KALDI_WARN << "Cannot generate factor transducer for lattice " << key;
-        n_fail++; 
-      }
-
-      MaybeDoSanityCheck(factor_transducer);
-
-      // Remove long silence arc
-      // We add the filtering step in our implementation. This is because gap
-      // between two successive words in a query term should be less than 0.5s
-      KALDI_VLOG(1) << "Removing long silence...";
-      RemoveLongSilences(max_silence_frames, state_times, &factor_transducer);
-
-      MaybeDoSanityCheck(factor_transducer);
-
-      // Do factor merging, and return a transducer in T*T*T semiring. This step
-      // corresponds to the "Factor Merging" part in Dogan and Murat's paper.
-      KALDI_VLOG(1) << "Merging factors...";
-      KwsLexicographicFst index_transducer;
-      DoFactorMerging(&factor_transducer, &index_transducer);
-
-      MaybeDoSanityCheck(index_transducer);
-      
-      // Do factor disambiguation. It corresponds to the "Factor Disambiguation"
-      // step in Dogan and Murat's paper.
-      KALDI_VLOG(1) << "Doing factor disambiguation...";
-      DoFactorDisambiguation(&index_transducer);
-
-      MaybeDoSanityCheck(index_transducer);
-
-      // Optimize the above factor transducer. It corresponds to the
-      // "Optimization" step in the paper.
-      KALDI_VLOG(1) << "Optimizing factor transducer...";
-      OptimizeFactorTransducer(&index_transducer, max_states, allow_partial);
-
-      MaybeDoSanityCheck(index_transducer);      
-      
-      // Write result
-      index_writer.Write(key, index_transducer);  
-
-      n_done++;
-    }
+    KwsIndexPipeline pipeline(sequencer_config, index_opts, &usymtab_reader,
+                              &index_writer);
+    pipeline.Run(&clat_reader);
+    int32 n_done = pipeline.NumDone(), n_fail = pipeline.NumFail();
 
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
     if (strict == true)
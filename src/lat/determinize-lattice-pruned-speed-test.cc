@@ -0,0 +1,50 @@
+// lat/determinize-lattice-pruned-speed-test.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/determinize-lattice-pruned.h"
+#include "lat/determinize-lattice-pruned-test-utils.h"
+#include "base/timer.h"
+
+namespace fst {
+
+// Prints the time taken by DeterminizeLatticePrunedChunked() on a long
+// lattice, for different numbers of threads.
+void DeterminizeLatticePrunedChunkedSpeedTest() {
+  VectorFst<kaldi::LatticeArc> lat;
+  RandSegmentedLattice(20000, &lat);
+  for (int32 num_threads = 1; num_threads <= 4; num_threads *= 2) {
+    DeterminizeLatticePrunedOptions opts;
+    DeterminizeLatticeChunkOptions chunk_opts;
+    chunk_opts.num_threads = num_threads;
+    kaldi::CompactLattice clat;
+    kaldi::Timer timer;
+    DeterminizeLatticePrunedChunked(lat, 10.0, &clat, opts, chunk_opts);
+    KALDI_LOG << "Determinizing lattice with " << lat.NumStates()
+              << " states with " << num_threads << " threads took "
+              << timer.Elapsed() << " seconds.";
+  }
+}
+
+} // end namespace fst
+
+int main() {
+  using namespace fst;
+  DeterminizeLatticePrunedChunkedSpeedTest();
+  std::cout << "Tests succeeded\n";
+}
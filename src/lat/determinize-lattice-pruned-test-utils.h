@@ -0,0 +1,67 @@
+// lat/determinize-lattice-pruned-test-utils.h
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LAT_DETERMINIZE_LATTICE_PRUNED_TEST_UTILS_H_
+#define KALDI_LAT_DETERMINIZE_LATTICE_PRUNED_TEST_UTILS_H_
+
+// This header contains functions shared by determinize-lattice-pruned-test.cc
+// and determinize-lattice-pruned-speed-test.cc; it is not part of the library.
+
+#include "lat/kaldi-lattice.h"
+
+namespace fst {
+
+// Makes a lattice of "num_segments" segments, each of which is a few parallel
+// paths of the same number of frames with random words on them, so there are
+// states at the segment boundaries that all paths pass through (as
+// DeterminizeLatticePrunedChunked() requires to split the lattice).  The words
+// are on the input side.
+inline void RandSegmentedLattice(int32 num_segments,
+                                 VectorFst<kaldi::LatticeArc> *lat) {
+  typedef kaldi::LatticeArc Arc;
+  typedef Arc::StateId StateId;
+  lat->DeleteStates();
+  StateId cur = lat->AddState();
+  lat->SetStart(cur);
+  for (int32 i = 0; i < num_segments; i++) {
+    int32 num_paths = 1 + kaldi::Rand() % 4,
+        num_frames = 5 + kaldi::Rand() % 10;
+    StateId end = lat->AddState();
+    for (int32 p = 0; p < num_paths; p++) {
+      StateId prev = cur;
+      for (int32 t = 0; t < num_frames; t++) {
+        StateId next = (t + 1 == num_frames ? end : lat->AddState());
+        int32 word = (t == 0 ? kaldi::Rand() % 4 : 0),  // may be epsilon.
+            tid = 1 + kaldi::Rand() % 10;
+        kaldi::LatticeWeight weight(kaldi::RandUniform(),
+                                    kaldi::RandUniform());
+        lat->AddArc(prev, Arc(word, tid, weight, next));
+        prev = next;
+      }
+    }
+    cur = end;
+  }
+  lat->SetFinal(cur, kaldi::LatticeWeight::One());
+  TopSort(lat);
+  ArcSort(lat, ILabelCompare<Arc>());
+}
+
+}  // end namespace fst
+
+#endif  // KALDI_LAT_DETERMINIZE_LATTICE_PRUNED_TEST_UTILS_H_
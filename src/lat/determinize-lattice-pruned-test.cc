@@ -23,6 +23,7 @@
 #include "fstext/fst-test-utils.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
+#include "lat/determinize-lattice-pruned-test-utils.h"
 
 namespace fst {
 // Caution: these tests are not as generic as you might think from all the
@@ -161,11 +162,34 @@ template<class Arc> void TestDeterminizeLatticePruned2() {
 }
 
 
+// test that determinizing a lattice in pieces gives the same result as
+// determinizing it all at once.
+void TestDeterminizeLatticePrunedChunked() {
+  for (int32 i = 0; i < 20; i++) {
+    VectorFst<kaldi::LatticeArc> lat;
+    RandSegmentedLattice(10 + kaldi::Rand() % 50, &lat);
+    kaldi::BaseFloat beam = 2.0 + kaldi::Rand() % 10;
+    DeterminizeLatticePrunedOptions opts;
+    DeterminizeLatticeChunkOptions chunk_opts;
+    chunk_opts.num_threads = 1 + kaldi::Rand() % 4;
+    chunk_opts.min_chunk_length = 1 + kaldi::Rand() % 50;
+    kaldi::CompactLattice clat, clat_chunked;
+    bool ans = DeterminizeLatticePruned(lat, beam, &clat, opts),
+        ans_chunked = DeterminizeLatticePrunedChunked(lat, beam, &clat_chunked,
+                                                      opts, chunk_opts);
+    KALDI_ASSERT(ans && ans_chunked);
+    KALDI_ASSERT(RandEquivalent(clat, clat_chunked, 5/*paths*/,
+                                0.01/*delta*/, kaldi::Rand()/*seed*/,
+                                1000/*path length, max*/));
+  }
+}
+
 } // end namespace fst
 
 int main() {
   using namespace fst;
   TestDeterminizeLatticePruned<kaldi::LatticeArc>();
   TestDeterminizeLatticePruned2<kaldi::LatticeArc>();
+  TestDeterminizeLatticePrunedChunked();
   std::cout << "Tests succeeded\n";
 }
@@ -31,13 +31,17 @@ using std::tr1::unordered_map;
 #endif
 
 #include <vector>
+#include <algorithm>
 #include <climits>
+#include <limits>
 #include "fstext/determinize-lattice.h" // for LatticeStringRepository
 #include "fstext/fstext-utils.h"
 #include "lat/lattice-functions.h"  // for PruneLattice
 #include "lat/minimize-lattice.h"   // for minimization
 #include "lat/push-lattice.h"       // for minimization
 #include "lat/determinize-lattice-pruned.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-thread-pool.h"
 
 namespace fst {
 
@@ -1306,6 +1310,268 @@ bool DeterminizeLatticePruned(const ExpandedFst<ArcTpl<Weight> > &ifst,
   return false; // Suppress compiler warning; this code is unreachable.
 }
 
+// This is used in DeterminizeLatticePrunedChunked().  Works out the times of
+// the states of "fst", which must be topologically sorted, where the time of a
+// state is the number of arcs with nonzero output label on paths to it; the
+// time of states that are not reachable is -1.  Returns false if the FST is not
+// topologically sorted, or if different paths to some state have different
+// numbers of labels.
+template<class Arc>
+static bool GetChunkingStateTimes(const ExpandedFst<Arc> &fst,
+                                  std::vector<int32> *times) {
+  typedef typename Arc::StateId StateId;
+  StateId num_states = fst.NumStates(), start = fst.Start();
+  times->clear();
+  times->resize(num_states, -1);
+  if (start == kNoStateId) return false;
+  (*times)[start] = 0;
+  for (StateId s = 0; s < num_states; s++) {
+    int32 t = (*times)[s];
+    if (t < 0) continue;  // not reachable.
+    for (ArcIterator<ExpandedFst<Arc> > aiter(fst, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.nextstate <= s) return false;  // not topologically sorted.
+      int32 next_t = t + (arc.olabel != 0 ? 1 : 0);
+      int32 &next_time = (*times)[arc.nextstate];
+      if (next_time == -1) next_time = next_t;
+      else if (next_time != next_t) return false;
+    }
+  }
+  return true;
+}
+
+// This is used in DeterminizeLatticePrunedChunked().  Splits "fst" (which must
+// be topologically sorted) into pieces at states that every path passes
+// through, which are found as the only state with their time, as computed by
+// GetChunkingStateTimes().  The pieces are at least min_chunk_length frames
+// long.  The start state of each piece after the first is the state we split
+// at, and the state corresponding to it in the previous piece is its only
+// final state, with weight One().  Returns false if the FST could not be split.
+template<class Arc>
+static bool SplitLatticeIntoChunks(const ExpandedFst<Arc> &fst,
+                                   int32 min_chunk_length,
+                                   std::vector<VectorFst<Arc> > *chunks) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  std::vector<int32> times;
+  if (!GetChunkingStateTimes(fst, &times)) return false;
+  StateId num_states = fst.NumStates();
+
+  // Work out the minimum time of a final state; we can only split before
+  // that, as every path has to pass through the state we split at.
+  int32 max_time = 0, min_final_time = std::numeric_limits<int32>::max();
+  for (StateId s = 0; s < num_states; s++) {
+    if (times[s] < 0) continue;
+    max_time = std::max(max_time, times[s]);
+    if (fst.Final(s) != Weight::Zero())
+      min_final_time = std::min(min_final_time, times[s]);
+  }
+  if (min_final_time == std::numeric_limits<int32>::max()) return false;
+  std::vector<int32> num_states_at_time(max_time + 1, 0);
+  std::vector<StateId> state_at_time(max_time + 1, kNoStateId);
+  for (StateId s = 0; s < num_states; s++) {
+    if (times[s] < 0) continue;
+    num_states_at_time[times[s]]++;
+    state_at_time[times[s]] = s;
+  }
+  // cut_times are the times at which we split; the first piece is before
+  // cut_times[0], and so on.
+  std::vector<int32> cut_times;
+  int32 last_cut_time = 0;
+  for (int32 t = min_chunk_length; t + min_chunk_length <= min_final_time;
+       t++) {
+    if (num_states_at_time[t] == 1 && t - last_cut_time >= min_chunk_length) {
+      cut_times.push_back(t);
+      last_cut_time = t;
+    }
+  }
+  if (cut_times.empty()) return false;
+
+  int32 num_chunks = cut_times.size() + 1;
+  chunks->clear();
+  chunks->resize(num_chunks);
+  // chunk_index[s] is the piece that state s is in (for the states we split
+  // at, the piece that it starts), and new_state[s] is its state-id there.
+  std::vector<int32> chunk_index(num_states, -1);
+  std::vector<StateId> new_state(num_states, kNoStateId);
+  for (StateId s = 0; s < num_states; s++) {
+    if (times[s] < 0) continue;
+    int32 c = std::upper_bound(cut_times.begin(), cut_times.end(), times[s]) -
+        cut_times.begin();
+    chunk_index[s] = c;
+    new_state[s] = (*chunks)[c].AddState();
+  }
+  (*chunks)[0].SetStart(new_state[fst.Start()]);
+  // end_state[c] is the final state of piece c, which corresponds to the start
+  // state of piece c + 1.  We add it last so the pieces stay topologically
+  // sorted.
+  std::vector<StateId> end_state(num_chunks - 1);
+  for (int32 c = 0; c + 1 < num_chunks; c++) {
+    (*chunks)[c + 1].SetStart(new_state[state_at_time[cut_times[c]]]);
+    end_state[c] = (*chunks)[c].AddState();
+    (*chunks)[c].SetFinal(end_state[c], Weight::One());
+  }
+  for (StateId s = 0; s < num_states; s++) {
+    if (times[s] < 0) continue;
+    int32 c = chunk_index[s];
+    VectorFst<Arc> &chunk = (*chunks)[c];
+    Weight final_weight = fst.Final(s);
+    if (final_weight != Weight::Zero()) {
+      KALDI_ASSERT(c + 1 == num_chunks);
+      chunk.SetFinal(new_state[s], final_weight);
+    }
+    for (ArcIterator<ExpandedFst<Arc> > aiter(fst, s); !aiter.Done();
+         aiter.Next()) {
+      Arc arc = aiter.Value();
+      if (chunk_index[arc.nextstate] == c) {
+        arc.nextstate = new_state[arc.nextstate];
+      } else {  // an arc into the state we split at.
+        KALDI_ASSERT(chunk_index[arc.nextstate] == c + 1 &&
+                     times[arc.nextstate] == cut_times[c]);
+        arc.nextstate = end_state[c];
+      }
+      chunk.AddArc(new_state[s], arc);
+    }
+  }
+  return true;
+}
+
+// This is used in DeterminizeLatticePrunedChunked(), to determinize one piece
+// of the lattice.
+template<class Weight, class IntType>
+struct DeterminizeLatticeChunkTask {
+  const VectorFst<ArcTpl<Weight> > *chunk;
+  double beam;
+  const DeterminizeLatticePrunedOptions *opts;
+  VectorFst<ArcTpl<CompactLatticeWeightTpl<Weight, IntType> > > output;
+  bool ans;
+};
+
+// This is used in DeterminizeLatticePrunedChunked().  Each of the threads
+// (including the calling thread) runs Run(), which determinizes pieces of the
+// lattice until there are none left; so the number of threads used is limited
+// by the number of times we run it, not by the size of the thread pool.
+template<class Weight, class IntType>
+struct DeterminizeLatticeChunkWorker {
+  std::vector<DeterminizeLatticeChunkTask<Weight, IntType> > *tasks;
+  kaldi::Mutex mutex;  // protects next_task.
+  size_t next_task;
+  static void *Run(void *arg) {
+    DeterminizeLatticeChunkWorker *worker =
+        static_cast<DeterminizeLatticeChunkWorker*>(arg);
+    while (true) {
+      worker->mutex.Lock();
+      size_t t = worker->next_task++;
+      worker->mutex.Unlock();
+      if (t >= worker->tasks->size())
+        return NULL;
+      DeterminizeLatticeChunkTask<Weight, IntType> &task = (*worker->tasks)[t];
+      task.ans = DeterminizeLatticePruned<Weight, IntType>(
+          *(task.chunk), task.beam, &(task.output), *(task.opts));
+    }
+  }
+};
+
+template<class Weight, class IntType>
+bool DeterminizeLatticePrunedChunked(
+    const ExpandedFst<ArcTpl<Weight> > &ifst,
+    double beam,
+    MutableFst<ArcTpl<CompactLatticeWeightTpl<Weight, IntType> > > *ofst,
+    DeterminizeLatticePrunedOptions opts,
+    const DeterminizeLatticeChunkOptions &chunk_opts) {
+  typedef ArcTpl<Weight> Arc;
+  typedef CompactLatticeWeightTpl<Weight, IntType> CompactWeight;
+  typedef ArcTpl<CompactWeight> CompactArc;
+  typedef typename Arc::StateId StateId;
+  KALDI_ASSERT(chunk_opts.min_chunk_length > 0);
+  if (chunk_opts.num_threads <= 1 || ifst.NumStates() == 0)
+    return DeterminizeLatticePruned<Weight, IntType>(ifst, beam, ofst, opts);
+
+  // Pruning first makes the states we can split at much more common.
+  VectorFst<Arc> pruned_fst(ifst);
+  std::vector<VectorFst<Arc> > chunks;
+  if (!kaldi::PruneLattice(beam, &pruned_fst) ||
+      !SplitLatticeIntoChunks(pruned_fst, chunk_opts.min_chunk_length,
+                              &chunks)) {
+    KALDI_VLOG(2) << "Could not split lattice; determinizing it in one piece.";
+    return DeterminizeLatticePruned<Weight, IntType>(ifst, beam, ofst, opts);
+  }
+  int32 num_chunks = chunks.size();
+  KALDI_VLOG(2) << "Determinizing lattice in " << num_chunks << " pieces.";
+  pruned_fst.DeleteStates();
+
+  std::vector<DeterminizeLatticeChunkTask<Weight, IntType> > tasks(num_chunks);
+  for (int32 c = 0; c < num_chunks; c++) {
+    tasks[c].chunk = &(chunks[c]);
+    tasks[c].beam = beam;
+    tasks[c].opts = &opts;
+  }
+  {
+    DeterminizeLatticeChunkWorker<Weight, IntType> worker;
+    worker.tasks = &tasks;
+    worker.next_task = 0;
+    // We use the process-wide thread pool.  The calling thread is one of the
+    // workers, so we queue one fewer than we want to use.
+    kaldi::TaskGroup group;
+    int32 num_workers = std::min<int32>(chunk_opts.num_threads, num_chunks);
+    for (int32 i = 1; i < num_workers; i++)
+      group.Run(DeterminizeLatticeChunkWorker<Weight, IntType>::Run, &worker);
+    DeterminizeLatticeChunkWorker<Weight, IntType>::Run(&worker);
+    group.Wait();
+  }
+  chunks.clear();
+
+  // Join the determinized pieces, with epsilon arcs from the final states of
+  // each piece to the start state of the next.
+  bool ans = true;
+  VectorFst<CompactArc> joined;
+  StateId next_start = kNoStateId;
+  for (int32 c = num_chunks - 1; c >= 0; c--) {
+    const VectorFst<CompactArc> &output = tasks[c].output;
+    ans = tasks[c].ans && ans;
+    if (output.Start() == kNoStateId) {
+      KALDI_WARN << "Determinization of piece of lattice gave empty output; "
+                 << "determinizing it in one piece.";
+      return DeterminizeLatticePruned<Weight, IntType>(ifst, beam, ofst, opts);
+    }
+    StateId offset = joined.NumStates();
+    for (StateId s = 0; s < output.NumStates(); s++)
+      joined.AddState();
+    for (StateId s = 0; s < output.NumStates(); s++) {
+      for (ArcIterator<VectorFst<CompactArc> > aiter(output, s); !aiter.Done();
+           aiter.Next()) {
+        CompactArc arc = aiter.Value();
+        arc.nextstate += offset;
+        joined.AddArc(s + offset, arc);
+      }
+      CompactWeight final_weight = output.Final(s);
+      if (final_weight != CompactWeight::Zero()) {
+        if (c + 1 == num_chunks)
+          joined.SetFinal(s + offset, final_weight);
+        else
+          joined.AddArc(s + offset, CompactArc(0, 0, final_weight,
+                                               next_start));
+      }
+    }
+    next_start = output.Start() + offset;
+    tasks[c].output.DeleteStates();
+  }
+  joined.SetStart(next_start);
+
+  // Determinize the joined lattice; we convert it back to a Lattice with the
+  // words on the input side.
+  VectorFst<Arc> joined_fst;
+  ConvertLattice<Weight, IntType>(joined, &joined_fst, false);
+  joined.DeleteStates();
+  if (!TopSort(&joined_fst))
+    KALDI_ERR << "Joined lattice has cycles (should not happen).";
+  ArcSort(&joined_fst, ILabelCompare<Arc>());
+  ans = DeterminizeLatticePruned<Weight, IntType>(joined_fst, beam, ofst,
+                                                  opts) && ans;
+  return ans;
+}
+
 template<class Weight>
 typename ArcTpl<Weight>::Label DeterminizeLatticeInsertPhones(
     const kaldi::TransitionModel &trans_model,
@@ -1535,6 +1801,14 @@ bool DeterminizeLatticePruned<kaldi::LatticeWeight>(
     MutableFst<kaldi::LatticeArc> *ofst, 
     DeterminizeLatticePrunedOptions opts);
 
+template
+bool DeterminizeLatticePrunedChunked<kaldi::LatticeWeight, kaldi::int32>(
+    const ExpandedFst<kaldi::LatticeArc> &ifst,
+    double prune,
+    MutableFst<kaldi::CompactLatticeArc> *ofst,
+    DeterminizeLatticePrunedOptions opts,
+    const DeterminizeLatticeChunkOptions &chunk_opts);
+
 template
 bool DeterminizeLatticePhonePruned<kaldi::LatticeWeight, kaldi::int32>(
     const kaldi::TransitionModel &trans_model,
@@ -212,6 +212,53 @@ bool DeterminizeLatticePruned(
     MutableFst<ArcTpl<CompactLatticeWeightTpl<Weight, IntType> > > *ofst,
     DeterminizeLatticePrunedOptions opts = DeterminizeLatticePrunedOptions());
 
+/// Options for DeterminizeLatticePrunedChunked().
+struct DeterminizeLatticeChunkOptions {
+  // num_threads: the number of threads to use; if <= 1, we just call
+  // DeterminizeLatticePruned().
+  int num_threads;
+  // min_chunk_length: the minimum length, in frames, of the pieces we split
+  // the lattice into; lattices shorter than twice this are not split.
+  int min_chunk_length;
+  DeterminizeLatticeChunkOptions(): num_threads(1), min_chunk_length(500) { }
+  void Register(kaldi::OptionsItf *opts) {
+    opts->Register("determinize-threads", &num_threads, "Number of threads "
+                   "to use to determinize each lattice; if > 1, long lattices "
+                   "are split into pieces that are determinized in parallel.");
+    opts->Register("determinize-chunk-length", &min_chunk_length, "Minimum "
+                   "length, in frames, of the pieces that lattices are split "
+                   "into for multi-threaded determinization.");
+  }
+};
+
+/**
+   This function gives the same output as the version of
+   DeterminizeLatticePruned() that outputs to CompactLattice (up to the usual
+   approximations of pruned determinization), but for long lattices it is
+   faster as it uses several threads.  After pruning the input with "prune",
+   it looks for frames in which the lattice has only one state, so that every
+   path passes through that state (these are common, e.g. in long silences).
+   It splits the lattice at some of those states into pieces of at least
+   chunk_opts.min_chunk_length frames, determinizes the pieces in parallel, and
+   joins the results with epsilon arcs.  Because a word sequence may be split
+   between pieces in more than one way, the joined result is not quite
+   deterministic, so we finish by determinizing it again; this is fast, as the
+   joined lattice is much smaller than the input.  If the lattice cannot be
+   split, this is the same as DeterminizeLatticePruned().
+
+   The time of a state is taken to be the number of nonzero output labels
+   (e.g. transition-ids; the input must have words on the input side, as for
+   DeterminizeLatticePruned()) on paths to it.  The input must be
+   topologically sorted.
+*/
+template<class Weight, class IntType>
+bool DeterminizeLatticePrunedChunked(
+    const ExpandedFst<ArcTpl<Weight> > &ifst,
+    double prune,
+    MutableFst<ArcTpl<CompactLatticeWeightTpl<Weight, IntType> > > *ofst,
+    DeterminizeLatticePrunedOptions opts,
+    const DeterminizeLatticeChunkOptions &chunk_opts);
+
 /** This function takes in lattices and inserts phones at phone boundaries. It
     uses the transition model to work out the transition_id to phone map. The
     returning value is the starting index of the phone label. Typically we pick
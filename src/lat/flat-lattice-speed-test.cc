@@ -0,0 +1,90 @@
+// lat/flat-lattice-speed-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/flat-lattice.h"
+#include "lat/lattice-functions.h"
+#include "hmm/hmm-topology.h"
+#include "tree/context-dep.h"
+#include "lat/flat-lattice-test-utils.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+// Prints the time taken by the forward-backward code with ArcIterator and with
+// FlatLattice, on a lattice of the size we see in discriminative training.
+void FlatLatticeForwardBackwardSpeedTest(
+    const TransitionModel &trans, const std::vector<int32> &silence_phones) {
+  int32 num_frames = 1000, states_per_frame = 100;
+  Lattice lat;
+  RandFrameLattice(trans, num_frames, states_per_frame, &lat);
+  std::vector<int32> num_ali(num_frames);
+  for (int32 t = 0; t < num_frames; t++)
+    num_ali[t] = 1 + Rand() % trans.NumTransitionIds();
+
+  Timer timer;
+  Posterior post;
+  double like_sum;
+  ReferenceLatticeForwardBackward(lat, &post, &like_sum);
+  double ref_time = timer.Elapsed();
+  timer.Reset();
+  FlatLattice flat_lat(lat);
+  LatticeForwardBackward(flat_lat, &post, &like_sum);
+  double flat_time = timer.Elapsed();
+
+  double mpe_ref_time = 0.0, mpe_flat_time = 0.0;
+  for (int32 i = 0; i < 4; i++) {
+    std::string criterion = (i % 2 == 0 ? "smbr" : "mpfe");
+    bool one_silence_class = (i / 2 == 0);
+    timer.Reset();
+    ReferenceLatticeForwardBackwardMpeVariants(
+        trans, silence_phones, lat, num_ali, criterion, one_silence_class,
+        &post);
+    mpe_ref_time += timer.Elapsed();
+    timer.Reset();
+    LatticeForwardBackwardMpeVariants(
+        trans, silence_phones, lat, num_ali, criterion, one_silence_class,
+        &post);
+    mpe_flat_time += timer.Elapsed();
+  }
+  KALDI_LOG << "For lattice with " << lat.NumStates() << " states and "
+            << flat_lat.NumArcs() << " arcs, forward-backward took "
+            << ref_time << " seconds with ArcIterator and " << flat_time
+            << " with FlatLattice; MPE forward-backward took "
+            << mpe_ref_time << " vs. " << mpe_flat_time << " seconds.";
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  std::vector<int32> phones;
+  for (int32 i = 1; i < 20; i++)
+    phones.push_back(i);
+  std::vector<int32> num_pdf_classes, silence_phones;
+  silence_phones.push_back(1);
+  silence_phones.push_back(2);
+  ContextDependency *ctx_dep = GenRandContextDependencyLarge(
+      phones, 3, 1, true, &num_pdf_classes);
+  HmmTopology topo = GetDefaultTopology(phones);
+  TransitionModel trans(*ctx_dep, topo);
+  delete ctx_dep;
+
+  FlatLatticeForwardBackwardSpeedTest(trans, silence_phones);
+  KALDI_LOG << "Success.";
+}
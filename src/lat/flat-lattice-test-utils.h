@@ -0,0 +1,276 @@
+// lat/flat-lattice-test-utils.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LAT_FLAT_LATTICE_TEST_UTILS_H_
+#define KALDI_LAT_FLAT_LATTICE_TEST_UTILS_H_
+
+// This header contains functions shared by flat-lattice-test.cc and
+// flat-lattice-speed-test.cc; it is not part of the library.
+
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "hmm/transition-model.h"
+
+namespace kaldi {
+
+// This is the forward-backward code as it was before FlatLattice, which we
+// use to check that the results are the same.
+inline BaseFloat ReferenceLatticeForwardBackward(const Lattice &lat,
+                                                 Posterior *post,
+                                                 double *acoustic_like_sum) {
+  using namespace fst;
+  typedef Lattice::Arc Arc;
+  typedef Arc::Weight Weight;
+  typedef Arc::StateId StateId;
+
+  if (acoustic_like_sum) *acoustic_like_sum = 0.0;
+  KALDI_ASSERT(lat.Start() == 0);
+
+  int32 num_states = lat.NumStates();
+  std::vector<int32> state_times;
+  int32 max_time = LatticeStateTimes(lat, &state_times);
+  std::vector<double> alpha(num_states, kLogZeroDouble);
+  std::vector<double> &beta(alpha);
+  double tot_forward_prob = kLogZeroDouble;
+
+  post->clear();
+  post->resize(max_time);
+
+  alpha[0] = 0.0;
+  for (StateId s = 0; s < num_states; s++) {
+    double this_alpha = alpha[s];
+    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      double arc_like = -ConvertToCost(arc.weight);
+      alpha[arc.nextstate] = LogAdd(alpha[arc.nextstate],
+                                    this_alpha + arc_like);
+    }
+    Weight f = lat.Final(s);
+    if (f != Weight::Zero()) {
+      double final_like = this_alpha - (f.Value1() + f.Value2());
+      tot_forward_prob = LogAdd(tot_forward_prob, final_like);
+    }
+  }
+  for (StateId s = num_states-1; s >= 0; s--) {
+    Weight f = lat.Final(s);
+    double this_beta = -(f.Value1() + f.Value2());
+    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      double arc_like = -ConvertToCost(arc.weight),
+          arc_beta = beta[arc.nextstate] + arc_like;
+      this_beta = LogAdd(this_beta, arc_beta);
+      int32 transition_id = arc.ilabel;
+      if (transition_id != 0 || acoustic_like_sum != NULL) {
+        double posterior = Exp(alpha[s] + arc_beta - tot_forward_prob);
+        if (transition_id != 0)
+          (*post)[state_times[s]].push_back(
+              std::make_pair(transition_id, static_cast<BaseFloat>(posterior)));
+        if (acoustic_like_sum != NULL)
+          *acoustic_like_sum -= posterior * arc.weight.Value2();
+      }
+    }
+    if (acoustic_like_sum != NULL && f != Weight::Zero()) {
+      double final_logprob = - ConvertToCost(f),
+          posterior = Exp(alpha[s] + final_logprob - tot_forward_prob);
+      *acoustic_like_sum -= posterior * f.Value2();
+    }
+    beta[s] = this_beta;
+  }
+  double tot_backward_prob = beta[0];
+  for (int32 t = 0; t < max_time; t++)
+    MergePairVectorSumming(&((*post)[t]));
+  return tot_backward_prob;
+}
+
+inline double ReferenceFrameAcc(const TransitionModel &trans,
+                                const std::vector<int32> &silence_phones,
+                                const std::vector<int32> &num_ali,
+                                bool is_mpfe, bool one_silence_class,
+                                int32 cur_time, int32 transition_id) {
+  if (transition_id == 0) return 0.0;
+  int32 phone = trans.TransitionIdToPhone(transition_id),
+      ref_phone = trans.TransitionIdToPhone(num_ali[cur_time]);
+  bool phone_is_sil = std::binary_search(silence_phones.begin(),
+                                         silence_phones.end(), phone),
+      ref_phone_is_sil = std::binary_search(silence_phones.begin(),
+                                            silence_phones.end(), ref_phone),
+      both_sil = phone_is_sil && ref_phone_is_sil;
+  if (!is_mpfe) {
+    int32 pdf = trans.TransitionIdToPdf(transition_id),
+        ref_pdf = trans.TransitionIdToPdf(num_ali[cur_time]);
+    if (!one_silence_class)
+      return (pdf == ref_pdf && !phone_is_sil) ? 1.0 : 0.0;
+    else
+      return (pdf == ref_pdf || both_sil) ? 1.0 : 0.0;
+  } else {
+    if (!one_silence_class)
+      return (phone == ref_phone && !phone_is_sil) ? 1.0 : 0.0;
+    else
+      return (phone == ref_phone || both_sil) ? 1.0 : 0.0;
+  }
+}
+
+// The MPFE/sMBR forward-backward as it was before FlatLattice.
+inline BaseFloat ReferenceLatticeForwardBackwardMpeVariants(
+    const TransitionModel &trans,
+    const std::vector<int32> &silence_phones,
+    const Lattice &lat,
+    const std::vector<int32> &num_ali,
+    std::string criterion,
+    bool one_silence_class,
+    Posterior *post) {
+  using namespace fst;
+  typedef Lattice::Arc Arc;
+  typedef Arc::Weight Weight;
+  typedef Arc::StateId StateId;
+  bool is_mpfe = (criterion == "mpfe");
+
+  int32 num_states = lat.NumStates();
+  std::vector<int32> state_times;
+  int32 max_time = LatticeStateTimes(lat, &state_times);
+  std::vector<double> alpha(num_states, kLogZeroDouble),
+      alpha_smbr(num_states, 0), beta(num_states, kLogZeroDouble),
+      beta_smbr(num_states, 0);
+  double tot_forward_prob = kLogZeroDouble, tot_forward_score = 0;
+
+  post->clear();
+  post->resize(max_time);
+
+  alpha[0] = 0.0;
+  for (StateId s = 0; s < num_states; s++) {
+    double this_alpha = alpha[s];
+    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      double arc_like = -ConvertToCost(arc.weight);
+      alpha[arc.nextstate] = LogAdd(alpha[arc.nextstate],
+                                    this_alpha + arc_like);
+    }
+    Weight f = lat.Final(s);
+    if (f != Weight::Zero()) {
+      double final_like = this_alpha - (f.Value1() + f.Value2());
+      tot_forward_prob = LogAdd(tot_forward_prob, final_like);
+    }
+  }
+  for (StateId s = num_states-1; s >= 0; s--) {
+    Weight f = lat.Final(s);
+    double this_beta = -(f.Value1() + f.Value2());
+    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      double arc_like = -ConvertToCost(arc.weight),
+          arc_beta = beta[arc.nextstate] + arc_like;
+      this_beta = LogAdd(this_beta, arc_beta);
+    }
+    beta[s] = this_beta;
+  }
+  alpha_smbr[0] = 0.0;
+  for (StateId s = 0; s < num_states; s++) {
+    double this_alpha = alpha[s];
+    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      double arc_like = -ConvertToCost(arc.weight);
+      double frame_acc = ReferenceFrameAcc(trans, silence_phones, num_ali,
+                                           is_mpfe, one_silence_class,
+                                           state_times[s], arc.ilabel);
+      double arc_scale = Exp(alpha[s] + arc_like - alpha[arc.nextstate]);
+      alpha_smbr[arc.nextstate] += arc_scale * (alpha_smbr[s] + frame_acc);
+    }
+    Weight f = lat.Final(s);
+    if (f != Weight::Zero()) {
+      double final_like = this_alpha - (f.Value1() + f.Value2());
+      double arc_scale = Exp(final_like - tot_forward_prob);
+      tot_forward_score += arc_scale * alpha_smbr[s];
+    }
+  }
+  for (StateId s = num_states-1; s >= 0; s--) {
+    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      double arc_like = -ConvertToCost(arc.weight),
+          arc_beta = beta[arc.nextstate] + arc_like;
+      double frame_acc = ReferenceFrameAcc(trans, silence_phones, num_ali,
+                                           is_mpfe, one_silence_class,
+                                           state_times[s], arc.ilabel);
+      double arc_scale = Exp(beta[arc.nextstate] + arc_like - beta[s]);
+      if (KALDI_ISNAN(arc_scale)) arc_scale = 0;
+      beta_smbr[s] += arc_scale * (beta_smbr[arc.nextstate] + frame_acc);
+      if (arc.ilabel != 0) {
+        double posterior = Exp(alpha[s] + arc_beta - tot_forward_prob);
+        double acc_diff = alpha_smbr[s] + frame_acc + beta_smbr[arc.nextstate]
+            - tot_forward_score;
+        (*post)[state_times[s]].push_back(
+            std::make_pair(arc.ilabel,
+                           static_cast<BaseFloat>(posterior * acc_diff)));
+      }
+    }
+  }
+  for (int32 t = 0; t < max_time; t++)
+    MergePairVectorSumming(&((*post)[t]));
+  return tot_forward_score;
+}
+
+// Generates a random, connected, topologically sorted lattice with
+// "num_frames" frames and up to "states_per_frame" states on each frame, with
+// some epsilon arcs, like a lattice from the decoder.
+inline void RandFrameLattice(const TransitionModel &trans, int32 num_frames,
+                             int32 states_per_frame, Lattice *lat) {
+  lat->DeleteStates();
+  int32 num_tids = trans.NumTransitionIds();
+  std::vector<std::vector<int32> > frame_states(num_frames + 1);
+  frame_states[0].push_back(lat->AddState());
+  lat->SetStart(0);
+  for (int32 t = 1; t <= num_frames; t++) {
+    int32 num_states = 1 + Rand() % states_per_frame;
+    for (int32 i = 0; i < num_states; i++)
+      frame_states[t].push_back(lat->AddState());
+  }
+  for (int32 t = 0; t < num_frames; t++) {
+    const std::vector<int32> &cur = frame_states[t], &next =
+        frame_states[t + 1];
+    // Make sure every state has an arc leaving it and an arc entering it.
+    for (size_t i = 0; i < cur.size(); i++) {
+      int32 num_arcs = 1 + Rand() % 3;
+      for (int32 j = 0; j < num_arcs; j++) {
+        int32 dest = next[Rand() % next.size()];
+        lat->AddArc(cur[i], LatticeArc(1 + Rand() % num_tids, 0,
+                                       LatticeWeight(RandUniform() * 5.0,
+                                                     RandUniform() * 20.0),
+                                       dest));
+      }
+      if (i + 1 < cur.size() && Rand() % 5 == 0) {  // epsilon arc.
+        int32 dest = cur[i + 1 + Rand() % (cur.size() - i - 1)];
+        lat->AddArc(cur[i], LatticeArc(0, 1 + Rand() % 10,
+                                       LatticeWeight(RandUniform() * 5.0, 0.0),
+                                       dest));
+      }
+    }
+    for (size_t i = 0; i < next.size(); i++)
+      lat->AddArc(cur[Rand() % cur.size()],
+                  LatticeArc(1 + Rand() % num_tids, 0,
+                             LatticeWeight(RandUniform() * 5.0,
+                                           RandUniform() * 20.0),
+                             next[i]));
+  }
+  const std::vector<int32> &last = frame_states[num_frames];
+  for (size_t i = 0; i < last.size(); i++)
+    lat->SetFinal(last[i], LatticeWeight(RandUniform(), RandUniform()));
+  KALDI_ASSERT(lat->Properties(fst::kTopSorted, true) != 0);
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_FLAT_LATTICE_TEST_UTILS_H_
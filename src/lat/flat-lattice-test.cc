@@ -0,0 +1,79 @@
+// lat/flat-lattice-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/flat-lattice.h"
+#include "lat/lattice-functions.h"
+#include "hmm/hmm-topology.h"
+#include "tree/context-dep.h"
+#include "lat/flat-lattice-test-utils.h"
+
+namespace kaldi {
+
+void TestFlatLatticeForwardBackward(const TransitionModel &trans,
+                                    const std::vector<int32> &silence_phones,
+                                    int32 num_frames, int32 states_per_frame) {
+  Lattice lat;
+  RandFrameLattice(trans, num_frames, states_per_frame, &lat);
+  std::vector<int32> num_ali(num_frames);
+  for (int32 t = 0; t < num_frames; t++)
+    num_ali[t] = 1 + Rand() % trans.NumTransitionIds();
+
+  Posterior post1, post2;
+  double like_sum1, like_sum2;
+  BaseFloat tot1 = ReferenceLatticeForwardBackward(lat, &post1, &like_sum1);
+  FlatLattice flat_lat(lat);
+  BaseFloat tot2 = LatticeForwardBackward(flat_lat, &post2, &like_sum2);
+  KALDI_ASSERT(flat_lat.NumFrames() == num_frames);
+  KALDI_ASSERT(tot1 == tot2 && like_sum1 == like_sum2 && post1 == post2);
+  KALDI_ASSERT(LatticeForwardBackward(lat, &post2) == tot1 && post1 == post2);
+
+  for (int32 i = 0; i < 4; i++) {
+    std::string criterion = (i % 2 == 0 ? "smbr" : "mpfe");
+    bool one_silence_class = (i / 2 == 0);
+    BaseFloat acc1 = ReferenceLatticeForwardBackwardMpeVariants(
+        trans, silence_phones, lat, num_ali, criterion, one_silence_class,
+        &post1);
+    BaseFloat acc2 = LatticeForwardBackwardMpeVariants(
+        trans, silence_phones, lat, num_ali, criterion, one_silence_class,
+        &post2);
+    KALDI_ASSERT(acc1 == acc2 && post1 == post2);
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  std::vector<int32> phones;
+  for (int32 i = 1; i < 20; i++)
+    phones.push_back(i);
+  std::vector<int32> num_pdf_classes, silence_phones;
+  silence_phones.push_back(1);
+  silence_phones.push_back(2);
+  ContextDependency *ctx_dep = GenRandContextDependencyLarge(
+      phones, 3, 1, true, &num_pdf_classes);
+  HmmTopology topo = GetDefaultTopology(phones);
+  TransitionModel trans(*ctx_dep, topo);
+  delete ctx_dep;
+
+  for (int32 i = 0; i < 10; i++)
+    TestFlatLatticeForwardBackward(trans, silence_phones, 1 + Rand() % 50,
+                                   1 + Rand() % 10);
+  KALDI_LOG << "Success.";
+}
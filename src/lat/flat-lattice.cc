@@ -0,0 +1,306 @@
+// lat/flat-lattice.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "lat/flat-lattice.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+FlatLattice::FlatLattice(const Lattice &lat) {
+  if (!lat.Properties(fst::kTopSorted, true))
+    KALDI_ERR << "Input lattice must be topologically sorted.";
+  KALDI_ASSERT(lat.Start() == 0);
+  int32 num_states = lat.NumStates(), num_arcs = 0;
+  arc_begin_.resize(num_states + 1);
+  for (int32 s = 0; s < num_states; s++) {
+    arc_begin_[s] = num_arcs;
+    num_arcs += lat.NumArcs(s);
+  }
+  arc_begin_[num_states] = num_arcs;
+  next_state_.resize(num_arcs);
+  ilabel_.resize(num_arcs);
+  weight_.resize(num_arcs);
+  final_.resize(num_states);
+  // We work out the state times as LatticeStateTimes() does.
+  state_times_.resize(num_states, -1);
+  state_times_[0] = 0;
+  for (int32 s = 0; s < num_states; s++) {
+    int32 cur_time = state_times_[s], a = arc_begin_[s];
+    for (fst::ArcIterator<Lattice> aiter(lat, s); !aiter.Done();
+         aiter.Next(), a++) {
+      const LatticeArc &arc = aiter.Value();
+      next_state_[a] = arc.nextstate;
+      ilabel_[a] = arc.ilabel;
+      weight_[a] = arc.weight;
+      int32 next_time = cur_time + (arc.ilabel != 0 ? 1 : 0);
+      if (state_times_[arc.nextstate] == -1)
+        state_times_[arc.nextstate] = next_time;
+      else
+        KALDI_ASSERT(state_times_[arc.nextstate] == next_time);
+    }
+    final_[s] = lat.Final(s);
+  }
+  num_frames_ = *std::max_element(state_times_.begin(), state_times_.end());
+}
+
+// Computes the forward log-probabilities of the states, not including the
+// final-probs, and returns the total log-probability of the lattice.
+static double ComputeFlatLatticeAlphas(const FlatLattice &lat,
+                                       std::vector<double> *alpha) {
+  int32 num_states = lat.NumStates(), max_time = lat.NumFrames();
+  alpha->clear();
+  alpha->resize(num_states, kLogZeroDouble);
+  double *alpha_data = &((*alpha)[0]), tot_forward_prob = kLogZeroDouble;
+  alpha_data[0] = 0.0;
+  for (int32 s = 0; s < num_states; s++) {
+    double this_alpha = alpha_data[s];
+    for (int32 a = lat.ArcBegin(s), end = lat.ArcEnd(s); a < end; a++) {
+      int32 n = lat.NextState(a);
+      double arc_like = -ConvertToCost(lat.Weight(a));
+      alpha_data[n] = LogAdd(alpha_data[n], this_alpha + arc_like);
+    }
+    const LatticeWeight &f = lat.Final(s);
+    if (f != LatticeWeight::Zero()) {
+      double final_like = this_alpha - (f.Value1() + f.Value2());
+      tot_forward_prob = LogAdd(tot_forward_prob, final_like);
+      KALDI_ASSERT(lat.StateTime(s) == max_time &&
+                   "Lattice is inconsistent (final-prob not at max_time)");
+    }
+  }
+  return tot_forward_prob;
+}
+
+// Computes the backward log-probabilities of the states, including the
+// final-probs.
+static void ComputeFlatLatticeBetas(const FlatLattice &lat,
+                                    std::vector<double> *beta) {
+  int32 num_states = lat.NumStates();
+  beta->resize(num_states);
+  double *beta_data = &((*beta)[0]);
+  for (int32 s = num_states - 1; s >= 0; s--) {
+    const LatticeWeight &f = lat.Final(s);
+    double this_beta = -(f.Value1() + f.Value2());
+    for (int32 a = lat.ArcBegin(s), end = lat.ArcEnd(s); a < end; a++) {
+      double arc_like = -ConvertToCost(lat.Weight(a)),
+          arc_beta = beta_data[lat.NextState(a)] + arc_like;
+      this_beta = LogAdd(this_beta, arc_beta);
+    }
+    beta_data[s] = this_beta;
+  }
+}
+
+// Clears and resizes "post" to num_frames, and reserves space for the
+// posteriors of the arcs with transition-ids.
+static void InitFlatLatticePosterior(const FlatLattice &lat, Posterior *post) {
+  int32 num_frames = lat.NumFrames();
+  std::vector<int32> counts(num_frames, 0);
+  for (int32 s = 0; s < lat.NumStates(); s++)
+    for (int32 a = lat.ArcBegin(s), end = lat.ArcEnd(s); a < end; a++)
+      if (lat.ILabel(a) != 0)
+        counts[lat.StateTime(s)]++;
+  post->clear();
+  post->resize(num_frames);
+  for (int32 t = 0; t < num_frames; t++)
+    (*post)[t].reserve(counts[t]);
+}
+
+// Note: the operations below are done in exactly the same order as in the
+// old code, which used fst::ArcIterator, so the results are identical.
+BaseFloat LatticeForwardBackward(const FlatLattice &lat, Posterior *post,
+                                 double *acoustic_like_sum) {
+  if (acoustic_like_sum) *acoustic_like_sum = 0.0;
+  int32 num_states = lat.NumStates(), num_arcs = lat.NumArcs();
+  std::vector<double> alpha, beta;
+  double tot_forward_prob = ComputeFlatLatticeAlphas(lat, &alpha);
+  ComputeFlatLatticeBetas(lat, &beta);
+
+  // Work out the posteriors of all the arcs.  The Exp() is done in a
+  // separate loop over a contiguous array, which the compiler can vectorize.
+  std::vector<double> arc_post(num_arcs);
+  for (int32 s = 0; s < num_states; s++) {
+    for (int32 a = lat.ArcBegin(s), end = lat.ArcEnd(s); a < end; a++) {
+      double arc_like = -ConvertToCost(lat.Weight(a)),
+          arc_beta = beta[lat.NextState(a)] + arc_like;
+      arc_post[a] = alpha[s] + arc_beta - tot_forward_prob;
+    }
+  }
+  for (int32 a = 0; a < num_arcs; a++)
+    arc_post[a] = Exp(arc_post[a]);
+
+  InitFlatLatticePosterior(lat, post);
+  for (int32 s = num_states - 1; s >= 0; s--) {
+    int32 t = lat.StateTime(s);
+    for (int32 a = lat.ArcBegin(s), end = lat.ArcEnd(s); a < end; a++) {
+      int32 transition_id = lat.ILabel(a);
+      if (transition_id != 0)  // Arc has a transition-id on it [not epsilon]
+        (*post)[t].push_back(std::make_pair(
+            transition_id, static_cast<BaseFloat>(arc_post[a])));
+      if (acoustic_like_sum != NULL)
+        *acoustic_like_sum -= arc_post[a] * lat.Weight(a).Value2();
+    }
+    const LatticeWeight &f = lat.Final(s);
+    if (acoustic_like_sum != NULL && f != LatticeWeight::Zero()) {
+      double final_logprob = - ConvertToCost(f),
+          posterior = Exp(alpha[s] + final_logprob - tot_forward_prob);
+      *acoustic_like_sum -= posterior * f.Value2();
+    }
+  }
+  double tot_backward_prob = beta[0];
+  if (!ApproxEqual(tot_forward_prob, tot_backward_prob, 1e-8)) {
+    KALDI_WARN << "Total forward probability over lattice = "
+               << tot_forward_prob << ", while total backward probability = "
+               << tot_backward_prob;
+  }
+  // Now combine any posteriors with the same transition-id.
+  for (int32 t = 0; t < lat.NumFrames(); t++)
+    MergePairVectorSumming(&((*post)[t]));
+  return tot_backward_prob;
+}
+
+BaseFloat LatticeForwardBackwardMpeVariants(
+    const TransitionModel &trans,
+    const std::vector<int32> &silence_phones,
+    const FlatLattice &lat,
+    const std::vector<int32> &num_ali,
+    std::string criterion,
+    bool one_silence_class,
+    Posterior *post) {
+  KALDI_ASSERT(criterion == "mpfe" || criterion == "smbr");
+  bool is_mpfe = (criterion == "mpfe");
+  int32 num_states = lat.NumStates(), num_arcs = lat.NumArcs(),
+      max_time = lat.NumFrames();
+  KALDI_ASSERT(max_time == static_cast<int32>(num_ali.size()));
+
+  // Work out the frame accuracy of each arc; the old code did this in both
+  // of the second passes.
+  std::vector<double> frame_acc(num_arcs, 0.0);
+  {
+    std::vector<int32> ref_phone(max_time), ref_pdf(max_time, -1);
+    std::vector<bool> ref_phone_is_sil(max_time);
+    for (int32 t = 0; t < max_time; t++) {
+      ref_phone[t] = trans.TransitionIdToPhone(num_ali[t]);
+      ref_phone_is_sil[t] = std::binary_search(silence_phones.begin(),
+                                               silence_phones.end(),
+                                               ref_phone[t]);
+      if (!is_mpfe)
+        ref_pdf[t] = trans.TransitionIdToPdf(num_ali[t]);
+    }
+    for (int32 s = 0; s < num_states; s++) {
+      int32 cur_time = lat.StateTime(s);
+      for (int32 a = lat.ArcBegin(s), end = lat.ArcEnd(s); a < end; a++) {
+        int32 transition_id = lat.ILabel(a);
+        if (transition_id == 0) continue;
+        int32 phone = trans.TransitionIdToPhone(transition_id);
+        bool phone_is_sil = std::binary_search(silence_phones.begin(),
+                                               silence_phones.end(),
+                                               phone),
+            both_sil = phone_is_sil && ref_phone_is_sil[cur_time];
+        if (!is_mpfe) { // smbr.
+          int32 pdf = trans.TransitionIdToPdf(transition_id);
+          if (!one_silence_class)  // old behavior
+            frame_acc[a] = (pdf == ref_pdf[cur_time] && !phone_is_sil) ?
+                1.0 : 0.0;
+          else
+            frame_acc[a] = (pdf == ref_pdf[cur_time] || both_sil) ? 1.0 : 0.0;
+        } else {
+          if (!one_silence_class)  // old behavior
+            frame_acc[a] = (phone == ref_phone[cur_time] && !phone_is_sil) ?
+                1.0 : 0.0;
+          else
+            frame_acc[a] = (phone == ref_phone[cur_time] || both_sil) ?
+                1.0 : 0.0;
+        }
+      }
+    }
+  }
+
+  std::vector<double> alpha, beta,
+      alpha_smbr(num_states, 0),  // forward variable for sMBR
+      beta_smbr(num_states, 0);  // backward variable for sMBR
+  // First pass forward and backward.
+  double tot_forward_prob = ComputeFlatLatticeAlphas(lat, &alpha);
+  ComputeFlatLatticeBetas(lat, &beta);
+  double tot_backward_prob = beta[0];
+  // may loose the condition somehow here 1e-6 (was 1e-8)
+  if (!ApproxEqual(tot_forward_prob, tot_backward_prob, 1e-6)) {
+    KALDI_ERR << "Total forward probability over lattice = "
+              << tot_forward_prob << ", while total backward probability = "
+              << tot_backward_prob;
+  }
+
+  double tot_forward_score = 0;
+  alpha_smbr[0] = 0.0;
+  // Second pass forward, calculate forward for MPFE/SMBR
+  for (int32 s = 0; s < num_states; s++) {
+    double this_alpha = alpha[s];
+    for (int32 a = lat.ArcBegin(s), end = lat.ArcEnd(s); a < end; a++) {
+      int32 n = lat.NextState(a);
+      double arc_like = -ConvertToCost(lat.Weight(a));
+      double arc_scale = Exp(alpha[s] + arc_like - alpha[n]);
+      alpha_smbr[n] += arc_scale * (alpha_smbr[s] + frame_acc[a]);
+    }
+    const LatticeWeight &f = lat.Final(s);
+    if (f != LatticeWeight::Zero()) {
+      double final_like = this_alpha - (f.Value1() + f.Value2());
+      double arc_scale = Exp(final_like - tot_forward_prob);
+      tot_forward_score += arc_scale * alpha_smbr[s];
+    }
+  }
+  // Second pass backward, collect Mpe style posteriors
+  InitFlatLatticePosterior(lat, post);
+  for (int32 s = num_states - 1; s >= 0; s--) {
+    int32 t = lat.StateTime(s);
+    for (int32 a = lat.ArcBegin(s), end = lat.ArcEnd(s); a < end; a++) {
+      int32 n = lat.NextState(a), transition_id = lat.ILabel(a);
+      double arc_like = -ConvertToCost(lat.Weight(a)),
+          arc_beta = beta[n] + arc_like;
+      double arc_scale = Exp(beta[n] + arc_like - beta[s]);
+      // check arc_scale NAN,
+      // this is to prevent partial paths in Lattices
+      // i.e., paths don't survive to the final state
+      if (KALDI_ISNAN(arc_scale)) arc_scale = 0;
+      beta_smbr[s] += arc_scale * (beta_smbr[n] + frame_acc[a]);
+
+      if (transition_id != 0) { // Arc has a transition-id on it [not epsilon]
+        double posterior = Exp(alpha[s] + arc_beta - tot_forward_prob);
+        double acc_diff = alpha_smbr[s] + frame_acc[a] + beta_smbr[n]
+            - tot_forward_score;
+        double posterior_smbr = posterior * acc_diff;
+        (*post)[t].push_back(std::make_pair(
+            transition_id, static_cast<BaseFloat>(posterior_smbr)));
+      }
+    }
+  }
+
+  // Second pass forward-backward check
+  double tot_backward_score = beta_smbr[0];  // Initial state id == 0
+  // may loose the condition somehow here 1e-5/1e-4
+  if (!ApproxEqual(tot_forward_score, tot_backward_score, 1e-4)) {
+    KALDI_ERR << "Total forward score over lattice = " << tot_forward_score
+              << ", while total backward score = " << tot_backward_score;
+  }
+
+  // Output the computed posteriors
+  for (int32 t = 0; t < max_time; t++)
+    MergePairVectorSumming(&((*post)[t]));
+  return tot_forward_score;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,92 @@
+// lat/flat-lattice.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LAT_FLAT_LATTICE_H_
+#define KALDI_LAT_FLAT_LATTICE_H_
+
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "hmm/posterior.h"
+#include "hmm/transition-model.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+/**
+   FlatLattice is a read-only copy of a topologically sorted Lattice, with the
+   arcs stored in compressed-sparse-row form: the arcs leaving state s are
+   numbered ArcBegin(s) to ArcEnd(s) - 1, and their next-states, labels and
+   weights are in flat arrays.  Algorithms that make several passes over all
+   the arcs of a lattice, like the forward-backward algorithms below, run much
+   faster on this than through fst::ArcIterator, which does a virtual function
+   call per state and whose arcs are scattered in memory.  The times of the
+   states (as from LatticeStateTimes()) are worked out when it is created.
+*/
+class FlatLattice {
+ public:
+  /// "lat" must be topologically sorted, with zero as the start state.
+  explicit FlatLattice(const Lattice &lat);
+
+  int32 NumStates() const { return final_.size(); }
+  int32 NumArcs() const { return next_state_.size(); }
+  /// Returns the maximum time of any state, which is the number of frames.
+  int32 NumFrames() const { return num_frames_; }
+
+  int32 ArcBegin(int32 s) const { return arc_begin_[s]; }
+  int32 ArcEnd(int32 s) const { return arc_begin_[s + 1]; }
+  int32 NextState(int32 arc) const { return next_state_[arc]; }
+  /// The input label (transition-id, or zero) of an arc.
+  int32 ILabel(int32 arc) const { return ilabel_[arc]; }
+  const LatticeWeight &Weight(int32 arc) const { return weight_[arc]; }
+
+  const LatticeWeight &Final(int32 s) const { return final_[s]; }
+  int32 StateTime(int32 s) const { return state_times_[s]; }
+  const std::vector<int32> &StateTimes() const { return state_times_; }
+
+ private:
+  std::vector<int32> arc_begin_;  // indexed by state, plus one at the end.
+  std::vector<int32> next_state_;  // indexed by arc.
+  std::vector<int32> ilabel_;  // indexed by arc.
+  std::vector<LatticeWeight> weight_;  // indexed by arc.
+  std::vector<LatticeWeight> final_;  // indexed by state.
+  std::vector<int32> state_times_;  // indexed by state.
+  int32 num_frames_;
+};
+
+/// As LatticeForwardBackward() in lattice-functions.h (which calls this), but
+/// on a FlatLattice.  The results are exactly the same.
+BaseFloat LatticeForwardBackward(const FlatLattice &lat,
+                                 Posterior *arc_post,
+                                 double *acoustic_like_sum = NULL);
+
+/// As LatticeForwardBackwardMpeVariants() in lattice-functions.h (which calls
+/// this), but on a FlatLattice.  The results are exactly the same.
+BaseFloat LatticeForwardBackwardMpeVariants(
+    const TransitionModel &trans,
+    const std::vector<int32> &silence_phones,
+    const FlatLattice &lat,
+    const std::vector<int32> &num_ali,
+    std::string criterion,
+    bool one_silence_class,
+    Posterior *post);
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_FLAT_LATTICE_H_
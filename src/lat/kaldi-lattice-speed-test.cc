@@ -0,0 +1,107 @@
+// lat/kaldi-lattice-speed-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "lat/kaldi-lattice.h"
+#include "base/timer.h"
+
+
+namespace kaldi {
+
+// Creates a topologically sorted lattice that looks roughly like decoder
+// output: each state has a few word arcs to the next few states, and the
+// transition-id strings consist of runs of the same transition-id, as from
+// HMM self-loops.
+static void RandDecoderLikeLattice(int32 num_states, CompactLattice *clat) {
+  clat->DeleteStates();
+  for (int32 s = 0; s < num_states; s++)
+    clat->AddState();
+  clat->SetStart(0);
+  for (int32 s = 0; s + 1 < num_states; s++) {
+    int32 num_arcs = 1 + Rand() % 4;
+    for (int32 a = 0; a < num_arcs; a++) {
+      int32 nextstate = std::min(num_states - 1, s + 1 + Rand() % 3),
+          word = 1 + Rand() % 20000;
+      std::vector<int32> string;
+      int32 num_phones = 1 + Rand() % 6;
+      for (int32 p = 0; p < num_phones * 3; p++) {
+        int32 tid = 1 + Rand() % 5000, length = 1 + Rand() % 4;
+        string.insert(string.end(), length, tid);
+      }
+      LatticeWeight weight(RandUniform() * 10.0,
+                           -100.0 * string.size() + RandGauss() * 20.0);
+      clat->AddArc(s, CompactLatticeArc(word, word,
+                                        CompactLatticeWeight(weight, string),
+                                        nextstate));
+    }
+  }
+  clat->SetFinal(num_states - 1, CompactLatticeWeight::One());
+}
+
+// Writes "clat" num_iters times, in OpenFst's format if cost_resolution is
+// -1, and in the compressed format otherwise, then reads it back as many
+// times, and prints the size and the time taken per lattice (we compare the
+// time per lattice, not the bytes per second, as the formats differ in size).
+static void TestCompactLatticeIoSpeed(const CompactLattice &clat,
+                                      BaseFloat cost_resolution,
+                                      int32 num_iters) {
+  std::string str;
+  Timer timer;
+  for (int32 i = 0; i < num_iters; i++) {
+    std::ostringstream os;
+    if (cost_resolution == -1)
+      KALDI_ASSERT(WriteCompactLattice(os, true, clat));
+    else
+      KALDI_ASSERT(WriteCompactLatticeCompressed(os, cost_resolution, clat));
+    if (i == 0)
+      str = os.str();
+  }
+  double write_time = timer.Elapsed();
+  timer.Reset();
+  for (int32 i = 0; i < num_iters; i++) {
+    std::istringstream is(str);
+    CompactLattice *clat2 = NULL;
+    KALDI_ASSERT(ReadCompactLattice(is, true, &clat2));
+    KALDI_ASSERT(clat2->NumStates() == clat.NumStates());
+    delete clat2;
+  }
+  double read_time = timer.Elapsed();
+  std::ostringstream format;
+  if (cost_resolution == -1)
+    format << "OpenFst format";
+  else
+    format << "compressed format with resolution " << cost_resolution;
+  KALDI_LOG << "For " << format.str() << ", size is " << str.size()
+            << " bytes; writing takes " << (1000.0 * write_time / num_iters)
+            << " ms and reading " << (1000.0 * read_time / num_iters)
+            << " ms per lattice.";
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  CompactLattice clat;
+  RandDecoderLikeLattice(2000, &clat);
+  int32 num_iters = 20;
+  TestCompactLatticeIoSpeed(clat, -1, num_iters);
+  TestCompactLatticeIoSpeed(clat, 0.0, num_iters);
+  TestCompactLatticeIoSpeed(clat, 1.0 / 128, num_iters);
+  std::cout << "Test OK\n";
+}
@@ -155,6 +155,89 @@ void TestLatticeTableCross(bool binary) {
 }
 
 
+// Tests the compressed format, directly and via the table code.
+void TestCompactLatticeCompressed() {
+  for (int32 i = 0; i < 10; i++) {
+    CompactLattice *clat = RandCompactLattice();
+    {  // Lossless.
+      std::ostringstream os;
+      KALDI_ASSERT(WriteCompactLatticeCompressed(os, 0.0, *clat));
+      std::istringstream is(os.str());
+      CompactLattice clat2;
+      KALDI_ASSERT(ReadCompactLatticeCompressed(is, &clat2));
+      KALDI_ASSERT(fst::Equal(clat2, *clat));
+    }
+    {  // Costs rounded to multiples of 1/128.
+      std::ostringstream os;
+      KALDI_ASSERT(WriteCompactLatticeCompressed(os, 1.0 / 128, *clat));
+      std::istringstream is(os.str());
+      CompactLattice clat2;
+      KALDI_ASSERT(ReadCompactLatticeCompressed(is, &clat2));
+      KALDI_ASSERT(clat2.NumStates() == clat->NumStates());
+      Lattice lat, lat2;
+      ConvertLattice(*clat, &lat);
+      ConvertLattice(clat2, &lat2);
+      KALDI_ASSERT(fst::RandEquivalent(lat, lat2, 5, 0.1, Rand(), 10));
+    }
+    {  // A truncated lattice should be rejected.
+      std::ostringstream os;
+      WriteCompactLatticeCompressed(os, 0.0, *clat);
+      std::string str = os.str();
+      std::istringstream is(str.substr(0, str.size() - 1));
+      CompactLattice clat2;
+      KALDI_ASSERT(!ReadCompactLatticeCompressed(is, &clat2));
+    }
+    {  // So should a lattice with a corrupted size (which is the uint64 after
+       // the 4-byte magic number and the float resolution), whether it is
+       // too large to be believable or just larger than the data.
+      std::ostringstream os;
+      WriteCompactLatticeCompressed(os, 0.0, *clat);
+      std::string str = os.str();
+      uint64 size;
+      for (int32 j = 0; j < 2; j++) {
+        size = (j == 0 ? ~static_cast<uint64>(0) : (1 << 30));
+        str.replace(8, sizeof(size), reinterpret_cast<const char*>(&size),
+                    sizeof(size));
+        std::istringstream is(str);
+        CompactLattice clat2;
+        KALDI_ASSERT(!ReadCompactLatticeCompressed(is, &clat2));
+      }
+    }
+    delete clat;
+  }
+  {  // A corrupted run length in a string should be rejected, not make us
+     // allocate a huge string.  The string is one run of length 2^14, whose
+     // varint is "\x80\x80\x01"; we change it to 127 * 2^14, which is too
+     // much for such a small lattice.
+    CompactLattice clat;
+    clat.AddState();
+    clat.SetStart(0);
+    clat.SetFinal(0, CompactLatticeWeight(LatticeWeight::One(),
+                                          std::vector<int32>(1 << 14, 5)));
+    std::ostringstream os;
+    KALDI_ASSERT(WriteCompactLatticeCompressed(os, 0.0, clat));
+    std::string str = os.str();
+    size_t pos = str.find("\x80\x80\x01");
+    KALDI_ASSERT(pos != std::string::npos);
+    {
+      std::istringstream is(str);
+      CompactLattice clat2;
+      KALDI_ASSERT(ReadCompactLatticeCompressed(is, &clat2) &&
+                   fst::Equal(clat, clat2));
+    }
+    str[pos + 2] = '\x7f';
+    std::istringstream is(str);
+    CompactLattice clat2;
+    KALDI_ASSERT(!ReadCompactLatticeCompressed(is, &clat2));
+  }
+
+  g_compact_lattice_compression_opts.compress = true;
+  g_compact_lattice_compression_opts.cost_resolution = 0.0;
+  TestCompactLatticeTable(true);
+  TestCompactLatticeTableCross(true);
+  g_compact_lattice_compression_opts.compress = false;
+  g_compact_lattice_compression_opts.cost_resolution = 1.0 / 128;
+}
 
 } // end namespace kaldi
 
@@ -167,6 +250,7 @@ int main() {
     TestLatticeTable(binary);
     TestLatticeTableCross(binary);
   }
+  TestCompactLatticeCompressed();
   std::cout << "Test OK\n";
   
   unlink("tmpf");
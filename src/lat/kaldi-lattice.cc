@@ -19,8 +19,12 @@
 // limitations under the License.
 
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include "lat/kaldi-lattice.h"
 #include "fst/script/print-impl.h"
+#include "util/stl-utils.h"
 
 namespace kaldi {
 
@@ -59,9 +63,351 @@ Lattice* ConvertToLattice(Lattice *ifst) {
 }
 
 
+CompactLatticeCompressionOptions g_compact_lattice_compression_opts;
+
+// The magic number of the compressed format; its first character is what
+// ReadCompactLattice() and the holders look at.
+static const char kCompressedLatticeMagic[4] = { 'K', 'C', 'L', '1' };
+
+// The largest size of the data after the magic number that we accept when
+// reading (4G).
+static const uint64 kMaxCompressedLatticeSize = static_cast<uint64>(1) << 32;
+
+// When reading, the total length of the strings (after undoing the
+// run-length encoding) may be at most this many times the size of the data,
+// plus 2^20.
+static const uint64 kMaxCompressedLatticeExpansion = 64;
+
+static inline void WriteVarint(uint64 i, std::string *out) {
+  while (i >= 128) {
+    out->push_back(static_cast<char>((i & 127) | 128));
+    i >>= 7;
+  }
+  out->push_back(static_cast<char>(i));
+}
+
+// Maps signed integers to unsigned ones so that small magnitudes are small.
+static inline uint64 ZigZagEncode(int64 i) {
+  return (static_cast<uint64>(i) << 1) ^ static_cast<uint64>(i >> 63);
+}
+
+static inline int64 ZigZagDecode(uint64 i) {
+  return static_cast<int64>(i >> 1) ^ -static_cast<int64>(i & 1);
+}
+
+// Reads one column of the compressed lattice format.
+class CompressedLatticeColumn {
+ public:
+  CompressedLatticeColumn(const char *begin, const char *end):
+      cur_(begin), end_(end), ok_(true) { }
+  uint64 ReadVarint() {
+    uint64 ans = 0;
+    for (int32 shift = 0; shift < 64; shift += 7) {
+      if (cur_ == end_) break;
+      unsigned char c = static_cast<unsigned char>(*(cur_++));
+      ans |= static_cast<uint64>(c & 127) << shift;
+      if ((c & 128) == 0) return ans;
+    }
+    ok_ = false;
+    return 0;
+  }
+  float ReadFloat() {
+    float ans = 0.0;
+    if (end_ - cur_ < static_cast<ptrdiff_t>(sizeof(ans))) {
+      ok_ = false;
+    } else {
+      memcpy(&ans, cur_, sizeof(ans));
+      cur_ += sizeof(ans);
+    }
+    return ans;
+  }
+  // Returns true if there were no errors and all the data was read.
+  bool Finished() const { return ok_ && cur_ == end_; }
+  bool Ok() const { return ok_; }
+ private:
+  const char *cur_;
+  const char *end_;
+  bool ok_;
+};
+
+bool WriteCompactLatticeCompressed(std::ostream &os, BaseFloat cost_resolution,
+                                   const CompactLattice &clat) {
+  typedef CompactLatticeArc::StateId StateId;
+  typedef unordered_map<std::vector<int32>, int32,
+                        VectorHasher<int32> > StringMap;
+  StateId num_states = clat.NumStates();
+  // We round the costs only if they are all finite and not too large.
+  bool quantize = (cost_resolution > 0.0), acceptor = true;
+  double max_cost = 1.0e+15 * cost_resolution;
+  for (StateId s = 0; s < num_states && quantize; s++) {
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      BaseFloat v1 = arc.weight.Weight().Value1(),
+          v2 = arc.weight.Weight().Value2();
+      if (!KALDI_ISFINITE(v1) || !KALDI_ISFINITE(v2) ||
+          std::abs(v1) > max_cost || std::abs(v2) > max_cost)
+        quantize = false;
+      if (arc.ilabel != arc.olabel)
+        acceptor = false;
+    }
+    const CompactLatticeWeight &final_weight = clat.Final(s);
+    if (final_weight != CompactLatticeWeight::Zero()) {
+      BaseFloat v1 = final_weight.Weight().Value1(),
+          v2 = final_weight.Weight().Value2();
+      if (!KALDI_ISFINITE(v1) || !KALDI_ISFINITE(v2) ||
+          std::abs(v1) > max_cost || std::abs(v2) > max_cost)
+        quantize = false;
+    }
+  }
+  if (!quantize) {
+    cost_resolution = 0.0;
+    for (StateId s = 0; s < num_states && acceptor; s++)
+      for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+           aiter.Next())
+        if (aiter.Value().ilabel != aiter.Value().olabel)
+          acceptor = false;
+  }
+  double inv_resolution = (quantize ? 1.0 / cost_resolution : 0.0);
+
+  StringMap string_map;
+  std::string strings, states, labels, olabels, nextstates, string_ids,
+      weights;
+  int32 num_strings = 0;
+  uint64 total_string_length = 0;
+  for (StateId s = 0; s < num_states; s++) {
+    const CompactLatticeWeight &final_weight = clat.Final(s);
+    bool is_final = (final_weight != CompactLatticeWeight::Zero());
+    WriteVarint(2 * static_cast<uint64>(clat.NumArcs(s)) + (is_final ? 1 : 0),
+                &states);
+    // We visit the arcs, then the final-prob.
+    fst::ArcIterator<CompactLattice> aiter(clat, s);
+    while (true) {
+      const CompactLatticeWeight *weight;
+      if (!aiter.Done()) {
+        const CompactLatticeArc &arc = aiter.Value();
+        WriteVarint(static_cast<uint32>(arc.ilabel), &labels);
+        if (!acceptor)
+          WriteVarint(static_cast<uint32>(arc.olabel), &olabels);
+        WriteVarint(ZigZagEncode(static_cast<int64>(arc.nextstate) - s),
+                    &nextstates);
+        weight = &(arc.weight);
+      } else if (is_final) {
+        weight = &final_weight;
+      } else {
+        break;
+      }
+      std::pair<StringMap::iterator, bool> ret = string_map.insert(
+          std::make_pair(weight->String(), num_strings));
+      if (ret.second) {  // A new string: run-length encode it.
+        const std::vector<int32> &str = weight->String();
+        total_string_length += str.size();
+        std::vector<std::pair<int32, int32> > runs;
+        for (size_t i = 0; i < str.size(); i++) {
+          if (!runs.empty() && runs.back().first == str[i])
+            runs.back().second++;
+          else
+            runs.push_back(std::make_pair(str[i], 1));
+        }
+        WriteVarint(runs.size(), &strings);
+        int32 prev = 0;
+        for (size_t i = 0; i < runs.size(); i++) {
+          WriteVarint(ZigZagEncode(static_cast<int64>(runs[i].first) - prev),
+                      &strings);
+          WriteVarint(runs[i].second, &strings);
+          prev = runs[i].first;
+        }
+        num_strings++;
+      }
+      WriteVarint(ret.first->second, &string_ids);
+      BaseFloat v[2] = { weight->Weight().Value1(),
+                         weight->Weight().Value2() };
+      for (int32 i = 0; i < 2; i++) {
+        if (quantize) {
+          WriteVarint(ZigZagEncode(static_cast<int64>(
+              floor(v[i] * inv_resolution + 0.5))), &weights);
+        } else {
+          weights.append(reinterpret_cast<const char*>(&(v[i])),
+                         sizeof(v[i]));
+        }
+      }
+      if (aiter.Done()) break;
+      aiter.Next();
+    }
+  }
+  std::string header;
+  WriteVarint(num_states, &header);
+  WriteVarint(clat.Start() + 1, &header);  // kNoStateId becomes zero.
+  WriteVarint(acceptor ? 1 : 0, &header);
+  WriteVarint(num_strings, &header);
+  const std::string *columns[7] = { &strings, &states, &labels, &olabels,
+                                    &nextstates, &string_ids, &weights };
+  uint64 size = 0;
+  for (int32 i = 0; i < 7; i++) {
+    WriteVarint(columns[i]->size(), &header);
+    size += columns[i]->size();
+  }
+  size += header.size();
+  if (total_string_length > kMaxCompressedLatticeExpansion * size + (1 << 20)) {
+    KALDI_WARN << "Not writing lattice in compressed format: its strings are "
+               << "too long to be read back.";
+    return false;
+  }
+  float resolution = cost_resolution;
+  os.write(kCompressedLatticeMagic, sizeof(kCompressedLatticeMagic));
+  os.write(reinterpret_cast<const char*>(&resolution), sizeof(resolution));
+  os.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  os.write(header.data(), header.size());
+  for (int32 i = 0; i < 7; i++)
+    os.write(columns[i]->data(), columns[i]->size());
+  return os.good();
+}
+
+bool ReadCompactLatticeCompressed(std::istream &is, CompactLattice *clat) {
+  typedef CompactLatticeArc::StateId StateId;
+  char magic[sizeof(kCompressedLatticeMagic)];
+  float resolution;
+  uint64 size;
+  is.read(magic, sizeof(magic));
+  is.read(reinterpret_cast<char*>(&resolution), sizeof(resolution));
+  is.read(reinterpret_cast<char*>(&size), sizeof(size));
+  if (!is.good() || memcmp(magic, kCompressedLatticeMagic,
+                           sizeof(magic)) != 0) {
+    KALDI_WARN << "Reading compressed lattice: bad header.";
+    return false;
+  }
+  // We don't trust "size" as it comes from the file: we limit it, and we read
+  // the data in pieces so that if it is corrupted, we don't allocate much
+  // more memory than the data that is actually there.
+  if (size > kMaxCompressedLatticeSize) {
+    KALDI_WARN << "Reading compressed lattice: bad size " << size;
+    return false;
+  }
+  std::vector<char> data;
+  while (data.size() < size) {
+    size_t cur_size = data.size(),
+        chunk_size = std::min<uint64>(size - cur_size, 1 << 20);
+    data.resize(cur_size + chunk_size);
+    is.read(&(data[cur_size]), chunk_size);
+    if (!is.good()) {
+      KALDI_WARN << "Reading compressed lattice: unexpected end of file.";
+      return false;
+    }
+  }
+  const char *begin = (size > 0 ? &(data[0]) : NULL), *end = begin + size;
+  CompressedLatticeColumn header(begin, end);
+  uint64 num_states = header.ReadVarint(), start = header.ReadVarint(),
+      acceptor = header.ReadVarint(), num_strings = header.ReadVarint();
+  uint64 column_sizes[7];
+  for (int32 i = 0; i < 7; i++)
+    column_sizes[i] = header.ReadVarint();
+  // The header is followed by the columns; work out where they start.
+  uint64 header_size = size;
+  for (int32 i = 0; i < 7; i++)
+    header_size -= std::min(header_size, column_sizes[i]);
+  const char *column_begin = begin + header_size;
+  std::vector<CompressedLatticeColumn> columns;
+  for (int32 i = 0; i < 7; i++) {
+    if (static_cast<uint64>(end - column_begin) < column_sizes[i]) break;
+    columns.push_back(CompressedLatticeColumn(column_begin,
+                                              column_begin + column_sizes[i]));
+    column_begin += column_sizes[i];
+  }
+  if (!header.Ok() || columns.size() != 7 || column_begin != end ||
+      start > num_states || num_states > size || num_strings > size) {
+    KALDI_WARN << "Reading compressed lattice: bad header.";
+    return false;
+  }
+  CompressedLatticeColumn &strings = columns[0], &states = columns[1],
+      &labels = columns[2], &olabels = columns[3], &nextstates = columns[4],
+      &string_ids = columns[5], &weights = columns[6];
+
+  // Run-length encoding means the strings can legitimately be much longer
+  // than the data, but we limit their total length so that a corrupted run
+  // length can't make us allocate a huge amount of memory.
+  uint64 max_total_length = kMaxCompressedLatticeExpansion * size + (1 << 20),
+      total_length = 0;
+  std::vector<std::vector<int32> > string_table(num_strings);
+  for (size_t i = 0; i < num_strings && strings.Ok(); i++) {
+    uint64 num_runs = strings.ReadVarint();
+    int32 prev = 0;
+    for (uint64 r = 0; r < num_runs && strings.Ok(); r++) {
+      int32 id = prev + ZigZagDecode(strings.ReadVarint());
+      uint64 length = strings.ReadVarint();
+      if (length > max_total_length - total_length) {
+        KALDI_WARN << "Reading compressed lattice: strings are too long "
+                   << "(data is corrupted?)";
+        return false;
+      }
+      total_length += length;
+      string_table[i].insert(string_table[i].end(), length, id);
+      prev = id;
+    }
+  }
+
+  clat->DeleteStates();
+  for (uint64 s = 0; s < num_states; s++)
+    clat->AddState();
+  if (start > 0)
+    clat->SetStart(start - 1);
+  bool ok = true;
+  for (StateId s = 0; s < static_cast<StateId>(num_states) && ok; s++) {
+    uint64 code = states.ReadVarint(), num_arcs = code / 2;
+    bool is_final = ((code & 1) != 0);
+    for (uint64 a = 0; a <= num_arcs && ok; a++) {
+      if (a == num_arcs && !is_final) break;
+      CompactLatticeArc arc;
+      if (a < num_arcs) {
+        arc.ilabel = static_cast<int32>(labels.ReadVarint());
+        arc.olabel = (acceptor ? arc.ilabel :
+                      static_cast<int32>(olabels.ReadVarint()));
+        int64 nextstate = s + ZigZagDecode(nextstates.ReadVarint());
+        if (nextstate < 0 || nextstate >= static_cast<int64>(num_states)) {
+          ok = false;
+          break;
+        }
+        arc.nextstate = nextstate;
+      }
+      uint64 string_id = string_ids.ReadVarint();
+      if (string_id >= num_strings) {
+        ok = false;
+        break;
+      }
+      BaseFloat v1, v2;
+      if (resolution > 0.0) {
+        v1 = ZigZagDecode(weights.ReadVarint()) * resolution;
+        v2 = ZigZagDecode(weights.ReadVarint()) * resolution;
+      } else {
+        v1 = weights.ReadFloat();
+        v2 = weights.ReadFloat();
+      }
+      CompactLatticeWeight weight(LatticeWeight(v1, v2),
+                                  string_table[string_id]);
+      if (a < num_arcs) {
+        arc.weight = weight;
+        clat->AddArc(s, arc);
+      } else {
+        clat->SetFinal(s, weight);
+      }
+    }
+  }
+  for (int32 i = 0; i < 7; i++)
+    if (!columns[i].Finished())
+      ok = false;
+  if (!ok) {
+    KALDI_WARN << "Reading compressed lattice: data is corrupted.";
+    clat->DeleteStates();
+    return false;
+  }
+  return true;
+}
+
 bool WriteCompactLattice(std::ostream &os, bool binary,
                          const CompactLattice &t) {
-  if (binary) {
+  if (binary && g_compact_lattice_compression_opts.compress) {
+    return WriteCompactLatticeCompressed(
+        os, g_compact_lattice_compression_opts.cost_resolution, t);
+  } else if (binary) {
     fst::FstWriteOptions opts;
     // Leave all the options default.  Normally these lattices wouldn't have any
     // osymbols/isymbols so no point directing it not to write them (who knows what
@@ -310,7 +656,15 @@ Lattice *ReadLatticeText(std::istream &is) {
 bool ReadCompactLattice(std::istream &is, bool binary,
                         CompactLattice **clat) {
   KALDI_ASSERT(*clat == NULL);
-  if (binary) {
+  if (binary && is.peek() == kCompressedLatticeMagic[0]) {
+    CompactLattice *ans = new CompactLattice();
+    if (!ReadCompactLatticeCompressed(is, ans)) {
+      delete ans;
+      return false;
+    }
+    *clat = ans;
+    return true;
+  } else if (binary) {
     fst::FstHeader hdr;
     if (!hdr.Read(is, "<unknown>")) {
       KALDI_WARN << "Reading compact lattice: error reading FST header.";
@@ -380,8 +734,9 @@ bool CompactLatticeHolder::Read(std::istream &is) {
     // cannot begin with space because it starts with the FST Type() which is not
     // space).
     return ReadCompactLattice(is, false, &t_);
-  } else if (c != 214) { // 214 is first char of FST magic number,
-    // on little-endian machines which is all we support (\326 octal)
+  } else if (c != 214 && c != kCompressedLatticeMagic[0]) {
+    // 214 is first char of FST magic number, on little-endian machines which
+    // is all we support (\326 octal); the other is the compressed format.
     KALDI_WARN << "Reading compact lattice: does not appear to be an FST "
                << " [non-space but no magic number detected], file pos is "
                << is.tellg();
@@ -429,7 +784,15 @@ bool WriteLattice(std::ostream &os, bool binary, const Lattice &t) {
 bool ReadLattice(std::istream &is, bool binary,
                  Lattice **lat) {
   KALDI_ASSERT(*lat == NULL);
-  if (binary) {
+  if (binary && is.peek() == kCompressedLatticeMagic[0]) {
+    CompactLattice *clat = new CompactLattice();
+    if (!ReadCompactLatticeCompressed(is, clat)) {
+      delete clat;
+      return false;
+    }
+    *lat = ConvertToLattice(clat);  // frees "clat".
+    return true;
+  } else if (binary) {
     fst::FstHeader hdr;
     if (!hdr.Read(is, "<unknown>")) {
       KALDI_WARN << "Reading lattice: error reading FST header.";
@@ -502,8 +865,9 @@ bool LatticeHolder::Read(std::istream &is) {
     // cannot begin with space because it starts with the FST Type() which is not
     // space).
     return ReadLattice(is, false, &t_);
-  } else if (c != 214) { // 214 is first char of FST magic number,
-    // on little-endian machines which is all we support (\326 octal)
+  } else if (c != 214 && c != kCompressedLatticeMagic[0]) {
+    // 214 is first char of FST magic number, on little-endian machines which
+    // is all we support (\326 octal); the other is the compressed format.
     KALDI_WARN << "Reading compact lattice: does not appear to be an FST "
                << " [non-space but no magic number detected], file pos is "
                << is.tellg();
@@ -59,6 +59,9 @@ int32 CompactLatticeStateTimes(const CompactLattice &clat,
 /// acoustic likelihood [i.e. negated acoustic score] on that link.
 /// This is used in combination with other quantities to work out
 /// the objective function in MMI discriminative training.
+/// This creates a FlatLattice (see flat-lattice.h) and calls the version of
+/// this function that takes that; if you need several of these functions on
+/// the same lattice, it is faster to create the FlatLattice yourself.
 BaseFloat LatticeForwardBackward(const Lattice &lat,
                                  Posterior *arc_post,
                                  double *acoustic_like_sum = NULL);
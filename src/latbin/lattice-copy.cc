@@ -43,6 +43,7 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     bool write_compact = true;
     po.Register("write-compact", &write_compact, "If true, write in normal (compact) form.");
+    g_compact_lattice_compression_opts.Register(&po);
     
     po.Read(argc, argv);
 
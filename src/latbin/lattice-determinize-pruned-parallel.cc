@@ -32,6 +32,7 @@ class DeterminizeLatticeTask {
   // Initializer takes ownership of "lat".
   DeterminizeLatticeTask(
       fst::DeterminizeLatticePrunedOptions &opts,
+      const fst::DeterminizeLatticeChunkOptions &chunk_opts,
       std::string key,
       BaseFloat acoustic_scale,
       BaseFloat beam,
@@ -39,9 +40,9 @@ class DeterminizeLatticeTask {
       Lattice *lat,
       CompactLatticeWriter *clat_writer,
       int32 *num_warn):
-      opts_(opts), key_(key), acoustic_scale_(acoustic_scale), beam_(beam),
-      minimize_(minimize), lat_(lat), clat_writer_(clat_writer),
-      num_warn_(num_warn) { }
+      opts_(opts), chunk_opts_(chunk_opts), key_(key),
+      acoustic_scale_(acoustic_scale), beam_(beam), minimize_(minimize),
+      lat_(lat), clat_writer_(clat_writer), num_warn_(num_warn) { }
 
   void operator () () {
     Invert(lat_); // to get word labels on the input side.
@@ -49,13 +50,15 @@ class DeterminizeLatticeTask {
     // afterward, since it can affect the result.
     fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale_), lat_);
     if (!TopSort(lat_)) {
-      KALDI_WARN << "Could not topologically sort lattice: this probably means it"
-          " has bad properties e.g. epsilon cycles.  Your LM or lexicon might "
-          "be broken, e.g. LM with epsilon cycles or lexicon with empty words.";
+      KALDI_WARN << "Could not topologically sort lattice: this probably "
+          "means it has bad properties e.g. epsilon cycles.  Your LM or "
+          "lexicon might be broken, e.g. LM with epsilon cycles or lexicon "
+          "with empty words.";
       (*num_warn_)++;
     }
     fst::ArcSort(lat_, fst::ILabelCompare<LatticeArc>());
-    if (!DeterminizeLatticePruned(*lat_, beam_, &det_clat_, opts_)) {
+    if (!DeterminizeLatticePrunedChunked(*lat_, beam_, &det_clat_, opts_,
+                                         chunk_opts_)) {
       KALDI_WARN << "For key " << key_ << ", determinization did not succeed"
           "(partial output will be pruned tighter than the specified beam.)";
       (*num_warn_)++;
@@ -78,6 +81,7 @@ class DeterminizeLatticeTask {
   }
  private:
   const fst::DeterminizeLatticePrunedOptions &opts_;
+  const fst::DeterminizeLatticeChunkOptions &chunk_opts_;
   std::string key_;
   BaseFloat acoustic_scale_;
   BaseFloat beam_;
@@ -99,32 +103,43 @@ int main(int argc, char *argv[]) {
     typedef kaldi::int32 int32;
     
     const char *usage =
-        "Determinize lattices, keeping only the best path (sequence of acoustic states)\n"
-        "for each input-symbol sequence.  This is a version of lattice-determnize-pruned\n"
-        "that accepts the --num-threads option.  These programs do pruning as part of the\n"
-        "determinization algorithm, which is more efficient and prevents blowup.\n"
-        "See http://kaldi.sourceforge.net/lattices.html for more information on lattices.\n"
+        "Determinize lattices, keeping only the best path (sequence of\n"
+        "acoustic states) for each input-symbol sequence.  This is a version\n"
+        "of lattice-determnize-pruned that accepts the --num-threads option.\n"
+        "These programs do pruning as part of the determinization algorithm,\n"
+        "which is more efficient and prevents blowup.  See\n"
+        "http://kaldi.sourceforge.net/lattices.html for more information on\n"
+        "lattices.\n"
         "\n"
-        "Usage: lattice-determinize-pruned-parallel [options] lattice-rspecifier lattice-wspecifier\n"
-        " e.g.: lattice-determinize-pruned-parallel --acoustic-scale=0.1 --beam=6.0 ark:in.lats ark:det.lats\n";
+        "Usage: lattice-determinize-pruned-parallel [options] "
+        "lattice-rspecifier lattice-wspecifier\n"
+        " e.g.: lattice-determinize-pruned-parallel --acoustic-scale=0.1 "
+        "--beam=6.0 ark:in.lats ark:det.lats\n";
     
     ParseOptions po(usage);
     BaseFloat acoustic_scale = 1.0;
     BaseFloat beam = 10.0;
     bool minimize = false;
     TaskSequencerConfig sequencer_config; // has --num-threads option
-    fst::DeterminizeLatticePrunedOptions determinize_config; // Options used in DeterminizeLatticePruned--
-    // this options class does not have its own Register function as it's viewed as
-    // being more part of "fst world", so we register its elements independently.
+    // Options used in DeterminizeLatticePruned-- this options class does not
+    // have its own Register function as it's viewed as being more part of
+    // "fst world", so we register its elements independently.
+    fst::DeterminizeLatticePrunedOptions determinize_config;
     determinize_config.max_mem = 50000000;
     determinize_config.max_loop = 0; // was 500000;
     
     po.Register("acoustic-scale", &acoustic_scale,
                 "Scaling factor for acoustic likelihoods");
-    po.Register("beam", &beam, "Pruning beam [applied after acoustic scaling].");
+    po.Register("beam", &beam,
+                "Pruning beam [applied after acoustic scaling].");
     po.Register("minimize", &minimize,
                 "If true, push and minimize after determinization");
+    // --determinize-threads splits each long lattice into pieces that are
+    // determinized in parallel; this helps when there are a few long lattices
+    // rather than many short ones.
+    fst::DeterminizeLatticeChunkOptions chunk_config;
     determinize_config.Register(&po);
+    chunk_config.Register(&po);
     sequencer_config.Register(&po);
     po.Read(argc, argv);
 
@@ -159,7 +174,7 @@ int main(int argc, char *argv[]) {
       KALDI_VLOG(2) << "Processing lattice " << key;
 
       DeterminizeLatticeTask *task = new DeterminizeLatticeTask(
-          determinize_config, key, acoustic_scale, beam, minimize,
+          determinize_config, chunk_config, key, acoustic_scale, beam, minimize,
           lat, &compact_lat_writer, &n_warn);
       sequencer.Run(task);
       n_done++;
@@ -54,6 +54,8 @@ int main(int argc, char *argv[]) {
     po.Register("minimize", &minimize,
                 "If true, push and minimize after determinization");
     opts.Register(&po);
+    fst::DeterminizeLatticeChunkOptions chunk_opts;
+    chunk_opts.Register(&po);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 2) {
@@ -93,7 +95,8 @@ int main(int argc, char *argv[]) {
       }
       fst::ArcSort(&lat, fst::ILabelCompare<LatticeArc>());
       CompactLattice det_clat;
-      if (!DeterminizeLatticePruned(lat, beam, &det_clat, opts)) {
+      if (!DeterminizeLatticePrunedChunked(lat, beam, &det_clat, opts,
+                                           chunk_opts)) {
         KALDI_WARN << "For key " << key << ", determinization did not succeed"
             "(partial output will be pruned tighter than the specified beam.)";
         n_warn++;
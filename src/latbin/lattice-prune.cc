@@ -24,6 +24,83 @@
 #include "fstext/fstext-lib.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
+#include "thread/kaldi-table-pipeline.h"
+
+namespace kaldi {
+
+// The output of LatticePrunePipeline::Process(): the pruned lattice, and
+// statistics.
+struct PrunedLattice {
+  CompactLattice clat;
+  int64 narcs, nstates;  // before pruning.
+  bool error;
+  PrunedLattice(): narcs(0), nstates(0), error(false) { }
+};
+
+// Prunes the lattices, in parallel if --num-threads > 1.
+class LatticePrunePipeline: public TablePipeline<CompactLatticeHolder,
+                                                 PrunedLattice> {
+ public:
+  LatticePrunePipeline(const TaskSequencerConfig &config,
+                       BaseFloat acoustic_scale, BaseFloat beam,
+                       CompactLatticeWriter *writer):
+      TablePipeline<CompactLatticeHolder, PrunedLattice>(config),
+      acoustic_scale_(acoustic_scale), beam_(beam), writer_(writer),
+      n_done_(0), n_err_(0), n_arcs_in_(0), n_arcs_out_(0), n_states_in_(0),
+      n_states_out_(0) { }
+
+  virtual bool Process(const std::string &key, const CompactLattice &clat,
+                       PrunedLattice *output) {
+    CompactLattice &pruned_clat = output->clat;
+    pruned_clat = clat;
+    fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale_),
+                      &pruned_clat);
+    output->narcs = NumArcs(pruned_clat);
+    output->nstates = pruned_clat.NumStates();
+    if (!PruneLattice(beam_, &pruned_clat))
+      output->error = true;
+    fst::ScaleLattice(fst::AcousticLatticeScale(1.0/acoustic_scale_),
+                      &pruned_clat);
+    return true;
+  }
+
+  virtual void Output(const std::string &key, const PrunedLattice &output) {
+    if (output.error) {
+      KALDI_WARN << "Error pruning lattice for utterance " << key;
+      n_err_++;
+    }
+    int64 pruned_narcs = NumArcs(output.clat),
+        pruned_nstates = output.clat.NumStates();
+    n_arcs_in_ += output.narcs;
+    n_states_in_ += output.nstates;
+    n_arcs_out_ += pruned_narcs;
+    n_states_out_ += pruned_nstates;
+    KALDI_LOG << "For utterance " << key << ", pruned #states from "
+              << output.nstates << " to " << pruned_nstates
+              << " and #arcs from " << output.narcs << " to " << pruned_narcs;
+    writer_->Write(key, output.clat);
+    n_done_++;
+  }
+
+  void PrintStats() const {
+    BaseFloat den = (n_done_ > 0 ? static_cast<BaseFloat>(n_done_) : 1.0);
+    KALDI_LOG << "Overall, pruned from on average " << (n_states_in_/den)
+              << " to " << (n_states_out_/den) << " states, and from "
+              << (n_arcs_in_/den) << " to " << (n_arcs_out_/den)
+              << " arcs, over " << n_done_ << " utterances.";
+  }
+
+  int32 NumDone() const { return n_done_; }
+
+ private:
+  BaseFloat acoustic_scale_;
+  BaseFloat beam_;
+  CompactLatticeWriter *writer_;
+  int32 n_done_, n_err_;
+  int64 n_arcs_in_, n_arcs_out_, n_states_in_, n_states_out_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -43,11 +120,13 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 1.0;
     BaseFloat inv_acoustic_scale = 1.0;
     BaseFloat beam = 10.0;
+    TaskSequencerConfig sequencer_config;
     
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("inv-acoustic-scale", &inv_acoustic_scale, "An alternative way of setting the "
                 "acoustic scale: you can set its inverse.");
     po.Register("beam", &beam, "Pruning beam [applied after acoustic scaling]");
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
 
@@ -68,43 +147,14 @@ int main(int argc, char *argv[]) {
     SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier); 
 
-    int32 n_done = 0, n_err = 0;
-    int64 n_arcs_in = 0, n_arcs_out = 0,
-        n_states_in = 0, n_states_out = 0;
-
     if (acoustic_scale == 0.0)
       KALDI_ERR << "Do not use a zero acoustic scale (cannot be inverted)";
-    
-    for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
-      std::string key = compact_lattice_reader.Key();
-      CompactLattice clat = compact_lattice_reader.Value();
-      compact_lattice_reader.FreeCurrent();
-      fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale), &clat);
-      int64 narcs = NumArcs(clat), nstates = clat.NumStates();
-      n_arcs_in += narcs;
-      n_states_in += nstates;
-      CompactLattice pruned_clat(clat);
-      if (!PruneLattice(beam, &pruned_clat)) {
-        KALDI_WARN << "Error pruning lattice for utterance " << key;
-        n_err++;
-      }
-      int64 pruned_narcs = NumArcs(pruned_clat),          
-          pruned_nstates = pruned_clat.NumStates();
-      n_arcs_out += pruned_narcs;
-      n_states_out += pruned_nstates;
-      KALDI_LOG << "For utterance " << key << ", pruned #states from "
-                << nstates << " to " << pruned_nstates << " and #arcs from "
-                << narcs << " to " << pruned_narcs;
-      fst::ScaleLattice(fst::AcousticLatticeScale(1.0/acoustic_scale), &pruned_clat);
-      compact_lattice_writer.Write(key, pruned_clat);
-      n_done++;
-    }
 
-    BaseFloat den = (n_done > 0 ? static_cast<BaseFloat>(n_done) : 1.0);
-    KALDI_LOG << "Overall, pruned from on average " << (n_states_in/den) << " to "
-              << (n_states_out/den) << " states, and from " << (n_arcs_in/den)
-              << " to " << (n_arcs_out/den) << " arcs, over " << n_done
-              << " utterances.";
+    LatticePrunePipeline pipeline(sequencer_config, acoustic_scale, beam,
+                                  &compact_lattice_writer);
+    pipeline.Run(&compact_lattice_reader);
+    pipeline.PrintStats();
+    int32 n_done = pipeline.NumDone();
     KALDI_LOG << "Done " << n_done << " lattices.";
     return (n_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
@@ -99,14 +99,19 @@ void CompressedMatrix::CopyFromMat(
         reinterpret_cast<unsigned char*>(header_data + global_header.num_cols);
 
     const Real *matrix_data = mat.Data();
-
+    MatrixIndexT stride = mat.Stride();
+    int32 num_rows = global_header.num_rows;
+    // We copy each column to a contiguous buffer first; this way we only
+    // read it from the matrix (which is slow as it's strided) once.
+    std::vector<Real> col_data(num_rows);
     for (int32 col = 0; col < global_header.num_cols; col++) {
-      CompressColumn(global_header,
-                     matrix_data + col, mat.Stride(),
-                     global_header.num_rows,
+      const Real *src = matrix_data + col;
+      for (int32 r = 0; r < num_rows; r++)
+        col_data[r] = src[r * stride];
+      CompressColumn(global_header, &(col_data[0]), 1, num_rows,
                      header_data, byte_data);
       header_data++;
-      byte_data += global_header.num_rows;
+      byte_data += num_rows;
     }
   } else {
     uint16 *data = reinterpret_cast<uint16*>(static_cast<char*>(data_) +
@@ -329,12 +334,14 @@ void CompressedMatrix::ComputeColHeader(
 // static
 inline unsigned char CompressedMatrix::FloatToChar(
     float p0, float p25, float p75, float p100,
+    float inv1, float inv2, float inv3,
     float value) {
+  // inv1, inv2 and inv3 are 64 / (p25 - p0), 128 / (p75 - p25) and
+  // 63 / (p100 - p75); see CompressColumn().
   int ans;
   if (value < p25) {  // range [ p0, p25 ) covered by
     // characters 0 .. 64.  We round to the closest int.
-    float f = (value - p0) / (p25 - p0);
-    ans = static_cast<int>(f * 64 + 0.5);
+    ans = static_cast<int>((value - p0) * inv1 + 0.5);
     // Note: the checks on the next two lines
     // are necessary in pathological cases when all the elements in a row
     // are the same and the percentile_* values are separated by one.
@@ -342,16 +349,14 @@ inline unsigned char CompressedMatrix::FloatToChar(
     if (ans > 64) ans = 64;
   } else if (value < p75) {  // range [ p25, p75 )covered
     // by characters 64 .. 192.  We round to the closest int.
-    float f = (value - p25) / (p75 - p25);
-    ans = 64 + static_cast<int>(f * 128 + 0.5);
+    ans = 64 + static_cast<int>((value - p25) * inv2 + 0.5);
     if (ans < 64) ans = 64;
     if (ans > 192) ans = 192;
   } else {  // range [ p75, p100 ] covered by
     // characters 192 .. 255.  Note: this last range
     // has fewer characters than the left range, because
     // we go up to 255, not 256.
-    float f = (value - p75) / (p100 - p75);
-    ans = 192 + static_cast<int>(f * 63 + 0.5);
+    ans = 192 + static_cast<int>((value - p75) * inv3 + 0.5);
     if (ans < 192) ans = 192;
     if (ans > 255) ans = 255;
   }
@@ -360,16 +365,29 @@ inline unsigned char CompressedMatrix::FloatToChar(
 
 
 // static
-inline float CompressedMatrix::CharToFloat(
-    float p0, float p25, float p75, float p100,
-    unsigned char value) {
-  if (value <= 64) {
-    return p0 + (p25 - p0) * value * (1/64.0);
-  } else if (value <= 192) {
-    return p25 + (p75 - p25) * (value - 64) * (1/128.0);
-  } else {
-    return p75 + (p100 - p75) * (value - 192) * (1/63.0);
-  }
+inline void CompressedMatrix::GetColDecoder(const GlobalHeader &global_header,
+                                            const PerColHeader &header,
+                                            float *p0, float *s1, float *s2,
+                                            float *s3) {
+  float p25 = Uint16ToFloat(global_header, header.percentile_25),
+      p75 = Uint16ToFloat(global_header, header.percentile_75),
+      p100 = Uint16ToFloat(global_header, header.percentile_100);
+  *p0 = Uint16ToFloat(global_header, header.percentile_0);
+  *s1 = (p25 - *p0) * (1.0F / 64);
+  *s2 = (p75 - p25) * (1.0F / 128);
+  *s3 = (p100 - p75) * (1.0F / 63);
+}
+
+// static
+inline float CompressedMatrix::CharToFloat(float p0, float s1, float s2,
+                                           float s3, unsigned char value) {
+  // This is equivalent to: if value <= 64, p0 + (p25 - p0) * value / 64; else
+  // if value <= 192, p25 + (p75 - p25) * (value - 64) / 128; else p75 + (p100
+  // - p75) * (value - 192) / 63.  It's written without branches so that the
+  // compiler can vectorize it.
+  int32 v = value;
+  return p0 + s1 * std::min(v, 64) + s2 * std::min(std::max(v - 64, 0), 128) +
+      s3 * std::max(v - 192, 0);
 }
 
 
@@ -387,9 +405,13 @@ void CompressedMatrix::CompressColumn(
       p75 = Uint16ToFloat(global_header, header->percentile_75),
       p100 = Uint16ToFloat(global_header, header->percentile_100);
 
+  // Multiplying is faster than dividing for each element.
+  float inv1 = 64.0F / (p25 - p0), inv2 = 128.0F / (p75 - p25),
+      inv3 = 63.0F / (p100 - p75);
   for (int32 i = 0; i < num_rows; i++) {
     Real this_data = data[i * stride];
-    byte_data[i] = FloatToChar(p0, p25, p75, p100, this_data);
+    byte_data[i] = FloatToChar(p0, p25, p75, p100, inv1, inv2, inv3,
+                               this_data);
   }
 }
 
@@ -492,31 +514,7 @@ void CompressedMatrix::CopyToMat(MatrixBase<Real> *mat) const {
   int32 num_cols = h->num_cols, num_rows = h->num_rows;
   KALDI_ASSERT(mat->NumRows() == num_rows);
   KALDI_ASSERT(mat->NumCols() == num_cols);
-  
-  if (h->format == 1) {
-    PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
-    unsigned char *byte_data = reinterpret_cast<unsigned char*>(per_col_header +
-                                                                h->num_cols);
-    for (int32 i = 0; i < num_cols; i++, per_col_header++) {
-      float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
-          p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
-          p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
-          p100 = Uint16ToFloat(*h, per_col_header->percentile_100);
-      for (int32 j = 0; j < num_rows; j++, byte_data++) {
-        float f = CharToFloat(p0, p25, p75, p100, *byte_data);
-        (*mat)(j, i) = f;
-      }
-    }
-  } else {
-    KALDI_ASSERT(h->format == 2);
-    const uint16 *data = reinterpret_cast<const uint16*>(h + 1);
-    for (int32 i = 0; i < num_rows; i++) {
-      Real *row_data = mat->RowData(i);
-      for (int32 j = 0; j < num_cols; j++)
-        row_data[j] = Uint16ToFloat(*h, data[j]);
-      data += num_cols;
-    }
-  }
+  DecompressBlock(0, num_rows, 0, num_cols, mat->Data(), mat->Stride());
 }
 
 // Instantiate the template for float and double.
@@ -531,63 +529,17 @@ void CompressedMatrix::CopyRowToVec(MatrixIndexT row,
   KALDI_ASSERT(row < this->NumRows());
   KALDI_ASSERT(row >= 0);
   KALDI_ASSERT(v->Dim() == this->NumCols());
-
-  GlobalHeader *h = reinterpret_cast<GlobalHeader*>(data_);
-
-  if (h->format == 1) {  // format with per-col header.
-    PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
-    unsigned char *byte_data = reinterpret_cast<unsigned char*>(per_col_header +
-                                                                h->num_cols);
-    byte_data += row;  // point to first value we are interested in
-    for (int32 i = 0; i < h->num_cols;
-         i++, per_col_header++, byte_data+=h->num_rows) {
-      float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
-          p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
-          p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
-          p100 = Uint16ToFloat(*h, per_col_header->percentile_100);
-      float f = CharToFloat(p0, p25, p75, p100, *byte_data);
-      (*v)(i) = f;
-    }
-  } else {
-    KALDI_ASSERT(h->format == 2);  // uint16 format
-    int32 num_cols = h->num_cols;
-    const uint16 *row_data = reinterpret_cast<uint16*>(h + 1) + (num_cols * row);
-    Real *v_data = v->Data();
-    for (int32 c = 0; c < num_cols; c++)
-      v_data[c] = Uint16ToFloat(*h, row_data[c]);
-  }
+  DecompressBlock(row, 1, 0, v->Dim(), v->Data(), 0);
 }
+
 template<typename Real>
 void CompressedMatrix::CopyColToVec(MatrixIndexT col,
                                     VectorBase<Real> *v) const {
   KALDI_ASSERT(col < this->NumCols());
   KALDI_ASSERT(col >= 0);
   KALDI_ASSERT(v->Dim() == this->NumRows());
-
-  GlobalHeader *h = reinterpret_cast<GlobalHeader*>(data_);
-
-  if (h->format == 1) {  // format with per-col header.
-    PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
-    unsigned char *byte_data = reinterpret_cast<unsigned char*>(per_col_header +
-                                                                h->num_cols);
-    byte_data += col*h->num_rows;  // point to first value in the column we want
-    per_col_header += col;
-    float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
-        p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
-        p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
-        p100 = Uint16ToFloat(*h, per_col_header->percentile_100);
-    for (int32 i = 0; i < h->num_rows; i++, byte_data++) {
-      float f = CharToFloat(p0, p25, p75, p100, *byte_data);
-      (*v)(i) = f;
-    }
-  } else {
-    KALDI_ASSERT(h->format == 2);  // uint16 format
-    int32 num_rows = h->num_rows, num_cols = h->num_cols;
-    const uint16 *col_data = reinterpret_cast<uint16*>(h + 1) + col;
-    Real *v_data = v->Data();
-    for (int32 r = 0; r < num_rows; r++)
-      v_data[r] = Uint16ToFloat(*h, col_data[r * num_cols]);
-  }
+  // A column is a block with one column and a row stride of 1.
+  DecompressBlock(0, v->Dim(), col, 1, v->Data(), 1);
 }
 
 // instantiate the templates.
@@ -604,55 +556,12 @@ template<typename Real>
 void CompressedMatrix::CopyToMat(int32 row_offset,
                                  int32 col_offset,
                                  MatrixBase<Real> *dest) const {
-  KALDI_PARANOID_ASSERT(row_offset < this->NumRows());
-  KALDI_PARANOID_ASSERT(col_offset < this->NumCols());
-  KALDI_PARANOID_ASSERT(row_offset >= 0);
-  KALDI_PARANOID_ASSERT(col_offset >= 0);
-  KALDI_ASSERT(row_offset+dest->NumRows() < this->NumRows());
-  KALDI_ASSERT(col_offset+dest->NumCols() < this->NumCols());
-  // everything is OK
-  GlobalHeader *h = reinterpret_cast<GlobalHeader*>(data_);
-  int32 num_rows = h->num_rows, num_cols = h->num_cols,
-      tgt_cols = dest->NumCols(), tgt_rows = dest->NumRows();
-  
-  if (h->format == 1) {
-    // format where we have a per-column header and use one byte per
-    // element.
-    PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
-    unsigned char *byte_data = reinterpret_cast<unsigned char*>(per_col_header +
-                                                                h->num_cols);
-
-    unsigned char *start_of_subcol = byte_data+row_offset;  // skip appropriate
-    // number of columns
-    start_of_subcol += col_offset*num_rows;  // skip appropriate number of rows
-
-    per_col_header += col_offset;  // skip the appropriate number of headers
-
-    for (int32 i = 0;
-         i < tgt_cols;
-         i++, per_col_header++, start_of_subcol+=num_rows) {
-      byte_data = start_of_subcol;
-      float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
-          p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
-          p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
-          p100 = Uint16ToFloat(*h, per_col_header->percentile_100);
-      for (int32 j = 0; j < tgt_rows; j++, byte_data++) {
-        float f = CharToFloat(p0, p25, p75, p100, *byte_data);
-        (*dest)(j, i) = f;
-      }
-    }
-  } else {
-    KALDI_ASSERT(h->format == 2);
-    const uint16 *data = reinterpret_cast<const uint16*>(h+1) + col_offset +
-        (num_cols * row_offset);
-
-    for (int32 row = 0; row < tgt_rows; row++) {
-      Real *dest_row = dest->RowData(row);
-      for (int32 col = 0; col < tgt_cols; col++)
-        dest_row[col] = Uint16ToFloat(*h, data[col]);
-      data += num_cols;
-    }
-  }
+  KALDI_ASSERT(row_offset >= 0 && col_offset >= 0);
+  KALDI_ASSERT(row_offset + dest->NumRows() <= this->NumRows());
+  KALDI_ASSERT(col_offset + dest->NumCols() <= this->NumCols());
+  if (dest->NumRows() == 0 || dest->NumCols() == 0) return;
+  DecompressBlock(row_offset, dest->NumRows(), col_offset, dest->NumCols(),
+                  dest->Data(), dest->Stride());
 }
 
 // instantiate the templates.
@@ -663,6 +572,47 @@ template void CompressedMatrix::CopyToMat(int32,
                int32,
                MatrixBase<double> *dest) const;
 
+template<typename Real>
+void CompressedMatrix::DecompressBlock(int32 row_offset, int32 num_rows,
+                                       int32 col_offset, int32 num_cols,
+                                       Real *dest, MatrixIndexT stride) const {
+  const GlobalHeader *h = reinterpret_cast<const GlobalHeader*>(data_);
+  int32 tot_rows = h->num_rows, tot_cols = h->num_cols;
+  if (h->format == 1) {
+    // Format where each column has a PerColHeader and is stored contiguously
+    // as bytes.  We go through the rows in blocks, and through each block one
+    // column at a time, so the columns are read sequentially while the part
+    // of "dest" we are writing to stays in cache.
+    const PerColHeader *per_col_header =
+        reinterpret_cast<const PerColHeader*>(h + 1) + col_offset;
+    const unsigned char *byte_data =
+        reinterpret_cast<const unsigned char*>(
+            reinterpret_cast<const PerColHeader*>(h + 1) + tot_cols) +
+        col_offset * tot_rows + row_offset;
+    const int32 kBlockSize = 32;
+    for (int32 r0 = 0; r0 < num_rows; r0 += kBlockSize) {
+      int32 block_rows = std::min(kBlockSize, num_rows - r0);
+      for (int32 c = 0; c < num_cols; c++) {
+        float p0, s1, s2, s3;
+        GetColDecoder(*h, per_col_header[c], &p0, &s1, &s2, &s3);
+        const unsigned char *col_data = byte_data + c * tot_rows + r0;
+        Real *d = dest + r0 * stride + c;
+        for (int32 r = 0; r < block_rows; r++, d += stride)
+          *d = CharToFloat(p0, s1, s2, s3, col_data[r]);
+      }
+    }
+  } else {
+    KALDI_ASSERT(h->format == 2);
+    const uint16 *data = reinterpret_cast<const uint16*>(h + 1) +
+        row_offset * tot_cols + col_offset;
+    float min_value = h->min_value,
+        increment = h->range * 1.52590218966964e-05F;  // 1/65535.
+    for (int32 r = 0; r < num_rows; r++, data += tot_cols, dest += stride)
+      for (int32 c = 0; c < num_cols; c++)
+        dest[c] = min_value + increment * data[c];
+  }
+}
+
 void CompressedMatrix::Destroy() {
   if (data_ != NULL) {
     delete [] static_cast<float*>(data_);
@@ -103,7 +103,10 @@ class CompressedMatrix {
 
   /// Copies submatrix of compressed matrix into matrix dest.
   /// Submatrix starts at row row_offset and column column_offset and its size
-  /// is defined by size of provided matrix dest
+  /// is defined by size of provided matrix dest.  dest may be a SubMatrix of
+  /// a larger matrix, so you can use this to decompress part of *this
+  /// directly into place (e.g. when assembling a minibatch) without
+  /// decompressing all of it into a temporary matrix.
   template<typename Real>
   void CopyToMat(int32 row_offset,
                  int32 column_offset,
@@ -156,10 +159,22 @@ class CompressedMatrix {
                                     uint16 value);
   static inline unsigned char FloatToChar(float p0, float p25,
                                           float p75, float p100,
+                                          float inv1, float inv2, float inv3,
                                           float value);
-  static inline float CharToFloat(float p0, float p25,
-                                  float p75, float p100,
+  // Works out the coefficients that CharToFloat() needs for a column.
+  static inline void GetColDecoder(const GlobalHeader &global_header,
+                                   const PerColHeader &header,
+                                   float *p0, float *s1, float *s2, float *s3);
+  static inline float CharToFloat(float p0, float s1, float s2, float s3,
                                   unsigned char value);
+
+  // Decompresses the block of num_rows by num_cols elements starting at
+  // (row_offset, col_offset) to "dest", which has row-stride "stride".  All
+  // the decompression functions use this, so they give identical results.
+  template<typename Real>
+  void DecompressBlock(int32 row_offset, int32 num_rows,
+                       int32 col_offset, int32 num_cols,
+                       Real *dest, MatrixIndexT stride) const;
   
   void Destroy();
   
@@ -4215,6 +4215,37 @@ static void UnitTestExtractCompressedMatrix() {
 }
 
 
+// Tests decompressing a range of rows and columns directly into part of a
+// larger matrix, including ranges that extend to the last row or column.
+template<typename Real>
+static void UnitTestCompressedMatrixCopyToSubMatrix() {
+  for (int32 i = 0; i < 30; i++) {
+    MatrixIndexT num_rows = 1 + Rand() % 100, num_cols = 1 + Rand() % 30;
+    Matrix<Real> mat(num_rows, num_cols);
+    mat.SetRandn();
+    CompressedMatrix cmat(mat);
+    Matrix<Real> full(cmat);
+
+    MatrixIndexT row_offset = Rand() % num_rows, col_offset = Rand() % num_cols,
+        sub_num_rows = num_rows - row_offset,
+        sub_num_cols = num_cols - col_offset;
+    if (Rand() % 2 == 0) sub_num_rows = 1 + Rand() % sub_num_rows;
+    if (Rand() % 2 == 0) sub_num_cols = 1 + Rand() % sub_num_cols;
+    // "dest" is a part of a larger matrix, so its stride is not its
+    // number of columns.
+    Matrix<Real> big(sub_num_rows + 2, sub_num_cols + 3);
+    big.Set(-100.0);
+    SubMatrix<Real> dest(big, 1, sub_num_rows, 2, sub_num_cols);
+    cmat.CopyToMat(row_offset, col_offset, &dest);
+    SubMatrix<Real> expected(full, row_offset, sub_num_rows,
+                             col_offset, sub_num_cols);
+    AssertEqual(dest, expected);
+    // The elements around "dest" should not have been touched.
+    dest.Set(-100.0);
+    KALDI_ASSERT(big.Min() == -100.0 && big.Max() == -100.0);
+  }
+}
+
 template<typename Real>
 static void UnitTestTridiag() {
   SpMatrix<Real> A(3);
@@ -4335,6 +4366,7 @@ template<typename Real> static void MatrixUnitTest(bool full_test) {
   // UnitTestSvdBad<Real>(); // test bug in Jama SVD code.
   UnitTestCompressedMatrix<Real>();
   UnitTestExtractCompressedMatrix<Real>();
+  UnitTestCompressedMatrixCopyToSubMatrix<Real>();
   UnitTestResize<Real>();
   UnitTestMatrixExponentialBackprop();
   UnitTestMatrixExponential<Real>();
@@ -25,6 +25,7 @@
 #include "nnet/nnet-max-pooling-component.h"
 #include "nnet/nnet-max-pooling-2d-component.h"
 #include "nnet/nnet-average-pooling-2d-component.h"
+#include "nnet/nnet-lstm-projected-streams.h"
 #include "util/common-utils.h"
 
 #include <sstream>
@@ -294,6 +295,61 @@ namespace nnet1 {
     delete c;
   }
 
+  void UnitTestLstmProjectedStreamsPacking() {
+    // several sequences packed into the streams of one minibatch should
+    // give the same output and input-diff as each sequence on its own,
+    int32 input_dim = 5, num_streams = 3, num_frames = 7;
+    LstmProjectedStreams* c = dynamic_cast<LstmProjectedStreams*>(
+      Component::Init("<LstmProjectedStreams> <InputDim> 5 <OutputDim> 4 "
+                      "<CellDim> 6 <ParamScale> 0.5"));
+    std::vector<int32> reset_all(num_streams, 1);
+
+    // prepare input, stream 1 holds sequences at frames [0,1), [1,3), [3,7),
+    // stream 2 at frames [0,5), [5,7),
+    CuMatrix<BaseFloat> mat_in(num_frames * num_streams, input_dim),
+      mat_out_diff(num_frames * num_streams, c->OutputDim());
+    mat_in.SetRandn();
+    mat_out_diff.SetRandn();
+    std::vector<int32> seq_start(num_frames * num_streams, 0);
+    seq_start[1 * num_streams + 1] = 1;
+    seq_start[3 * num_streams + 1] = 1;
+    seq_start[5 * num_streams + 2] = 1;
+
+    // propagate, backpropagate the packed minibatch,
+    CuMatrix<BaseFloat> mat_out, mat_in_diff;
+    c->ResetLstmStreams(reset_all);
+    c->SetSequenceStarts(seq_start);
+    c->Propagate(mat_in, &mat_out);
+    c->Backpropagate(mat_in, mat_out, mat_out_diff, &mat_in_diff);
+
+    // compare with the sequences of stream 1 starting at frame 0,
+    int32 seq_begin[] = { 1, 3 }, seq_length[] = { 2, 4 };
+    for (int32 n = 0; n < 2; n++) {
+      CuMatrix<BaseFloat> mat_in2(num_frames * num_streams, input_dim),
+        mat_out_diff2(num_frames * num_streams, c->OutputDim());
+      mat_in2.SetRandn();
+      for (int32 t = 0; t < seq_length[n]; t++) {
+        int32 r = t * num_streams + 1, r_packed = (seq_begin[n] + t) * num_streams + 1;
+        mat_in2.Row(r).CopyFromVec(mat_in.Row(r_packed));
+        mat_out_diff2.Row(r).CopyFromVec(mat_out_diff.Row(r_packed));
+      }
+      CuMatrix<BaseFloat> mat_out2, mat_in_diff2;
+      c->ResetLstmStreams(reset_all);
+      c->Propagate(mat_in2, &mat_out2);
+      c->Backpropagate(mat_in2, mat_out2, mat_out_diff2, &mat_in_diff2);
+      for (int32 t = 0; t < seq_length[n]; t++) {
+        int32 r = t * num_streams + 1, r_packed = (seq_begin[n] + t) * num_streams + 1;
+        CuVector<BaseFloat> out2(mat_out2.Row(r)), out(mat_out.Row(r_packed)),
+          in_diff2(mat_in_diff2.Row(r)), in_diff(mat_in_diff.Row(r_packed));
+        AssertEqual(out2, out);
+        AssertEqual(in_diff2, in_diff);
+      }
+    }
+
+    // clean,
+    delete c;
+  }
+
 } // namespace nnet1
 } // namespace kaldi
 
@@ -315,6 +371,7 @@ int main() {
     UnitTestConvolutional2DComponent();
     UnitTestMaxPooling2DComponent();
     UnitTestAveragePooling2DComponent();
+    UnitTestLstmProjectedStreamsPacking();
     // end of unit-tests,
     if (loop == 0)
         KALDI_LOG << "Tests without GPU use succeeded.";
@@ -293,6 +293,16 @@ class LstmProjectedStreams : public UpdatableComponent {
     }
   }
 
+  /// Marks the frames of the next minibatch where a new sequence starts in the
+  /// middle of a stream, so that utterances can be packed into the streams
+  /// back to back instead of padding the minibatch.  The flags are in the
+  /// order of the rows of the input, t * nstream + s; a flag of 1 means the
+  /// state of stream s is reset before frame t.  They apply to the next
+  /// PropagateFnc() and the BackpropagateFnc() that follows it.
+  void SetSequenceStarts(const std::vector<int32> &seq_start_flag) {
+    seq_start_flag_ = seq_start_flag;
+  }
+
   void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
     int DEBUG = 0;
 
@@ -342,6 +352,23 @@ class LstmProjectedStreams : public UpdatableComponent {
     // bias -> g, i, f, o
     YGIFO.RowRange(1*S,T*S).AddVecToRows(1.0, bias_);
 
+    // seq_starts_[t] lists the streams in which a new sequence starts at
+    // frame t, see SetSequenceStarts(),
+    seq_starts_.clear();
+    seq_starts_.resize(T+2);
+    if (!seq_start_flag_.empty()) {
+      KALDI_ASSERT(seq_start_flag_.size() == in.NumRows());
+      for (int32 r = 0; r < in.NumRows(); r++)
+        if (seq_start_flag_[r] == 1) seq_starts_[1 + r / S].push_back(r % S);
+      seq_start_flag_.clear();
+    }
+
+    // the c(t-1) and r(t-1) which are the input of frame t, in frames [1,T];
+    // they are zero where a new sequence starts,
+    prev_state_buf_.Resize(T*S, ncell_ + nrecur_, kUndefined);
+    CuSubMatrix<BaseFloat> PC(prev_state_buf_.ColRange(0, ncell_));
+    CuSubMatrix<BaseFloat> PR(prev_state_buf_.ColRange(ncell_, nrecur_));
+
     for (int t = 1; t <= T; t++) {
       // multistream buffers for current time-step
       CuSubMatrix<BaseFloat> y_g(YG.RowRange(t*S,S));
@@ -354,43 +381,27 @@ class LstmProjectedStreams : public UpdatableComponent {
       CuSubMatrix<BaseFloat> y_r(YR.RowRange(t*S,S));
 
       CuSubMatrix<BaseFloat> y_gifo(YGIFO.RowRange(t*S,S));
+      CuSubMatrix<BaseFloat> y_gifochm(propagate_buf_.Range(t*S, S, 0, 7*ncell_));
+
+      CuSubMatrix<BaseFloat> p_c(PC.RowRange((t-1)*S,S));
+      CuSubMatrix<BaseFloat> p_r(PR.RowRange((t-1)*S,S));
+      p_c.CopyFromMat(YC.RowRange((t-1)*S,S));
+      p_r.CopyFromMat(YR.RowRange((t-1)*S,S));
+      for (size_t k = 0; k < seq_starts_[t].size(); k++) {
+        p_c.Row(seq_starts_[t][k]).SetZero();
+        p_r.Row(seq_starts_[t][k]).SetZero();
+      }
 
       // r(t-1) -> g, i, f, o
-      y_gifo.AddMatMat(1.0, YR.RowRange((t-1)*S,S), kNoTrans, w_gifo_r_, kTrans,  1.0);
-
-      // c(t-1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_i_c_, 1.0);
-
-      // c(t-1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
+      y_gifo.AddMatMat(1.0, p_r, kNoTrans, w_gifo_r_, kTrans,  1.0);
 
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-      // c(t-1) -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, YC.RowRange((t-1)*S,S), y_f, 1.0);
-
-      y_c.ApplyFloor(-50);   // optional clipping of cell activation
-      y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-      // h tanh squashing
-      y_h.Tanh(y_c);
-
-      // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c_, 1.0);
-
-      // o sigmoid squashing
-      y_o.Sigmoid(y_o);
-
-      // h -> m via output gate
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      // c(t-1) -> i(t), f(t) via peepholes, the squashing of g, i, f,
+      // c(t-1) -> c(t) via forget-gate and g -> c via input-gate, the optional
+      // clipping of cell activation (google paper Interspeech2014: LSTM for
+      // LVCSR), c(t) -> o(t) via peephole, o squashing, h tanh squashing and
+      // h -> m via output gate: on CPU all in one pass over the data,
+      cu::ComputeLstmNonlinearity(p_c, peephole_i_c_, peephole_f_c_,
+                                  peephole_o_c_, BaseFloat(50.0), &y_gifochm);
 
       // m -> r
       y_r.AddMatMat(1.0, y_m, kNoTrans, w_r_m_, kTrans, 0.0);
@@ -451,15 +462,15 @@ class LstmProjectedStreams : public UpdatableComponent {
     // projection layer to LSTM output is not recurrent, so backprop it all in once
     DR.RowRange(1*S,T*S).CopyFromMat(out_diff);
 
+    // the state of the previous frame, as used in the forward pass,
+    CuSubMatrix<BaseFloat> PC(prev_state_buf_.ColRange(0, ncell_));
+    CuSubMatrix<BaseFloat> PR(prev_state_buf_.ColRange(ncell_, nrecur_));
+    // the diffs of the next frame, with zeros where a new sequence starts,
+    CuMatrix<BaseFloat> next_diff_masked;
+
     for (int t = T; t >= 1; t--) {
-      CuSubMatrix<BaseFloat> y_g(YG.RowRange(t*S,S));
-      CuSubMatrix<BaseFloat> y_i(YI.RowRange(t*S,S));
-      CuSubMatrix<BaseFloat> y_f(YF.RowRange(t*S,S));
-      CuSubMatrix<BaseFloat> y_o(YO.RowRange(t*S,S));
-      CuSubMatrix<BaseFloat> y_c(YC.RowRange(t*S,S));
-      CuSubMatrix<BaseFloat> y_h(YH.RowRange(t*S,S));
-      CuSubMatrix<BaseFloat> y_m(YM.RowRange(t*S,S));
-      CuSubMatrix<BaseFloat> y_r(YR.RowRange(t*S,S));
+      CuSubMatrix<BaseFloat> y_gifochm(propagate_buf_.Range(t*S, S, 0, 7*ncell_));
+      CuSubMatrix<BaseFloat> next_y_gifochm(propagate_buf_.Range((t+1)*S, S, 0, 7*ncell_));
 
       CuSubMatrix<BaseFloat> d_g(DG.RowRange(t*S,S));
       CuSubMatrix<BaseFloat> d_i(DI.RowRange(t*S,S));
@@ -470,10 +481,21 @@ class LstmProjectedStreams : public UpdatableComponent {
       CuSubMatrix<BaseFloat> d_m(DM.RowRange(t*S,S));
       CuSubMatrix<BaseFloat> d_r(DR.RowRange(t*S,S));
 
+      CuSubMatrix<BaseFloat> d_gifochm(backpropagate_buf_.Range(t*S, S, 0, 7*ncell_));
+      CuSubMatrix<BaseFloat> next_d_gifochm(backpropagate_buf_.Range((t+1)*S, S, 0, 7*ncell_));
+      const CuMatrixBase<BaseFloat> *next_diff = &next_d_gifochm;
+      if (!seq_starts_[t+1].empty()) {
+        // nothing flows back from the start of the next sequence,
+        next_diff_masked = next_d_gifochm;
+        for (size_t k = 0; k < seq_starts_[t+1].size(); k++)
+          next_diff_masked.Row(seq_starts_[t+1][k]).SetZero();
+        next_diff = &next_diff_masked;
+      }
+
       // r
       //   Version 1 (precise gradients):
       //   backprop error from g(t+1), i(t+1), f(t+1), o(t+1) to r(t)
-      d_r.AddMatMat(1.0, DGIFO.RowRange((t+1)*S,S), kNoTrans, w_gifo_r_, kNoTrans, 1.0);
+      d_r.AddMatMat(1.0, next_diff->ColRange(0, 4*ncell_), kNoTrans, w_gifo_r_, kNoTrans, 1.0);
 
       /*
       //   Version 2 (Alex Graves' PhD dissertation):
@@ -491,37 +513,17 @@ class LstmProjectedStreams : public UpdatableComponent {
       // r -> m
       d_m.AddMatMat(1.0, d_r, kNoTrans, w_r_m_, kNoTrans, 0.0);
 
-      // m -> h via output gate
-      d_h.AddMatMatElements(1.0, d_m, y_o, 0.0);
-      d_h.DiffTanh(y_h, d_h);
-
-      // o
-      d_o.AddMatMatElements(1.0, d_m, y_h, 0.0);
-      d_o.DiffSigmoid(y_o, d_o);
-
-      // c
+      // m -> h via output gate, o, then c:
       // 1. diff from h(t)
       // 2. diff from c(t+1) (via forget-gate between CEC)
       // 3. diff from i(t+1) (via peephole)
       // 4. diff from f(t+1) (via peephole)
       // 5. diff from o(t)   (via peephole, not recurrent)
-      d_c.AddMat(1.0, d_h);
-      d_c.AddMatMatElements(1.0, DC.RowRange((t+1)*S,S), YF.RowRange((t+1)*S,S), 1.0);
-      d_c.AddMatDiagVec(1.0, DI.RowRange((t+1)*S,S), kNoTrans, peephole_i_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, DF.RowRange((t+1)*S,S), kNoTrans, peephole_f_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, d_o                   , kNoTrans, peephole_o_c_, 1.0);
-
-      // f
-      d_f.AddMatMatElements(1.0, d_c, YC.RowRange((t-1)*S,S), 0.0);
-      d_f.DiffSigmoid(y_f, d_f);
-
-      // i
-      d_i.AddMatMatElements(1.0, d_c, y_g, 0.0);
-      d_i.DiffSigmoid(y_i, d_i);
-
-      // c -> g via input gate
-      d_g.AddMatMatElements(1.0, d_c, y_i, 0.0);
-      d_g.DiffTanh(y_g, d_g);
+      // and f, i, and c -> g via input gate: on CPU all in one pass,
+      cu::BackpropLstmNonlinearity(PC.RowRange((t-1)*S,S), y_gifochm,
+                                   next_y_gifochm, *next_diff,
+                                   peephole_i_c_, peephole_f_c_, peephole_o_c_,
+                                   &d_gifochm);
 
       // debug info
       if (DEBUG) {
@@ -553,16 +555,16 @@ class LstmProjectedStreams : public UpdatableComponent {
                                   in                     , kNoTrans, mmt);
     // recurrent weight r -> g, i, f, o
     w_gifo_r_corr_.AddMatMat(1.0, DGIFO.RowRange(1*S,T*S), kTrans,
-                                  YR.RowRange(0*S,T*S)   , kNoTrans, mmt);
+                                  PR                     , kNoTrans, mmt);
     // bias of g, i, f, o
     bias_corr_.AddRowSumMat(1.0, DGIFO.RowRange(1*S,T*S), mmt);
 
     // recurrent peephole c -> i
     peephole_i_c_corr_.AddDiagMatMat(1.0, DI.RowRange(1*S,T*S), kTrans,
-                                          YC.RowRange(0*S,T*S), kNoTrans, mmt);
+                                          PC                  , kNoTrans, mmt);
     // recurrent peephole c -> f
     peephole_f_c_corr_.AddDiagMatMat(1.0, DF.RowRange(1*S,T*S), kTrans,
-                                          YC.RowRange(0*S,T*S), kNoTrans, mmt);
+                                          PC                  , kNoTrans, mmt);
     // peephole c -> o
     peephole_o_c_corr_.AddDiagMatMat(1.0, DO.RowRange(1*S,T*S), kTrans,
                                           YC.RowRange(1*S,T*S), kNoTrans, mmt);
@@ -722,6 +724,13 @@ class LstmProjectedStreams : public UpdatableComponent {
   // back-propagate buffer: diff-input of [g, i, f, o, c, h, m, r]
   CuMatrix<BaseFloat> backpropagate_buf_;
 
+  // c(t-1) and r(t-1) as input to frames [1,T], zero at sequence starts
+  CuMatrix<BaseFloat> prev_state_buf_;
+
+  // sequence starts inside the minibatch, see SetSequenceStarts(),
+  std::vector<int32> seq_start_flag_;  // as passed to SetSequenceStarts(),
+  std::vector<std::vector<int32> > seq_starts_;  // streams, per frame
+
 };
 } // namespace nnet1
 } // namespace kaldi
@@ -364,6 +364,19 @@ void Nnet::ResetLstmStreams(const std::vector<int32> &stream_reset_flag) {
   }
 }
 
+void Nnet::SetLstmSequenceStarts(const std::vector<int32> &seq_start_flag) {
+  for (int32 c=0; c < NumComponents(); c++) {
+    if (GetComponent(c).GetType() == Component::kLstmProjectedStreams) {
+      LstmProjectedStreams& comp = dynamic_cast<LstmProjectedStreams&>(GetComponent(c));
+      comp.SetSequenceStarts(seq_start_flag);
+    }
+    if (GetComponent(c).GetType() == Component::kBLstmProjectedStreams) {
+      KALDI_ERR << "Packing several sequences into a stream is not supported "
+                << "for BLstmProjectedStreams";
+    }
+  }
+}
+
 
 void Nnet::Init(const std::string &file) {
   Input in(file);
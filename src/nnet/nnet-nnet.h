@@ -100,6 +100,9 @@ class Nnet {
   void SetDropoutRetention(BaseFloat r);
   /// Reset streams in LSTM multi-stream training,
   void ResetLstmStreams(const std::vector<int32> &stream_reset_flag);
+  /// Mark where new sequences start inside the next minibatch of LSTM
+  /// multi-stream training (one flag per row of the input; only LSTM),
+  void SetLstmSequenceStarts(const std::vector<int32> &seq_start_flag);
 
   /// Initialize MLP from config
   void Init(const std::string &config_file);
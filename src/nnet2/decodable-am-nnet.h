@@ -27,10 +27,29 @@
 #include "itf/decodable-itf.h"
 #include "nnet2/am-nnet.h"
 #include "nnet2/nnet-compute.h"
+#include "nnet2/nnet-compiled.h"
 
 namespace kaldi {
 namespace nnet2 {
 
+/// Turns the output of the network into the scaled log-likelihoods used in
+/// decoding: floors the probabilities at 1.0e-20 (to avoid log of zero, which
+/// leads to NaN), takes the log, subtracts the log-priors of "am_nnet" (divides
+/// by the prior) and scales by "prob_scale".  VectorType is the vector type
+/// that matches MatrixType, e.g. CuVector<BaseFloat> for CuMatrix<BaseFloat>.
+template<class VectorType, class MatrixType>
+void ProbsToScaledLogLikes(const AmNnet &am_nnet, BaseFloat prob_scale,
+                           MatrixType *probs) {
+  probs->ApplyFloor(1.0e-20);
+  probs->ApplyLog();
+  VectorType priors(am_nnet.Priors());
+  KALDI_ASSERT(priors.Dim() == probs->NumCols() &&
+               "Priors in neural network not set up.");
+  priors.ApplyLog();
+  probs->AddVecToRows(-1.0, priors);
+  probs->Scale(prob_scale);
+}
+
 /// DecodableAmNnet is a decodable object that decodes
 /// with a neural net acoustic model of type AmNnet.
 
@@ -57,21 +76,40 @@ class DecodableAmNnet: public DecodableInterface {
     CuMatrix<BaseFloat> log_probs(num_rows, trans_model.NumPdfs());
     // the following function is declared in nnet-compute.h
     NnetComputation(am_nnet.GetNnet(), feats, pad_input, &log_probs);
-    log_probs.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
-    log_probs.ApplyLog();
-    CuVector<BaseFloat> priors(am_nnet.Priors());
-    KALDI_ASSERT(priors.Dim() == trans_model.NumPdfs() &&
-                 "Priors in neural network not set up.");
-    priors.ApplyLog();
-    // subtract log-prior (divide by prior)
-    log_probs.AddVecToRows(-1.0, priors);
-    // apply probability scale.
-    log_probs.Scale(prob_scale);
+    ProbsToScaledLogLikes<CuVector<BaseFloat> >(am_nnet, prob_scale,
+                                                &log_probs);
     // Transfer the log-probs to the CPU for faster access by the
     // decoding process.
     log_probs_.Swap(&log_probs);
   }
 
+  /// This version does the computation on the CPU with a CompiledNnet
+  /// (see nnet-compiled.h), which must have been compiled from
+  /// am_nnet.GetNnet().  It is not const because of its buffers, so
+  /// a CompiledNnet may be reused by successive DecodableAmNnet objects
+  /// but not shared between threads.
+  DecodableAmNnet(const TransitionModel &trans_model,
+                  const AmNnet &am_nnet,
+                  CompiledNnet *compiled_nnet,
+                  const MatrixBase<BaseFloat> &feats,
+                  bool pad_input = true,
+                  BaseFloat prob_scale = 1.0):
+      trans_model_(trans_model) {
+    int32 num_rows = feats.NumRows() -
+        (pad_input ? 0 : am_nnet.GetNnet().LeftContext() +
+                         am_nnet.GetNnet().RightContext());
+    if (num_rows <= 0) {
+      KALDI_WARN << "Input with " << feats.NumRows()  << " rows will produce "
+                 << "empty output.";
+      return;
+    }
+    KALDI_ASSERT(compiled_nnet->OutputDim() == trans_model.NumPdfs());
+    log_probs_.Resize(num_rows, trans_model.NumPdfs(), kUndefined);
+    compiled_nnet->Compute(feats, pad_input, &log_probs_);
+    ProbsToScaledLogLikes<Vector<BaseFloat> >(am_nnet, prob_scale,
+                                              &log_probs_);
+  }
+
   // Note, frames are numbered from zero.  But state_index is numbered
   // from one (this routine is called by FSTs).
   virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id) {
@@ -120,16 +158,8 @@ class DecodableAmNnetParallel: public DecodableInterface {
     // the following function is declared in nnet-compute.h
     NnetComputation(am_nnet_.GetNnet(), *feats_,
                     pad_input_, &log_probs_);
-    log_probs_.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
-    log_probs_.ApplyLog();
-    CuVector<BaseFloat> priors(am_nnet_.Priors());
-    KALDI_ASSERT(priors.Dim() == trans_model_.NumPdfs() &&
-                 "Priors in neural network not set up.");
-    priors.ApplyLog();
-    // subtract log-prior (divide by prior)
-    log_probs_.AddVecToRows(-1.0, priors);
-    // apply probability scale.
-    log_probs_.Scale(prob_scale_);
+    ProbsToScaledLogLikes<CuVector<BaseFloat> >(am_nnet_, prob_scale_,
+                                                &log_probs_);
     delete feats_;
     feats_ = NULL;
   }
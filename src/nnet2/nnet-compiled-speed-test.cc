@@ -0,0 +1,122 @@
+// nnet2/nnet-compiled-speed-test.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet2/nnet-nnet.h"
+#include "nnet2/nnet-compute.h"
+#include "nnet2/nnet-compiled.h"
+#include "base/timer.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+
+// Returns the proportion of rows of "a" and "b" whose largest element is in
+// the same place.
+BaseFloat ArgmaxAgreement(const MatrixBase<BaseFloat> &a,
+                          const MatrixBase<BaseFloat> &b) {
+  int32 num_agree = 0;
+  for (int32 r = 0; r < a.NumRows(); r++) {
+    int32 i, j;
+    a.Row(r).Max(&i);
+    b.Row(r).Max(&j);
+    if (i == j) num_agree++;
+  }
+  return num_agree / static_cast<BaseFloat>(a.NumRows());
+}
+
+// Creates a network like those in the p-norm recipes.
+Nnet *GenPnormNnet(int32 input_dim, int32 num_hidden_layers,
+                   int32 pnorm_input_dim, int32 pnorm_output_dim,
+                   int32 output_dim) {
+  std::vector<Component*> components;
+  std::ostringstream os;
+  os << "SpliceComponent input-dim=" << input_dim
+     << " left-context=4 right-context=4";
+  components.push_back(Component::NewFromString(os.str()));
+  int32 cur_dim = input_dim * 9;
+  for (int32 i = 0; i < num_hidden_layers; i++) {
+    std::ostringstream affine, pnorm, normalize;
+    affine << "AffineComponent input-dim=" << cur_dim << " output-dim="
+           << pnorm_input_dim << " param-stddev="
+           << (1.0 / sqrt(cur_dim)) << " bias-stddev=0.5";
+    pnorm << "PnormComponent input-dim=" << pnorm_input_dim
+          << " output-dim=" << pnorm_output_dim << " p=2";
+    normalize << "NormalizeComponent dim=" << pnorm_output_dim;
+    components.push_back(Component::NewFromString(affine.str()));
+    components.push_back(Component::NewFromString(pnorm.str()));
+    components.push_back(Component::NewFromString(normalize.str()));
+    cur_dim = pnorm_output_dim;
+  }
+  std::ostringstream affine, softmax;
+  affine << "AffineComponent input-dim=" << cur_dim << " output-dim="
+         << output_dim << " param-stddev=" << (1.0 / sqrt(cur_dim))
+         << " bias-stddev=0.5";
+  softmax << "SoftmaxComponent dim=" << output_dim;
+  components.push_back(Component::NewFromString(affine.str()));
+  components.push_back(Component::NewFromString(softmax.str()));
+  Nnet *ans = new Nnet();
+  ans->Init(&components);
+  return ans;
+}
+
+// Compares the speed and accuracy of NnetComputation() and CompiledNnet on a
+// p-norm network.
+void CompiledNnetSpeedTest() {
+  int32 input_dim = 40, num_frames = 500, num_repeats = 3;
+  Nnet *nnet = GenPnormNnet(input_dim, 3, 2000, 200, 3000);
+  Matrix<BaseFloat> input(num_frames, input_dim);
+  input.SetRandn();
+  CuMatrix<BaseFloat> cu_input(input);
+
+  Timer timer;
+  CuMatrix<BaseFloat> cu_output(num_frames, nnet->OutputDim());
+  for (int32 i = 0; i < num_repeats; i++)
+    NnetComputation(*nnet, cu_input, true, &cu_output);
+  double ref_time = timer.Elapsed();
+  Matrix<BaseFloat> ref_output(cu_output);
+
+  CompiledNnet compiled(*nnet);
+  Matrix<BaseFloat> output(num_frames, nnet->OutputDim());
+  timer.Reset();
+  for (int32 i = 0; i < num_repeats; i++)
+    compiled.Compute(input, true, &output);
+  double time = timer.Elapsed();
+  Matrix<BaseFloat> diff(output);
+  diff.AddMat(-1.0, ref_output);
+  KALDI_LOG << "CompiledNnet: speedup over NnetComputation is "
+            << (ref_time / time) << ", relative difference in output is "
+            << (diff.FrobeniusNorm() / ref_output.FrobeniusNorm())
+            << ", best output agrees on "
+            << (100.0 * ArgmaxAgreement(ref_output, output))
+            << "% of frames.";
+  delete nnet;
+}
+
+}  // namespace nnet2
+}  // namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet2;
+
+  CompiledNnetSpeedTest();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
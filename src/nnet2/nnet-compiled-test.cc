@@ -0,0 +1,70 @@
+// nnet2/nnet-compiled-test.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet2/nnet-nnet.h"
+#include "nnet2/nnet-compute.h"
+#include "nnet2/nnet-compiled.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+
+void UnitTestCompiledNnet() {
+  int32 input_dim = 10 + Rand() % 40, output_dim = 100 + Rand() % 500;
+  bool pad_input = (Rand() % 2 == 0);
+
+  Nnet *nnet = GenRandomNnet(input_dim, output_dim);
+  int32 num_feats = 5 + Rand() % 200;
+  int32 num_output_rows = num_feats -
+      (pad_input ? 0 : nnet->LeftContext() + nnet->RightContext());
+  if (num_output_rows <= 0) {
+    delete nnet;
+    return;
+  }
+  CuMatrix<BaseFloat> input(num_feats, input_dim);
+  input.SetRandn();
+  CuMatrix<BaseFloat> output1(num_output_rows, output_dim);
+  NnetComputation(*nnet, input, pad_input, &output1);
+  Matrix<BaseFloat> ref_output(output1);
+
+  Matrix<BaseFloat> cpu_input(input);
+  CompiledNnet compiled(*nnet);
+  KALDI_LOG << "Compiled nnet is:\n" << compiled.Info();
+  Matrix<BaseFloat> output2(num_output_rows, output_dim);
+  // Do it twice, to check that reusing the buffers works.
+  for (int32 i = 0; i < 2; i++) {
+    compiled.Compute(cpu_input, pad_input, &output2);
+    AssertEqual(ref_output, output2);
+  }
+  delete nnet;
+}
+
+}  // namespace nnet2
+}  // namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet2;
+
+  for (int32 i = 0; i < 10; i++)
+    UnitTestCompiledNnet();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
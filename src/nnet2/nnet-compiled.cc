@@ -0,0 +1,312 @@
+// nnet2/nnet-compiled.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include "nnet2/nnet-compiled.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+bool CompiledNnet::GetRowOp(const Component &c, RowOp *op) {
+  op->input_dim = c.InputDim();
+  op->output_dim = c.OutputDim();
+  op->param = 0.0;
+  if (dynamic_cast<const SigmoidComponent*>(&c) != NULL) {
+    op->type = kSigmoid;
+  } else if (dynamic_cast<const TanhComponent*>(&c) != NULL) {
+    op->type = kTanh;
+  } else if (dynamic_cast<const RectifiedLinearComponent*>(&c) != NULL) {
+    op->type = kRectifiedLinear;
+  } else if (dynamic_cast<const SoftHingeComponent*>(&c) != NULL) {
+    op->type = kSoftHinge;
+  } else if (const PnormComponent *pc =
+             dynamic_cast<const PnormComponent*>(&c)) {
+    op->type = kPnorm;
+    op->param = pc->p_;
+  } else if (dynamic_cast<const NormalizeComponent*>(&c) != NULL) {
+    op->type = kNormalize;
+  } else if (dynamic_cast<const SoftmaxComponent*>(&c) != NULL) {
+    op->type = kSoftmax;
+  } else if (dynamic_cast<const LogSoftmaxComponent*>(&c) != NULL) {
+    op->type = kLogSoftmax;
+  } else if (const ScaleComponent *sc =
+             dynamic_cast<const ScaleComponent*>(&c)) {
+    op->type = kScale;
+    op->param = sc->scale_;
+  } else if (const FixedScaleComponent *fc =
+             dynamic_cast<const FixedScaleComponent*>(&c)) {
+    op->type = kScaleVec;
+    op->vec.Resize(fc->scales_.Dim());
+    fc->scales_.CopyToVec(&(op->vec));
+  } else if (const FixedBiasComponent *bc =
+             dynamic_cast<const FixedBiasComponent*>(&c)) {
+    op->type = kBiasVec;
+    op->vec.Resize(bc->bias_.Dim());
+    bc->bias_.CopyToVec(&(op->vec));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void CompiledNnet::SetAffine(const CuMatrixBase<BaseFloat> &linear,
+                             const CuVectorBase<BaseFloat> &bias,
+                             Step *step) {
+  step->has_affine = true;
+  step->bias.Resize(bias.Dim());
+  bias.CopyToVec(&(step->bias));
+  step->linear.Resize(linear.NumRows(), linear.NumCols());
+  linear.CopyToMat(&(step->linear));
+}
+
+CompiledNnet::CompiledNnet(const Nnet &nnet): nnet_(nnet) {
+  for (int32 c = 0; c < nnet.NumComponents(); c++) {
+    const Component &component = nnet.GetComponent(c);
+    RowOp op;
+    if (GetRowOp(component, &op)) {
+      if (steps_.empty() || steps_.back()->type != kRowwise) {
+        Step *step = new Step();
+        step->type = kRowwise;
+        step->first_component = c;
+        step->num_components = 0;
+        step->has_affine = false;
+        steps_.push_back(step);
+      }
+      Step *step = steps_.back();
+      step->row_ops.push_back(op);
+      step->num_components++;
+      step->output_dim = op.output_dim;
+      continue;
+    }
+    Step *step = new Step();
+    step->first_component = c;
+    step->num_components = 1;
+    step->output_dim = component.OutputDim();
+    step->has_affine = false;
+    step->const_component_dim = 0;
+    if (const AffineComponent *ac =
+        dynamic_cast<const AffineComponent*>(&component)) {
+      step->type = kRowwise;
+      SetAffine(ac->linear_params_, ac->bias_params_, step);
+    } else if (const FixedAffineComponent *fc =
+               dynamic_cast<const FixedAffineComponent*>(&component)) {
+      step->type = kRowwise;
+      SetAffine(fc->linear_params_, fc->bias_params_, step);
+    } else if (const SpliceComponent *sc =
+               dynamic_cast<const SpliceComponent*>(&component)) {
+      step->type = kSplice;
+      step->context = sc->context_;
+      step->const_component_dim = sc->const_component_dim_;
+    } else {
+      step->type = kOther;
+    }
+    steps_.push_back(step);
+  }
+}
+
+CompiledNnet::~CompiledNnet() {
+  DeletePointers(&steps_);
+}
+
+std::string CompiledNnet::Info() const {
+  std::ostringstream os;
+  for (size_t i = 0; i < steps_.size(); i++) {
+    const Step &step = *(steps_[i]);
+    os << "step " << i << ": ";
+    for (int32 c = step.first_component;
+         c < step.first_component + step.num_components; c++) {
+      if (c > step.first_component) os << " + ";
+      os << nnet_.GetComponent(c).Type();
+    }
+    if (step.type == kOther) os << " (not compiled)";
+    os << ", output-dim=" << step.output_dim << std::endl;
+  }
+  return os.str();
+}
+
+SubMatrix<BaseFloat> CompiledNnet::GetBuffer(int32 i, int32 num_rows,
+                                             int32 num_cols) {
+  Matrix<BaseFloat> &buffer = buffers_[i];
+  if (buffer.NumRows() < num_rows || buffer.NumCols() < num_cols)
+    buffer.Resize(std::max(buffer.NumRows(), num_rows),
+                  std::max(buffer.NumCols(), num_cols), kUndefined);
+  return SubMatrix<BaseFloat>(buffer, 0, num_rows, 0, num_cols);
+}
+
+void CompiledNnet::DoSplice(const Step &step, const ChunkInfo &in_info,
+                            const ChunkInfo &out_info,
+                            const MatrixBase<BaseFloat> &in,
+                            MatrixBase<BaseFloat> *out) const {
+  // This is as SpliceComponent::Propagate() for a single chunk.
+  int32 const_dim = step.const_component_dim,
+      dim = in.NumCols() - const_dim,
+      num_splice = step.context.size();
+  for (int32 r = 0; r < out->NumRows(); r++) {
+    int32 offset = out_info.GetOffset(r);
+    BaseFloat *out_row = out->RowData(r);
+    for (int32 c = 0; c < num_splice; c++) {
+      const BaseFloat *in_row =
+          in.RowData(in_info.GetIndex(offset + step.context[c]));
+      std::copy(in_row, in_row + dim, out_row + c * dim);
+    }
+    if (const_dim != 0) {
+      const BaseFloat *in_row = in.RowData(r) + dim;
+      std::copy(in_row, in_row + const_dim, out_row + num_splice * dim);
+    }
+  }
+}
+
+void CompiledNnet::DoAffine(const Step &step, const MatrixBase<BaseFloat> &in,
+                            MatrixBase<BaseFloat> *out) {
+  if (!step.has_affine) {
+    out->CopyFromMat(in);
+    return;
+  }
+  out->AddMatMat(1.0, in, kNoTrans, step.linear, kTrans, 0.0);
+}
+
+void CompiledNnet::DoRowOps(const Step &step, BaseFloat *row_data) {
+  if (step.has_affine) {
+    SubVector<BaseFloat> row(row_data, step.bias.Dim());
+    row.AddVec(1.0, step.bias);
+  }
+  // These do the same as the components' Propagate() functions.
+  for (size_t i = 0; i < step.row_ops.size(); i++) {
+    const RowOp &op = step.row_ops[i];
+    SubVector<BaseFloat> row(row_data, op.input_dim);
+    switch (op.type) {
+      case kSigmoid:
+        row.Sigmoid(row);
+        break;
+      case kTanh:
+        row.Tanh(row);
+        break;
+      case kRectifiedLinear:
+        row.ApplyFloor(0.0);
+        break;
+      case kSoftHinge:
+        for (int32 j = 0; j < op.input_dim; j++)
+          if (row_data[j] <= 10.0)
+            row_data[j] = Log1p(Exp(row_data[j]));
+        break;
+      case kPnorm: {
+        // Writing output j only overwrites inputs that were already used.
+        int32 group_size = op.input_dim / op.output_dim;
+        for (int32 j = 0; j < op.output_dim; j++) {
+          SubVector<BaseFloat> group(row_data + j * group_size, group_size);
+          row_data[j] = group.Norm(op.param);
+        }
+        break;
+      }
+      case kNormalize: {
+        BaseFloat sumsq = VecVec(row, row) / op.input_dim;
+        if (sumsq < NormalizeComponent::kNormFloor)
+          sumsq = NormalizeComponent::kNormFloor;
+        row.Scale(pow(sumsq, -0.5));
+        break;
+      }
+      case kSoftmax:
+        row.ApplySoftMax();
+        row.ApplyFloor(1.0e-20);
+        break;
+      case kLogSoftmax:
+        row.ApplyLogSoftMax();
+        row.ApplyFloor(Log(1.0e-20));
+        break;
+      case kScale:
+        row.Scale(op.param);
+        break;
+      case kScaleVec:
+        row.MulElements(op.vec);
+        break;
+      case kBiasVec:
+        row.AddVec(1.0, op.vec);
+        break;
+    }
+  }
+}
+
+void CompiledNnet::Compute(const MatrixBase<BaseFloat> &input,
+                           bool pad_input,
+                           MatrixBase<BaseFloat> *output) {
+  int32 dim = input.NumCols();
+  if (dim != nnet_.InputDim()) {
+    KALDI_ERR << "Feature dimension is " << dim << " but network expects "
+              << nnet_.InputDim();
+  }
+  int32 left_context = (pad_input ? nnet_.LeftContext() : 0),
+      right_context = (pad_input ? nnet_.RightContext() : 0),
+      num_rows = left_context + input.NumRows() + right_context;
+  std::vector<ChunkInfo> chunk_info;
+  nnet_.ComputeChunkInfo(num_rows, 1, &chunk_info);
+
+  // The current data is the first cur_rows rows and cur_cols columns of
+  // buffers_[cur].
+  int32 cur = 0, cur_rows = num_rows, cur_cols = dim;
+  {
+    SubMatrix<BaseFloat> in = GetBuffer(cur, num_rows, dim);
+    in.Range(left_context, input.NumRows(), 0, dim).CopyFromMat(input);
+    for (int32 i = 0; i < left_context; i++)
+      in.Row(i).CopyFromVec(input.Row(0));
+    int32 last_row = input.NumRows() - 1;
+    for (int32 i = 0; i < right_context; i++)
+      in.Row(num_rows - i - 1).CopyFromVec(input.Row(last_row));
+  }
+
+  for (size_t s = 0; s < steps_.size(); s++) {
+    const Step &step = *(steps_[s]);
+    const ChunkInfo &in_info = chunk_info[step.first_component],
+        &out_info = chunk_info[step.first_component + step.num_components];
+    int32 out_rows = out_info.NumRows();
+    // Intermediate dimensions in a kRowwise step may be larger than its
+    // output dimension (e.g. before PnormComponent).
+    int32 out_cols = (step.type != kRowwise ? step.output_dim :
+                      (step.has_affine ? step.bias.Dim() : cur_cols));
+    SubMatrix<BaseFloat> out = GetBuffer(1 - cur, out_rows, out_cols);
+    SubMatrix<BaseFloat> in(buffers_[cur], 0, cur_rows, 0, cur_cols);
+    switch (step.type) {
+      case kSplice:
+        DoSplice(step, in_info, out_info, in, &out);
+        break;
+      case kRowwise:
+        DoAffine(step, in, &out);
+        for (int32 r = 0; r < out_rows; r++)
+          DoRowOps(step, out.RowData(r));
+        break;
+      case kOther: {
+        const Component &component =
+            nnet_.GetComponent(step.first_component);
+        CuMatrix<BaseFloat> cu_in(in), cu_out;
+        component.Propagate(in_info, out_info, cu_in, &cu_out);
+        cu_out.CopyToMat(&out);
+        break;
+      }
+    }
+    cur = 1 - cur;
+    cur_rows = out_rows;
+    cur_cols = step.output_dim;
+  }
+  output->CopyFromMat(SubMatrix<BaseFloat>(buffers_[cur], 0, cur_rows,
+                                           0, cur_cols));
+}
+
+
+}  // namespace nnet2
+}  // namespace kaldi
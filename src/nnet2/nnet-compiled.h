@@ -0,0 +1,139 @@
+// nnet2/nnet-compiled.h
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET2_NNET_COMPILED_H_
+#define KALDI_NNET2_NNET_COMPILED_H_
+
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "nnet2/nnet-nnet.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+/**
+   CompiledNnet is a form of an Nnet that is only for the forward computation
+   on the CPU, as in decoding; it gives the same output as NnetComputation()
+   (see nnet-compute.h), up to roundoff.  It is faster than NnetComputation()
+   because:
+    - An affine component and the "row-wise" components that follow it
+      (nonlinearities, PnormComponent, NormalizeComponent, SoftmaxComponent
+      and fixed scales and biases) are done as one step: after the matrix
+      multiplication, all the rest is done in one pass over each row, while it
+      is in cache.
+    - The intermediate results go in two buffers that we alternate between,
+      which are only reallocated if a longer input is seen.
+   Components that we don't handle specially are done with their own
+   Propagate() function.
+
+   This object keeps a reference to the Nnet, which must not be changed or
+   destroyed while it exists.  Compute() is not const because of the buffers;
+   if you have several threads, give each its own CompiledNnet.
+ */
+class CompiledNnet {
+ public:
+  explicit CompiledNnet(const Nnet &nnet);
+
+  int32 InputDim() const { return nnet_.InputDim(); }
+  int32 OutputDim() const { return nnet_.OutputDim(); }
+
+  /// As NnetComputation() in nnet-compute.h.  "output" must have the right
+  /// size: input.NumRows() rows if pad_input == true, and otherwise
+  /// nnet.LeftContext() + nnet.RightContext() fewer.
+  void Compute(const MatrixBase<BaseFloat> &input,
+               bool pad_input,
+               MatrixBase<BaseFloat> *output);
+
+  /// Describes how the components were grouped into steps.
+  std::string Info() const;
+
+  ~CompiledNnet();
+
+ private:
+  // The operations we can do on each row of the output of an affine
+  // component, in place.
+  enum RowOpType {
+    kSigmoid, kTanh, kRectifiedLinear, kSoftHinge, kPnorm, kNormalize,
+    kSoftmax, kLogSoftmax, kScale, kScaleVec, kBiasVec
+  };
+  struct RowOp {
+    RowOpType type;
+    int32 input_dim;
+    int32 output_dim;
+    BaseFloat param;  // p for kPnorm, the scale for kScale.
+    Vector<BaseFloat> vec;  // for kScaleVec and kBiasVec.
+  };
+
+  enum StepType { kSplice, kRowwise, kOther };
+
+  struct Step {
+    StepType type;
+    int32 first_component;  // this step does components first_component ...
+    int32 num_components;   // first_component + num_components - 1.
+    int32 output_dim;
+    // The following are for kRowwise: an optional affine transform, then
+    // the row operations.
+    bool has_affine;
+    Matrix<BaseFloat> linear;
+    Vector<BaseFloat> bias;
+    std::vector<RowOp> row_ops;
+    // The following are for kSplice.
+    std::vector<int32> context;
+    int32 const_component_dim;
+  };
+
+  // Returns true if the component can be done as a row operation, and if
+  // so, outputs it.
+  static bool GetRowOp(const Component &c, RowOp *op);
+
+  void SetAffine(const CuMatrixBase<BaseFloat> &linear,
+                 const CuVectorBase<BaseFloat> &bias, Step *step);
+
+  void DoSplice(const Step &step, const ChunkInfo &in_info,
+                const ChunkInfo &out_info, const MatrixBase<BaseFloat> &in,
+                MatrixBase<BaseFloat> *out) const;
+
+  // Does the affine part (if any) of a kRowwise step into "out", which has
+  // as many columns as the output of the affine part (or the input, if
+  // none); the row operations are done afterwards, in place.
+  static void DoAffine(const Step &step, const MatrixBase<BaseFloat> &in,
+                       MatrixBase<BaseFloat> *out);
+
+  // Adds the bias and does the row operations of a kRowwise step, in place,
+  // on "row", which has the output dimension of the affine part.
+  static void DoRowOps(const Step &step, BaseFloat *row);
+
+  // Returns the first "num_rows" rows and "num_cols" columns of buffer i,
+  // resizing it if needed.
+  SubMatrix<BaseFloat> GetBuffer(int32 i, int32 num_rows, int32 num_cols);
+
+  const Nnet &nnet_;
+  std::vector<Step*> steps_;
+  Matrix<BaseFloat> buffers_[2];
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CompiledNnet);
+};
+
+
+}  // namespace nnet2
+}  // namespace kaldi
+
+#endif  // KALDI_NNET2_NNET_COMPILED_H_
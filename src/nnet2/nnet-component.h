@@ -484,6 +484,7 @@ class PnormComponent: public Component {
 
   virtual std::string Info() const;
  protected:
+  friend class CompiledNnet;
   int32 input_dim_;
   int32 output_dim_;
   BaseFloat p_;
@@ -511,6 +512,7 @@ class NormalizeComponent: public NonlinearComponent {
                         Component *to_update, // may be identical to "this".
                         CuMatrix<BaseFloat> *in_deriv) const;
  private:
+  friend class CompiledNnet;
   NormalizeComponent &operator = (const NormalizeComponent &other); // Disallow.
   static const BaseFloat kNormFloor;
   // about 0.7e-20.  We need a value that's exactly representable in
@@ -700,6 +702,7 @@ class ScaleComponent: public Component {
   virtual std::string Info() const;
   
  private:
+  friend class CompiledNnet;
   int32 dim_;
   BaseFloat scale_;
   ScaleComponent &operator = (const ScaleComponent &other); // Disallow.
@@ -858,6 +861,7 @@ class AffineComponent: public UpdatableComponent {
              AffineComponent *c3);
  protected:
   friend class AffineComponentPreconditionedOnline;
+  friend class CompiledNnet;
   // This function Update() is for extensibility; child classes may override this.
   virtual void Update(
       const CuMatrixBase<BaseFloat> &in_value,
@@ -1067,6 +1071,7 @@ class SpliceComponent: public Component {
   virtual void Write(std::ostream &os, bool binary) const;
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(SpliceComponent);
+  friend class CompiledNnet;
   int32 input_dim_;
   std::vector<int32> context_;
   int32 const_component_dim_;
@@ -1431,6 +1436,7 @@ class FixedAffineComponent: public Component {
   // Function to provide access to linear_params_.
   const CuMatrix<BaseFloat> &LinearParams() const { return linear_params_; }
  protected:
+  friend class CompiledNnet;
   friend class AffineComponent;
   CuMatrix<BaseFloat> linear_params_;
   CuVector<BaseFloat> bias_params_;
@@ -1475,6 +1481,7 @@ class FixedScaleComponent: public Component {
   virtual void Write(std::ostream &os, bool binary) const;
 
  protected:
+  friend class CompiledNnet;
   friend class AffineComponent;  // necessary for collapse
   CuVector<BaseFloat> scales_;  
   KALDI_DISALLOW_COPY_AND_ASSIGN(FixedScaleComponent);
@@ -1516,6 +1523,7 @@ class FixedBiasComponent: public Component {
   virtual void Write(std::ostream &os, bool binary) const;
 
  protected:
+  friend class CompiledNnet;
   CuVector<BaseFloat> bias_;  
   KALDI_DISALLOW_COPY_AND_ASSIGN(FixedBiasComponent);
 };
@@ -0,0 +1,103 @@
+// nnet2/nnet-example-prefetch-test.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet2/nnet-example-prefetch.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+
+// If stop_early == true, checks that we can stop reading before the end.
+void UnitTestNnetExamplePrefetcher(bool stop_early) {
+  int32 input_dim = 10, output_dim = 20;
+  Nnet *nnet = GenRandomNnet(input_dim, output_dim);
+  int32 context = nnet->LeftContext() + nnet->RightContext(),
+      num_egs = 100 + Rand() % 500;
+  {
+    NnetExampleWriter writer("ark:tmp.egs");
+    for (int32 i = 0; i < num_egs; i++) {
+      NnetExample eg;
+      eg.labels.resize(1);
+      eg.labels[0].push_back(std::make_pair(RandInt(0, output_dim - 1),
+                                            static_cast<BaseFloat>(1.0)));
+      Matrix<BaseFloat> input_frames(1 + context, input_dim);
+      input_frames.SetRandn();
+      eg.input_frames.CopyFromMat(input_frames);
+      eg.left_context = nnet->LeftContext();
+      std::ostringstream os;
+      os << i;
+      writer.Write(os.str(), eg);
+    }
+  }
+  NnetPrefetchConfig config;
+  config.num_threads = Rand() % 4;  // 0 means g_num_threads.
+  config.queue_size = 1 + Rand() % 3;
+  int32 minibatch_size = 1 + Rand() % 100;
+  bool format_input = (Rand() % 4 != 0);
+
+  {
+    // The prefetcher has to be destroyed before the nnet.
+    SequentialNnetExampleReader reader("ark:tmp.egs");
+    NnetExamplePrefetcher prefetcher(config, minibatch_size, *nnet, &reader,
+                                     format_input);
+    std::vector<NnetExample> examples;
+    Matrix<BaseFloat> examples_formatted;
+    double weight, tot_weight = 0.0;
+    int32 num_read = 0;
+    if (stop_early) {
+      bool got_minibatch = prefetcher.GetNextMinibatch(
+          &examples, &examples_formatted, &weight);
+      KALDI_ASSERT(got_minibatch);
+    } else {
+      while (prefetcher.GetNextMinibatch(&examples, &examples_formatted,
+                                         &weight)) {
+        KALDI_ASSERT(examples.size() <= minibatch_size);
+        if (format_input) {
+          Matrix<BaseFloat> ref_formatted;
+          FormatNnetInput(*nnet, examples, &ref_formatted);
+          AssertEqual(ref_formatted, examples_formatted);
+        } else {
+          KALDI_ASSERT(examples_formatted.NumRows() == 0);
+        }
+        num_read += examples.size();
+        tot_weight += weight;
+      }
+      KALDI_ASSERT(num_read == num_egs && tot_weight == num_egs);
+      // It should keep returning false.
+      bool got_minibatch = prefetcher.GetNextMinibatch(
+          &examples, &examples_formatted, &weight);
+      KALDI_ASSERT(!got_minibatch);
+    }
+  }
+  delete nnet;
+}
+
+}  // namespace nnet2
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet2;
+
+  for (int32 i = 0; i < 10; i++)
+    UnitTestNnetExamplePrefetcher(i % 3 == 0);
+  unlink("tmp.egs");
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
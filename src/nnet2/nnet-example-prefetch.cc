@@ -0,0 +1,162 @@
+// nnet2/nnet-example-prefetch.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet2/nnet-example-prefetch.h"
+#include <algorithm>
+#include "base/timer.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+// Thread 0 reads the examples, and the others format them.
+class NnetExamplePrefetcher::ThreadClass: public MultiThreadable {
+ public:
+  ThreadClass(NnetExamplePrefetcher *prefetcher): prefetcher_(prefetcher) { }
+  void operator () () {
+    if (thread_id_ == 0)
+      prefetcher_->ReadExamples();
+    else
+      prefetcher_->FormatExamples();
+  }
+ private:
+  NnetExamplePrefetcher *prefetcher_;
+};
+
+
+NnetExamplePrefetcher::NnetExamplePrefetcher(
+    const NnetPrefetchConfig &config,
+    int32 minibatch_size,
+    const Nnet &nnet,
+    SequentialNnetExampleReader *reader,
+    bool format_input):
+    num_threads_(config.num_threads > 0 ? config.num_threads :
+                 std::max<int32>(1, g_num_threads)),
+    minibatch_size_(minibatch_size), format_input_(format_input),
+    nnet_(nnet), reader_(reader), free_slots_(config.queue_size),
+    num_ready_(0), num_threads_done_(0), stop_(false), num_minibatches_(0),
+    num_waits_(0), wait_time_(0.0) {
+  KALDI_ASSERT(minibatch_size > 0 && config.queue_size > 0);
+  ThreadClass c(this);
+  threads_ = new MultiThreader<ThreadClass>(num_threads_ + 1, c);
+}
+
+bool NnetExamplePrefetcher::Stopped() {
+  queue_mutex_.Lock();
+  bool ans = stop_;
+  queue_mutex_.Unlock();
+  return ans;
+}
+
+void NnetExamplePrefetcher::ReadExamples() {
+  std::vector<NnetExample> examples;
+  examples.reserve(minibatch_size_);
+  for (; !reader_->Done() && !Stopped(); reader_->Next()) {
+    examples.push_back(reader_->Value());
+    if (examples.size() == minibatch_size_) {
+      repository_.AcceptExamples(&examples);
+      examples.reserve(minibatch_size_);
+    }
+  }
+  if (!examples.empty()) // partial minibatch.
+    repository_.AcceptExamples(&examples);
+  repository_.ExamplesDone();
+}
+
+void NnetExamplePrefetcher::FormatExamples() {
+  std::vector<NnetExample> examples;
+  while (repository_.ProvideExamples(&examples)) {
+    // Formatting the examples involves decompressing the features, which is
+    // the expensive part.  If we are stopping, the minibatch will be thrown
+    // away, so we don't bother.
+    Minibatch *minibatch = new Minibatch();
+    minibatch->examples.swap(examples);
+    if (format_input_ && !Stopped())
+      FormatNnetInput(nnet_, minibatch->examples,
+                      &(minibatch->examples_formatted));
+    minibatch->tot_weight = TotalNnetTrainingWeight(minibatch->examples);
+    free_slots_.Wait();
+    queue_mutex_.Lock();
+    queue_.push_back(minibatch);
+    queue_mutex_.Unlock();
+    num_ready_.Signal();
+  }
+  queue_mutex_.Lock();
+  bool last = (++num_threads_done_ == num_threads_);
+  if (last)
+    queue_.push_back(NULL);
+  queue_mutex_.Unlock();
+  if (last)
+    num_ready_.Signal();
+}
+
+bool NnetExamplePrefetcher::GetNextMinibatch(
+    std::vector<NnetExample> *examples,
+    Matrix<BaseFloat> *examples_formatted,
+    double *tot_weight) {
+  if (!num_ready_.TryWait()) {
+    // The training has caught up with the background threads.
+    Timer timer;
+    num_ready_.Wait();
+    double elapsed = timer.Elapsed();
+    queue_mutex_.Lock();
+    num_waits_++;
+    wait_time_ += elapsed;
+    queue_mutex_.Unlock();
+  }
+  queue_mutex_.Lock();
+  Minibatch *minibatch = queue_.front();
+  if (minibatch == NULL) {
+    // We leave the NULL for any other callers.
+    queue_mutex_.Unlock();
+    num_ready_.Signal();
+    return false;
+  }
+  queue_.pop_front();
+  num_minibatches_++;
+  queue_mutex_.Unlock();
+  free_slots_.Signal();
+
+  examples->swap(minibatch->examples);
+  examples_formatted->Swap(&(minibatch->examples_formatted));
+  *tot_weight = minibatch->tot_weight;
+  delete minibatch;
+  return true;
+}
+
+NnetExamplePrefetcher::~NnetExamplePrefetcher() {
+  // If the caller stopped early, we tell the threads to stop, and take the
+  // minibatches they had already read out of the queue, or they would never
+  // finish.
+  queue_mutex_.Lock();
+  stop_ = true;
+  queue_mutex_.Unlock();
+  std::vector<NnetExample> examples;
+  Matrix<BaseFloat> examples_formatted;
+  double tot_weight;
+  while (GetNextMinibatch(&examples, &examples_formatted, &tot_weight));
+  delete threads_;  // joins the threads.
+  KALDI_ASSERT(queue_.size() == 1 && queue_.front() == NULL);
+  KALDI_LOG << "Prefetched " << num_minibatches_ << " minibatches; training "
+            << "waited for them " << num_waits_ << " times, for "
+            << wait_time_ << " seconds in total.";
+}
+
+
+} // namespace nnet2
+} // namespace kaldi
@@ -0,0 +1,142 @@
+// nnet2/nnet-example-prefetch.h
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET2_NNET_EXAMPLE_PREFETCH_H_
+#define KALDI_NNET2_NNET_EXAMPLE_PREFETCH_H_
+
+#include <deque>
+#include <vector>
+#include "nnet2/nnet-example.h"
+#include "nnet2/nnet-update.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-semaphore.h"
+#include "thread/kaldi-thread.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+struct NnetPrefetchConfig {
+  int32 queue_size;
+  int32 num_threads;
+
+  NnetPrefetchConfig(): queue_size(4), num_threads(0) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("prefetch-queue-size", &queue_size, "Maximum number of "
+                 "minibatches that are read and formatted ahead of the "
+                 "training.");
+    po->Register("prefetch-threads", &num_threads, "Number of threads that "
+                 "format minibatches (decompress the features and splice "
+                 "them into a matrix) in the background.  If <= 0, uses one "
+                 "per training thread.  If >1, the order of the minibatches "
+                 "may change slightly.");
+  }
+};
+
+
+/**
+   This class reads minibatches of examples in the background and formats them
+   with FormatNnetInput(), so the training threads get them ready to use and
+   (if there are enough threads) don't have to wait.  One thread reads the
+   examples and passes them, a minibatch at a time, through an
+   ExamplesRepository to config.num_threads threads that format them; the
+   formatted minibatches go in a queue of at most config.queue_size
+   minibatches, from which GetNextMinibatch() takes them.  If
+   config.num_threads <= 0 we use g_num_threads formatting threads, as that
+   is the number of training threads in the programs that use this class
+   with multiple threads.
+ */
+class NnetExamplePrefetcher {
+ public:
+  /// Starts the background threads.  "nnet" is only needed for its context and
+  /// input dimension, so it may be trained while this object exists (but not
+  /// destroyed).  If format_input == false, the minibatches are only read
+  /// ahead, not formatted, and the formatted input output by
+  /// GetNextMinibatch() is empty; this is for callers that don't use it.
+  NnetExamplePrefetcher(const NnetPrefetchConfig &config,
+                        int32 minibatch_size,
+                        const Nnet &nnet,
+                        SequentialNnetExampleReader *reader,
+                        bool format_input = true);
+
+  /// Outputs the next minibatch, its formatted input and its total weight (from
+  /// TotalNnetTrainingWeight()) and returns true; or returns false if there are
+  /// no more examples.  May be called from several threads at once.  The
+  /// formatted input is as required by the version of DoBackprop() that takes
+  /// it.
+  bool GetNextMinibatch(std::vector<NnetExample> *examples,
+                        Matrix<BaseFloat> *examples_formatted,
+                        double *tot_weight);
+
+  /// Stops reading examples, joins the threads and prints how long the
+  /// callers of GetNextMinibatch() had to wait.  If the caller stopped early,
+  /// the rest of the archive is not read.
+  ~NnetExamplePrefetcher();
+
+ private:
+  class ThreadClass;
+
+  struct Minibatch {
+    std::vector<NnetExample> examples;
+    Matrix<BaseFloat> examples_formatted;
+    double tot_weight;
+  };
+
+  // Called in the reading thread.
+  void ReadExamples();
+  // Called in each of the formatting threads.
+  void FormatExamples();
+  // Returns true if the destructor has been called.
+  bool Stopped();
+
+  int32 num_threads_;  // number of formatting threads.
+  int32 minibatch_size_;
+  bool format_input_;
+  const Nnet &nnet_;
+  SequentialNnetExampleReader *reader_;
+
+  // passes the examples from the reading thread to the formatting threads.
+  ExamplesRepository repository_;
+
+  // The formatted minibatches.  A NULL pointer at the end means there are no
+  // more; it is never removed.
+  std::deque<Minibatch*> queue_;
+  Mutex queue_mutex_;  // protects queue_ and the stats below.
+  Semaphore free_slots_;  // number of minibatches we can add to queue_.
+  Semaphore num_ready_;  // number of elements of queue_.
+  int32 num_threads_done_;  // number of formatting threads that finished.
+  // set by the destructor to tell the threads to stop reading and formatting
+  // examples; protected by queue_mutex_.
+  bool stop_;
+
+  int32 num_minibatches_;
+  int32 num_waits_;
+  double wait_time_;
+
+  MultiThreader<ThreadClass> *threads_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetExamplePrefetcher);
+};
+
+
+} // namespace nnet2
+} // namespace kaldi
+
+#endif // KALDI_NNET2_NNET_EXAMPLE_PREFETCH_H_
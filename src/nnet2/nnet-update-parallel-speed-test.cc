@@ -0,0 +1,86 @@
+// nnet2/nnet-update-parallel-speed-test.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet2/nnet-update-parallel-test-utils.h"
+#include "thread/kaldi-thread.h"
+#include "base/timer.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+// Compares how the Hogwild update of DoBackpropParallel() and
+// DoBackpropParallelLocalCopies() scale with the number of threads.
+void NnetUpdateParallelSpeedTest() {
+  int32 input_dim = 40, output_dim = 500, hidden_dim = 500,
+      num_egs = 10000, minibatch_size = 128, sync_interval = 4;
+  std::vector<Component*> components;
+  AffineComponent *affine1 = new AffineComponent(),
+      *affine2 = new AffineComponent(), *affine3 = new AffineComponent();
+  affine1->Init(0.001, input_dim, hidden_dim, 0.1, 0.1);
+  affine2->Init(0.001, hidden_dim, hidden_dim, 0.05, 0.1);
+  affine3->Init(0.001, hidden_dim, output_dim, 0.05, 0.1);
+  components.push_back(affine1);
+  components.push_back(new TanhComponent(hidden_dim));
+  components.push_back(affine2);
+  components.push_back(new TanhComponent(hidden_dim));
+  components.push_back(affine3);
+  components.push_back(new SoftmaxComponent(output_dim));
+  Nnet nnet;
+  nnet.Init(&components);
+  WriteRandomExamples(nnet, num_egs, "ark:tmp.egs");
+
+  int32 thread_counts[] = { 1, 2, 4, 8, 16 };
+  for (size_t i = 0; i < sizeof(thread_counts) / sizeof(int32); i++) {
+    g_num_threads = thread_counts[i];
+    double tot_weight;
+    Nnet hogwild_nnet(nnet), local_nnet(nnet);
+    Timer hogwild_timer;
+    {
+      SequentialNnetExampleReader reader("ark:tmp.egs");
+      DoBackpropParallel(hogwild_nnet, minibatch_size, &reader, &tot_weight,
+                         &hogwild_nnet);
+    }
+    double hogwild_time = hogwild_timer.Elapsed();
+    Timer local_timer;
+    {
+      SequentialNnetExampleReader reader("ark:tmp.egs");
+      DoBackpropParallelLocalCopies(minibatch_size, sync_interval, &reader,
+                                    &tot_weight, &local_nnet);
+    }
+    double local_time = local_timer.Elapsed();
+    KALDI_LOG << "With " << g_num_threads << " threads, Hogwild processed "
+              << (num_egs / hogwild_time) << " examples per second and "
+              << "local copies (sync interval " << sync_interval << ") "
+              << (num_egs / local_time) << " examples per second.";
+  }
+}
+
+
+}  // namespace nnet2
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet2;
+
+  NnetUpdateParallelSpeedTest();
+  unlink("tmp.egs");
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,58 @@
+// nnet2/nnet-update-parallel-test-utils.h
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET2_NNET_UPDATE_PARALLEL_TEST_UTILS_H_
+#define KALDI_NNET2_NNET_UPDATE_PARALLEL_TEST_UTILS_H_
+
+// This header contains functions shared by nnet-update-parallel-test.cc and
+// nnet-update-parallel-speed-test.cc; it is not part of the library.
+
+#include <sstream>
+#include "nnet2/nnet-update-parallel.h"
+#include "nnet2/nnet-update.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+// Writes "num_egs" random single-frame examples suitable for "nnet" to the
+// archive "wspecifier".
+inline void WriteRandomExamples(const Nnet &nnet, int32 num_egs,
+                                const std::string &wspecifier) {
+  int32 input_dim = nnet.InputDim(), output_dim = nnet.OutputDim(),
+      context = nnet.LeftContext() + nnet.RightContext();
+  NnetExampleWriter writer(wspecifier);
+  for (int32 i = 0; i < num_egs; i++) {
+    NnetExample eg;
+    eg.labels.resize(1);
+    eg.labels[0].push_back(std::make_pair(RandInt(0, output_dim - 1),
+                                          static_cast<BaseFloat>(1.0)));
+    Matrix<BaseFloat> input_frames(1 + context, input_dim);
+    input_frames.SetRandn();
+    eg.input_frames.CopyFromMat(input_frames);
+    eg.left_context = nnet.LeftContext();
+    std::ostringstream os;
+    os << i;
+    writer.Write(os.str(), eg);
+  }
+}
+
+}  // namespace nnet2
+}  // namespace kaldi
+
+#endif  // KALDI_NNET2_NNET_UPDATE_PARALLEL_TEST_UTILS_H_
@@ -0,0 +1,142 @@
+// nnet2/nnet-update-parallel-test.cc
+
+// Copyright 2015  Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet2/nnet-update-parallel-test-utils.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+
+// Returns the parameters of "nnet" minus those of "ref_nnet".
+void GetParameterChange(const Nnet &nnet, const Nnet &ref_nnet,
+                        Vector<BaseFloat> *change) {
+  Vector<BaseFloat> ref_params(ref_nnet.GetParameterDim());
+  ref_nnet.Vectorize(&ref_params);
+  change->Resize(nnet.GetParameterDim());
+  nnet.Vectorize(change);
+  change->AddVec(-1.0, ref_params);
+}
+
+// Does backprop serially on the examples in "rspecifier", in minibatches of
+// size "minibatch_size", computing the derivatives with "nnet" and adding them
+// to "nnet_to_update" (which may equal &nnet, for SGD).  Returns the total
+// log-prob.
+double DoBackpropSerial(const Nnet &nnet, int32 minibatch_size,
+                        const std::string &rspecifier,
+                        Nnet *nnet_to_update) {
+  SequentialNnetExampleReader reader(rspecifier);
+  double tot_log_prob = 0.0;
+  while (!reader.Done()) {
+    std::vector<NnetExample> egs;
+    for (; !reader.Done() && egs.size() < minibatch_size; reader.Next())
+      egs.push_back(reader.Value());
+    tot_log_prob += DoBackprop(nnet, egs, nnet_to_update);
+  }
+  return tot_log_prob;
+}
+
+// With one thread, DoBackpropParallelLocalCopies() must apply exactly the
+// same SGD updates as serial DoBackprop(), whatever the sync interval.
+void UnitTestLocalCopiesOneThread() {
+  Nnet *nnet = GenRandomNnet(10, 20);
+  int32 num_egs = 100 + Rand() % 200, minibatch_size = 1 + Rand() % 50,
+      sync_interval = 1 + Rand() % 4;
+  WriteRandomExamples(*nnet, num_egs, "ark:tmp.egs");
+
+  Nnet serial_nnet(*nnet);
+  double serial_log_prob = DoBackpropSerial(serial_nnet, minibatch_size,
+                                            "ark:tmp.egs", &serial_nnet);
+
+  g_num_threads = 1;
+  Nnet parallel_nnet(*nnet);
+  double tot_weight;
+  double parallel_log_prob;
+  {
+    SequentialNnetExampleReader reader("ark:tmp.egs");
+    parallel_log_prob = DoBackpropParallelLocalCopies(
+        minibatch_size, sync_interval, &reader, &tot_weight, &parallel_nnet);
+  }
+  KALDI_ASSERT(tot_weight == num_egs);
+  KALDI_ASSERT(ApproxEqual(serial_log_prob, parallel_log_prob, 1.0e-04));
+
+  // The syncs only add and subtract the same numbers, so the parameter
+  // changes should agree to within roundoff.
+  Vector<BaseFloat> serial_change, parallel_change;
+  GetParameterChange(serial_nnet, *nnet, &serial_change);
+  GetParameterChange(parallel_nnet, *nnet, &parallel_change);
+  KALDI_ASSERT(serial_change.Norm(2.0) != 0.0);
+  AssertEqual(serial_change, parallel_change, 1.0e-03);
+  delete nnet;
+}
+
+// With several threads the order of the updates is not deterministic, but
+// with small learning rates the summed changes of the local copies must equal
+// the summed gradient computed serially by DoBackprop() at the initial
+// parameters, to first order.
+void UnitTestLocalCopiesGradientSum() {
+  Nnet *nnet = GenRandomNnet(10, 20);
+  nnet->SetLearningRates(1.0e-06);
+  int32 num_egs = 200 + Rand() % 300, minibatch_size = 1 + Rand() % 50,
+      sync_interval = 1 + Rand() % 4;
+  WriteRandomExamples(*nnet, num_egs, "ark:tmp.egs");
+
+  Nnet serial_nnet(*nnet);
+  double serial_log_prob = DoBackpropSerial(*nnet, minibatch_size,
+                                            "ark:tmp.egs", &serial_nnet);
+
+  g_num_threads = 2 + Rand() % 4;
+  NnetPrefetchConfig prefetch_config;
+  prefetch_config.num_threads = 1 + Rand() % 2;
+  Nnet parallel_nnet(*nnet);
+  double tot_weight;
+  double parallel_log_prob;
+  {
+    SequentialNnetExampleReader reader("ark:tmp.egs");
+    parallel_log_prob = DoBackpropParallelLocalCopies(
+        minibatch_size, sync_interval, &reader, &tot_weight, &parallel_nnet,
+        prefetch_config);
+  }
+  KALDI_ASSERT(tot_weight == num_egs);
+  KALDI_ASSERT(ApproxEqual(serial_log_prob, parallel_log_prob, 1.0e-03));
+
+  Vector<BaseFloat> serial_change, parallel_change;
+  GetParameterChange(serial_nnet, *nnet, &serial_change);
+  GetParameterChange(parallel_nnet, *nnet, &parallel_change);
+  KALDI_ASSERT(serial_change.Norm(2.0) != 0.0);
+  AssertEqual(serial_change, parallel_change, 0.01);
+  delete nnet;
+}
+
+
+}  // namespace nnet2
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet2;
+
+  for (int32 i = 0; i < 5; i++) {
+    UnitTestLocalCopiesOneThread();
+    UnitTestLocalCopiesGradientSum();
+  }
+  unlink("tmp.egs");
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
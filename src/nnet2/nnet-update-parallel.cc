@@ -21,6 +21,7 @@
 #include "nnet2/nnet-update.h"
 #include "thread/kaldi-thread.h"
 #include "thread/kaldi-mutex.h"
+#include "base/timer.h"
 #include <numeric>
 
 namespace kaldi {
@@ -31,13 +32,15 @@ class DoBackpropParallelClass: public MultiThreadable {
  public:
   // This constructor is only called for a temporary object
   // that we pass to the RunMultiThreaded function.
+  // Exactly one of "repository" and "prefetcher" should be non-NULL.
   DoBackpropParallelClass(const Nnet &nnet,
                           ExamplesRepository *repository,
+                          NnetExamplePrefetcher *prefetcher,
                           double *tot_weight_ptr,
                           double *log_prob_ptr,
                           Nnet *nnet_to_update,
                           bool store_separate_gradients):
-      nnet_(nnet), repository_(repository),
+      nnet_(nnet), repository_(repository), prefetcher_(prefetcher),
       nnet_to_update_(nnet_to_update),
       nnet_to_update_orig_(nnet_to_update),
       store_separate_gradients_(store_separate_gradients),
@@ -51,6 +54,7 @@ class DoBackpropParallelClass: public MultiThreadable {
   DoBackpropParallelClass(const DoBackpropParallelClass &other):
       nnet_(other.nnet_),
       repository_(other.repository_),
+      prefetcher_(other.prefetcher_),
       nnet_to_update_(other.nnet_to_update_),
       nnet_to_update_orig_(other.nnet_to_update_orig_),
       store_separate_gradients_(other.store_separate_gradients_),
@@ -78,14 +82,22 @@ class DoBackpropParallelClass: public MultiThreadable {
   // This does the main function of the class.
   void operator () () {
     std::vector<NnetExample> examples;
-    while (repository_->ProvideExamples(&examples)) {
-      // This is a function call to a function defined in
+    Matrix<BaseFloat> examples_formatted;  // used if prefetcher_ != NULL.
+    double minibatch_weight;
+    while (prefetcher_ != NULL ?
+           prefetcher_->GetNextMinibatch(&examples, &examples_formatted,
+                                         &minibatch_weight) :
+           repository_->ProvideExamples(&examples)) {
+      // These are function calls to functions defined in
       // nnet-update.h
       double tot_loglike;
-      if (nnet_to_update_ != NULL) 
-        tot_loglike = DoBackprop(nnet_, examples, nnet_to_update_);
-      else
+      if (nnet_to_update_ == NULL)
         tot_loglike = ComputeNnetObjf(nnet_, examples);
+      else if (prefetcher_ != NULL)
+        tot_loglike = DoBackprop(nnet_, examples, &examples_formatted,
+                                 nnet_to_update_);
+      else
+        tot_loglike = DoBackprop(nnet_, examples, nnet_to_update_);
       tot_weight_ += TotalNnetTrainingWeight(examples);
       log_prob_ += tot_loglike;
       KALDI_VLOG(4) << "Thread " << thread_id_ << " saw "
@@ -110,6 +122,7 @@ class DoBackpropParallelClass: public MultiThreadable {
  private:
   const Nnet &nnet_;
   ExamplesRepository *repository_;
+  NnetExamplePrefetcher *prefetcher_;
   Nnet *nnet_to_update_;
   Nnet *nnet_to_update_orig_;
   bool store_separate_gradients_;
@@ -120,6 +133,103 @@ class DoBackpropParallelClass: public MultiThreadable {
 };
 
 
+// Sets the parameters and the stats of "dest" to those of "src", which must
+// have the same structure; unlike the copy constructor, it does not
+// reallocate anything.
+static void CopyNnetParams(const Nnet &src, Nnet *dest) {
+  dest->SetZero(false);
+  dest->AddNnet(1.0, src);
+}
+
+
+// This class is used in DoBackpropParallelLocalCopies().
+class DoBackpropParallelLocalClass: public MultiThreadable {
+ public:
+  // This constructor is only called for a temporary object
+  // that we pass to the RunMultiThreaded function.
+  DoBackpropParallelLocalClass(int32 sync_interval,
+                               NnetExamplePrefetcher *prefetcher,
+                               Mutex *nnet_mutex,
+                               double *tot_weight_ptr,
+                               double *log_prob_ptr,
+                               Nnet *nnet):
+      sync_interval_(sync_interval), prefetcher_(prefetcher),
+      nnet_mutex_(nnet_mutex), tot_weight_ptr_(tot_weight_ptr),
+      log_prob_ptr_(log_prob_ptr), nnet_(nnet),
+      tot_weight_(0.0), log_prob_(0.0), num_syncs_(0) {
+    KALDI_ASSERT(sync_interval > 0);
+  }
+
+  // The following constructor is called multiple times within
+  // the RunMultiThreaded template function.
+  DoBackpropParallelLocalClass(const DoBackpropParallelLocalClass &other):
+      sync_interval_(other.sync_interval_),
+      prefetcher_(other.prefetcher_),
+      nnet_mutex_(other.nnet_mutex_),
+      tot_weight_ptr_(other.tot_weight_ptr_),
+      log_prob_ptr_(other.log_prob_ptr_),
+      nnet_(other.nnet_),
+      tot_weight_(0.0), log_prob_(0.0), num_syncs_(0) { }
+
+  void operator () () {
+    // We allocate our copies of the model here, not in the constructor, so
+    // that (with the usual first-touch policy of the OS) their memory is on
+    // the NUMA node of the thread that uses them.  "local_nnet" is the one we
+    // train, and "start_nnet" is what it was at the last sync.
+    nnet_mutex_->Lock();
+    Nnet local_nnet(*nnet_), start_nnet(*nnet_);
+    nnet_mutex_->Unlock();
+
+    std::vector<NnetExample> examples;
+    Matrix<BaseFloat> examples_formatted;
+    double minibatch_weight;
+    int32 num_minibatches = 0;
+    while (prefetcher_->GetNextMinibatch(&examples, &examples_formatted,
+                                         &minibatch_weight)) {
+      log_prob_ += DoBackprop(local_nnet, examples, &examples_formatted,
+                              &local_nnet);
+      tot_weight_ += minibatch_weight;
+      if (++num_minibatches % sync_interval_ == 0)
+        Sync(&local_nnet, &start_nnet);
+    }
+    if (num_minibatches % sync_interval_ != 0)
+      Sync(&local_nnet, &start_nnet);
+    KALDI_VLOG(4) << "Thread " << thread_id_ << " saw "
+                  << tot_weight_ << " frames (weighted) and synced "
+                  << num_syncs_ << " times; likelihood per frame was "
+                  << (log_prob_ / tot_weight_);
+  }
+
+  ~DoBackpropParallelLocalClass() {
+    *log_prob_ptr_ += log_prob_;
+    *tot_weight_ptr_ += tot_weight_;
+  }
+ private:
+  // Adds the change in local_nnet since the last sync to nnet_, and sets
+  // local_nnet and start_nnet to the new nnet_.  Only the add and one copy
+  // are done while holding the lock.
+  void Sync(Nnet *local_nnet, Nnet *start_nnet) {
+    local_nnet->AddNnet(-1.0, *start_nnet);  // now it's the change.
+    nnet_mutex_->Lock();
+    nnet_->AddNnet(1.0, *local_nnet);
+    CopyNnetParams(*nnet_, start_nnet);
+    nnet_mutex_->Unlock();
+    CopyNnetParams(*start_nnet, local_nnet);
+    num_syncs_++;
+  }
+
+  int32 sync_interval_;
+  NnetExamplePrefetcher *prefetcher_;
+  Mutex *nnet_mutex_;
+  double *tot_weight_ptr_;
+  double *log_prob_ptr_;
+  Nnet *nnet_;
+  double tot_weight_;
+  double log_prob_; // log-like times num frames.
+  int32 num_syncs_;
+};
+
+
 #if HAVE_CUDA == 1
 double DoBackpropSingleThreaded(const Nnet &nnet,
                                 int32 minibatch_size,
@@ -148,7 +258,8 @@ double DoBackpropParallel(const Nnet &nnet,
                           int32 minibatch_size,
                           SequentialNnetExampleReader *examples_reader,
                           double *tot_weight,
-                          Nnet *nnet_to_update) {
+                          Nnet *nnet_to_update,
+                          const NnetPrefetchConfig &prefetch_config) {
 #if HAVE_CUDA == 1
   // Our GPU code won't work with multithreading; we do this
   // to enable it to work with this code in the single-threaded
@@ -158,8 +269,11 @@ double DoBackpropParallel(const Nnet &nnet,
                                     tot_weight, nnet_to_update);
 #endif
   
-  ExamplesRepository repository; // handles parallel programming issues regarding
-  // the "examples" of data.
+  Timer timer;
+  // reads and formats the examples in background threads.  If we are only
+  // computing the objective function, ComputeNnetObjf() formats them itself.
+  NnetExamplePrefetcher prefetcher(prefetch_config, minibatch_size, nnet,
+                                   examples_reader, nnet_to_update != NULL);
   double tot_log_prob = 0.0;
   *tot_weight = 0.0;
 
@@ -167,32 +281,60 @@ double DoBackpropParallel(const Nnet &nnet,
   // nnet_to_update != &nnet.
   const bool store_separate_gradients = (nnet_to_update != &nnet);
   
-  DoBackpropParallelClass c(nnet, &repository, tot_weight,
+  DoBackpropParallelClass c(nnet, NULL, &prefetcher, tot_weight,
                             &tot_log_prob, nnet_to_update,
                             store_separate_gradients);
 
   {
     // The initialization of the following class spawns the threads that
-    // process the examples.  They get re-joined in its destructor.
+    // process the examples.  They get re-joined in its destructor, which
+    // returns when the prefetcher has no more examples.  The destructors of
+    // the objects of type DoBackpropParallelClass do the summing of the
+    // gradients if we're doing gradient computation (i.e. &nnet !=
+    // nnet_to_update).
     MultiThreader<DoBackpropParallelClass> m(g_num_threads, c);
-    
-    std::vector<NnetExample> examples;
-    for (; !examples_reader->Done(); examples_reader->Next()) {
-      examples.push_back(examples_reader->Value());
-      if (examples.size() == minibatch_size)
-        repository.AcceptExamples(&examples);
-    }
-    if (!examples.empty()) // partial minibatch.
-      repository.AcceptExamples(&examples);
-    // Here, the destructor of "m" re-joins the threads, and
-    // does the summing of the gradients if we're doing gradient
-    // computation (i.e. &nnet != nnet_to_update).  This gets
-    // done in the destructors of the objects of type
-    // DoBackpropParallelClass.
-    repository.ExamplesDone();
   }
-  KALDI_LOG << "Did backprop on " << *tot_weight << " examples, average log-prob "
-            << "per frame is " << (tot_log_prob / *tot_weight);
+  double elapsed = timer.Elapsed();
+  KALDI_LOG << "Did backprop on " << *tot_weight << " examples with "
+            << g_num_threads << " threads in " << elapsed << " seconds ("
+            << (*tot_weight / elapsed) << " examples per second), average "
+            << "log-prob per frame is " << (tot_log_prob / *tot_weight);
+  KALDI_LOG << "[this line is to be parsed by a script:] log-prob-per-frame="
+            << (tot_log_prob / *tot_weight);
+  return tot_log_prob;
+}
+
+
+double DoBackpropParallelLocalCopies(int32 minibatch_size,
+                                     int32 sync_interval,
+                                     SequentialNnetExampleReader *examples_reader,
+                                     double *tot_weight,
+                                     Nnet *nnet,
+                                     const NnetPrefetchConfig &prefetch_config) {
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled())
+    return DoBackpropSingleThreaded(*nnet, minibatch_size, examples_reader,
+                                    tot_weight, nnet);
+#endif
+  Timer timer;
+  NnetExamplePrefetcher prefetcher(prefetch_config, minibatch_size, *nnet,
+                                   examples_reader);
+  Mutex nnet_mutex;
+  double tot_log_prob = 0.0;
+  *tot_weight = 0.0;
+
+  DoBackpropParallelLocalClass c(sync_interval, &prefetcher, &nnet_mutex,
+                                 tot_weight, &tot_log_prob, nnet);
+  {
+    // The initialization of the following class spawns the threads that
+    // process the examples.  They get re-joined in its destructor.
+    MultiThreader<DoBackpropParallelLocalClass> m(g_num_threads, c);
+  }
+  double elapsed = timer.Elapsed();
+  KALDI_LOG << "Did backprop on " << *tot_weight << " examples with "
+            << g_num_threads << " threads in " << elapsed << " seconds ("
+            << (*tot_weight / elapsed) << " examples per second), average "
+            << "log-prob per frame is " << (tot_log_prob / *tot_weight);
   KALDI_LOG << "[this line is to be parsed by a script:] log-prob-per-frame="
             << (tot_log_prob / *tot_weight);
   return tot_log_prob;
@@ -234,7 +376,7 @@ double DoBackpropParallel(const Nnet &nnet,
   *tot_weight = 0;
   const bool store_separate_gradients = (nnet_to_update != &nnet);
   
-  DoBackpropParallelClass c(nnet, &repository, tot_weight,
+  DoBackpropParallelClass c(nnet, &repository, NULL, tot_weight,
                             &tot_log_prob, nnet_to_update,
                             store_separate_gradients);
 
@@ -26,6 +26,7 @@
 #include "thread/kaldi-thread.h"
 #include "itf/options-itf.h"
 #include "nnet2/nnet-update.h"
+#include "nnet2/nnet-example-prefetch.h"
 
 namespace kaldi {
 namespace nnet2 {
@@ -45,11 +46,38 @@ namespace nnet2 {
 /// gradient and it sums up the gradients.
 /// The return value is the total log-prob summed over the #frames. It also
 /// outputs the #frames into "num_frames".
+/// The examples are read and formatted in background threads, as configured
+/// by "prefetch_config".
 double DoBackpropParallel(const Nnet &nnet,
                           int32 minibatch_size,
                           SequentialNnetExampleReader *example_reader,
                           double *tot_weight,
-                          Nnet *nnet_to_update);
+                          Nnet *nnet_to_update,
+                          const NnetPrefetchConfig &prefetch_config =
+                          NnetPrefetchConfig());
+
+
+/// This is an alternative to the Hogwild update done by DoBackpropParallel()
+/// with nnet_to_update == &nnet, for machines with many cores.  In Hogwild,
+/// every thread writes to the same parameter matrices, and the cache lines
+/// get passed between cores (and sockets) so much that it stops scaling after
+/// about 10 threads.  Here, each thread trains its own copy of "nnet",
+/// allocated by that thread so it will be on the same NUMA node.  Every
+/// "sync_interval" minibatches, it adds the change in its copy since its last
+/// sync to "nnet", and copies "nnet" back to its copy.  Threads only wait for
+/// each other while one of them adds its change to "nnet".  Each
+/// update is applied to "nnet" once, as in Hogwild, so the learning rates do
+/// not need to be changed; with sync_interval == 1 it is similar to Hogwild
+/// with delayed updates.  This needs two copies of the model per thread.
+/// Returns the total log-prob, and outputs the total weight of the
+/// examples to "tot_weight".
+double DoBackpropParallelLocalCopies(int32 minibatch_size,
+                                     int32 sync_interval,
+                                     SequentialNnetExampleReader *example_reader,
+                                     double *tot_weight,
+                                     Nnet *nnet,
+                                     const NnetPrefetchConfig &prefetch_config =
+                                     NnetPrefetchConfig());
 
 
 /// This version of DoBackpropParallel takes a vector of examples, and will
@@ -232,10 +232,8 @@ void FormatNnetInput(const Nnet &nnet,
                               chunk * num_splice, num_splice,
                               0, feat_dim);
 
-    Matrix<BaseFloat> full_src(data[chunk].input_frames);
-    SubMatrix<BaseFloat> src(full_src, ignore_frames, num_splice, 0, feat_dim);
-                             
-    dest.CopyFromMat(src);
+    // Decompress just the frames we need, directly into place.
+    data[chunk].input_frames.CopyToMat(ignore_frames, 0, &dest);
     if (spk_dim != 0) {
       SubMatrix<BaseFloat> spk_dest(*input_mat,
                                     chunk * num_splice, num_splice,
@@ -22,6 +22,7 @@
 
 #include "nnet2/nnet-update.h"
 #include "nnet2/nnet-compute.h"
+#include "nnet2/nnet-example-prefetch.h"
 #include "itf/options-itf.h"
 
 namespace kaldi {
@@ -31,6 +32,7 @@ namespace nnet2 {
 struct NnetSimpleTrainerConfig {
   int32 minibatch_size;
   int32 minibatches_per_phase;
+  NnetPrefetchConfig prefetch_config;
   
   NnetSimpleTrainerConfig(): minibatch_size(500),
                              minibatches_per_phase(50) { }
@@ -41,13 +43,15 @@ struct NnetSimpleTrainerConfig {
     opts->Register("minibatches-per-phase", &minibatches_per_phase,
                    "Number of minibatches to wait before printing training-set "
                    "objective.");
+    prefetch_config.Register(opts);
   }  
 };
 
 
 /// Train on all the examples it can read from the reader.  This does training
-/// in a single thread, but it uses a separate thread to read in the examples
-/// and format the input data on the CPU; this saves us time when using GPUs.
+/// in a single thread, but it uses separate threads to read in the examples
+/// and format the input data on the CPU (see NnetExamplePrefetcher); this saves
+/// us time when using GPUs.
 /// Returns the number of examples processed.
 /// Outputs to tot_weight and tot_logprob_per_frame, if non-NULL, the total
 /// weight of the examples (typically equal to the number of examples) and the
@@ -23,6 +23,7 @@
 #include "hmm/transition-model.h"
 #include "nnet2/train-nnet.h"
 #include "nnet2/am-nnet.h"
+#include "nnet2/nnet-compiled.h"
 
 
 int main(int argc, char *argv[]) {
@@ -43,6 +44,7 @@ int main(int argc, char *argv[]) {
     
     bool apply_log = false;
     bool pad_input = true;
+    bool use_compiled_nnet = false;
     std::string use_gpu = "no";
     ParseOptions po(usage);
     po.Register("apply-log", &apply_log, "Apply a log to the result of the computation "
@@ -52,6 +54,9 @@ int main(int argc, char *argv[]) {
                 "of output being less than those of input.");
     po.Register("use-gpu", &use_gpu,
                 "yes|no|optional|wait, only has effect if compiled with CUDA");
+    po.Register("use-compiled-nnet", &use_compiled_nnet, "If true, do the "
+                "computation on the CPU with a compiled form of the network "
+                "(faster).  Ignores --use-gpu.");
     
     po.Read(argc, argv);
     
@@ -77,6 +82,9 @@ int main(int argc, char *argv[]) {
     }
 
     Nnet &nnet = am_nnet.GetNnet();
+    CompiledNnet *compiled_nnet = NULL;
+    if (use_compiled_nnet)
+      compiled_nnet = new CompiledNnet(nnet);
     
     int64 num_done = 0, num_frames = 0;
     SequentialBaseFloatCuMatrixReader feature_reader(features_rspecifier);
@@ -95,7 +103,14 @@ int main(int argc, char *argv[]) {
         continue;
       }
       CuMatrix<BaseFloat> output(output_frames, output_dim);
-      NnetComputation(nnet, feats, pad_input, &output);
+      if (compiled_nnet != NULL) {
+        Matrix<BaseFloat> cpu_feats(feats),
+            cpu_output(output_frames, output_dim, kUndefined);
+        compiled_nnet->Compute(cpu_feats, pad_input, &cpu_output);
+        output.CopyFromMat(cpu_output);
+      } else {
+        NnetComputation(nnet, feats, pad_input, &output);
+      }
 
       if (apply_log) {
         output.ApplyFloor(1.0e-20);
@@ -108,6 +123,7 @@ int main(int argc, char *argv[]) {
 #if HAVE_CUDA==1
     CuDevice::Instantiate().PrintProfile();
 #endif
+    delete compiled_nnet;
     
     KALDI_LOG << "Processed " << num_done << " feature files, "
               << num_frames << " frames of input were processed.";
@@ -46,6 +46,7 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     Timer timer;
     bool allow_partial = false;
+    bool use_compiled_nnet = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
     
@@ -54,6 +55,9 @@ int main(int argc, char *argv[]) {
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("use-compiled-nnet", &use_compiled_nnet, "If true, do the "
+                "neural net computation on the CPU with a compiled form of "
+                "the network (faster).");
     
     po.Read(argc, argv);
     
@@ -77,6 +81,9 @@ int main(int argc, char *argv[]) {
       trans_model.Read(ki.Stream(), binary);
       am_nnet.Read(ki.Stream(), binary);
     }
+    CompiledNnet *compiled_nnet = NULL;
+    if (use_compiled_nnet)
+      compiled_nnet = new CompiledNnet(am_nnet.GetNnet());
 
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
@@ -105,7 +112,7 @@ int main(int argc, char *argv[]) {
       SequentialBaseFloatCuMatrixReader feature_reader(feature_rspecifier);
       
       // Input FST is just one FST, not a table of FSTs.
-      VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+      fst::Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
 
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
@@ -119,14 +126,17 @@ int main(int argc, char *argv[]) {
             continue;
           }
           bool pad_input = true;
-          DecodableAmNnet nnet_decodable(trans_model,
-                                         am_nnet,
-                                         features,
-                                         pad_input,
-                                         acoustic_scale);
+          DecodableAmNnet *nnet_decodable;
+          if (compiled_nnet != NULL)
+            nnet_decodable = new DecodableAmNnet(
+                trans_model, am_nnet, compiled_nnet, Matrix<BaseFloat>(features),
+                pad_input, acoustic_scale);
+          else
+            nnet_decodable = new DecodableAmNnet(
+                trans_model, am_nnet, features, pad_input, acoustic_scale);
           double like;
           if (DecodeUtteranceLatticeFaster(
-                  decoder, nnet_decodable, trans_model, word_syms, utt,
+                  decoder, *nnet_decodable, trans_model, word_syms, utt,
                   acoustic_scale, determinize, allow_partial, &alignment_writer,
                   &words_writer, &compact_lattice_writer, &lattice_writer,
                   &like)) {
@@ -134,6 +144,7 @@ int main(int argc, char *argv[]) {
             frame_count += features.NumRows();
             num_success++;
           } else num_fail++;
+          delete nnet_decodable;
         }
       }
       delete decode_fst; // delete this only after decoder goes out of scope.
@@ -158,14 +169,17 @@ int main(int argc, char *argv[]) {
         LatticeFasterDecoder decoder(fst_reader.Value(), config);
 
         bool pad_input = true;
-        DecodableAmNnet nnet_decodable(trans_model,
-                                       am_nnet,
-                                       features,
-                                       pad_input,
-                                       acoustic_scale);
+        DecodableAmNnet *nnet_decodable;
+        if (compiled_nnet != NULL)
+          nnet_decodable = new DecodableAmNnet(
+              trans_model, am_nnet, compiled_nnet, Matrix<BaseFloat>(features),
+              pad_input, acoustic_scale);
+        else
+          nnet_decodable = new DecodableAmNnet(
+              trans_model, am_nnet, features, pad_input, acoustic_scale);
         double like;
         if (DecodeUtteranceLatticeFaster(
-                decoder, nnet_decodable, trans_model, word_syms, utt,
+                decoder, *nnet_decodable, trans_model, word_syms, utt,
                 acoustic_scale, determinize, allow_partial, &alignment_writer,
                 &words_writer, &compact_lattice_writer, &lattice_writer,
                 &like)) {
@@ -173,8 +187,10 @@ int main(int argc, char *argv[]) {
           frame_count += features.NumRows();
           num_success++;
         } else num_fail++;
+        delete nnet_decodable;
       }
     }
+    delete compiled_nnet;
       
     double elapsed = timer.Elapsed();
     KALDI_LOG << "Time taken "<< elapsed
@@ -19,6 +19,7 @@
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/kaldi-archive-index.h"
 #include "hmm/transition-model.h"
 #include "nnet2/nnet-example-functions.h"
 
@@ -32,7 +33,9 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Copy examples (typically single frames) for neural network training,\n"
         "from the input to output, but randomly shuffle the order.  This program will keep\n"
-        "all of the examples in memory at once, so don't give it too many.\n"
+        "all of the examples in memory at once, so don't give it too many, unless\n"
+        "the input is an archive with an index (written with ark,idx:...), which\n"
+        "is read directly in a random order.\n"
         "\n"
         "Usage:  nnet-shuffle-egs-discriminative [options] <egs-rspecifier> <egs-wspecifier>\n"
         "\n"
@@ -60,12 +63,34 @@ int main(int argc, char *argv[]) {
 
     int64 num_done = 0;
 
+    // If the input is an archive with an index, we can read the examples in a
+    // random order without keeping them in memory.
+    bool use_index = false;
+    if (buffer_size == 0) {
+      std::string archive_rxfilename;
+      RspecifierOptions opts;
+      if (ClassifyRspecifier(examples_rspecifier, &archive_rxfilename, &opts)
+          == kArchiveRspecifier &&
+          ArchiveIndex::IndexExists(archive_rxfilename)) {
+        ArchiveIndex index;
+        use_index = index.Open(archive_rxfilename);
+        if (use_index && !opts.shuffle)
+          examples_rspecifier = "shuffle," + examples_rspecifier;
+      }
+    }
+
     std::vector<DiscriminativeNnetExample*> egs;
     SequentialDiscriminativeNnetExampleReader example_reader(
         examples_rspecifier);
     DiscriminativeNnetExampleWriter example_writer(
         examples_wspecifier);
-    if (buffer_size == 0) { // Do full randomization
+    if (use_index) {
+      for (; !example_reader.Done(); example_reader.Next(), num_done++) {
+        std::ostringstream ostr;
+        ostr << num_done;
+        example_writer.Write(ostr.str(), example_reader.Value());
+      }
+    } else if (buffer_size == 0) { // Do full randomization
       // Putting in an extra level of indirection here to avoid excessive
       // computation and memory demands when we have to resize the vector.
     
@@ -102,7 +127,8 @@ int main(int argc, char *argv[]) {
 
     KALDI_LOG << "Shuffled order of " << num_done
               << " neural-network training examples "
-              << (buffer_size ? "using a buffer (partial randomization)" : "");
+              << (use_index ? "using the archive index" :
+                  (buffer_size ? "using a buffer (partial randomization)" : ""));
                   
     return (num_done == 0 ? 1 : 0);
   } catch(const std::exception &e) {
@@ -20,6 +20,7 @@
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/kaldi-archive-index.h"
 #include "hmm/transition-model.h"
 #include "nnet2/nnet-example-functions.h"
 
@@ -33,7 +34,10 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Copy examples (typically single frames) for neural network training,\n"
         "from the input to output, but randomly shuffle the order. This program will keep\n"
-        "all of the examples in memory at once, so don't give it too many.\n"
+        "all of the examples in memory at once, so don't give it too many, unless\n"
+        "the input is an archive with an index (written with ark,idx:...), which\n"
+        "is read in blocks of consecutive examples, in a random order, holding\n"
+        "only one block in memory.\n"
         "\n"
         "Usage:  nnet-shuffle-egs [options] <egs-rspecifier> <egs-wspecifier>\n"
         "\n"
@@ -61,10 +65,30 @@ int main(int argc, char *argv[]) {
 
     int64 num_done = 0;
 
+    // If the input is an archive with an index, we can read the examples in a
+    // random order without keeping them all in memory.  Opening the reader
+    // with the "shuffle" option checks the index; if it is not usable, we
+    // read the archive normally.
+    SequentialNnetExampleReader example_reader;
+    bool use_index = false;
+    if (buffer_size == 0) {
+      std::string archive_rxfilename;
+      RspecifierOptions opts;
+      if (ClassifyRspecifier(examples_rspecifier, &archive_rxfilename, &opts)
+          == kArchiveRspecifier &&
+          ArchiveIndex::IndexExists(archive_rxfilename))
+        use_index = example_reader.Open(opts.shuffle ? examples_rspecifier :
+                                        "shuffle," + examples_rspecifier);
+    }
+    if (!use_index && !example_reader.Open(examples_rspecifier))
+      KALDI_ERR << "Error opening examples from " << examples_rspecifier;
+
     std::vector<std::pair<std::string, NnetExample*> > egs;
-    SequentialNnetExampleReader example_reader(examples_rspecifier);
     NnetExampleWriter example_writer(examples_wspecifier);
-    if (buffer_size == 0) {  // Do full randomization
+    if (use_index) {
+      for (; !example_reader.Done(); example_reader.Next(), num_done++)
+        example_writer.Write(example_reader.Key(), example_reader.Value());
+    } else if (buffer_size == 0) {  // Do full randomization
       // Putting in an extra level of indirection here to avoid excessive
       // computation and memory demands when we have to resize the vector.
 
@@ -100,7 +124,8 @@ int main(int argc, char *argv[]) {
 
     KALDI_LOG << "Shuffled order of " << num_done
               << " neural-network training examples "
-              << (buffer_size ? "using a buffer (partial randomization)" : "");
+              << (use_index ? "using the archive index" :
+                  (buffer_size ? "using a buffer (partial randomization)" : ""));
 
     return (num_done == 0 ? 1 : 0);
   } catch(const std::exception &e) {
@@ -39,12 +39,16 @@ int main(int argc, char *argv[]) {
         "Usage:  nnet-train-parallel [options] <model-in> <training-examples-in> <model-out>\n"
         "\n"
         "e.g.:\n"
-        "nnet-train-parallel --num-threads=8 1.nnet ark:1.1.egs 2.nnet\n";
+        "nnet-train-parallel --num-threads=8 1.nnet ark:1.1.egs 2.nnet\n"
+        "On machines with many cores, --sync-interval=10 (say) may be faster;\n"
+        "compare the examples per second printed at the end.\n";
     
     bool binary_write = true;
     bool zero_stats = true;
     int32 minibatch_size = 1024;
     int32 srand_seed = 0;
+    int32 sync_interval = 0;
+    NnetPrefetchConfig prefetch_config;
     
     ParseOptions po(usage);
     po.Register("binary", &binary_write, "Write output in binary mode");
@@ -57,6 +61,12 @@ int main(int argc, char *argv[]) {
                 "implementation of BLAS, the actual number of threads may be larger.]");
     po.Register("minibatch-size", &minibatch_size, "Number of examples to use for "
                 "each minibatch during training.");
+    po.Register("sync-interval", &sync_interval, "If >0, instead of all threads "
+                "updating the same model (Hogwild), each thread trains its own "
+                "copy of the model and adds its change to the shared model "
+                "every this-many minibatches.  Scales better with many "
+                "threads, but uses two copies of the model per thread.");
+    prefetch_config.Register(&po);
     
     po.Read(argc, argv);
     srand(srand_seed);
@@ -87,11 +97,20 @@ int main(int argc, char *argv[]) {
     SequentialNnetExampleReader example_reader(examples_rspecifier);
     
 
-    DoBackpropParallel(am_nnet.GetNnet(),
-                       minibatch_size,
-                       &example_reader,
-                       &num_examples,
-                       &(am_nnet.GetNnet()));
+    if (sync_interval > 0)
+      DoBackpropParallelLocalCopies(minibatch_size,
+                                    sync_interval,
+                                    &example_reader,
+                                    &num_examples,
+                                    &(am_nnet.GetNnet()),
+                                    prefetch_config);
+    else
+      DoBackpropParallel(am_nnet.GetNnet(),
+                         minibatch_size,
+                         &example_reader,
+                         &num_examples,
+                         &(am_nnet.GetNnet()),
+                         prefetch_config);
     
     {
       Output ko(nnet_wxfilename, binary_write);
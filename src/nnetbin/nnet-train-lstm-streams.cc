@@ -29,6 +29,51 @@
 #include "base/timer.h"
 #include "cudamatrix/cu-device.h"
 
+namespace kaldi {
+namespace nnet1 {
+
+// Reads the next utterance which has targets of the right length, and applies
+// the feature transform to it; returns false if there are no more utterances.
+static bool ReadNextUtterance(Nnet &nnet_transf,
+                              SequentialBaseFloatMatrixReader *feature_reader,
+                              RandomAccessPosteriorReader *target_reader,
+                              std::string *key,
+                              Matrix<BaseFloat> *feats,
+                              Posterior *targets,
+                              int32 *num_no_tgt_mat,
+                              int32 *num_other_error) {
+  CuMatrix<BaseFloat> feat_transf;
+  for (; !feature_reader->Done(); feature_reader->Next()) {
+    *key = feature_reader->Key();
+    if (!target_reader->HasKey(*key)) {
+      KALDI_WARN << *key << ", missing targets";
+      (*num_no_tgt_mat)++;
+      continue;
+    }
+    const Matrix<BaseFloat> &mat = feature_reader->Value();
+    { // apply optional feature transform,
+      // Karel: feature transform may contain <Splice> which does clone
+      // frames on sentence boundaries. It is better to apply feature 
+      // transform to whole sentences.
+      nnet_transf.Feedforward(CuMatrix<BaseFloat>(mat), &feat_transf);
+      feats->Resize(feat_transf.NumRows(), feat_transf.NumCols());
+      feat_transf.CopyToMat(feats);
+    }
+    *targets = target_reader->Value(*key);
+    if (feats->NumRows() != targets->size()) {
+      KALDI_WARN << *key << ", length miss-match between feats and targets, skip";
+      (*num_other_error)++;
+      continue;
+    }
+    feature_reader->Next();
+    return true;
+  }
+  return false;
+}
+
+}  // namespace nnet1
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   using namespace kaldi;
   using namespace kaldi::nnet1;
@@ -82,6 +127,11 @@ int main(int argc, char *argv[]) {
 
     int32 dump_interval=0;
     po.Register("dump-interval", &dump_interval, "---LSTM--- num utts between model dumping [ 0 == disabled ]"); 
+
+    bool pack_sequences = false;
+    po.Register("pack-sequences", &pack_sequences, "---LSTM--- when an utterance "
+                "ends inside a BPTT batch, continue its stream with the next "
+                "utterance (resetting the LSTM state there) instead of padding");
     //</jiayu>
 
     // Add dummy randomizer options, to make the tool compatible with standard scripts
@@ -125,7 +175,7 @@ int main(int argc, char *argv[]) {
     nnet.Read(model_filename);
     nnet.SetTrainOptions(trn_opts);
 
-    kaldi::int64 total_frames = 0;
+    kaldi::int64 total_frames = 0, total_padded_frames = 0;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     RandomAccessPosteriorReader target_reader(targets_rspecifier);
@@ -163,46 +213,23 @@ int main(int argc, char *argv[]) {
     Vector<BaseFloat> frame_mask(batch_size * num_stream, kSetZero);
     Matrix<BaseFloat> feat(batch_size * num_stream, feat_dim, kSetZero);
     Posterior target(batch_size * num_stream);
-    CuMatrix<BaseFloat> feat_transf, nnet_out, obj_diff;
+    std::vector<int32> seq_start(batch_size * num_stream, 0);
+    CuMatrix<BaseFloat> nnet_out, obj_diff;
 
     while (1) {
         // loop over all streams, check if any stream reaches the end of its utterance,
         // if any, feed the exhausted stream with a new utterance, update book-keeping infos
         for (int s = 0; s < num_stream; s++) {
+            new_utt_flags[s] = 0;
             // this stream still has valid frames
-            if (curt[s] < lent[s]) {
-                new_utt_flags[s] = 0;
-                continue;
-            }
+            if (curt[s] < lent[s]) continue;
             // else, this stream exhausted, need new utterance
-            while (!feature_reader.Done()) {
-                keys[s]  = feature_reader.Key();
-                const Matrix<BaseFloat> &mat = feature_reader.Value();
-                { // apply optional feature transform,
-                  // Karel: feature transform may contain <Splice> which does clone
-                  // frames on sentence boundaries. It is better to apply feature 
-                  // transform to whole sentences.
-                  nnet_transf.Feedforward(CuMatrix<BaseFloat>(mat), &feat_transf);
-                  feats[s].Resize(feat_transf.NumRows(), feat_transf.NumCols());
-                  feat_transf.CopyToMat(&feats[s]); 
-                }
-                if (!target_reader.HasKey(keys[s])) {
-                    KALDI_WARN << keys[s] << ", missing targets";
-                    num_no_tgt_mat++;
-                    feature_reader.Next();
-                    continue;
-                }
-                targets[s] = target_reader.Value(keys[s]);
-                if (feats[s].NumRows() != targets[s].size()) {
-                    KALDI_WARN << keys[s] << ", length miss-match between feats and targets, skip";
-                    feature_reader.Next();
-                    continue;
-                }
+            if (ReadNextUtterance(nnet_transf, &feature_reader, &target_reader,
+                                  &keys[s], &feats[s], &targets[s],
+                                  &num_no_tgt_mat, &num_other_error)) {
                 curt[s] = 0;
                 lent[s] = feats[s].NumRows();
                 new_utt_flags[s] = 1;  // a new utterance feeded to this stream
-                feature_reader.Next();
-                break;
             }
         }
 
@@ -217,8 +244,21 @@ int main(int argc, char *argv[]) {
         // * frame_mask: 0 indicates padded frames, 1 indicates valid frames
         // * target: padded to batch_size
         // * feat: first shifted to achieve targets delay; then padded to batch_size
+        // * seq_start: 1 where a packed utterance starts inside the batch
+        int32 num_packed = 0;
+        std::fill(seq_start.begin(), seq_start.end(), 0);
         for (int t = 0; t < batch_size; t++) {
             for (int s = 0; s < num_stream; s++) {
+                // with --pack-sequences, the next utterance follows directly
+                if (pack_sequences && t > 0 && curt[s] >= lent[s] &&
+                    ReadNextUtterance(nnet_transf, &feature_reader, &target_reader,
+                                      &keys[s], &feats[s], &targets[s],
+                                      &num_no_tgt_mat, &num_other_error)) {
+                    curt[s] = 0;
+                    lent[s] = feats[s].NumRows();
+                    seq_start[t * num_stream + s] = 1;
+                    num_packed++;
+                }
                 // frame_mask & targets padding
                 if (curt[s] < lent[s]) {
                     frame_mask(t * num_stream + s) = 1;
@@ -240,6 +280,9 @@ int main(int argc, char *argv[]) {
 
         // for streams with new utterance, history states need to be reset
         nnet.ResetLstmStreams(new_utt_flags);
+        if (pack_sequences) {
+            nnet.SetLstmSequenceStarts(seq_start);
+        }
 
         // forward pass
         nnet.Propagate(CuMatrix<BaseFloat>(feat), &nnet_out);
@@ -270,8 +313,9 @@ int main(int argc, char *argv[]) {
 
         int frame_progress = frame_mask.Sum();
         total_frames += frame_progress;
+        total_padded_frames += frame_mask.Dim() - frame_progress;
 
-        int num_done_progress = 0;
+        int num_done_progress = num_packed;
         for (int i =0; i < new_utt_flags.size(); i++) {
             num_done_progress += new_utt_flags[i];
         }
@@ -334,6 +378,9 @@ int main(int argc, char *argv[]) {
               << ", " << (randomize?"RANDOMIZED":"NOT-RANDOMIZED") 
               << ", " << time.Elapsed()/60 << " min, fps" << total_frames/time.Elapsed()
               << "]";  
+    KALDI_LOG << "Padding was " << (100.0 * total_padded_frames /
+                                    (total_frames + total_padded_frames))
+              << "% of the frames" << (pack_sequences ? " (packed sequences)." : ".");
 
     if (objective_function == "xent") {
       KALDI_LOG << xent.Report();
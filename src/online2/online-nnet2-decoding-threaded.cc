@@ -123,6 +123,7 @@ SingleUtteranceNnet2DecoderThreaded::SingleUtteranceNnet2DecoderThreaded(
   silence_weighting_(tmodel, feature_info.silence_weighting_config),
   decodable_(tmodel),
   num_frames_decoded_(0), decoder_(fst, config_.decoder_opts),
+  determinizer_(config_.incremental_det_opts, config_.decoder_opts, tmodel),
   abort_(false), error_(false) {
   // if the user supplies an adaptation state that was not freshly initialized,
   // it means that we take the adaptation state from the previous
@@ -329,6 +330,13 @@ void SingleUtteranceNnet2DecoderThreaded::GetLattice(
                    CompactLatticeWeight::One());
     return;
   }
+  if (config_.incremental_det_opts.incremental) {
+    // Only the part of the lattice since the last piece that was determinized
+    // during decoding needs to be determinized here.
+    determinizer_.GetLattice(decoder_, end_of_utterance, clat);
+    const_cast<Mutex&>(decoder_mutex_).Unlock();
+    return;
+  }
   Lattice raw_lat;
   decoder_.GetRawLattice(&raw_lat, end_of_utterance);
   const_cast<Mutex&>(decoder_mutex_).Unlock();
@@ -669,6 +677,8 @@ bool SingleUtteranceNnet2DecoderThreaded::RunDecoderSearchInternal() {
       decoder_mutex_.Lock();
       decoder_.AdvanceDecoding(&decodable_, config_.decode_batch_size);
       num_frames_decoded = decoder_.NumFramesDecoded();
+      if (config_.incremental_det_opts.incremental)
+        determinizer_.AdvanceDeterminization(decoder_);
       if (silence_weighting_.Active()) {
         silence_weighting_mutex_.Lock();
         // the next function does not trace back all the way; it's very fast.
@@ -33,6 +33,7 @@
 #include "online2/online-nnet2-feature-pipeline.h"
 #include "online2/online-endpoint.h"
 #include "decoder/lattice-faster-online-decoder.h"
+#include "decoder/lattice-incremental-determinizer.h"
 #include "hmm/transition-model.h"
 #include "thread/kaldi-mutex.h"
 #include "thread/kaldi-semaphore.h"
@@ -120,6 +121,8 @@ class ThreadSynchronizer {
 struct OnlineNnet2DecodingThreadedConfig {
   
   LatticeFasterDecoderConfig decoder_opts;
+
+  LatticeIncrementalDeterminizerConfig incremental_det_opts;
   
   BaseFloat acoustic_scale;
   
@@ -162,6 +165,7 @@ struct OnlineNnet2DecodingThreadedConfig {
   
   void Register(OptionsItf *opts) {
     decoder_opts.Register(opts);
+    incremental_det_opts.Register(opts);
     opts->Register("acoustic-scale", &acoustic_scale, "Scale used on acoustics "
                    "when decoding");
     opts->Register("max-buffered-features", &max_buffered_features, "Obscure "
@@ -408,6 +412,11 @@ class SingleUtteranceNnet2DecoderThreaded {
   // by the main (parent) thread if you call functions like NumFramesDecoded(),
   // GetLattice() and GetBestPath().
   Mutex decoder_mutex_;
+
+  // If config_.incremental_det_opts.incremental is true, this determinizes
+  // the lattice as we go; it is called by the decoder-search thread after
+  // each batch of frames, and is guarded by decoder_mutex_.
+  LatticeIncrementalDeterminizer determinizer_;
   
   // This contains the thread pointers for the nnet-evaluation and
   // decoder-search threads respectively (or NULL if they have been joined in
@@ -33,12 +33,15 @@ SingleUtteranceNnet2Decoder::SingleUtteranceNnet2Decoder(
     feature_pipeline_(feature_pipeline),
     tmodel_(tmodel),
     decodable_(model, tmodel, config.decodable_opts, feature_pipeline),
-    decoder_(fst, config.decoder_opts) {
+    decoder_(fst, config.decoder_opts),
+    determinizer_(config.incremental_det_opts, config.decoder_opts, tmodel) {
   decoder_.InitDecoding();
 }
 
 void SingleUtteranceNnet2Decoder::AdvanceDecoding() {
   decoder_.AdvanceDecoding(&decodable_);
+  if (config_.incremental_det_opts.incremental)
+    determinizer_.AdvanceDeterminization(decoder_);
 }
 
 void SingleUtteranceNnet2Decoder::FinalizeDecoding() {
@@ -53,12 +56,16 @@ void SingleUtteranceNnet2Decoder::GetLattice(bool end_of_utterance,
                                              CompactLattice *clat) const {
   if (NumFramesDecoded() == 0)
     KALDI_ERR << "You cannot get a lattice if you decoded no frames.";
-  Lattice raw_lat;
-  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
-
   if (!config_.decoder_opts.determinize_lattice)
     KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
 
+  if (config_.incremental_det_opts.incremental) {
+    determinizer_.GetLattice(decoder_, end_of_utterance, clat);
+    return;
+  }
+  Lattice raw_lat;
+  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
+
   BaseFloat lat_beam = config_.decoder_opts.lattice_beam;
   DeterminizeLatticePhonePrunedWrapper(
       tmodel_, &raw_lat, lat_beam, clat, config_.decoder_opts.det_opts);
@@ -32,6 +32,7 @@
 #include "online2/online-nnet2-feature-pipeline.h"
 #include "online2/online-endpoint.h"
 #include "decoder/lattice-faster-online-decoder.h"
+#include "decoder/lattice-incremental-determinizer.h"
 #include "hmm/transition-model.h"
 #include "hmm/posterior.h"
 
@@ -51,12 +52,14 @@ struct OnlineNnet2DecodingConfig {
   
   LatticeFasterDecoderConfig decoder_opts;
   nnet2::DecodableNnet2OnlineOptions decodable_opts;
+  LatticeIncrementalDeterminizerConfig incremental_det_opts;
   
   OnlineNnet2DecodingConfig() {  decodable_opts.acoustic_scale = 0.1; }
   
   void Register(OptionsItf *opts) {
     decoder_opts.Register(opts);
     decodable_opts.Register(opts);
+    incremental_det_opts.Register(opts);
   }
 };
 
@@ -118,6 +121,10 @@ class SingleUtteranceNnet2Decoder {
   nnet2::DecodableNnet2Online decodable_;
   
   LatticeFasterOnlineDecoder decoder_;
+
+  // Used if config_.incremental_det_opts.incremental is true, to determinize
+  // the lattice as we go.
+  LatticeIncrementalDeterminizer determinizer_;
   
 };
 
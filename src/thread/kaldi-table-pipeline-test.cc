@@ -0,0 +1,127 @@
+// thread/kaldi-table-pipeline-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include "base/kaldi-common.h"
+#include "util/table-types.h"
+#include "thread/kaldi-table-pipeline.h"
+
+namespace kaldi {
+
+// Scales each matrix by the number in its key, and fails for keys that are
+// multiples of 7, and throws an exception for the key "error_key" if it is
+// not -1.  Also sums the elements of the output, in Output().
+typedef KaldiObjectHolder<Matrix<BaseFloat> > MatrixHolder;
+
+class TestPipeline: public TablePipeline<MatrixHolder, Matrix<BaseFloat> > {
+ public:
+  TestPipeline(const TaskSequencerConfig &config, int32 error_key,
+               BaseFloatMatrixWriter *writer):
+      TablePipeline<MatrixHolder, Matrix<BaseFloat> >(config),
+      error_key_(error_key), writer_(writer), tot_(0.0) { }
+
+  virtual bool Process(const std::string &key, const Matrix<BaseFloat> &input,
+                       Matrix<BaseFloat> *output) {
+    int32 i = atoi(key.c_str());
+    if (i % 7 == 0) return false;
+    if (i == error_key_) KALDI_ERR << "Error processing " << key;
+    *output = input;
+    output->Scale(i);
+    int32 spin = Rand() % 100000;  // so that the jobs finish out of order.
+    for (int32 j = 0; j < spin; j++);
+    return true;
+  }
+
+  virtual void Output(const std::string &key, const Matrix<BaseFloat> &output) {
+    writer_->Write(key, output);
+    tot_ += output.Sum();
+  }
+
+  double Tot() const { return tot_; }
+ private:
+  int32 error_key_;
+  BaseFloatMatrixWriter *writer_;
+  double tot_;
+};
+
+void TestTablePipeline() {
+  int32 num_items = Rand() % 50;
+  const char *in_filename = "tmpf.pipeline.in", *out_filename =
+      "tmpf.pipeline.out";
+  std::vector<Matrix<BaseFloat> > mats(num_items);
+  {
+    BaseFloatMatrixWriter writer(std::string("ark:") + in_filename);
+    for (int32 i = 0; i < num_items; i++) {
+      mats[i].Resize(1 + Rand() % 5, 1 + Rand() % 5);
+      mats[i].SetRandn();
+      std::ostringstream os;
+      os << (i + 1);
+      writer.Write(os.str(), mats[i]);
+    }
+  }
+  TaskSequencerConfig config;
+  config.num_threads = 1 + Rand() % 5;
+  // Sometimes one of the items throws an exception, which Run() should throw
+  // in this thread after outputting the items before it.
+  int32 error_key = (num_items > 0 && Rand() % 2 == 0 ?
+                     1 + Rand() % num_items : -1);
+  if (error_key % 7 == 0) error_key = -1;
+  double tot;
+  {
+    SequentialBaseFloatMatrixReader reader(std::string("ark:") + in_filename);
+    BaseFloatMatrixWriter writer(std::string("ark:") + out_filename);
+    TestPipeline pipeline(config, error_key, &writer);
+    bool threw = false;
+    try {
+      pipeline.Run(&reader);
+    } catch (const std::exception &e) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw == (error_key != -1));
+    tot = pipeline.Tot();
+  }
+  int32 num_output = (error_key != -1 ? error_key - 1 : num_items);
+  double expected_tot = 0.0;
+  SequentialBaseFloatMatrixReader reader(std::string("ark:") + out_filename);
+  for (int32 i = 0; i < num_output; i++) {
+    if ((i + 1) % 7 == 0) continue;
+    KALDI_ASSERT(!reader.Done());
+    std::ostringstream os;
+    os << (i + 1);
+    KALDI_ASSERT(reader.Key() == os.str());
+    Matrix<BaseFloat> expected(mats[i]);
+    expected.Scale(i + 1);
+    KALDI_ASSERT(expected.ApproxEqual(reader.Value()));
+    expected_tot += expected.Sum();
+    reader.Next();
+  }
+  KALDI_ASSERT(reader.Done());
+  AssertEqual(tot, expected_tot);
+  unlink(in_filename);
+  unlink(out_filename);
+}
+
+}  // end namespace kaldi.
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 20; i++)
+    TestTablePipeline();
+  KALDI_LOG << "Test OK.";
+}
@@ -0,0 +1,189 @@
+// thread/kaldi-table-pipeline.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_THREAD_KALDI_TABLE_PIPELINE_H_
+#define KALDI_THREAD_KALDI_TABLE_PIPELINE_H_ 1
+
+#include <stdexcept>
+#include <string>
+#include "base/kaldi-common.h"
+#include "util/kaldi-table.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+/**
+   TablePipeline is for the very common kind of program that reads a table
+   with a SequentialTableReader, does some computation on each item, and
+   writes the results to a table in the same order.  It runs the computation
+   for several items in parallel: the calling thread reads the input (reading
+   ahead of the computation by up to --num-threads-total items), up to
+   --num-threads worker threads do the computation, and the results are output
+   sequentially and in the original order.  It is built on TaskSequencer (see
+   kaldi-task-sequence.h), which has the same options.
+
+   To use it, inherit from TablePipeline<InHolder, OutType> and override
+   Process(), which does the computation and must be safe to call from several
+   threads at once, and Output(), which is called for the results in order and
+   one at a time, so it can write to a TableWriter and accumulate statistics
+   without locking.  The output type is up to you; it may include, for
+   instance, statistics to be accumulated in Output().  Example:
+   \code
+   typedef KaldiObjectHolder<Matrix<BaseFloat> > MatrixHolder;
+   class ScalePipeline: public TablePipeline<MatrixHolder, Matrix<BaseFloat> > {
+    public:
+     ScalePipeline(const TaskSequencerConfig &config, BaseFloat scale,
+                   BaseFloatMatrixWriter *writer):
+         TablePipeline<MatrixHolder, Matrix<BaseFloat> >(config),
+         scale_(scale), writer_(writer) { }
+     virtual bool Process(const std::string &key,
+                          const Matrix<BaseFloat> &input,
+                          Matrix<BaseFloat> *output) {
+       *output = input;
+       output->Scale(scale_);
+       return true;
+     }
+     virtual void Output(const std::string &key,
+                         const Matrix<BaseFloat> &output) {
+       writer_->Write(key, output);
+     }
+    private:
+     BaseFloat scale_;
+     BaseFloatMatrixWriter *writer_;
+   };
+   \endcode
+   Note: if Process() needs to look things up in a RandomAccessTableReader, it
+   must lock a mutex while doing so, and copy the value, as the readers are not
+   thread-safe.  If Process() or Output() throws an exception (e.g. by
+   KALDI_ERR), no more items are read and no later items are output, and Run()
+   throws a std::runtime_error with the same message in the calling thread
+   once the items already started have finished; so it behaves like the
+   single-threaded case, where the exception would be thrown from Run()
+   directly.
+*/
+template<class InHolder, class OutType>
+class TablePipeline {
+ public:
+  typedef typename InHolder::T InType;
+
+  explicit TablePipeline(const TaskSequencerConfig &config):
+      config_(config), failed_(false) { }
+
+  /// Does the computation for one item, putting the result in "output";
+  /// returns false if it failed (in which case Output() will not be called).
+  /// This will be called from several threads at once if num_threads > 1.
+  virtual bool Process(const std::string &key, const InType &input,
+                       OutType *output) = 0;
+
+  /// This is called with the result of each successful call to Process(), in
+  /// the same order as the input, and from only one thread at a time.
+  virtual void Output(const std::string &key, const OutType &output) = 0;
+
+  /// Processes all the remaining items in "reader", and returns when they
+  /// have all been output.
+  void Run(SequentialTableReader<InHolder> *reader) {
+    if (config_.num_threads <= 1) {  // no need to copy the input.
+      for (; !reader->Done(); reader->Next()) {
+        OutType output;
+        if (Process(reader->Key(), reader->Value(), &output))
+          Output(reader->Key(), output);
+      }
+    } else {
+      {
+        TaskSequencer<Job> sequencer(config_);
+        for (; !reader->Done() && !Failed(); reader->Next()) {
+          Job *job = new Job(this, reader->Key(), reader->Value());
+          reader->FreeCurrent();
+          sequencer.Run(job);
+        }
+        sequencer.Wait();
+      }
+      if (failed_)  // All the jobs are done, so we don't need the lock.
+        throw std::runtime_error(error_);
+    }
+  }
+
+  virtual ~TablePipeline() { }
+
+ private:
+  // The class that TaskSequencer runs; its destructor does the output.
+  class Job {
+   public:
+    Job(TablePipeline *pipeline, const std::string &key, const InType &input):
+        pipeline_(pipeline), key_(key), input_(input), success_(false),
+        failed_(false) { }
+    // This runs in a worker thread, so we must not let exceptions escape.
+    void operator () () {
+      try {
+        success_ = pipeline_->Process(key_, input_, &output_);
+      } catch (const std::exception &e) {
+        error_ = e.what();
+        failed_ = true;
+      }
+    }
+    // The jobs are destroyed in order, so once one has failed, the later
+    // ones are not output.
+    ~Job() {
+      if (failed_) {
+        pipeline_->SetFailed(error_);
+      } else if (success_ && !pipeline_->Failed()) {
+        try {
+          pipeline_->Output(key_, output_);
+        } catch (const std::exception &e) {
+          pipeline_->SetFailed(e.what());
+        }
+      }
+    }
+   private:
+    TablePipeline *pipeline_;
+    std::string key_;
+    InType input_;
+    OutType output_;
+    bool success_;
+    bool failed_;  // true if Process() threw.
+    std::string error_;  // the message of the exception, if failed_.
+  };
+
+  bool Failed() {
+    mutex_.Lock();
+    bool ans = failed_;
+    mutex_.Unlock();
+    return ans;
+  }
+
+  // Records the message of the first exception thrown in a job.
+  void SetFailed(const std::string &error) {
+    mutex_.Lock();
+    if (!failed_) {
+      failed_ = true;
+      error_ = error;
+    }
+    mutex_.Unlock();
+  }
+
+  TaskSequencerConfig config_;
+  Mutex mutex_;  // protects failed_ and error_.
+  bool failed_;
+  std::string error_;
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_THREAD_KALDI_TABLE_PIPELINE_H_
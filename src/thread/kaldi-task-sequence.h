@@ -21,6 +21,7 @@
 #define KALDI_THREAD_KALDI_TASK_SEQUENCE_H_ 1
 
 #include <pthread.h>
+#include <deque>
 #include "thread/kaldi-thread.h"
 #include "itf/options-itf.h"
 #include "thread/kaldi-semaphore.h"
@@ -54,7 +55,12 @@ namespace kaldi {
    effects such as outputting data.
 
    Note: the destructor of TaskSequencer will wait for any remaining jobs that
-   are still running and will call the destructors.   
+   are still running and will call the destructors.
+
+   The jobs are run in the process-wide thread pool (see kaldi-thread-pool.h),
+   each in a thread of its own, so no threads are created or destroyed per
+   job.  The objects are deleted by whichever job's thread finds that they
+   are next in sequence and finished.
  */
 
 struct TaskSequencerConfig {
@@ -82,114 +88,100 @@ class TaskSequencer {
       threads_avail_(config.num_threads),
       tot_threads_avail_(config.num_threads_total > 0 ? config.num_threads_total :
                          config.num_threads + 20),
-      thread_list_(NULL) {
+      deleting_(false) {
     KALDI_ASSERT((config.num_threads_total <= 0 ||
                   config.num_threads_total >= config.num_threads) &&
                  "num-threads-total, if specified, must be >= num-threads");
+    if (pthread_mutex_init(&mutex_, NULL) != 0)
+      KALDI_ERR << "Cannot initialize pthread mutex";
   }
 
   /// This function takes ownership of the pointer "c", and will delete it
   /// in the same sequence as Run was called on the jobs.
   void Run(C *c) {
     threads_avail_.Wait(); // wait till we have a thread for computation free.
-    tot_threads_avail_.Wait(); // this ensures we don't have too many threads
-    // waiting on I/O, and consume too much memory.
-    
-    // put the new RunTaskArgsList object at head of the singly
-    // linked list thread_list_.
-    thread_list_ = new RunTaskArgsList(this, c, thread_list_);
-    int32 ret;
-    if ((ret=pthread_create(&(thread_list_->thread),
-                            NULL, // default attributes
-                            TaskSequencer<C>::RunTask,
-                            static_cast<void*>(thread_list_)))) {
-      const char *c = strerror(ret);
-      KALDI_ERR << "Error creating thread, errno was: " << (c ? c : "[NULL]");
-    }
+    tot_threads_avail_.Wait(); // this ensures we don't have too many jobs
+    // waiting to be deleted, and consume too much memory.
+
+    RunTaskArgs *args = new RunTaskArgs(this, c);
+    pthread_mutex_lock(&mutex_);
+    pending_.push_back(args);
+    pthread_mutex_unlock(&mutex_);
+    group_.RunDedicated(TaskSequencer<C>::RunTask, args);
   }
 
   void Wait() { // You call this at the end if it's more convenient
     // than waiting for the destructor.  It waits for all tasks to finish.
-    if (thread_list_ != NULL) {
-      int ret = pthread_join(thread_list_->thread, NULL);
-      if (ret != 0) {
-        const char *c = strerror(ret);
-        KALDI_ERR << "Error joining thread, errno was: " << (c ? c : "[NULL]");
-      }
-      KALDI_ASSERT(thread_list_->tail == NULL); // thread would not
-      // have exited without setting tail to NULL.
-      delete thread_list_;
-      thread_list_ = NULL;
-    }
+    group_.Wait();
+    KALDI_ASSERT(pending_.empty()); // the last job to finish would have
+    // deleted all of them.
   }
-  
-  /// The destructor waits for the last thread to exit.
+
+  /// The destructor waits for the last job to finish.
   ~TaskSequencer() {
-    Wait();      
+    Wait();
+    pthread_mutex_destroy(&mutex_);
   }
  private:
-  struct RunTaskArgsList {
+  struct RunTaskArgs {
     TaskSequencer *me; // Think of this as a "this" pointer.
-    C *c; // Clist element of the task we're expected
-    pthread_t thread;
-    RunTaskArgsList *tail;
-    RunTaskArgsList(TaskSequencer *me, C *c, RunTaskArgsList *tail):
-        me(me), c(c), tail(tail) {}
+    C *c; // the job.
+    bool done; // true once c's operator () has returned.
+    RunTaskArgs(TaskSequencer *me, C *c): me(me), c(c), done(false) {}
   };
-  // This static function gets run in the threads that we create.
+  // This static function gets run in the pool's threads.
   static void* RunTask(void *input) {
-    RunTaskArgsList *args = static_cast<RunTaskArgsList*>(input);
-    
+    RunTaskArgs *args = static_cast<RunTaskArgs*>(input);
+
     // (1) run the job.
     (*(args->c))(); // call operator () on args->c, which does the computation.
     args->me->threads_avail_.Signal(); // Signal that the compute-intensive
-    // part of the thread is done (we want to run no more than
+    // part of the job is done (we want to run no more than
     // config_.num_threads of these.)
-    
-    // (2) we want to destroy the object "c" now, by deleting it.  But for
-    //     correct sequencing (this is the whole point of this class, it
-    //     is intended to ensure the output of the program is in correct order),
-    //     we first wait till the previous thread, whose details will be in "tail",
-    //     is finished.
-    if (args->tail != NULL) {
-      int ret = pthread_join(args->tail->thread, NULL);
-      if (ret != 0) {
-        const char *c = strerror(ret);
-        KALDI_ERR << "Error joining thread, errno was: " << (c ? c : "[NULL]");
-      }
-    }
 
-    delete args->c; // delete the object "c".  This may cause some output,
-    // e.g. to a stream.  We don't need to worry about concurrent access to
-    // the output stream, because each thread waits for the previous thread
-    // to be done, before doing this.  So there is no risk of concurrent
-    // access.
-    args->c = NULL;
-    
-    if (args->tail != NULL) {
-      KALDI_ASSERT(args->tail->tail == NULL); // Because we already
-      // did pthread_join on args->tail->thread, which means that
-      // thread was done, and before it exited, it would have
-      // deleted and set to NULL its tail (which is the next line of code).
-      delete args->tail;
-      args->tail = NULL;
-    }
-    // At this point we are exiting from the thread.  Signal the
-    // "tot_threads_avail_" semaphore which is used to limit the total number of threads that are alive, including
-    // not onlhy those that are in active computation in c->operator (), but those
-    // that are waiting on I/O or other threads.
-    args->me->tot_threads_avail_.Signal();
-    // .. and exit the thread, by returning. 
+    // (2) delete the finished jobs that are next in sequence.
+    args->me->JobDone(args);
     return NULL;
   }
 
+  // Marks this job as done, and deletes, in order, the jobs at the front of
+  // pending_ that are done, unless another thread is already doing so.
+  void JobDone(RunTaskArgs *args) {
+    pthread_mutex_lock(&mutex_);
+    args->done = true;
+    if (!deleting_) {
+      deleting_ = true;
+      while (!pending_.empty() && pending_.front()->done) {
+        RunTaskArgs *front = pending_.front();
+        pending_.pop_front();
+        pthread_mutex_unlock(&mutex_);
+        delete front->c; // delete the object "c".  This may cause some
+        // output, e.g. to a stream.  We don't need to worry about concurrent
+        // access to the output stream, because only one thread at a time
+        // deletes objects (the one that set deleting_ to true).
+        delete front;
+        // Signal the "tot_threads_avail_" semaphore which is used to limit
+        // the total number of jobs that are alive, including not only those
+        // that are in active computation in c->operator (), but those that
+        // are waiting for earlier jobs to finish.
+        tot_threads_avail_.Signal();
+        pthread_mutex_lock(&mutex_);
+      }
+      deleting_ = false;
+    }
+    pthread_mutex_unlock(&mutex_);
+  }
+
   Semaphore threads_avail_; // Initialized to the number of threads we are
   // supposed to run with; the function Run() waits on this.
 
   Semaphore tot_threads_avail_; // We use this semaphore to ensure we don't
   // consume too much memory...
-  RunTaskArgsList *thread_list_; 
-  
+
+  pthread_mutex_t mutex_; // protects pending_ and deleting_.
+  std::deque<RunTaskArgs*> pending_; // the jobs not yet deleted, in order.
+  bool deleting_; // true while some thread is deleting jobs.
+  TaskGroup group_;
 };
 
 } // namespace kaldi
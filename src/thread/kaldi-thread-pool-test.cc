@@ -0,0 +1,179 @@
+// thread/kaldi-thread-pool-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "thread/kaldi-thread.h"
+#include "thread/kaldi-thread-pool.h"
+#include "thread/kaldi-mutex.h"
+
+namespace kaldi {
+
+// Adds up the integers in a range into a total, protected by a mutex.
+class SumRange {
+ public:
+  SumRange(Mutex *mutex, int64 *total): mutex_(mutex), total_(total) { }
+  void operator() (int32 begin, int32 end) const {
+    int64 sum = 0;
+    for (int32 i = begin; i < end; i++)
+      sum += i;
+    mutex_->Lock();
+    *total_ += sum;
+    mutex_->Unlock();
+  }
+ private:
+  Mutex *mutex_;
+  int64 *total_;
+};
+
+void TestParallelFor() {
+  for (int32 n = 0; n < 20; n++) {
+    int32 begin = Rand() % 100, end = begin + Rand() % 10000,
+        chunk_size = 1 + Rand() % 200;
+    Mutex mutex;
+    int64 total = 0;
+    ParallelFor(begin, end, chunk_size, SumRange(&mutex, &total));
+    int64 expected = 0;
+    for (int32 i = begin; i < end; i++)
+      expected += i;
+    KALDI_ASSERT(total == expected);
+  }
+}
+
+// Each element does a ParallelFor of its own; this tests that nested use of
+// the pool works.
+class NestedSum {
+ public:
+  NestedSum(Mutex *mutex, int64 *total): mutex_(mutex), total_(total) { }
+  void operator() (int32 begin, int32 end) const {
+    for (int32 i = begin; i < end; i++)
+      ParallelFor(0, i, 7, SumRange(mutex_, total_));
+  }
+ private:
+  Mutex *mutex_;
+  int64 *total_;
+};
+
+void TestNestedParallelFor() {
+  Mutex mutex;
+  int64 total = 0;
+  int32 n = 200;
+  ParallelFor(0, n, 3, NestedSum(&mutex, &total));
+  int64 expected = 0;
+  for (int32 i = 0; i < n; i++)
+    expected += static_cast<int64>(i) * (i - 1) / 2;
+  KALDI_ASSERT(total == expected);
+}
+
+// Tasks run with RunDedicated() must all run at the same time; this would
+// deadlock otherwise.
+struct BarrierTask {
+  Barrier *barrier;
+  static void *Run(void *arg) {
+    BarrierTask *task = static_cast<BarrierTask*>(arg);
+    for (int32 i = 0; i < 3; i++)
+      task->barrier->Wait();
+    return NULL;
+  }
+};
+
+void TestDedicated() {
+  ThreadPool pool(2);
+  for (int32 n = 0; n < 5; n++) {
+    int32 num_tasks = 1 + Rand() % 10;
+    Barrier barrier(num_tasks);
+    BarrierTask task;
+    task.barrier = &barrier;
+    TaskGroup group(&pool);
+    for (int32 i = 0; i < num_tasks; i++)
+      group.RunDedicated(BarrierTask::Run, &task);
+    group.Wait();
+    KALDI_ASSERT(group.NumPending() == 0);
+    KALDI_ASSERT(pool.NumThreads() >= num_tasks);
+  }
+}
+
+// A task that does a small amount of work, for the speed comparison.
+struct SmallTask {
+  int32 num_iters;
+  double result;
+  static void *Run(void *arg) {
+    SmallTask *task = static_cast<SmallTask*>(arg);
+    double sum = 0.0;
+    for (int32 i = 0; i < task->num_iters; i++)
+      sum += i * 0.5;
+    task->result = sum;
+    return NULL;
+  }
+};
+
+// Compares the time taken to run many small tasks by creating a thread for
+// each of them (as MultiThreader used to do), and by using the thread pool.
+void TestSpeed() {
+  int32 num_threads = 4, num_rounds = 500;
+  std::vector<SmallTask> tasks(num_threads);
+  for (int32 t = 0; t < num_threads; t++)
+    tasks[t].num_iters = 1000;
+
+  Timer timer;
+  std::vector<pthread_t> threads(num_threads);
+  for (int32 r = 0; r < num_rounds; r++) {
+    for (int32 t = 0; t < num_threads; t++)
+      if (pthread_create(&(threads[t]), NULL, SmallTask::Run, &(tasks[t])))
+        KALDI_ERR << "Error creating thread";
+    for (int32 t = 0; t < num_threads; t++)
+      if (pthread_join(threads[t], NULL))
+        KALDI_ERR << "Error joining thread";
+  }
+  double pthread_time = timer.Elapsed();
+
+  timer.Reset();
+  for (int32 r = 0; r < num_rounds; r++) {
+    TaskGroup group;
+    for (int32 t = 0; t < num_threads; t++)
+      group.RunDedicated(SmallTask::Run, &(tasks[t]));
+  }
+  double dedicated_time = timer.Elapsed();
+
+  timer.Reset();
+  for (int32 r = 0; r < num_rounds; r++) {
+    TaskGroup group;
+    for (int32 t = 0; t < num_threads; t++)
+      group.Run(SmallTask::Run, &(tasks[t]));
+  }
+  double queued_time = timer.Elapsed();
+
+  int32 num_tasks = num_threads * num_rounds;
+  KALDI_LOG << "Per-task overhead: pthread_create/join: "
+            << (1.0e+06 * pthread_time / num_tasks) << " us; thread pool "
+            << "(dedicated): " << (1.0e+06 * dedicated_time / num_tasks)
+            << " us; thread pool (queued): "
+            << (1.0e+06 * queued_time / num_tasks) << " us.";
+}
+
+}  // end namespace kaldi.
+
+int main() {
+  using namespace kaldi;
+  TestParallelFor();
+  TestNestedParallelFor();
+  TestDedicated();
+  TestSpeed();
+  KALDI_LOG << "Test OK.";
+}
@@ -0,0 +1,295 @@
+// thread/kaldi-thread-pool.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include "base/kaldi-common.h"
+#include "thread/kaldi-thread.h"
+#include "thread/kaldi-thread-pool.h"
+
+namespace kaldi {
+
+// We reserve space for this many workers, so that workers_ never gets
+// reallocated, which lets threads read its elements without holding mutex_.
+static const size_t kMaxWorkers = 4096;
+
+ThreadPool::ThreadPool(int32 num_threads): num_queued_(0), next_queue_(0),
+                                           stop_(false) {
+  KALDI_ASSERT(num_threads >= 0);
+  if (pthread_mutex_init(&mutex_, NULL) != 0)
+    KALDI_ERR << "Cannot initialize pthread mutex";
+  if (pthread_key_create(&worker_key_, NULL) != 0)
+    KALDI_ERR << "Cannot create pthread key";
+  workers_.reserve(kMaxWorkers);
+  pthread_mutex_lock(&mutex_);
+  for (int32 i = 0; i < num_threads; i++)
+    AddWorker();
+  pthread_mutex_unlock(&mutex_);
+}
+
+static ThreadPool *global_thread_pool = NULL;
+static pthread_once_t global_thread_pool_once = PTHREAD_ONCE_INIT;
+
+static void CreateGlobalThreadPool() {
+  global_thread_pool = new ThreadPool(std::max<int32>(1, g_num_threads));
+}
+
+ThreadPool *ThreadPool::Instance() {
+  pthread_once(&global_thread_pool_once, CreateGlobalThreadPool);
+  return global_thread_pool;
+}
+
+int32 ThreadPool::NumThreads() {
+  pthread_mutex_lock(&mutex_);
+  int32 ans = workers_.size();
+  pthread_mutex_unlock(&mutex_);
+  return ans;
+}
+
+ThreadPool::Worker *ThreadPool::AddWorker() {
+  if (workers_.size() == kMaxWorkers)
+    KALDI_ERR << "Too many threads in thread pool (" << kMaxWorkers << ")";
+  Worker *w = new Worker();
+  w->pool = this;
+  w->idle = false;
+  w->has_dedicated = false;
+  if (pthread_cond_init(&(w->cond), NULL) != 0 ||
+      pthread_mutex_init(&(w->queue_mutex), NULL) != 0)
+    KALDI_ERR << "Cannot initialize pthread mutex or condition variable";
+  workers_.push_back(w);
+  int32 ret;
+  if ((ret = pthread_create(&(w->thread), NULL, WorkerMain, w)) != 0) {
+    const char *c = strerror(ret);
+    KALDI_ERR << "Error creating thread, errno was: " << (c ? c : "[NULL]");
+  }
+  return w;
+}
+
+ThreadPool::Worker *ThreadPool::CurrentWorker() {
+  return static_cast<Worker*>(pthread_getspecific(worker_key_));
+}
+
+void ThreadPool::Submit(const Task &task) {
+  Worker *self = CurrentWorker();
+  pthread_mutex_lock(&mutex_);
+  if (workers_.empty())
+    AddWorker();
+  // A worker puts tasks in its own queue, so they are likely to be run by the
+  // same thread, which is good for memory locality; other threads distribute
+  // them in round-robin fashion.
+  Worker *w = self;
+  if (w == NULL)
+    w = workers_[next_queue_++ % workers_.size()];
+  pthread_mutex_lock(&(w->queue_mutex));
+  w->queue.push_back(task);
+  pthread_mutex_unlock(&(w->queue_mutex));
+  num_queued_++;
+  if (!idle_.empty()) {  // wake up an idle worker.
+    Worker *i = idle_.back();
+    idle_.pop_back();
+    i->idle = false;
+    pthread_cond_signal(&(i->cond));
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+void ThreadPool::SubmitDedicated(const Task &task) {
+  pthread_mutex_lock(&mutex_);
+  Worker *w;
+  if (!idle_.empty()) {
+    w = idle_.back();
+    idle_.pop_back();
+    w->idle = false;
+    pthread_cond_signal(&(w->cond));
+  } else {
+    w = AddWorker();  // it won't start running until we release mutex_.
+  }
+  w->dedicated = task;
+  w->has_dedicated = true;
+  pthread_mutex_unlock(&mutex_);
+}
+
+ThreadPool::Task ThreadPool::TakeQueuedTask(Worker *self) {
+  // The caller has reserved a task, so one of the queues has a task for us,
+  // but we may have to look at more than one queue to find it.
+  while (true) {
+    if (self != NULL) {  // Take the most recent task from our own queue.
+      pthread_mutex_lock(&(self->queue_mutex));
+      if (!self->queue.empty()) {
+        Task task = self->queue.back();
+        self->queue.pop_back();
+        pthread_mutex_unlock(&(self->queue_mutex));
+        return task;
+      }
+      pthread_mutex_unlock(&(self->queue_mutex));
+    }
+    pthread_mutex_lock(&mutex_);
+    size_t num_workers = workers_.size(), start = next_queue_++;
+    pthread_mutex_unlock(&mutex_);
+    // Steal the oldest task from another queue.
+    for (size_t i = 0; i < num_workers; i++) {
+      Worker *w = workers_[(start + i) % num_workers];
+      if (w == self) continue;
+      pthread_mutex_lock(&(w->queue_mutex));
+      if (!w->queue.empty()) {
+        Task task = w->queue.front();
+        w->queue.pop_front();
+        pthread_mutex_unlock(&(w->queue_mutex));
+        return task;
+      }
+      pthread_mutex_unlock(&(w->queue_mutex));
+    }
+  }
+}
+
+bool ThreadPool::RunQueuedTask() {
+  pthread_mutex_lock(&mutex_);
+  if (num_queued_ == 0) {
+    pthread_mutex_unlock(&mutex_);
+    return false;
+  }
+  num_queued_--;
+  pthread_mutex_unlock(&mutex_);
+  RunTask(TakeQueuedTask(CurrentWorker()));
+  return true;
+}
+
+void ThreadPool::RunTask(const Task &task) {
+  task.func(task.arg);
+  task.group->TaskDone();
+}
+
+void *ThreadPool::WorkerMain(void *worker) {
+  Worker *w = static_cast<Worker*>(worker);
+  w->pool->WorkerLoop(w);
+  return NULL;
+}
+
+void ThreadPool::WorkerLoop(Worker *w) {
+  pthread_setspecific(worker_key_, w);
+  pthread_mutex_lock(&mutex_);
+  while (true) {
+    if (w->has_dedicated) {
+      Task task = w->dedicated;
+      w->has_dedicated = false;
+      pthread_mutex_unlock(&mutex_);
+      RunTask(task);
+      pthread_mutex_lock(&mutex_);
+    } else if (num_queued_ > 0) {
+      num_queued_--;  // reserve a task.
+      pthread_mutex_unlock(&mutex_);
+      RunTask(TakeQueuedTask(w));
+      pthread_mutex_lock(&mutex_);
+    } else if (stop_) {
+      break;
+    } else {
+      w->idle = true;
+      idle_.push_back(w);
+      // Whoever gives us something to do will remove us from idle_ and set
+      // w->idle to false.
+      while (w->idle)
+        pthread_cond_wait(&(w->cond), &mutex_);
+    }
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+ThreadPool::~ThreadPool() {
+  pthread_mutex_lock(&mutex_);
+  stop_ = true;
+  for (size_t i = 0; i < idle_.size(); i++) {
+    idle_[i]->idle = false;
+    pthread_cond_signal(&(idle_[i]->cond));
+  }
+  idle_.clear();
+  pthread_mutex_unlock(&mutex_);
+  // No new workers can be added now, unless a task that is still running
+  // submits a dedicated task, which would be a usage error.
+  for (size_t i = 0; i < workers_.size(); i++) {
+    Worker *w = workers_[i];
+    if (pthread_join(w->thread, NULL) != 0)
+      KALDI_ERR << "Error rejoining thread.";
+    pthread_cond_destroy(&(w->cond));
+    pthread_mutex_destroy(&(w->queue_mutex));
+    delete w;
+  }
+  pthread_key_delete(worker_key_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+
+TaskGroup::TaskGroup(ThreadPool *pool): pool_(pool), num_pending_(0) {
+  if (pthread_mutex_init(&mutex_, NULL) != 0)
+    KALDI_ERR << "Cannot initialize pthread mutex";
+  if (pthread_cond_init(&cond_, NULL) != 0)
+    KALDI_ERR << "Cannot initialize pthread conditional variable";
+}
+
+void TaskGroup::Run(void *(*func)(void*), void *arg) {
+  // We don't get the global pool until we need it, so that code that never
+  // actually runs anything in parallel doesn't create the threads.
+  if (pool_ == NULL) pool_ = ThreadPool::Instance();
+  pthread_mutex_lock(&mutex_);
+  num_pending_++;
+  pthread_mutex_unlock(&mutex_);
+  pool_->Submit(ThreadPool::Task(func, arg, this));
+}
+
+void TaskGroup::RunDedicated(void *(*func)(void*), void *arg) {
+  if (pool_ == NULL) pool_ = ThreadPool::Instance();
+  pthread_mutex_lock(&mutex_);
+  num_pending_++;
+  pthread_mutex_unlock(&mutex_);
+  pool_->SubmitDedicated(ThreadPool::Task(func, arg, this));
+}
+
+int32 TaskGroup::NumPending() {
+  pthread_mutex_lock(&mutex_);
+  int32 ans = num_pending_;
+  pthread_mutex_unlock(&mutex_);
+  return ans;
+}
+
+void TaskGroup::Wait() {
+  while (NumPending() != 0) {
+    // Rather than just waiting, help to run queued tasks (which may include
+    // our own).  This also means that a task may use ParallelFor() without
+    // tying up the thread it is running in.
+    if (pool_->RunQueuedTask()) continue;
+    pthread_mutex_lock(&mutex_);
+    if (num_pending_ != 0)
+      pthread_cond_wait(&cond_, &mutex_);
+    pthread_mutex_unlock(&mutex_);
+  }
+}
+
+void TaskGroup::TaskDone() {
+  pthread_mutex_lock(&mutex_);
+  num_pending_--;
+  if (num_pending_ == 0)
+    pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+TaskGroup::~TaskGroup() {
+  Wait();
+  pthread_mutex_destroy(&mutex_);
+  pthread_cond_destroy(&cond_);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,227 @@
+// thread/kaldi-thread-pool.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_THREAD_KALDI_THREAD_POOL_H_
+#define KALDI_THREAD_KALDI_THREAD_POOL_H_ 1
+
+#include <pthread.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include "base/kaldi-common.h"
+
+/**
+   This header provides a pool of persistent threads, which avoids the cost of
+   creating and joining a pthread every time we want to run something in
+   parallel.  MultiThreader / RunMultiThreaded (see kaldi-thread.h) and
+   TaskSequencer (see kaldi-task-sequence.h) are implemented on top of it, so
+   most code won't need to use it directly.
+
+   Tasks are given to the pool in the same form as to pthread_create(): a
+   function taking a void* argument, and the argument.  Each task belongs to a
+   TaskGroup, which you can Wait() on (so a TaskGroup with one task acts as a
+   "future").  There are two ways to run a task:
+
+     - TaskGroup::Run() puts the task in a queue.  Each thread of the pool has
+       its own queue: tasks submitted from a pool thread go to its own queue,
+       which it processes last-in first-out, and idle threads take (steal)
+       tasks from the other end of the other threads' queues.  Tasks run this
+       way must not block waiting for other tasks, as there is no guarantee
+       they will run concurrently.  This is what ParallelFor() uses.
+
+     - TaskGroup::RunDedicated() gives the task its own thread, taking an idle
+       thread from the pool or adding a new thread to the pool if none is
+       idle.  Tasks run this way are guaranteed to run concurrently with each
+       other, so they may wait for each other (e.g. using a Barrier).  This is
+       what MultiThreader uses, since some of its users depend on this.
+
+   TaskGroup::Wait() runs queued tasks while it is waiting, so it's OK to call
+   ParallelFor() from inside a task.
+*/
+
+namespace kaldi {
+
+class TaskGroup;
+
+class ThreadPool {
+ public:
+  /// Creates a pool with "num_threads" threads to start with (it may grow
+  /// later; see TaskGroup::RunDedicated()).  Normally you will use the
+  /// process-wide pool returned by Instance() instead of creating your own.
+  explicit ThreadPool(int32 num_threads);
+
+  /// Returns the process-wide pool, creating it with g_num_threads threads
+  /// the first time it is called.  It is never destroyed.
+  static ThreadPool *Instance();
+
+  /// Returns the current number of threads in the pool.
+  int32 NumThreads();
+
+  /// Waits for the threads to finish any tasks that are running or queued,
+  /// and terminates them.
+  ~ThreadPool();
+
+ private:
+  friend class TaskGroup;
+
+  struct Task {
+    void *(*func)(void*);
+    void *arg;
+    TaskGroup *group;
+    Task(): func(NULL), arg(NULL), group(NULL) { }
+    Task(void *(*func)(void*), void *arg, TaskGroup *group):
+        func(func), arg(arg), group(group) { }
+  };
+
+  struct Worker {
+    ThreadPool *pool;
+    pthread_t thread;
+    pthread_cond_t cond;  // signaled when this worker is given work.
+    bool idle;  // true if waiting on "cond" and in pool->idle_.
+    bool has_dedicated;  // true if "dedicated" is a task to run.
+    Task dedicated;
+    pthread_mutex_t queue_mutex;  // protects "queue".
+    std::deque<Task> queue;
+  };
+
+  // Adds the task to a queue.
+  void Submit(const Task &task);
+
+  // Runs the task in an idle thread, or a new thread.
+  void SubmitDedicated(const Task &task);
+
+  // If there is a queued task, runs it in this thread and returns true;
+  // otherwise returns false.
+  bool RunQueuedTask();
+
+  // Removes a task from the queues; the caller must have "reserved" it by
+  // decrementing num_queued_.  "self" is the calling worker, or NULL.
+  Task TakeQueuedTask(Worker *self);
+
+  static void RunTask(const Task &task);
+
+  // Creates a worker and starts its thread; requires mutex_ to be held.
+  Worker *AddWorker();
+
+  // Returns the worker that is the current thread, or NULL if the current
+  // thread is not part of this pool.
+  Worker *CurrentWorker();
+
+  static void *WorkerMain(void *worker);
+  void WorkerLoop(Worker *w);
+
+  pthread_mutex_t mutex_;  // protects everything below.
+  std::vector<Worker*> workers_;
+  std::vector<Worker*> idle_;  // workers waiting for something to do.
+  int32 num_queued_;  // number of tasks in the queues and not yet reserved.
+  size_t next_queue_;  // for choosing a queue in round-robin fashion.
+  bool stop_;
+  pthread_key_t worker_key_;  // thread-specific data: the Worker, if any.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+
+/// A TaskGroup is a set of tasks run by a ThreadPool, whose completion you can
+/// wait for.  See the comment at the top of this file.
+class TaskGroup {
+ public:
+  /// If "pool" is NULL, uses ThreadPool::Instance().
+  explicit TaskGroup(ThreadPool *pool = NULL);
+
+  /// Queues the task func(arg).  It must not block waiting for other tasks.
+  void Run(void *(*func)(void*), void *arg);
+
+  /// Runs the task func(arg) in a thread of its own.
+  void RunDedicated(void *(*func)(void*), void *arg);
+
+  /// Waits until all tasks run in this group have finished.  While waiting,
+  /// this thread helps to run queued tasks.
+  void Wait();
+
+  /// Returns the number of tasks that have not yet finished.
+  int32 NumPending();
+
+  /// The destructor calls Wait().
+  ~TaskGroup();
+
+ private:
+  friend class ThreadPool;
+  void TaskDone();
+
+  ThreadPool *pool_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+  int32 num_pending_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(TaskGroup);
+};
+
+
+/// Calls c(i, j) for consecutive ranges [i, j) of at most "chunk_size"
+/// integers that together cover [begin, end), in parallel using the
+/// process-wide thread pool, and returns when they have all been processed.
+/// C must have an operator () (int32, int32) const that is safe to call from
+/// several threads at once.
+template<class C>
+void ParallelFor(int32 begin, int32 end, int32 chunk_size, const C &c);
+
+
+// Implementation of ParallelFor().
+namespace internal {
+template<class C> struct ParallelForChunk {
+  const C *c;
+  int32 begin;
+  int32 end;
+  static void *Run(void *arg) {
+    ParallelForChunk *chunk = static_cast<ParallelForChunk*>(arg);
+    (*(chunk->c))(chunk->begin, chunk->end);
+    return NULL;
+  }
+};
+}  // namespace internal
+
+template<class C>
+void ParallelFor(int32 begin, int32 end, int32 chunk_size, const C &c) {
+  KALDI_ASSERT(chunk_size > 0);
+  if (end <= begin) return;
+  if (end - begin <= chunk_size) {  // no point using other threads.
+    c(begin, end);
+    return;
+  }
+  std::vector<internal::ParallelForChunk<C> > chunks;
+  chunks.reserve((end - begin + chunk_size - 1) / chunk_size);
+  for (int32 i = begin; i < end; i += chunk_size) {
+    internal::ParallelForChunk<C> chunk;
+    chunk.c = &c;
+    chunk.begin = i;
+    chunk.end = std::min(end, i + chunk_size);
+    chunks.push_back(chunk);
+  }
+  TaskGroup group;
+  // We run the first chunk in this thread, after queueing the others.
+  for (size_t i = 1; i < chunks.size(); i++)
+    group.Run(internal::ParallelForChunk<C>::Run, &(chunks[i]));
+  internal::ParallelForChunk<C>::Run(&(chunks[0]));
+  group.Wait();
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_THREAD_KALDI_THREAD_POOL_H_
@@ -0,0 +1,157 @@
+// util/flat-hash-list-inl.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_FLAT_HASH_LIST_INL_H_
+#define KALDI_UTIL_FLAT_HASH_LIST_INL_H_
+
+// Do not include this file directly.  It is included by flat-hash-list.h
+
+
+namespace kaldi {
+
+template<class I, class T> FlatHashList<I, T>::FlatHashList():
+    generation_(1), num_elems_(0), list_head_(NULL), list_tail_(NULL),
+    cur_arena_(0) {
+  Rehash(16);  // just so we start with something reasonable.
+}
+
+template<class I, class T> void FlatHashList<I, T>::SetSize(size_t size) {
+  KALDI_ASSERT(list_head_ == NULL);  // make sure empty.
+  size_t num_slots = 1;
+  while (num_slots < size) num_slots *= 2;
+  if (num_slots > slots_.size())
+    Rehash(num_slots);
+}
+
+template<class I, class T>
+void FlatHashList<I, T>::Rehash(size_t num_slots) {
+  KALDI_ASSERT(num_slots <= (static_cast<size_t>(1) << 31));
+  Slot empty_slot;
+  empty_slot.generation = 0;
+  empty_slot.elem = NULL;
+  slots_.clear();
+  slots_.resize(num_slots, empty_slot);
+  mask_ = num_slots - 1;
+  shift_ = 32;
+  for (size_t n = num_slots; n > 1; n /= 2) shift_--;
+  for (Elem *e = list_head_; e != NULL; e = e->tail) {
+    size_t index = HashIndex(e->key);
+    while (slots_[index].generation == generation_)
+      index = (index + 1) & mask_;
+    Slot &slot = slots_[index];
+    slot.key = e->key;
+    slot.generation = generation_;
+    slot.elem = e;
+  }
+}
+
+template<class I, class T>
+typename FlatHashList<I, T>::Elem* FlatHashList<I, T>::Clear() {
+  Arena &other = arenas_[1 - cur_arena_];
+  if (other.num_live != 0)
+    KALDI_ERR << "FlatHashList: you must call Delete() for all elements "
+              << "returned by Clear() before calling Clear() again.";
+  other.num_used = 0;
+  // The current arena becomes the one holding the list we hand out.
+  cur_arena_ = 1 - cur_arena_;
+
+  generation_++;
+  if (generation_ == 0) {  // wrapped around; very rare.
+    for (size_t i = 0; i < slots_.size(); i++)
+      slots_[i].generation = 0;
+    generation_ = 1;
+  }
+  Elem *ans = list_head_;
+  list_head_ = list_tail_ = NULL;
+  num_elems_ = 0;
+  return ans;
+}
+
+template<class I, class T>
+inline void FlatHashList<I, T>::Delete(Elem *e) {
+  Arena &other = arenas_[1 - cur_arena_];
+  KALDI_PARANOID_ASSERT(other.num_live > 0);
+  other.num_live--;
+}
+
+template<class I, class T>
+inline typename FlatHashList<I, T>::Elem* FlatHashList<I, T>::Find(I key) {
+  size_t index = HashIndex(key);
+  while (true) {
+    const Slot &slot = slots_[index];
+    if (slot.generation != generation_) return NULL;  // empty slot.
+    if (slot.key == key) return slot.elem;
+    index = (index + 1) & mask_;
+  }
+}
+
+template<class I, class T>
+inline typename FlatHashList<I, T>::Elem* FlatHashList<I, T>::NewElem() {
+  Arena &arena = arenas_[cur_arena_];
+  size_t block = arena.num_used / kBlockSize,
+      offset = arena.num_used % kBlockSize;
+  if (block == arena.blocks.size())
+    arena.blocks.push_back(new Elem[kBlockSize]);
+  arena.num_used++;
+  arena.num_live++;
+  return arena.blocks[block] + offset;
+}
+
+template<class I, class T>
+inline void FlatHashList<I, T>::Insert(I key, T val) {
+  if (2 * (num_elems_ + 1) > slots_.size())  // keep the load factor <= 0.5.
+    Rehash(2 * slots_.size());
+  Elem *elem = NewElem();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = NULL;
+  if (list_tail_ != NULL) list_tail_->tail = elem;
+  else list_head_ = elem;
+  list_tail_ = elem;
+  num_elems_++;
+
+  size_t index = HashIndex(key);
+  while (slots_[index].generation == generation_)
+    index = (index + 1) & mask_;
+  Slot &slot = slots_[index];
+  slot.key = key;
+  slot.generation = generation_;
+  slot.elem = elem;
+}
+
+template<class I, class T>
+FlatHashList<I, T>::~FlatHashList() {
+  // As in HashList, check whether the user forgot to call Delete() for
+  // some elements.  Elements in the current list are not counted, as the
+  // decoders don't necessarily Clear() the list before destruction.
+  size_t num_undeleted = arenas_[1 - cur_arena_].num_live;
+  if (num_undeleted != 0) {
+    KALDI_WARN << "Possible memory leak: " << num_undeleted
+               << " elements were not deleted: you might have forgotten "
+               << "to call Delete on some Elems";
+  }
+  for (int32 a = 0; a < 2; a++)
+    for (size_t i = 0; i < arenas_[a].blocks.size(); i++)
+      delete [] arenas_[a].blocks[i];
+}
+
+
+} // end namespace kaldi
+
+#endif  // KALDI_UTIL_FLAT_HASH_LIST_INL_H_
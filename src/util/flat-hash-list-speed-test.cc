@@ -0,0 +1,110 @@
+// util/flat-hash-list-speed-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/flat-hash-list.h"
+#include "util/hash-list.h"
+#include "base/timer.h"
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace kaldi {
+
+// This is a rough imitation of how the decoders use the hash: on each "frame"
+// we take the list of the previous frame's tokens, and for each of them
+// Find() or Insert() a few successor states out of a large state space, then
+// Delete() the old element.  Returns a checksum so the work can't be
+// optimized away.
+template<template<class, class> class HashListType>
+double DecoderLikeWorkload(int32 num_frames, int32 num_active,
+                           int32 num_states, double *checksum) {
+  typedef typename HashListType<int32, float>::Elem Elem;
+  srand(0);
+  std::vector<int32> succ(num_states * 4);
+  for (size_t i = 0; i < succ.size(); i++)
+    succ[i] = Rand() % num_states;
+
+  HashListType<int32, float> hash;
+  hash.SetSize(num_active * 2);
+  for (int32 i = 0; i < num_active; i++) {
+    int32 s = Rand() % num_states;
+    if (hash.Find(s) == NULL) hash.Insert(s, 0.0);
+  }
+  Timer timer;
+  double sum = 0.0;
+  for (int32 f = 0; f < num_frames; f++) {
+    Elem *h = hash.Clear(), *tmp;
+    // A first pass over the list, like the decoders' GetCutoff().
+    int32 n = 0;
+    for (const Elem *e = h; e != NULL; e = e->tail) n++;
+    if (n == 0) break;  // no tokens survived, so nothing more to do.
+    // Expand about num_active of the n elements, choosing them by key so that
+    // the result doesn't depend on the order of the list.
+    uint32 threshold = static_cast<uint32>(1000.0 * num_active / n);
+    for (; h != NULL; h = tmp) {
+      tmp = h->tail;
+      if ((static_cast<uint32>(h->key) * 2654435761U) % 1000 < threshold) {
+        for (int32 a = 0; a < 4; a++) {
+          int32 next = succ[4 * h->key + a];
+          float cost = h->val + 0.001 * a;
+          Elem *e = hash.Find(next);
+          if (e == NULL) hash.Insert(next, cost);
+          else if (e->val > cost) e->val = cost;
+        }
+      }
+      sum += h->val;
+      hash.Delete(h);
+    }
+  }
+  Elem *h = hash.Clear(), *tmp;
+  for (; h != NULL; h = tmp) {
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+  *checksum = sum;
+  return timer.Elapsed();
+}
+
+void TestFlatHashListSpeed() {
+  int32 num_frames = 100, num_states = 1000000;
+  for (int32 num_active = 1000; num_active <= 30000; num_active *= 5) {
+    double sum1, sum2;
+    double t1 = DecoderLikeWorkload<HashList>(num_frames, num_active,
+                                              num_states, &sum1),
+        t2 = DecoderLikeWorkload<FlatHashList>(num_frames, num_active,
+                                               num_states, &sum2);
+    // Both should have done exactly the same computation.
+    KALDI_ASSERT(ApproxEqual(sum1, sum2));
+    KALDI_LOG << "For " << num_active << " active states, HashList took "
+              << t1 << " seconds, FlatHashList took " << t2
+              << " seconds; speedup is " << (t1 / t2);
+  }
+}
+
+
+} // end namespace kaldi
+
+
+
+int main() {
+  using namespace kaldi;
+  TestFlatHashListSpeed();
+  std::cout << "Test OK.\n";
+}
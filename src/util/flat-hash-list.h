@@ -0,0 +1,150 @@
+// util/flat-hash-list.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_FLAT_HASH_LIST_H_
+#define KALDI_UTIL_FLAT_HASH_LIST_H_
+#include <vector>
+#include "base/kaldi-common.h"
+
+
+/* FlatHashList is a drop-in alternative to HashList (see hash-list.h), with
+   the same interface as far as the decoders use it (Clear(), GetList(),
+   Delete(), Find(), Insert(), SetSize() and Size()), but a more cache-friendly
+   layout.
+
+     - The hash is open-addressed with linear probing, and each slot stores
+       the key next to the pointer to its element, so Find() usually touches
+       one or two adjacent slots and never follows a pointer to compare keys.
+     - The elements of the current list are allocated consecutively from
+       large blocks, in insertion order, and the list is linked in that same
+       order, so iterating over the list is (nearly) a sequential scan of
+       memory.
+     - Clear() is constant time: each slot is stamped with a "generation"
+       number, and Clear() just increments the current generation.
+
+   The price is a restriction on how the elements returned by Clear() are
+   deleted: you must call Delete() on all of them before the next call to
+   Clear().  (Elements are not reused one by one; the whole block of elements
+   from the previous list is reused once they have all been deleted).  The
+   decoders always satisfy this, since they process and delete the previous
+   frame's tokens before moving on to the next frame.
+
+   Unlike HashList, there is no InsertMore() (we don't support duplicate keys),
+   and the key type I must be an integer type.
+
+   See flat-hash-list-test.cc for an example of use, and a speed comparison
+   with HashList.
+*/
+
+
+namespace kaldi {
+
+template<class I, class T> class FlatHashList {
+ public:
+  struct Elem {
+    I key;
+    T val;
+    Elem *tail;
+  };
+
+  FlatHashList();
+
+  /// Clears the hash and gives the head of the current list to the user; the
+  /// user must call Delete() for each element in the list before the next
+  /// call to Clear().
+  Elem *Clear();
+
+  /// Gives the head of the current list to the user.  Ownership retained in
+  /// the class.
+  const Elem *GetList() const { return list_head_; }
+
+  /// To be called for each Elem in the list returned by Clear(), when the
+  /// user has finished with it.
+  inline void Delete(Elem *e);
+
+  /// Finds this key in the current list using the hash; returns NULL if not
+  /// present.  The user is free to modify the "val" element of the Elem.
+  inline Elem *Find(I key);
+
+  /// Inserts a new element.  By calling this, the user asserts that it is not
+  /// already present (e.g. Find() was called and returned NULL).
+  inline void Insert(I key, T val);
+
+  /// Tells the object the number of hash slots to use (it is rounded up to a
+  /// power of two).  As for HashList, this should be at least twice the number
+  /// of elements expected, and it must be called while the hash is empty.  If
+  /// more elements than this are inserted, the hash grows automatically.
+  void SetSize(size_t sz);
+
+  /// Returns current number of hash slots.
+  inline size_t Size() { return slots_.size(); }
+
+  ~FlatHashList();
+
+ private:
+  struct Slot {
+    I key;
+    uint32 generation;  // slot is occupied iff generation == generation_.
+    Elem *elem;
+  };
+
+  // An Arena holds the elements of one list, allocated consecutively from
+  // blocks of kBlockSize elements.
+  struct Arena {
+    std::vector<Elem*> blocks;
+    size_t num_used;  // number of elements handed out.
+    size_t num_live;  // number of elements not yet deleted.
+    Arena(): num_used(0), num_live(0) { }
+  };
+
+  inline Elem *NewElem();
+
+  inline size_t HashIndex(I key) const {
+    return (static_cast<uint32>(key) * 2654435761U) >> shift_;
+  }
+
+  // Resizes the hash to "num_slots" slots (a power of two) and re-inserts the
+  // elements of the current list.
+  void Rehash(size_t num_slots);
+
+  static const size_t kBlockSize = 1024;
+
+  std::vector<Slot> slots_;
+  size_t mask_;  // slots_.size() - 1.
+  int32 shift_;  // 32 - log2(slots_.size()).
+  uint32 generation_;
+  size_t num_elems_;  // number of elements in the current list.
+
+  Elem *list_head_;
+  Elem *list_tail_;
+
+  // arenas_[cur_arena_] holds the current list, the other one the list that
+  // was most recently returned by Clear().
+  Arena arenas_[2];
+  int32 cur_arena_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FlatHashList);
+};
+
+
+} // end namespace kaldi
+
+#include "util/flat-hash-list-inl.h"
+
+#endif  // KALDI_UTIL_FLAT_HASH_LIST_H_
@@ -0,0 +1,211 @@
+// util/kaldi-archive-index.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "util/kaldi-archive-index.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+
+static const char kMagic[8] = { 'K', 'a', 'l', 'd', 'i', 'I', 'X', '\0' };
+static const int32 kVersion = 1;
+static const uint32 kByteOrder = 0x01020304;
+
+// Returns the size of the file in bytes, or -1 if it cannot be opened.
+static int64 FileSize(const std::string &filename) {
+  std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!is.is_open()) return -1;
+  is.seekg(0, std::ios::end);
+  return static_cast<int64>(is.tellg());
+}
+
+bool ArchiveIndex::IndexExists(const std::string &archive_rxfilename) {
+  if (ClassifyRxfilename(archive_rxfilename) != kFileInput)
+    return false;
+  std::ifstream is(IndexFilename(archive_rxfilename).c_str());
+  return is.is_open();
+}
+
+bool ArchiveIndex::Open(const std::string &archive_filename) {
+  Close();
+  std::string index_filename = IndexFilename(archive_filename);
+  if (!file_.Open(index_filename))
+    return false;  // MappedFile will have printed a warning.
+  const char *data = file_.Data();
+  size_t size = file_.Size();
+  const Header *header = reinterpret_cast<const Header*>(data);
+  if (size < sizeof(Header) || memcmp(header->magic, kMagic,
+                                      sizeof(kMagic)) != 0) {
+    KALDI_WARN << "File " << index_filename << " is not an archive index.";
+    Close();
+    return false;
+  }
+  if (header->byte_order != kByteOrder || header->version != kVersion) {
+    KALDI_WARN << "Archive index " << index_filename << " was written on a "
+               << "machine with a different byte order, or by a different "
+               << "version of Kaldi.";
+    Close();
+    return false;
+  }
+  if (header->num_entries < 0 || static_cast<uint64>(header->num_entries) >
+      (size - sizeof(Header)) / sizeof(Entry)) {
+    KALDI_WARN << "Archive index " << index_filename << " is truncated.";
+    Close();
+    return false;
+  }
+  size_t keys_offset = sizeof(Header) + sizeof(Entry) * header->num_entries;
+  int64 archive_size = FileSize(archive_filename);
+  if (archive_size != header->archive_size) {
+    KALDI_WARN << "Archive index " << index_filename << " does not match "
+               << "the archive (it is out of date?): archive size is "
+               << archive_size << ", expected " << header->archive_size;
+    Close();
+    return false;
+  }
+  // We don't check the entries here, as that would touch every page of the
+  // index; Lookup() and GetEntry() check each entry they use.
+  header_ = header;
+  entries_ = reinterpret_cast<const Entry*>(data + sizeof(Header));
+  keys_ = data + keys_offset;
+  keys_size_ = size - keys_offset;
+  filename_ = index_filename;
+  return true;
+}
+
+void ArchiveIndex::CheckEntry(int64 i) const {
+  // Check that the key is within the file and the object within the archive,
+  // so that a corrupted index can't make us read outside them.
+  const Entry &e = entries_[i];
+  int64 archive_size = header_->archive_size;
+  if (e.key_offset < 0 || e.key_length < 0 || e.key_offset > keys_size_ ||
+      e.key_length > keys_size_ - e.key_offset ||
+      e.offset < 0 || e.length < 0 || e.offset > archive_size ||
+      e.length > archive_size - e.offset)
+    KALDI_ERR << "Archive index " << filename_ << " is corrupted (bad entry "
+              << i << ").";
+}
+
+void ArchiveIndex::Close() {
+  file_.Close();
+  header_ = NULL;
+  entries_ = NULL;
+  keys_ = NULL;
+  keys_size_ = 0;
+  filename_.clear();
+}
+
+bool ArchiveIndex::Lookup(const std::string &key, int64 *offset,
+                          int64 *length) const {
+  KALDI_ASSERT(IsOpen());
+  // Binary search for the first entry whose key is not less than "key"; the
+  // keys are sorted as by std::string's operator <, which is what this
+  // comparison does.  We want the first, as a key may have several entries.
+  int64 lo = 0, hi = header_->num_entries;
+  while (lo < hi) {
+    int64 mid = lo + (hi - lo) / 2;
+    CheckEntry(mid);
+    const Entry &e = entries_[mid];
+    size_t n = std::min<size_t>(e.key_length, key.size());
+    int c = memcmp(keys_ + e.key_offset, key.data(), n);
+    if (c < 0 || (c == 0 && e.key_length < key.size()))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == header_->num_entries)
+    return false;
+  CheckEntry(lo);  // in case the search did not look at it.
+  const Entry &e = entries_[lo];
+  if (e.key_length != key.size() ||
+      memcmp(keys_ + e.key_offset, key.data(), key.size()) != 0)
+    return false;
+  *offset = e.offset;
+  *length = e.length;
+  return true;
+}
+
+void ArchiveIndex::GetEntry(int64 i, std::string *key, int64 *offset,
+                            int64 *length) const {
+  KALDI_ASSERT(IsOpen() && i >= 0 && i < header_->num_entries);
+  CheckEntry(i);
+  const Entry &e = entries_[i];
+  key->assign(keys_ + e.key_offset, e.key_length);
+  *offset = e.offset;
+  *length = e.length;
+}
+
+void ArchiveIndexWriter::Add(const std::string &key, int64 begin, int64 end) {
+  KALDI_ASSERT(end >= begin);
+  IndexEntry e;
+  e.key = key;
+  e.offset = begin;
+  e.length = end - begin;
+  entries_.push_back(e);
+}
+
+bool ArchiveIndexWriter::Write(const std::string &archive_filename,
+                               int64 archive_size) {
+  // stable_sort keeps repeated keys in the order they were written, so
+  // ArchiveIndex::Lookup() finds the first of them.  Repeated keys are only
+  // stored once.
+  std::stable_sort(entries_.begin(), entries_.end());
+  std::vector<ArchiveIndex::Entry> entries(entries_.size());
+  std::string keys;
+  for (size_t i = 0; i < entries_.size(); i++) {
+    ArchiveIndex::Entry &e = entries[i];
+    if (i > 0 && entries_[i].key == entries_[i-1].key) {
+      e.key_offset = entries[i-1].key_offset;
+    } else {
+      e.key_offset = keys.size();
+      keys += entries_[i].key;
+    }
+    e.offset = entries_[i].offset;
+    e.length = entries_[i].length;
+    e.key_length = entries_[i].key.size();
+    e.padding = 0;
+  }
+  ArchiveIndex::Header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrder;
+  header.num_entries = entries.size();
+  header.archive_size = archive_size;
+
+  std::string index_filename = ArchiveIndex::IndexFilename(archive_filename);
+  Output ko;
+  if (!ko.Open(index_filename, true, false)) {  // binary, no header.
+    KALDI_WARN << "Failed to open " << index_filename << " for writing.";
+    return false;
+  }
+  std::ostream &os = ko.Stream();
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!entries.empty())
+    os.write(reinterpret_cast<const char*>(&(entries[0])),
+             sizeof(ArchiveIndex::Entry) * entries.size());
+  os.write(keys.data(), keys.size());
+  if (!ko.Close()) {
+    KALDI_WARN << "Error writing archive index " << index_filename;
+    return false;
+  }
+  return true;
+}
+
+}  // end namespace kaldi
@@ -0,0 +1,159 @@
+// util/kaldi-archive-index.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_ARCHIVE_INDEX_H_
+#define KALDI_UTIL_KALDI_ARCHIVE_INDEX_H_
+
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "util/kaldi-mapped-file.h"
+
+namespace kaldi {
+
+/// \addtogroup table_impl_types
+/// @{
+
+/**
+   An archive index is a "sidecar" file, written alongside an archive (with
+   the name of the archive plus ".idx"), that gives for each key the byte
+   offset in the archive of the object (just after "key "), and its length in
+   bytes.  It is written by TableWriter if you give the "idx" option in the
+   wspecifier, e.g. "ark,idx:foo.ark" writes foo.ark and foo.ark.idx.
+   RandomAccessTableReader uses it automatically when reading an archive that
+   is an ordinary file and has an index, so it can seek straight to the
+   objects it is asked for, instead of reading the archive (and holding the
+   objects in memory) until it finds them.  This makes a big difference when
+   looking up a few keys in a large archive.
+
+   The index is a binary file in the native byte order: a header (see
+   ArchiveIndex::Header), then an array of ArchiveIndex::Entry sorted on the
+   key, then the keys themselves.  There is an entry for every object in the
+   archive, so if a key was written more than once it has several entries (in
+   the order they were written), which share the key.  It is memory-mapped,
+   and looking up a key is a binary search; each entry is checked (that it
+   points within the index and the archive) when it is used, so opening an
+   index doesn't have to read all of it.  The header records the
+   size of the archive, so an index that is out of date because the archive
+   was rewritten is (in most cases) detected and ignored.
+*/
+class ArchiveIndex {
+ public:
+  ArchiveIndex(): header_(NULL), entries_(NULL), keys_(NULL),
+                  keys_size_(0) { }
+
+  /// Returns the filename of the index of the archive "archive_filename".
+  static std::string IndexFilename(const std::string &archive_filename) {
+    return archive_filename + ".idx";
+  }
+
+  /// Returns true if "archive_rxfilename" is an ordinary file (see
+  /// ClassifyRxfilename()), and there is a file where its index would be.
+  static bool IndexExists(const std::string &archive_rxfilename);
+
+  /// Opens the index of the archive "archive_filename", and checks its header
+  /// and that it matches the archive's size.  Returns true on success; on
+  /// failure prints a warning and returns false.
+  bool Open(const std::string &archive_filename);
+
+  bool IsOpen() const { return header_ != NULL; }
+
+  void Close();
+
+  /// If "key" is in the index, outputs the offset and length (in bytes) of
+  /// its object in the archive and returns true; otherwise returns false.  If
+  /// the key was written more than once, this gives the first of them (as
+  /// RandomAccessTableReader would without the index).  Throws if an entry
+  /// it looks at is corrupted.
+  bool Lookup(const std::string &key, int64 *offset, int64 *length) const;
+
+  /// Returns the number of entries, which is the number of objects in the
+  /// archive.
+  int64 NumEntries() const { return IsOpen() ? header_->num_entries : 0; }
+
+  /// Outputs the key, and the offset and length of its object, of entry i of
+  /// the index, for 0 <= i < NumEntries(); the entries are sorted on the
+  /// key.  Throws if the entry is corrupted.
+  void GetEntry(int64 i, std::string *key, int64 *offset,
+                int64 *length) const;
+
+  // The on-disk header.
+  struct Header {
+    char magic[8];  // kMagic.
+    int32 version;
+    uint32 byte_order;  // in the native byte order of the writer.
+    int64 num_entries;
+    int64 archive_size;  // size of the archive in bytes.
+  };
+
+  // The on-disk representation of an entry.
+  struct Entry {
+    int64 key_offset;  // offset of the key in the keys section.
+    int64 offset;  // offset of the object in the archive.
+    int64 length;  // length of the object in bytes.
+    int32 key_length;
+    int32 padding;
+  };
+
+ private:
+  // Throws if entry i points outside the keys section or the archive.
+  void CheckEntry(int64 i) const;
+
+  MappedFile file_;
+  const Header *header_;
+  const Entry *entries_;
+  const char *keys_;
+  int64 keys_size_;  // size of the keys section in bytes.
+  std::string filename_;  // the index filename, for error messages.
+};
+
+
+/// ArchiveIndexWriter is used by TableWriter to create an archive index (see
+/// ArchiveIndex); you give it the keys and positions as you write them, and
+/// it writes the index when you call Write().
+class ArchiveIndexWriter {
+ public:
+  /// Adds the object for "key", which occupies bytes [begin, end) of the
+  /// archive.
+  void Add(const std::string &key, int64 begin, int64 end);
+
+  /// Writes the index of the archive "archive_filename", which has size
+  /// "archive_size" bytes.  Returns true on success; on failure, prints a
+  /// warning and returns false.
+  bool Write(const std::string &archive_filename, int64 archive_size);
+
+  void Clear() { entries_.clear(); }
+
+ private:
+  struct IndexEntry {
+    std::string key;
+    int64 offset;
+    int64 length;
+    bool operator < (const IndexEntry &other) const {
+      return key < other.key;
+    }
+  };
+  std::vector<IndexEntry> entries_;
+};
+
+/// @} end "addtogroup table_impl_types"
+
+}  // end namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_ARCHIVE_INDEX_H_
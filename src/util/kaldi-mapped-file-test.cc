@@ -0,0 +1,79 @@
+// util/kaldi-mapped-file-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/kaldi-mapped-file.h"
+#include "util/kaldi-io.h"
+#include <cstring>
+#include <sstream>
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+namespace kaldi {
+
+void UnitTestMappedFile() {
+  const char *filename = "tmpf.mapped";
+  std::string contents;
+  int32 size = Rand() % 3000000;
+  for (int32 i = 0; i < size; i++)
+    contents.push_back(static_cast<char>(Rand() % 256));
+  {
+    Output ko(filename, true, false);
+    ko.Stream().write(contents.data(), contents.size());
+  }
+  std::vector<std::string> rxfilenames;
+  rxfilenames.push_back(filename);  // will be mapped.
+  rxfilenames.push_back(std::string("cat ") + filename + " |");  // read.
+  rxfilenames.push_back(std::string(filename) + ":0");  // read.
+  for (size_t i = 0; i < rxfilenames.size(); i++) {
+    MappedFile mf;
+    KALDI_ASSERT(mf.Open(rxfilenames[i]));
+#ifndef _MSC_VER
+    KALDI_ASSERT(mf.IsMapped() == (i == 0 && size != 0));
+#endif
+    KALDI_ASSERT(mf.Size() == contents.size());
+    KALDI_ASSERT(reinterpret_cast<size_t>(mf.Data()) % 8 == 0);
+    if (size != 0)
+      KALDI_ASSERT(memcmp(mf.Data(), contents.data(), size) == 0);
+    mf.Close();
+    KALDI_ASSERT(mf.Size() == 0 && mf.Data() == NULL);
+  }
+  {
+    std::istringstream is(contents);
+    MappedFile mf;
+    KALDI_ASSERT(mf.Read(is) && !mf.IsMapped());
+    KALDI_ASSERT(mf.Size() == contents.size());
+    if (size != 0)
+      KALDI_ASSERT(memcmp(mf.Data(), contents.data(), size) == 0);
+  }
+  {
+    MappedFile mf;
+    KALDI_ASSERT(!mf.Open("tmpf.nonexistent"));
+  }
+  unlink(filename);
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 5; i++)
+    UnitTestMappedFile();
+  std::cout << "Test OK.\n";
+}
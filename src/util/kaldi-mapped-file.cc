@@ -0,0 +1,110 @@
+// util/kaldi-mapped-file.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/kaldi-mapped-file.h"
+#include "util/kaldi-io.h"
+
+#include <cstring>
+#include <errno.h>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kaldi {
+
+bool MappedFile::Open(const std::string &rxfilename) {
+  Close();
+  if (ClassifyRxfilename(rxfilename) == kFileInput && Map(rxfilename))
+    return true;
+  Input ki;
+  if (!ki.Open(rxfilename)) {
+    KALDI_WARN << "Failed to open " << PrintableRxfilename(rxfilename);
+    return false;
+  }
+  if (!Read(ki.Stream())) {
+    KALDI_WARN << "Failed to read data from "
+               << PrintableRxfilename(rxfilename);
+    return false;
+  }
+  return true;
+}
+
+bool MappedFile::Map(const std::string &filename) {
+#ifdef _MSC_VER
+  return false;
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) return false;  // Open() will print the error.
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);  // the mapping stays valid after the file is closed.
+  if (addr == MAP_FAILED) {
+    KALDI_WARN << "Failed to memory-map " << filename << ", will read it "
+               << "instead: " << strerror(errno);
+    return false;
+  }
+  data_ = static_cast<const char*>(addr);
+  size_ = st.st_size;
+  mapped_ = true;
+  return true;
+#endif
+}
+
+bool MappedFile::Read(std::istream &is) {
+  Close();
+  const size_t kChunkSize = 1 << 20;  // must be a multiple of 8.
+  size_t size = 0;
+  while (is.good()) {
+    buffer_.resize((size + kChunkSize) / sizeof(uint64));
+    is.read(reinterpret_cast<char*>(&(buffer_[0])) + size, kChunkSize);
+    size += is.gcount();
+  }
+  if (is.bad()) {
+    Close();
+    return false;
+  }
+  buffer_.resize((size + sizeof(uint64) - 1) / sizeof(uint64));
+  size_ = size;
+  data_ = (size == 0 ? NULL : reinterpret_cast<const char*>(&(buffer_[0])));
+  mapped_ = false;
+  return true;
+}
+
+void MappedFile::Close() {
+#ifndef _MSC_VER
+  if (mapped_ && data_ != NULL) {
+    if (munmap(const_cast<char*>(data_), size_) != 0)
+      KALDI_WARN << "munmap() failed: " << strerror(errno);
+  }
+#endif
+  std::vector<uint64> empty;
+  buffer_.swap(empty);
+  data_ = NULL;
+  size_ = 0;
+  mapped_ = false;
+}
+
+}  // end namespace kaldi
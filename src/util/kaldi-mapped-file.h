@@ -0,0 +1,103 @@
+// util/kaldi-mapped-file.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_MAPPED_FILE_H_
+#define KALDI_UTIL_KALDI_MAPPED_FILE_H_
+
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// \addtogroup io_group
+/// @{
+
+/// MappedFile gives read-only access to the whole contents of a file as a
+/// block of memory.  If the rxfilename is an ordinary file (kFileInput, see
+/// ClassifyRxfilename()), the file is memory-mapped, so "reading" it is
+/// nearly free, the pages are only read from disk when they are touched, and
+/// processes that map the same file share the same physical memory through
+/// the page cache.  For other kinds of rxfilename (pipes, the standard input,
+/// "file:offset" specifiers), and on platforms without mmap(), we fall back to
+/// reading the contents into memory, so the caller doesn't have to care.
+///
+/// The data is always at least 8-byte aligned.
+class MappedFile {
+ public:
+  MappedFile(): data_(NULL), size_(0), mapped_(false) { }
+
+  /// Opens "rxfilename" as described above.  Returns true on success; on
+  /// failure, prints a warning and returns false.
+  bool Open(const std::string &rxfilename);
+
+  /// Reads the rest of the stream "is" into memory (this never maps).
+  /// Returns true on success.
+  bool Read(std::istream &is);
+
+  /// Unmaps or frees the data.  Called by the destructor.
+  void Close();
+
+  const char *Data() const { return data_; }
+
+  size_t Size() const { return size_; }
+
+  /// True if the data is memory-mapped (as opposed to read into memory).
+  bool IsMapped() const { return mapped_; }
+
+  ~MappedFile() { Close(); }
+ private:
+  // Tries to mmap() the file; returns false if that is not possible.
+  bool Map(const std::string &filename);
+
+  const char *data_;
+  size_t size_;
+  bool mapped_;
+  // Holds the data if it was read rather than mapped; we use uint64 to make
+  // sure it is suitably aligned.
+  std::vector<uint64> buffer_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+/// MemoryInputStream is an std::istream that reads from a block of memory,
+/// such as part of a MappedFile, without copying it.  The memory must not be
+/// freed while the stream exists.
+class MemoryInputStream: public std::istream {
+ public:
+  MemoryInputStream(const char *data, size_t size):
+      std::istream(NULL), buffer_(data, size) { rdbuf(&buffer_); }
+ private:
+  class Buffer: public std::streambuf {
+   public:
+    Buffer(const char *data, size_t size) {
+      char *begin = const_cast<char*>(data);  // we never write to it.
+      setg(begin, begin, begin + size);
+    }
+  };
+  Buffer buffer_;
+};
+
+/// @} end "addtogroup io_group"
+
+}  // end namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_MAPPED_FILE_H_
@@ -26,6 +26,8 @@
 #include "util/kaldi-io.h"
 #include "util/text-utils.h"
 #include "util/stl-utils.h" // for StringHasher.
+#include "util/kaldi-archive-index.h"
+#include "util/kaldi-mapped-file.h"
 
 
 namespace kaldi {
@@ -507,6 +509,204 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
 };
 
 
+// SequentialTableReaderShuffledArchiveImpl is the implementation for
+// SequentialTableReader with the "shuffle" option: it reads the objects of an
+// archive that has an index (see ArchiveIndex) in a random order.  The
+// archive is memory-mapped and divided into blocks of consecutive objects, of
+// about "block_size" bytes each.  We visit the blocks in a random order, read
+// the objects of each block in the order they are in the archive (so the
+// reads are sequential, and the pages can be read ahead), and output them in
+// a random order.  Only the objects of the current block are kept in memory.
+template<class Holder>  class SequentialTableReaderShuffledArchiveImpl:
+      public SequentialTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  explicit SequentialTableReaderShuffledArchiveImpl(
+      int64 block_size = kDefaultBlockSize):
+      block_size_(block_size), next_block_(0), pos_(0), error_(false) {
+    KALDI_ASSERT(block_size > 0);
+  }
+
+  virtual bool Open(const std::string &rspecifier) {
+    if (IsOpen())
+      if (!Close())  // call Close() yourself to suppress this exception.
+        KALDI_ERR << "TableReader::Open, error closing previous input: "
+                  << "rspecifier was " << rspecifier_;
+    rspecifier_ = rspecifier;
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &archive_rxfilename_,
+                                           &opts_);
+    KALDI_ASSERT(rs == kArchiveRspecifier && opts_.shuffle);
+    if (ClassifyRxfilename(archive_rxfilename_) != kFileInput) {
+      KALDI_WARN << "The shuffle option requires the archive to be an actual "
+                 << "file: rspecifier is " << rspecifier;
+      return false;
+    }
+    if (!index_.Open(archive_rxfilename_)) {
+      KALDI_WARN << "The shuffle option requires the archive to have an "
+                 << "up-to-date index (write it with ark,idx:...): "
+                 << "rspecifier is " << rspecifier;
+      return false;
+    }
+    if (!archive_.Open(archive_rxfilename_)) {
+      index_.Close();
+      return false;  // it will have printed a warning.
+    }
+    // The index is sorted on the key, so we sort the entries on their offset
+    // in the archive, and divide them into blocks.
+    std::vector<std::pair<int64, int64> > offsets(index_.NumEntries());
+    std::string key;
+    for (size_t i = 0; i < offsets.size(); i++) {
+      int64 length;
+      index_.GetEntry(i, &key, &(offsets[i].first), &length);
+      offsets[i].second = i;
+    }
+    std::sort(offsets.begin(), offsets.end());
+    entries_.resize(offsets.size());
+    blocks_.clear();
+    for (size_t i = 0; i < offsets.size(); i++) {
+      entries_[i] = offsets[i].second;
+      if (blocks_.empty() ||
+          offsets[i].first - offsets[blocks_.back().first].first >= block_size_)
+        blocks_.push_back(std::make_pair(i, i + 1));
+      else
+        blocks_.back().second = i + 1;
+    }
+    std::random_shuffle(blocks_.begin(), blocks_.end());
+    next_block_ = 0;
+    error_ = false;
+    LoadNextBlock();
+    return true;
+  }
+
+  virtual bool IsOpen() const { return index_.IsOpen(); }
+
+  virtual bool Done() const {
+    KALDI_ASSERT(IsOpen());
+    return error_ || pos_ == objects_.size();
+  }
+
+  virtual std::string Key() {
+    KALDI_ASSERT(IsOpen() && !Done());
+    return objects_[pos_].first;
+  }
+
+  virtual const T &Value() {
+    KALDI_ASSERT(IsOpen() && !Done());
+    if (objects_[pos_].second == NULL)
+      KALDI_ERR << "Value() called after FreeCurrent(), rspecifier is "
+                << rspecifier_;
+    return objects_[pos_].second->Value();
+  }
+
+  virtual void FreeCurrent() {
+    KALDI_ASSERT(IsOpen() && !Done());
+    delete objects_[pos_].second;
+    objects_[pos_].second = NULL;
+  }
+
+  virtual void Next() {
+    KALDI_ASSERT(IsOpen() && !Done());
+    FreeCurrent();
+    if (++pos_ == objects_.size())
+      LoadNextBlock();
+  }
+
+  virtual bool Close() {
+    if (!IsOpen())
+      KALDI_ERR << "Close() called on TableReader twice or otherwise wrongly.";
+    index_.Close();
+    archive_.Close();
+    ClearObjects();
+    entries_.clear();
+    blocks_.clear();
+    next_block_ = 0;
+    // Like the other archive reader, we report an error if an object could
+    // not be read, unless the "permissive" option was given.
+    bool ans = !error_;
+    error_ = false;
+    return ans;
+  }
+
+  virtual ~SequentialTableReaderShuffledArchiveImpl() {
+    if (IsOpen() && !Close())
+      KALDI_ERR << "TableReader: error detected closing archive "
+                << PrintableRxfilename(archive_rxfilename_);
+  }
+
+  // The default size of the blocks in bytes.
+  static const int64 kDefaultBlockSize = 1 << 25;
+
+ private:
+  void ClearObjects() {
+    for (size_t i = 0; i < objects_.size(); i++)
+      delete objects_[i].second;
+    objects_.clear();
+    pos_ = 0;
+  }
+
+  // Reads the objects of the next block that has any we can read, and
+  // shuffles them.  If an object cannot be read, in permissive mode it is
+  // skipped, and otherwise we set error_.
+  void LoadNextBlock() {
+    ClearObjects();
+    for (; objects_.empty() && next_block_ < blocks_.size(); next_block_++) {
+      for (size_t i = blocks_[next_block_].first;
+           i < blocks_[next_block_].second; i++) {
+        std::string key;
+        int64 offset, length;
+        index_.GetEntry(entries_[i], &key, &offset, &length);
+        // As a check that the index matches the archive, we make sure the key
+        // (followed by a space) precedes the object.
+        const char *data = archive_.Data();
+        int64 key_begin = offset - static_cast<int64>(key.size()) - 1;
+        if (key_begin < 0 ||
+            offset + length > static_cast<int64>(archive_.Size()) ||
+            key.compare(0, key.size(), data + key_begin, key.size()) != 0 ||
+            !isspace(data[offset - 1])) {
+          KALDI_WARN << "Archive index does not match archive (key " << key
+                     << "): rspecifier is " << rspecifier_;
+        } else {
+          MemoryInputStream is(data + offset, length);
+          Holder *holder = new Holder;
+          if (holder->Read(is)) {
+            objects_.push_back(std::make_pair(key, holder));
+            continue;
+          }
+          delete holder;
+          KALDI_WARN << "Object read failed for key " << key
+                     << ", reading archive "
+                     << PrintableRxfilename(archive_rxfilename_);
+        }
+        if (!opts_.permissive) {
+          error_ = true;
+          ClearObjects();
+          return;
+        }
+      }
+    }
+    std::random_shuffle(objects_.begin(), objects_.end());
+  }
+
+  int64 block_size_;
+  ArchiveIndex index_;
+  MappedFile archive_;
+  std::vector<int64> entries_;  // the index entries, sorted on the offset.
+  // The blocks, as ranges [begin, end) of entries_, in the order in which
+  // we read them.
+  std::vector<std::pair<size_t, size_t> > blocks_;
+  size_t next_block_;  // the next block of blocks_ to read.
+  // The keys and objects of the current block, in the order we output them;
+  // the object is NULL after FreeCurrent().
+  std::vector<std::pair<std::string, Holder*> > objects_;
+  size_t pos_;  // our position in objects_.
+  bool error_;  // true if we failed to read an object (not in permissive mode).
+  std::string rspecifier_;
+  std::string archive_rxfilename_;
+  RspecifierOptions opts_;
+};
+
+
 template<class Holder>
 SequentialTableReader<Holder>::SequentialTableReader(const std::string &rspecifier): impl_(NULL) {
   if (rspecifier != "" && !Open(rspecifier))
@@ -520,12 +720,21 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
       KALDI_ERR << "Could not close previously open object.";
   // now impl_ will be NULL.
 
-  RspecifierType wt = ClassifyRspecifier(rspecifier, NULL, NULL);
+  RspecifierOptions opts;
+  RspecifierType wt = ClassifyRspecifier(rspecifier, NULL, &opts);
   switch (wt) {
     case kArchiveRspecifier:
-      impl_ = new SequentialTableReaderArchiveImpl<Holder>();
+      if (opts.shuffle)
+        impl_ = new SequentialTableReaderShuffledArchiveImpl<Holder>();
+      else
+        impl_ = new SequentialTableReaderArchiveImpl<Holder>();
       break;
     case kScriptRspecifier:
+      if (opts.shuffle) {
+        KALDI_WARN << "The shuffle option is only supported for archives: "
+                   << "rspecifier is " << rspecifier;
+        return false;
+      }
       impl_ = new SequentialTableReaderScriptImpl<Holder>();
       break;
     case kNoRspecifier: default:
@@ -656,6 +865,12 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
                                            NULL,
                                            &opts_);
     KALDI_ASSERT(ws == kArchiveWspecifier);  // or wrongly called.
+    if (opts_.index && ClassifyWxfilename(archive_wxfilename_) != kFileOutput) {
+      KALDI_WARN << "Not writing an archive index as the archive is not an "
+                 << "actual file: wspecifier = " << wspecifier;
+      opts_.index = false;
+    }
+    index_writer_.Clear();
 
     if (output_.Open(archive_wxfilename_, opts_.binary, false)) {  // false means no binary header.
       state_ = kOpen;
@@ -695,12 +910,16 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
     if (!IsToken(key)) // e.g. empty string or has spaces...
       KALDI_ERR << "TableWriter: using invalid key " << key;
     output_.Stream() << key << ' ';
+    int64 begin = (opts_.index ? static_cast<int64>(output_.Stream().tellp()) :
+                   0);
     if (!Holder::Write(output_.Stream(), opts_.binary, value)) {
       KALDI_WARN << "TableWriter: write failure to "
                  << PrintableWxfilename(archive_wxfilename_);
       state_ = kWriteError;
       return false;
     }
+    if (opts_.index)
+      index_writer_.Add(key, begin, output_.Stream().tellp());
     if (state_ == kWriteError) return false;  // Even if this Write seems to have
     // succeeded, we fail because a previous Write failed and the archive may be
     // corrupted and unreadable.
@@ -725,7 +944,12 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
   virtual bool Close() {
     if (!this->IsOpen() || !output_.IsOpen())
       KALDI_ERR << "TableWriter: Close called on a stream that was not open." << this->IsOpen() << ", " << output_.IsOpen();
+    int64 archive_size = (opts_.index ?
+                          static_cast<int64>(output_.Stream().tellp()) : 0);
     bool close_success = output_.Close();
+    if (close_success && state_ != kWriteError && opts_.index)
+      close_success = index_writer_.Write(archive_wxfilename_, archive_size);
+    index_writer_.Clear();
     if (!close_success) {
       KALDI_WARN << "TableWriter: error closing stream: wspecifier is "
                  << wspecifier_;
@@ -757,6 +981,7 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
   WspecifierOptions opts_;
   std::string wspecifier_;
   std::string archive_wxfilename_;
+  ArchiveIndexWriter index_writer_;  // used if opts_.index.
   enum {               // is stream open?
     kUninitialized,    // no
     kOpen,             // yes
@@ -945,10 +1170,13 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
                                            &script_wxfilename_,
                                            &opts_);
     KALDI_ASSERT(ws == kBothWspecifier);  // or wrongly called.
-    if (ClassifyWxfilename(archive_wxfilename_) != kFileOutput)
+    if (ClassifyWxfilename(archive_wxfilename_) != kFileOutput) {
       KALDI_WARN << "When writing to both archive and script, the script file "
           "will generally not be interpreted correctly unless the archive is "
           "an actual file: wspecifier = " << wspecifier;
+      opts_.index = false;  // we can't write an index either.
+    }
+    index_writer_.Clear();
 
     if (!archive_output_.Open(archive_wxfilename_, opts_.binary, false)) {  // false means no binary header.
       state_ = kUninitialized;
@@ -1022,6 +1250,8 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
       state_ = kWriteError;
       return false;
     }
+    if (opts_.index)
+      index_writer_.Add(key, archive_os_pos, archive_os.tellp());
 
     if (script_os.fail()) {
       KALDI_WARN << "TableWriter: write failure to script file detected: "
@@ -1063,11 +1293,18 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
     if (!this->IsOpen())
       KALDI_ERR << "TableWriter: Close called on a stream that was not open.";
     bool close_success = true;
-    if (archive_output_.IsOpen())
+    int64 archive_size = 0;
+    if (archive_output_.IsOpen()) {
+      if (opts_.index)
+        archive_size = archive_output_.Stream().tellp();
       if (!archive_output_.Close()) close_success = false;
+    }
     if (script_output_.IsOpen())
       if (!script_output_.Close()) close_success = false;
     bool ans = close_success && (state_ != kWriteError);
+    if (ans && opts_.index)
+      ans = index_writer_.Write(archive_wxfilename_, archive_size);
+    index_writer_.Clear();
     state_ = kUninitialized;
     return ans;
   }
@@ -1090,6 +1327,7 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
   std::string archive_wxfilename_;
   std::string script_wxfilename_;
   std::string wspecifier_;
+  ArchiveIndexWriter index_writer_;  // used if opts_.index.
   enum {               // is stream open?
     kUninitialized,    // no
     kOpen,             // yes
@@ -2080,6 +2318,131 @@ template<class Holder>  class RandomAccessTableReaderUnsortedArchiveImpl:
 
 
 
+// RandomAccessTableReaderIndexedArchiveImpl is the implementation for
+// random-access reading of archives that have an index (see ArchiveIndex in
+// kaldi-archive-index.h).  It looks up the key in the index and seeks to the
+// object, so it never has to read more of the archive than the objects it is
+// asked for, and it only keeps the most recently read object in memory.  The
+// "sorted", "called_sorted" and "once" options make no difference to it.
+template<class Holder>  class RandomAccessTableReaderIndexedArchiveImpl:
+      public RandomAccessTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  RandomAccessTableReaderIndexedArchiveImpl(): have_object_(false) { }
+
+  virtual bool Open(const std::string &rspecifier) {
+    if (index_.IsOpen())
+      KALDI_ERR << "Opening already open RandomAccessTableReader: call Close "
+                << "first.";
+    rspecifier_ = rspecifier;
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &archive_rxfilename_,
+                                           &opts_);
+    KALDI_ASSERT(rs == kArchiveRspecifier);
+    if (ClassifyRxfilename(archive_rxfilename_) != kFileInput) {
+      KALDI_WARN << "Cannot use an archive index unless the archive is an "
+                 << "actual file: rspecifier is " << rspecifier;
+      return false;
+    }
+    if (!index_.Open(archive_rxfilename_))
+      return false;  // it will have printed a warning.
+    bool ans;
+    if (Holder::IsReadInBinary())
+      ans = input_.Open(archive_rxfilename_, NULL);
+    else
+      ans = input_.OpenTextMode(archive_rxfilename_);
+    if (!ans) {
+      KALDI_WARN << "TableReader: failed to open stream "
+                 << PrintableRxfilename(archive_rxfilename_);
+      index_.Close();
+      return false;
+    }
+    return true;
+  }
+
+  virtual bool HasKey(const std::string &key) {
+    if (opts_.permissive)  // make sure we can read it.
+      return LoadObject(key);
+    int64 offset, length;
+    return index_.Lookup(key, &offset, &length);
+  }
+
+  virtual const T &Value(const std::string &key) {
+    if (!LoadObject(key))
+      KALDI_ERR << "Could not get item for key " << key
+                << ", rspecifier is " << rspecifier_;
+    return holder_.Value();
+  }
+
+  virtual bool Close() {
+    if (!index_.IsOpen())
+      KALDI_ERR << "Close() called on RandomAccessTableReader that was not "
+                << "open.";
+    index_.Close();
+    if (input_.IsOpen())
+      input_.Close();
+    holder_.Clear();
+    have_object_ = false;
+    cur_key_ = "";
+    return true;
+  }
+
+  virtual ~RandomAccessTableReaderIndexedArchiveImpl() {
+    if (index_.IsOpen())
+      Close();
+  }
+
+ private:
+  // Makes sure holder_ has the object for "key", reading it from the archive
+  // if necessary.  Returns false if the key is not in the index, or the
+  // object could not be read.
+  bool LoadObject(const std::string &key) {
+    if (have_object_ && key == cur_key_)
+      return true;
+    int64 offset, length;
+    if (!index_.Lookup(key, &offset, &length))
+      return false;
+    have_object_ = false;
+    holder_.Clear();
+    std::istream &is = input_.Stream();
+    is.clear();
+    // As a check that the index matches the archive, we make sure the key
+    // (followed by a space) precedes the object.
+    int64 key_begin = offset - static_cast<int64>(key.size()) - 1;
+    std::string archive_key(key.size() + 1, ' ');
+    if (key_begin < 0 ||
+        !is.seekg(key_begin) ||
+        !is.read(&(archive_key[0]), archive_key.size()) ||
+        archive_key.compare(0, key.size(), key) != 0 ||
+        !isspace(archive_key[key.size()])) {
+      KALDI_WARN << "Archive index does not match archive (key " << key
+                 << "): rspecifier is " << rspecifier_;
+      return false;
+    }
+    if (!holder_.Read(is)) {
+      KALDI_WARN << "Object read failed for key " << key
+                 << ", reading archive "
+                 << PrintableRxfilename(archive_rxfilename_);
+      holder_.Clear();
+      return false;
+    }
+    cur_key_ = key;
+    have_object_ = true;
+    return true;
+  }
+
+  ArchiveIndex index_;
+  Input input_;
+  Holder holder_;
+  bool have_object_;  // true if holder_ has the object for cur_key_.
+  std::string cur_key_;
+  std::string rspecifier_;
+  std::string archive_rxfilename_;
+  RspecifierOptions opts_;
+};
+
+
+
 template<class Holder>
 RandomAccessTableReader<Holder>::RandomAccessTableReader(const std::string &rspecifier):
     impl_(NULL) {
@@ -2093,12 +2456,28 @@ bool RandomAccessTableReader<Holder>::Open(const std::string &rspecifier) {
   if (IsOpen())
     KALDI_ERR << "Already open.";
   RspecifierOptions opts;
-  RspecifierType rs = ClassifyRspecifier(rspecifier, NULL, &opts);
+  std::string rxfilename;
+  RspecifierType rs = ClassifyRspecifier(rspecifier, &rxfilename, &opts);
   switch (rs) {
     case kScriptRspecifier:
       impl_ = new RandomAccessTableReaderScriptImpl<Holder>();
       break;
     case kArchiveRspecifier:
+      if (opts.index || ArchiveIndex::IndexExists(rxfilename)) {
+        impl_ = new RandomAccessTableReaderIndexedArchiveImpl<Holder>();
+        if (impl_->Open(rspecifier))
+          return true;
+        delete impl_;
+        impl_ = NULL;
+        if (opts.index) {
+          KALDI_WARN << "Could not use the index of the archive (you "
+                     << "specified the idx option): rspecifier is "
+                     << rspecifier;
+          return false;
+        }
+        // The index is out of date or unusable, and a warning will have been
+        // printed; read the archive without it.
+      }
       if (opts.sorted) {
         if (opts.called_sorted) // "doubly" sorted case.
           impl_ = new RandomAccessTableReaderDSortedArchiveImpl<Holder>();
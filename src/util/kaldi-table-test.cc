@@ -164,6 +164,12 @@ void UnitTestClassifyWspecifier() {
     KALDI_ASSERT(ans == kBothWspecifier && ark == "" && scp == "" && opts.binary == true && opts.flush == false);
   }
 
+  {
+    std::string a = "ark,idx:foo";
+    std::string ark = "x", scp = "y"; WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, &ark, &scp, &opts);
+    KALDI_ASSERT(ans == kArchiveWspecifier && ark == "foo" && opts.index);
+  }
 
 }
 
@@ -313,6 +319,19 @@ void UnitTestClassifyRspecifier() {
     RspecifierType ans = ClassifyRspecifier(a, &b, NULL);
     KALDI_ASSERT(ans == kArchiveRspecifier && b == "a");
   }
+  {
+    std::string a = "idx,ark:a", b;
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &b, &opts);
+    KALDI_ASSERT(ans == kArchiveRspecifier && b == "a" && opts.index);
+  }
+  {
+    std::string a = "shuffle,ark:a", b;
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &b, &opts);
+    KALDI_ASSERT(ans == kArchiveRspecifier && b == "a" && opts.shuffle &&
+                 !opts.index);
+  }
 
 
 }
@@ -879,6 +898,240 @@ void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
 }
 
 
+// Tests random access to an archive with an index, written with either the
+// ark or the ark,scp wspecifier.
+void UnitTestTableRandomIndexedDoubleMatrix(bool binary, bool write_scp,
+                                            bool permissive) {
+  int32 sz = Rand() % 20;
+  std::vector<std::string> k;
+  std::vector<Matrix<double> > v;
+  for (int32 i = 0; i < sz; i++) {
+    k.push_back("key" + CharToString('a' + static_cast<char>(i)));
+    if (i % 2 == 0) k.back() += CharToString('a' + i);  // different lengths.
+    v.resize(v.size() + 1);
+    v.back().Resize(1 + Rand() % 3, 1 + Rand() % 3);
+    v.back().SetRandn();
+  }
+  RandomizeVector(&k);
+
+  std::string wspecifier = binary ? "b,idx," : "t,idx,";
+  wspecifier += write_scp ? "ark,scp:tmpf,tmpf.scp" : "ark:tmpf";
+  DoubleMatrixWriter bw(wspecifier);
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[i], v[i]);
+  KALDI_ASSERT(bw.Close());
+
+  {
+    ArchiveIndex index;
+    KALDI_ASSERT(ArchiveIndex::IndexExists("tmpf") && index.Open("tmpf"));
+    KALDI_ASSERT(index.NumEntries() == sz);
+  }
+
+  RandomAccessDoubleMatrixReader sbr(permissive ? "p,ark:tmpf" :
+                                     "idx,ark:tmpf");
+  for (int32 n = 0; n < 2 * sz; n++) {
+    int32 i = Rand() % sz;
+    KALDI_ASSERT(sbr.HasKey(k[i]));
+    KALDI_ASSERT(v[i].ApproxEqual(sbr.Value(k[i]), binary ? 1.0e-10 : 0.01));
+  }
+  KALDI_ASSERT(!sbr.HasKey("foo"));
+  KALDI_ASSERT(sbr.Close());
+
+  if (sz > 0) {
+    // If the archive is rewritten without the index, the index is out of date
+    // and should be ignored.
+    DoubleMatrixWriter bw2("ark:tmpf");
+    bw2.Write(k[0], v[0]);
+    KALDI_ASSERT(bw2.Close());
+    RandomAccessDoubleMatrixReader sbr2("ark:tmpf");
+    KALDI_ASSERT(sbr2.HasKey(k[0]) && !(sz > 1 && sbr2.HasKey(k[1])));
+    RandomAccessDoubleMatrixReader sbr3;
+    KALDI_ASSERT(!sbr3.Open("idx,ark:tmpf"));
+  }
+  unlink("tmpf");
+  unlink("tmpf.scp");
+  unlink("tmpf.idx");
+}
+
+// Tests reading an archive with an index in a random order, with the "shuffle"
+// option.
+void UnitTestTableSequentialShuffledDoubleMatrix(bool binary) {
+  int32 sz = Rand() % 20;
+  std::vector<std::string> k;
+  std::vector<Matrix<double> > v;
+  for (int32 i = 0; i < sz; i++) {
+    k.push_back("key" + CharToString('a' + static_cast<char>(i)));
+    if (i % 2 == 0) k.back() += CharToString('a' + i);  // different lengths.
+    v.resize(v.size() + 1);
+    v.back().Resize(1 + Rand() % 3, 1 + Rand() % 3);
+    v.back().SetRandn();
+  }
+
+  DoubleMatrixWriter bw(binary ? "b,idx,ark:tmpf" : "t,idx,ark:tmpf");
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[i], v[i]);
+  KALDI_ASSERT(bw.Close());
+
+  std::vector<bool> seen(sz, false);
+  SequentialDoubleMatrixReader sbr("shuffle,ark:tmpf");
+  for (; !sbr.Done(); sbr.Next()) {
+    std::vector<std::string>::iterator iter =
+        std::find(k.begin(), k.end(), sbr.Key());
+    KALDI_ASSERT(iter != k.end());
+    int32 i = iter - k.begin();
+    KALDI_ASSERT(!seen[i]);
+    seen[i] = true;
+    KALDI_ASSERT(v[i].ApproxEqual(sbr.Value(), binary ? 1.0e-10 : 0.01));
+  }
+  KALDI_ASSERT(sbr.Close());
+  KALDI_ASSERT(std::count(seen.begin(), seen.end(), true) == sz);
+
+  // With small blocks, so the archive is divided into several.
+  SequentialTableReaderShuffledArchiveImpl<KaldiObjectHolder<Matrix<double> > >
+      small_block_reader(1 + Rand() % 100);
+  KALDI_ASSERT(small_block_reader.Open("shuffle,ark:tmpf"));
+  std::fill(seen.begin(), seen.end(), false);
+  for (; !small_block_reader.Done(); small_block_reader.Next()) {
+    std::vector<std::string>::iterator iter =
+        std::find(k.begin(), k.end(), small_block_reader.Key());
+    KALDI_ASSERT(iter != k.end());
+    int32 i = iter - k.begin();
+    KALDI_ASSERT(!seen[i]);
+    seen[i] = true;
+    KALDI_ASSERT(v[i].ApproxEqual(small_block_reader.Value(),
+                                  binary ? 1.0e-10 : 0.01));
+  }
+  KALDI_ASSERT(small_block_reader.Close());
+  KALDI_ASSERT(std::count(seen.begin(), seen.end(), true) == sz);
+
+  // Without the index, it should fail.
+  unlink("tmpf.idx");
+  SequentialDoubleMatrixReader sbr2;
+  KALDI_ASSERT(!sbr2.Open("shuffle,ark:tmpf"));
+  unlink("tmpf");
+}
+
+// Tests an indexed archive in which a key is written twice: the index has an
+// entry for each object, random access gives the first one, and the "shuffle"
+// option reads both.
+void UnitTestTableIndexedRepeatedKey(bool binary) {
+  std::vector<std::string> k;
+  k.push_back("b");
+  k.push_back("a");
+  k.push_back("c");
+  k.push_back("a");
+  std::vector<Matrix<double> > v(k.size());
+  for (size_t i = 0; i < k.size(); i++) {
+    v[i].Resize(1 + Rand() % 3, 1 + Rand() % 3);
+    v[i].SetRandn();
+  }
+  DoubleMatrixWriter bw(binary ? "b,idx,ark:tmpf" : "t,idx,ark:tmpf");
+  for (size_t i = 0; i < k.size(); i++)
+    bw.Write(k[i], v[i]);
+  KALDI_ASSERT(bw.Close());
+  BaseFloat tolerance = (binary ? 1.0e-10 : 0.01);
+
+  {
+    ArchiveIndex index;
+    KALDI_ASSERT(index.Open("tmpf") && index.NumEntries() == 4);
+    std::string key;
+    int64 offset, length, first_offset, first_length;
+    index.GetEntry(0, &key, &first_offset, &first_length);
+    KALDI_ASSERT(key == "a");
+    index.GetEntry(1, &key, &offset, &length);
+    KALDI_ASSERT(key == "a" && offset > first_offset);
+    KALDI_ASSERT(index.Lookup("a", &offset, &length) &&
+                 offset == first_offset && length == first_length);
+    KALDI_ASSERT(!index.Lookup("aa", &offset, &length) &&
+                 !index.Lookup("", &offset, &length) &&
+                 !index.Lookup("d", &offset, &length));
+  }
+  {
+    RandomAccessDoubleMatrixReader sbr("idx,ark:tmpf");
+    KALDI_ASSERT(v[1].ApproxEqual(sbr.Value("a"), tolerance));
+    KALDI_ASSERT(v[0].ApproxEqual(sbr.Value("b"), tolerance));
+  }
+  {
+    std::vector<bool> seen(k.size(), false);
+    SequentialDoubleMatrixReader sbr("shuffle,ark:tmpf");
+    for (; !sbr.Done(); sbr.Next()) {
+      size_t i = 0;
+      for (; i < k.size(); i++)
+        if (!seen[i] && k[i] == sbr.Key() &&
+            SameDim(v[i], sbr.Value()) &&
+            v[i].ApproxEqual(sbr.Value(), tolerance))
+          break;
+      KALDI_ASSERT(i < k.size());
+      seen[i] = true;
+    }
+    KALDI_ASSERT(std::count(seen.begin(), seen.end(), true) == 4);
+  }
+  unlink("tmpf");
+  unlink("tmpf.idx");
+}
+
+// Tests that ArchiveIndex throws when it uses an entry that points outside
+// the keys or outside the archive.
+void UnitTestTableIndexCorrupted() {
+  DoubleMatrixWriter bw("b,idx,ark:tmpf");
+  Matrix<double> m(2, 2);
+  bw.Write("foo", m);
+  bw.Write("bar", m);
+  KALDI_ASSERT(bw.Close());
+  std::string index_str;
+  {
+    std::ifstream is("tmpf.idx", std::ios::in | std::ios::binary);
+    std::ostringstream os;
+    os << is.rdbuf();
+    index_str = os.str();
+  }
+  ArchiveIndex index;
+  KALDI_ASSERT(index.Open("tmpf"));
+  index.Close();
+  for (int32 i = 0; i < 5; i++) {
+    // Corrupt one field of the second entry.
+    ArchiveIndex::Entry e;
+    size_t entry_offset = sizeof(ArchiveIndex::Header) + sizeof(e);
+    std::string str(index_str);
+    memcpy(&e, str.data() + entry_offset, sizeof(e));
+    switch (i) {
+      case 0: e.key_offset = -1; break;
+      case 1: e.key_length = 1000; break;
+      case 2: e.key_offset = 1000000; break;
+      case 3: e.offset = 1000000; break;  // the archive is much smaller.
+      default: e.length = -1; break;
+    }
+    str.replace(entry_offset, sizeof(e), reinterpret_cast<const char*>(&e),
+                sizeof(e));
+    {
+      std::ofstream os("tmpf.idx", std::ios::out | std::ios::binary);
+      os << str;
+    }
+    // The entries are only checked when they are used.
+    KALDI_ASSERT(index.Open("tmpf"));
+    std::string key;
+    int64 offset, length;
+    index.GetEntry(0, &key, &offset, &length);
+    KALDI_ASSERT(key == "bar");
+    bool threw = false;
+    try {
+      index.Lookup("foo", &offset, &length);
+    } catch (const std::runtime_error &e) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw);
+    threw = false;
+    try {
+      index.GetEntry(1, &key, &offset, &length);
+    } catch (const std::runtime_error &e) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw);
+    index.Close();
+  }
+  unlink("tmpf");
+  unlink("tmpf.idx");
+}
 
 }  // end namespace kaldi.
 
@@ -893,6 +1146,9 @@ int main() {
     UnitTestTableSequentialInt32(b);
     UnitTestTableSequentialInt32Script(b);
     UnitTestTableSequentialDouble(b);
+    UnitTestTableSequentialShuffledDoubleMatrix(b);
+    UnitTestTableIndexedRepeatedKey(b);
+    UnitTestTableIndexCorrupted();
     for (int j = 0; j < 2; j++) {
       bool c = (j == 0);
       UnitTestTableSequentialDoubleBoth(b, c);
@@ -911,6 +1167,7 @@ int main() {
             UnitTestTableRandomBothDoubleMatrix (b, c, d, e, f);
           }
         }
+        UnitTestTableRandomIndexedDoubleMatrix(b, c, d);
       }
     }
   }
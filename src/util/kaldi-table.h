@@ -70,12 +70,17 @@ typedef std::vector<std::string> KeyList;
 //  p means permissive mode, when writing to an "scp" file only: will ignore
 //     missing scp entries, i.e. won't write anything for those files but will
 //     return success status).
+//  idx means write an index of the archive, in a file with ".idx" appended to
+//     the archive filename (only if the archive is an actual file).  A
+//     RandomAccessTableReader reading the archive will use the index
+//     automatically; see ArchiveIndex in kaldi-archive-index.h.
 //
 //  So the following are valid wspecifiers:
 //  ark,b,f:foo
 //  "ark,b,b:| gzip -c > foo"
 //  "ark,scp,t,nf:foo.ark,|gzip -c > foo.scp.gz"
 //  ark,b:-
+//  ark,idx:foo.ark
 //
 //  The meanings of rxfilename and wxfilename are as described in
 //  kaldi-stream.h (they are filenames but include pipes, stdin/stdout
@@ -113,7 +118,9 @@ struct WspecifierOptions {
   bool binary;
   bool flush;
   bool permissive; // will ignore absent scp entries.
-  WspecifierOptions(): binary(true), flush(false), permissive(false) { }
+  bool index;  // write an archive index (foo.ark.idx).
+  WspecifierOptions(): binary(true), flush(false), permissive(false),
+                       index(false) { }
 };
 
 // ClassifyWspecifier returns the type of the wspecifier string,
@@ -179,6 +186,18 @@ bool WriteScriptFile(std::ostream &os,
 //      [any of the above options can be prefixed by n to negate them, e.g. no, ns,
 //       ncs, np; but these aren't currently useful as you could just omit the option].
 //
+//   idx means that the archive must have an index (see the "idx" option for
+//       wspecifiers); RandomAccessTableReader will fail to open it if the index
+//       is missing or out of date.  Without this option, the index is used if
+//       it is present and up to date, so the option is not normally needed.
+//
+//   shuffle means that SequentialTableReader reads the objects of the archive
+//       in a random order (from std::random_shuffle, so it depends on srand()).
+//       The archive must be an actual file with an index; it is
+//       memory-mapped, so only the current object is held in memory however
+//       large the archive is.  If a key occurs more than once, all of its
+//       objects are read.
+//
 //   b   is ignored [for scripting convenience]
 //   t   is ignored [for scripting convenience]
 //
@@ -198,9 +217,13 @@ struct  RspecifierOptions {
   // For archive files it will suppress errors getting thrown if the archive
   
   // is corrupted and can't be read to the end.
+  bool index;  // we assert that the archive has an up-to-date index.
+  // This option only makes a difference for the SequentialTableReader class.
+  bool shuffle;  // read the objects of an indexed archive in a random order.
 
   RspecifierOptions(): once(false), sorted(false),
-                       called_sorted(false), permissive(false) { }
+                       called_sorted(false), permissive(false), index(false),
+                       shuffle(false) { }
 };
 
 enum RspecifierType  {
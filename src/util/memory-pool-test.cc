@@ -0,0 +1,94 @@
+// util/memory-pool-test.cc
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/memory-pool.h"
+#include <set>
+
+namespace kaldi {
+
+struct TestPoolObject {
+  int32 a;
+  double b;
+  TestPoolObject *next;
+  TestPoolObject(int32 a, double b): a(a), b(b), next(NULL) { }
+};
+
+template<class T> void TestMemoryPoolSimple() {
+  MemoryPool<T> pool(1 + Rand() % 10);
+  std::vector<T*> objects;
+  for (int32 i = 0; i < 100; i++)
+    objects.push_back(pool.Allocate());
+  KALDI_ASSERT(pool.NumInUse() == 100 && pool.PeakInUse() == 100 &&
+               pool.NumAllocated() >= 100);
+  std::set<T*> distinct(objects.begin(), objects.end());
+  KALDI_ASSERT(distinct.size() == objects.size());
+  for (size_t i = 0; i < objects.size(); i++)
+    pool.Free(objects[i]);
+  KALDI_ASSERT(pool.NumInUse() == 0 && pool.PeakInUse() == 100);
+  size_t num_allocated = pool.NumAllocated();
+  // Storage should be reused, not reallocated.
+  for (int32 i = 0; i < 100; i++)
+    objects[i] = pool.Allocate();
+  KALDI_ASSERT(pool.NumAllocated() == num_allocated);
+  for (size_t i = 0; i < objects.size(); i++)
+    pool.Free(objects[i]);
+  pool.ResetPeak();
+  KALDI_ASSERT(pool.PeakInUse() == 0);
+}
+
+void TestMemoryPoolRandom() {
+  MemoryPool<TestPoolObject> pool(1 + Rand() % 100);
+  std::vector<TestPoolObject*> objects;
+  size_t peak = 0;
+  for (int32 i = 0; i < 10000; i++) {
+    if (objects.empty() || Rand() % 3 != 0) {
+      int32 a = Rand();
+      objects.push_back(new (pool.Allocate()) TestPoolObject(a, 0.5 * a));
+    } else {
+      size_t j = Rand() % objects.size();
+      TestPoolObject *obj = objects[j];
+      KALDI_ASSERT(obj->b == 0.5 * obj->a && obj->next == NULL);
+      obj->~TestPoolObject();
+      pool.Free(obj);
+      objects[j] = objects.back();
+      objects.pop_back();
+    }
+    peak = std::max(peak, objects.size());
+    KALDI_ASSERT(pool.NumInUse() == objects.size());
+  }
+  KALDI_ASSERT(pool.PeakInUse() == peak);
+  for (size_t i = 0; i < objects.size(); i++) {
+    KALDI_ASSERT(objects[i]->b == 0.5 * objects[i]->a);
+    pool.Free(objects[i]);
+  }
+}
+
+} // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 5; i++) {
+    TestMemoryPoolSimple<char>();
+    TestMemoryPoolSimple<int32>();
+    TestMemoryPoolSimple<TestPoolObject>();
+    TestMemoryPoolRandom();
+  }
+  std::cout << "Test OK.\n";
+}
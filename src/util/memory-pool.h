@@ -0,0 +1,126 @@
+// util/memory-pool.h
+
+// Copyright 2015  Johns Hopkins University (Author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_MEMORY_POOL_H_
+#define KALDI_UTIL_MEMORY_POOL_H_
+
+#include <new>
+#include <vector>
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/* MemoryPool<T> hands out storage for objects of a single type T, allocating
+   it from the system in blocks of many objects and keeping freed objects on a
+   free list for reuse; the memory is only returned to the system when the pool
+   is destroyed.  It is intended for objects that are created and destroyed in
+   very large numbers, like the Tokens and ForwardLinks in the decoders, where
+   going through the general-purpose allocator each time is slow and, in
+   multi-threaded programs, causes contention on the allocator's lock.  This is
+   the same idea as the Elem allocation inside HashList (see hash-list.h).
+
+   T must not need stricter alignment than a pointer or a double does.
+   The class is not thread-safe: each thread (e.g. each decoder object) should
+   have its own pool.  It only supplies memory; you construct and destroy
+   the objects yourself, e.g.:
+   \code
+     Token *tok = new (token_pool.Allocate()) Token(cost, 0.0, NULL, NULL);
+     ...
+     tok->~Token();  // not needed if Token has a trivial destructor.
+     token_pool.Free(tok);
+   \endcode
+*/
+template<class T> class MemoryPool {
+ public:
+  /// "block_size" is the number of objects we allocate at a time.
+  explicit MemoryPool(size_t block_size = 1024):
+      block_size_(block_size), free_head_(NULL), num_in_use_(0),
+      peak_in_use_(0) {
+    KALDI_ASSERT(block_size > 0);
+  }
+
+  /// Returns uninitialized storage for one object of type T.
+  inline T *Allocate() {
+    if (free_head_ == NULL) AllocateBlock();
+    FreeElem *ans = free_head_;
+    free_head_ = ans->next;
+    if (++num_in_use_ > peak_in_use_) peak_in_use_ = num_in_use_;
+    return reinterpret_cast<T*>(ans);
+  }
+
+  /// Returns the storage for "t" to the pool; any destructor must already
+  /// have been called.  "t" must have come from Allocate() on this object.
+  inline void Free(T *t) {
+    FreeElem *e = reinterpret_cast<FreeElem*>(t);
+    e->next = free_head_;
+    free_head_ = e;
+    num_in_use_--;
+  }
+
+  /// Number of objects currently allocated and not yet freed.
+  size_t NumInUse() const { return num_in_use_; }
+
+  /// The largest value NumInUse() has had since construction (or since the
+  /// last call to ResetPeak()).
+  size_t PeakInUse() const { return peak_in_use_; }
+
+  /// Number of objects the pool currently has memory for.
+  size_t NumAllocated() const { return blocks_.size() * block_size_; }
+
+  void ResetPeak() { peak_in_use_ = num_in_use_; }
+
+  ~MemoryPool() {
+    if (num_in_use_ != 0)
+      KALDI_WARN << "MemoryPool destroyed while " << num_in_use_
+                 << " objects are still in use (code error?)";
+    for (size_t i = 0; i < blocks_.size(); i++)
+      ::operator delete(blocks_[i]);
+  }
+
+ private:
+  // Free objects have their storage reused to hold the free list.
+  union FreeElem {
+    FreeElem *next;
+    double align;  // makes sure the storage is suitably aligned.
+    char storage[sizeof(T)];
+  };
+
+  void AllocateBlock() {
+    FreeElem *block = static_cast<FreeElem*>(
+        ::operator new(sizeof(FreeElem) * block_size_));
+    for (size_t i = 0; i + 1 < block_size_; i++)
+      block[i].next = block + i + 1;
+    block[block_size_ - 1].next = free_head_;
+    free_head_ = block;
+    blocks_.push_back(block);
+  }
+
+  size_t block_size_;
+  FreeElem *free_head_;  // head of the list of free objects.
+  std::vector<FreeElem*> blocks_;  // the blocks we allocated.
+  size_t num_in_use_;
+  size_t peak_in_use_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MemoryPool);
+};
+
+
+} // end namespace kaldi
+
+#endif  // KALDI_UTIL_MEMORY_POOL_H_